@@ -0,0 +1,42 @@
+#ifndef AHO_CORASICK_H
+#define AHO_CORASICK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Case-insensitive multi-literal matcher (one pass over the text).
+typedef struct AhoCorasick AhoCorasick;
+
+// Create an empty automaton. Returns NULL on allocation failure.
+AhoCorasick *aho_corasick_create(void);
+
+// Add a non-empty literal that reports id when found. Returns 0 on success.
+int aho_corasick_add(AhoCorasick *automaton, const char *literal, size_t id);
+
+// Build the automaton after all literals were added. Returns 0 on success.
+int aho_corasick_build(AhoCorasick *automaton);
+
+// Scan text and set marks[id] = 1 for every literal found.
+// marks must hold one entry per id passed to aho_corasick_add.
+void aho_corasick_mark(const AhoCorasick *automaton,
+                       const char *text,
+                       size_t length,
+                       unsigned char *marks);
+
+// Find the first literal in text. Returns true and sets *end to the offset
+// just past it, false if text contains none of the literals.
+bool aho_corasick_find(const AhoCorasick *automaton, const char *text, size_t length, size_t *end);
+
+// Write the built automaton as a flat image to out and return its size;
+// with out == NULL only the size is returned. Returns 0 if not built.
+size_t aho_corasick_serialize(const AhoCorasick *automaton, void *out);
+
+// Use an image written by aho_corasick_serialize without copying it. data
+// must be 8-byte aligned and outlive the automaton. Returns NULL if the
+// image is malformed or reports an id >= id_count.
+AhoCorasick *aho_corasick_load(const void *data, size_t size, size_t id_count);
+
+// Free the automaton.
+void aho_corasick_destroy(AhoCorasick *automaton);
+
+#endif /* AHO_CORASICK_H */
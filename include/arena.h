@@ -0,0 +1,37 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Bump allocator: small allocations are carved out of large blocks and
+// all of them are released together by arena_destroy, so storing many
+// short strings costs one malloc per block instead of one per string.
+// Not synchronized.
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+    ArenaBlock *blocks;
+    size_t block_size;
+    // Blocks allocated so far.
+    uint64_t allocations;
+} Arena;
+
+// Start an empty arena whose blocks hold block_size bytes (larger
+// allocations get a block of their own).
+void arena_init(Arena *arena, size_t block_size);
+
+// Free every block.
+void arena_destroy(Arena *arena);
+
+// Release every allocation but keep one block for the next ones, so an
+// arena that is filled and reset over and over stops allocating.
+void arena_reset(Arena *arena);
+
+// size bytes aligned for any type, or NULL on allocation failure.
+void *arena_alloc(Arena *arena, size_t size);
+
+// Copy of text in the arena, or NULL on allocation failure.
+char *arena_copy_string(Arena *arena, const char *text);
+
+#endif /* ARENA_H */
@@ -0,0 +1,68 @@
+#ifndef BLOCK_RULE_H
+#define BLOCK_RULE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Secrets that span lines: a match of a multi-line rule opens a block that
+// is followed line by line until it ends, so the whole block can be
+// reported without keeping its text. The state is a few counters, whatever
+// the size of the block.
+typedef enum {
+    BLOCK_RULE_NONE = 0,
+    // "-----BEGIN ...-----" up to the next "-----END ...-----".
+    BLOCK_RULE_PEM,
+    // The JSON object the match is in, up to its closing brace.
+    BLOCK_RULE_JSON,
+    // A YAML block scalar ("key: |" or "key: >"): the lines indented
+    // deeper than the key.
+    BLOCK_RULE_YAML
+} block_rule_kind_t;
+
+typedef enum {
+    // The match does not open a block (a YAML value on the same line):
+    // report it as it is.
+    BLOCK_RULE_SINGLE = 0,
+    BLOCK_RULE_OPEN,
+    BLOCK_RULE_CLOSED,
+    // No end within BLOCK_RULE_MAX_LINES lines or before the input ended.
+    BLOCK_RULE_UNTERMINATED
+} block_rule_status_t;
+
+// Lines after the opening one that a block may take.
+#define BLOCK_RULE_MAX_LINES 256
+
+typedef struct {
+    block_rule_kind_t kind;
+    // Lines fed since the opening line.
+    size_t lines;
+    // Where the block ends: lines after the opening one, and the column
+    // just past its last byte.
+    size_t end_lines;
+    size_t end_column;
+    // BLOCK_RULE_JSON: open braces and string state.
+    size_t depth;
+    bool in_string;
+    bool escaped;
+    // BLOCK_RULE_YAML: indentation of the key.
+    size_t indent;
+} BlockState;
+
+// Start a block of kind for the match line[start..end). line has no
+// newline. The rest of the line is looked at too, so a block can close on
+// its opening line (an escaped PEM key in a JSON string).
+block_rule_status_t block_rule_open(BlockState *state,
+                                    block_rule_kind_t kind,
+                                    const char *line,
+                                    size_t length,
+                                    size_t start,
+                                    size_t end);
+
+// Feed the next line (without its newline) to an open block.
+block_rule_status_t block_rule_next_line(BlockState *state, const char *line, size_t length);
+
+// The input ended with the block open. A YAML block ends there; the others
+// are unterminated.
+block_rule_status_t block_rule_finish(BlockState *state);
+
+#endif /* BLOCK_RULE_H */
@@ -0,0 +1,58 @@
+#ifndef BYTE_CLASS_H
+#define BYTE_CLASS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Byte classification kernels for the scanner's hot loops: the binary file
+// check, line counting and separator search. Each has an AVX2 and an SSE2
+// version, picked at run time, and portable code elsewhere; all of them
+// give the same results.
+
+// Sets with at most this many bytes are matched with compares by the SSE2
+// kernel, which has no byte shuffle; larger ones use the table there.
+#define BYTE_CLASS_SET_LIST 8
+
+// A set of bytes, e.g. the characters of a token or the separators of
+// key/value pairs. Fill it with byte_class_set_init; the fields belong to
+// the kernels.
+typedef struct {
+    // 1 if the byte is in the set.
+    unsigned char table[256];
+    // Bit h & 7 of low[l] (h < 8) or high_low[l] (h >= 8) is set if byte
+    // h * 16 + l is in the set: two nibble lookups per byte.
+    unsigned char low[16];
+    unsigned char high_low[16];
+    unsigned char list[BYTE_CLASS_SET_LIST];
+    size_t count;
+} ByteClassSet;
+
+// Fill set from members, where members[byte] is nonzero for bytes in it.
+void byte_class_set_init(ByteClassSet *set, const unsigned char members[256]);
+
+// Bytes in data that is_binary_buffer counts against a file: control
+// characters other than tab, newline, vertical tab, form feed and carriage
+// return (0x00-0x08 and 0x0E-0x1F).
+size_t byte_class_count_control(const unsigned char *data, size_t length);
+
+// Offset of the first NUL byte in data, or length if there is none.
+size_t byte_class_find_nul(const unsigned char *data, size_t length);
+
+// Occurrences of byte in text, e.g. the newlines of a run of lines.
+size_t byte_class_count(const char *text, size_t length, char byte);
+
+// Last occurrence of byte in text[0..length), or NULL. Like the GNU
+// extension memrchr.
+const char *byte_class_find_last(const char *text, size_t length, char byte);
+
+// Offset of the first byte of data in set, or length if there is none.
+size_t byte_class_find_set(const ByteClassSet *set, const unsigned char *data, size_t length);
+
+// Kernel in use: "avx2", "sse2" or "scalar".
+const char *byte_class_kernel(void);
+
+// Switch every caller to kernel name, e.g. to compare kernels. Returns
+// false if this build or CPU does not have it.
+bool byte_class_use_kernel(const char *name);
+
+#endif /* BYTE_CLASS_H */
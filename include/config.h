@@ -3,10 +3,19 @@
 
 #include <stdbool.h>
 
+#include "rules.h"
+#include "scanner.h"
+
 #define APP_NAME "SecretGuard"
 #define APP_VERSION "0.1.0"
 #define DEFAULT_MAX_DEPTH -1
 #define DEFAULT_THREADS 0
+#define MAX_LINE_CACHE_MB 4096
+#define MAX_LINE_LENGTH_KB (1024 * 1024)
+#define MIN_IO_BUFFER_KB 4
+#define MAX_IO_BUFFER_KB (64 * 1024)
+#define DEFAULT_SPLIT_MB 64
+#define MAX_SPLIT_MB (1024 * 1024)
 
 typedef struct {
     char *root_path;
@@ -15,6 +24,36 @@ typedef struct {
     bool json_output;
     int threads;
     char *output_path;
+    rules_engine_t engine;
+    bool profile_rules;
+    // Scan every file with every rule instead of skipping and routing by
+    // file type (see file_type.h).
+    bool all_files;
+    // Scan binary files for printable strings instead of skipping them.
+    bool scan_binaries;
+    char *rules_path;
+    // Comma-separated rule names or globs; repeated options are joined.
+    char *rules_include;
+    char *rules_exclude;
+    severity_t min_severity;
+    // HIGH_ENTROPY_STRING detector; a threshold of 0 turns it off.
+    double entropy_threshold;
+    int entropy_min_length;
+    // Per-worker repeated-line cache in MiB; 0 turns it off.
+    int line_cache_mb;
+    // Long line guard: lines over max_line_kb KiB are handled by
+    // long_lines; 0 turns it off.
+    int max_line_kb;
+    rules_long_line_t long_lines;
+    // How files are read and the size of one read in KiB.
+    scanner_io_t io;
+    int io_buffer_kb;
+    // With several threads, files of at least split_mb MiB and standard
+    // input are scanned in parts by all of them; 0 turns it off.
+    int split_mb;
+    // "compile-rules" mode: write the compiled rules to bundle_path.
+    bool compile_rules;
+    char *bundle_path;
 } Config;
 
 void init_config(Config *config);
@@ -0,0 +1,49 @@
+#ifndef ENTROPY_H
+#define ENTROPY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Rule name and severity of the findings.
+#define ENTROPY_RULE_NAME "HIGH_ENTROPY_STRING"
+#define ENTROPY_DEFAULT_THRESHOLD 4.5
+#define ENTROPY_DEFAULT_MIN_LENGTH 20
+// Longer runs are blobs such as embedded images rather than credentials.
+#define ENTROPY_MAX_LENGTH 256
+
+// Finds unlabeled credentials: maximal runs of base64/base62/hex
+// characters ([A-Za-z0-9+/=_-]) that mix letters and digits and whose
+// Shannon entropy reaches a threshold. Runs are located with a vectorized
+// byte classification (AVX2 or SSE2, picked at run time, or a table
+// lookup elsewhere), so text without long runs costs one pass of compares.
+typedef struct EntropyDetector EntropyDetector;
+
+// threshold is in bits per character for base64 runs; runs of hex digits
+// only need two thirds of it, as their alphabet carries 4 bits instead of
+// 6. Runs shorter than min_length are ignored. Returns NULL on invalid
+// arguments or allocation failure.
+EntropyDetector *entropy_detector_create(double threshold, size_t min_length);
+
+// Free the detector.
+void entropy_detector_destroy(EntropyDetector *detector);
+
+// First high-entropy run in text[from..length). A run that starts before
+// from is skipped. Returns true and fills start/end if found.
+bool entropy_detector_next(const EntropyDetector *detector,
+                           const char *text,
+                           size_t length,
+                           size_t from,
+                           size_t *start,
+                           size_t *end);
+
+// Classification kernel in use: "avx2", "sse2" or "scalar".
+const char *entropy_detector_kernel(const EntropyDetector *detector);
+
+// Switch to kernel name, e.g. to compare kernels. Returns false if this
+// build or CPU does not have it.
+bool entropy_detector_use_kernel(EntropyDetector *detector, const char *name);
+
+// Shannon entropy of text in bits per byte.
+double entropy_bits(const char *text, size_t length);
+
+#endif /* ENTROPY_H */
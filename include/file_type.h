@@ -0,0 +1,36 @@
+#ifndef FILE_TYPE_H
+#define FILE_TYPE_H
+
+#include <stddef.h>
+
+// What a file is, decided before its lines are matched so irrelevant files
+// are not read and rules only run where they can match.
+typedef enum {
+    // No hint: every rule runs. This includes source code, plain text,
+    // logs and configuration (.env, YAML, TOML, XML, ...), which can hold
+    // pasted or embedded JSON.
+    FILE_TYPE_UNKNOWN = 0,
+    // Text that cannot hold JSON: PEM keys and certificates, SSH keys and
+    // password files (*.pem, *.crt, id_rsa, .netrc, ...). Rules flagged
+    // json do not run.
+    FILE_TYPE_TEXT,
+    // JSON documents, such as service_account.json or *.ipynb.
+    FILE_TYPE_JSON,
+    // Known-irrelevant formats: images, fonts, media, archives and
+    // lockfiles. Not scanned.
+    FILE_TYPE_SKIP,
+    // Binary content: compiled code by name or signature (*.class, *.so,
+    // ELF, ...) and anything is_binary_buffer flags. Skipped, or scanned
+    // for printable strings with --scan-binaries.
+    FILE_TYPE_BINARY
+} file_type_t;
+
+// Classify path by its file name and extension alone.
+file_type_t file_type_from_path(const char *path);
+
+// Refine type with the first bytes of the file: a known signature gives
+// FILE_TYPE_SKIP (PNG, JPEG, ZIP, WOFF, ...) or FILE_TYPE_BINARY (ELF,
+// Mach-O, Java class, WebAssembly), anything else keeps type.
+file_type_t file_type_sniff(file_type_t type, const unsigned char *head, size_t length);
+
+#endif /* FILE_TYPE_H */
@@ -0,0 +1,31 @@
+#ifndef GENERATED_RULES_H
+#define GENERATED_RULES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Matchers generated at build time from include/default_rules.def by
+// tools/rules_codegen.c. Indices run over the generated rules only.
+
+// Number of rules with a generated matcher.
+size_t generated_rules_count(void);
+
+// Generated index for pattern/flags, or -1 if the rule was not generated.
+int generated_rules_lookup(const char *pattern, int flags);
+
+// Shortest text the rule can match.
+size_t generated_rules_min_length(size_t index);
+
+// NULL-terminated list of lowercase literals of which every match of rule
+// index contains at least one (case-insensitively); empty if there are none.
+const char *const *generated_rules_literals(size_t index);
+
+// Set marks[index] = 1 for every generated rule with a match in text.
+// Position 0 is the start of the line for '^'.
+void generated_rules_mark(const char *text, size_t length, unsigned char *marks);
+
+// Leftmost-longest match of rule index with the same semantics as regexec
+// on text[0..length). Returns true and fills start/end if found.
+bool generated_rules_find(size_t index, const char *text, size_t length, size_t *start, size_t *end);
+
+#endif /* GENERATED_RULES_H */
@@ -0,0 +1,39 @@
+#ifndef IO_RING_H
+#define IO_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A small io_uring wrapper (raw system calls, no liburing) for keeping
+// several opens and reads in flight from one thread. Requests are queued,
+// submitted together, and their completions are taken in the order they
+// finish, each with the user_data it was queued with. Not synchronized;
+// give each thread its own ring.
+typedef struct IoRing IoRing;
+
+// Create a ring for up to entries requests in flight. Returns NULL if
+// io_uring is unavailable (old kernel, seccomp, not Linux) or on failure.
+IoRing *io_ring_create(unsigned entries);
+
+// Unmap and close the ring. Requests still in flight are abandoned.
+void io_ring_destroy(IoRing *ring);
+
+// Whether this process can use io_uring at all.
+bool io_ring_supported(void);
+
+// Queue openat(AT_FDCWD, path, flags) or pread(fd, buffer, length,
+// offset). path and buffer must stay valid until the completion is taken.
+// Returns -1 if the submission queue is full.
+int io_ring_queue_open(IoRing *ring, const char *path, int flags, uint64_t user_data);
+int io_ring_queue_read(IoRing *ring, int fd, void *buffer, size_t length, uint64_t offset, uint64_t user_data);
+
+// Submit the queued requests and wait until at least wait_for completions
+// are ready. Returns 0 on success, -1 on error.
+int io_ring_submit(IoRing *ring, unsigned wait_for);
+
+// Take the next completion: its user_data and result (a file descriptor
+// or byte count, or -errno). Returns false if none is ready.
+bool io_ring_next(IoRing *ring, uint64_t *user_data, int *result);
+
+#endif /* IO_RING_H */
@@ -0,0 +1,58 @@
+#ifndef KV_TOKENIZER_H
+#define KV_TOKENIZER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "pattern.h"
+
+// Key/value rules of the shape
+//     [(^|BOUNDARY)]KEY[[:space:]]*SEPARATOR VALUE
+// where KEY is a small finite set of words (such as (access|refresh)?_?token
+// or "type" with its quotes) and SEPARATOR is ':' or '='. Instead of one
+// search per rule, one pass visits every separator in a line, walks left
+// over the key and looks each suffix up in a perfect hash of the keys of
+// all rules. Positions found this way are candidates: every match starts
+// at one, and the rule's own matcher confirms the value.
+typedef struct KvTokenizer KvTokenizer;
+
+// Create an empty tokenizer. Returns NULL on allocation failure.
+KvTokenizer *kv_tokenizer_create(void);
+
+// Add pattern as rule id if it has the key/value shape. Returns 1 if it
+// was added, 0 if the pattern has another shape, -1 on allocation failure.
+int kv_tokenizer_add(KvTokenizer *tokenizer, const PatternNode *pattern, size_t id);
+
+// Build the key table after all rules were added. Returns 0 on success.
+int kv_tokenizer_build(KvTokenizer *tokenizer);
+
+// Number of rules added; rule index i was added with id kv_tokenizer_id(i).
+size_t kv_tokenizer_count(const KvTokenizer *tokenizer);
+size_t kv_tokenizer_id(const KvTokenizer *tokenizer, size_t index);
+
+// One pass: set marks[id] = 1 for every rule with a candidate in text.
+// Position 0 is the start of the line for '^'.
+void kv_tokenizer_mark(const KvTokenizer *tokenizer, const char *text, size_t length, unsigned char *marks);
+
+// Smallest candidate start >= from of rule index in text[0..length).
+// Returns false if there is none.
+bool kv_tokenizer_next(const KvTokenizer *tokenizer,
+                       size_t index,
+                       const char *text,
+                       size_t length,
+                       size_t from,
+                       size_t *start);
+
+// Write the built tokenizer as a flat image to out and return its size;
+// with out == NULL only the size is returned. Returns 0 if not built.
+size_t kv_tokenizer_serialize(const KvTokenizer *tokenizer, void *out);
+
+// Use an image written by kv_tokenizer_serialize without copying it. data
+// must be 8-byte aligned and outlive the tokenizer. Returns NULL if the
+// image is malformed or holds an id >= id_count.
+KvTokenizer *kv_tokenizer_load(const void *data, size_t size, size_t id_count);
+
+// Free the tokenizer.
+void kv_tokenizer_destroy(KvTokenizer *tokenizer);
+
+#endif /* KV_TOKENIZER_H */
@@ -0,0 +1,98 @@
+#ifndef LAZY_DFA_H
+#define LAZY_DFA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pattern.h"
+
+// Compiled multi-pattern program (Thompson NFA over byte classes).
+// Immutable after creation and safe to share between threads.
+typedef struct LazyDfa LazyDfa;
+
+// DFA states built on demand. One cache per thread; never shared.
+typedef struct LazyDfaCache LazyDfaCache;
+
+// True if the pattern is small enough to be compiled natively.
+bool lazy_dfa_supports(const PatternNode *pattern);
+
+// Compile patterns[0..count). Pattern i reports id i; NULL entries are skipped.
+// Returns NULL on allocation failure.
+LazyDfa *lazy_dfa_create(PatternNode *const *patterns, size_t count);
+
+// Like lazy_dfa_create, but lazy_dfa_mark only reports the ids with
+// marked[id] set; the others can still be searched. marked may be NULL.
+LazyDfa *lazy_dfa_create_with_marks(PatternNode *const *patterns, size_t count, const bool *marked);
+
+// Free a compiled program.
+void lazy_dfa_destroy(LazyDfa *dfa);
+
+// Write the program as a flat image to out and return its size; with
+// out == NULL only the size is returned.
+size_t lazy_dfa_serialize(const LazyDfa *dfa, void *out);
+
+// Use an image written by lazy_dfa_serialize without copying it. data must
+// be 8-byte aligned and outlive the program. Returns NULL if the image is
+// malformed or was not built for id_count pattern ids.
+LazyDfa *lazy_dfa_load(const void *data, size_t size, size_t id_count);
+
+// Create or free a state cache for dfa.
+LazyDfaCache *lazy_dfa_cache_create(const LazyDfa *dfa);
+void lazy_dfa_cache_destroy(LazyDfaCache *cache);
+
+// One left-to-right pass: set marks[id] = 1 for every pattern with a match
+// in text. Position 0 is the start of the line for '^'.
+// Returns 0 on success, -1 on allocation failure (marks are then incomplete).
+int lazy_dfa_mark(LazyDfaCache *cache, const char *text, size_t length, unsigned char *marks);
+
+// Find the leftmost-longest match of pattern id, with the same semantics as
+// regexec on text[0..length). Returns true and fills start/end if found.
+bool lazy_dfa_find(LazyDfaCache *cache,
+                   size_t id,
+                   const char *text,
+                   size_t length,
+                   size_t *start,
+                   size_t *end);
+
+// Longest match of pattern id that starts exactly at start, with '^' and
+// '$' still relative to text[0..length). Returns true and fills end if found.
+bool lazy_dfa_match_at(LazyDfaCache *cache, size_t id, const char *text, size_t length, size_t start, size_t *end);
+
+// Fully expanded DFA, used to generate matchers at build time.
+typedef struct {
+    size_t state_count;
+    size_t class_count;
+    unsigned char class_of[256];
+    // next[state * class_count + class].
+    uint32_t *next;
+    // Start state at the beginning of the line and, for anchored tables,
+    // at any later position (equal to start otherwise).
+    uint32_t start;
+    uint32_t start_inner;
+    // State without live threads, UINT32_MAX if there is none.
+    uint32_t dead;
+    // Pattern ids matching on entering state i: ids[match_offset[i]..+match_count[i]),
+    // and when the text ends in state i: ids[eol_offset[i]..+eol_count[i]).
+    size_t *match_offset;
+    size_t *match_count;
+    size_t *eol_offset;
+    size_t *eol_count;
+    // Pattern ids matching an empty line.
+    size_t empty_offset;
+    size_t empty_count;
+    uint32_t *ids;
+    size_t id_count;
+} LazyDfaTable;
+
+// Build every state reachable from the start. Unanchored tables restart all
+// patterns at each byte like lazy_dfa_mark; anchored tables only follow
+// matches that begin at the first byte.
+// Returns 0 on success, -1 if more than max_states states are needed or on
+// allocation failure.
+int lazy_dfa_export(const LazyDfa *dfa, bool anchored, size_t max_states, LazyDfaTable *table);
+
+// Free the arrays of an exported table.
+void lazy_dfa_table_free(LazyDfaTable *table);
+
+#endif /* LAZY_DFA_H */
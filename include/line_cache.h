@@ -0,0 +1,76 @@
+#ifndef LINE_CACHE_H
+#define LINE_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Matches of recently scanned lines, so a line that repeats verbatim (log
+// lines, fixtures) is answered from memory instead of running the rules
+// again. Entries are found by a hash of the line and confirmed by
+// comparing the bytes. The cache is not synchronized; give each thread
+// its own.
+typedef struct LineCache LineCache;
+
+// One match, relative to the line. rule is chosen by the caller.
+typedef struct {
+    uint32_t rule;
+    uint32_t start;
+    uint32_t end;
+} LineCacheMatch;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    // Lines passed by while line_cache_active was false.
+    uint64_t bypassed;
+    // Bytes in use, including the slot table; never above the cap.
+    size_t bytes;
+} LineCacheStats;
+
+// Smallest cap line_cache_create accepts.
+#define LINE_CACHE_MIN_BYTES 4096
+
+// Create a cache that holds at most max_bytes. Returns NULL if max_bytes
+// is below LINE_CACHE_MIN_BYTES or on allocation failure.
+LineCache *line_cache_create(size_t max_bytes);
+
+// Free the cache.
+void line_cache_destroy(LineCache *cache);
+
+// Whether the next line should go through the cache. Lookups are sampled
+// in windows: after a window in which fewer than one line in 16 repeated,
+// the cache sits out the following windows, so text without repeats costs
+// almost nothing. Call once per line.
+bool line_cache_active(LineCache *cache);
+
+// Hash of line under tag; lines scanned differently (e.g. with other
+// rules) need different tags.
+uint64_t line_cache_hash(uint32_t tag, const char *line, size_t length);
+
+// Matches recorded for line, counted as a hit, or false (a miss). The
+// matches stay valid until the next line_cache_store.
+bool line_cache_lookup(LineCache *cache,
+                       uint64_t hash,
+                       uint32_t tag,
+                       const char *line,
+                       size_t length,
+                       const LineCacheMatch **matches,
+                       size_t *count);
+
+// Remember the matches of a line after a miss. A line is only admitted the
+// second time it misses, so lines seen once cost nothing but the hash.
+// Returns true if the line was stored.
+bool line_cache_store(LineCache *cache,
+                      uint64_t hash,
+                      uint32_t tag,
+                      const char *line,
+                      size_t length,
+                      const LineCacheMatch *matches,
+                      size_t count);
+
+// Counters since the cache was created.
+void line_cache_stats(const LineCache *cache, LineCacheStats *stats);
+
+#endif /* LINE_CACHE_H */
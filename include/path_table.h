@@ -0,0 +1,38 @@
+#ifndef PATH_TABLE_H
+#define PATH_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Paths of the files with findings, stored once each and referred to by
+// a 32-bit ID, so a finding does not carry its own copy of the path. The
+// table is append-only and interning is synchronized, so the workers of a
+// scan can share one table. The strings are copied into an arena and never
+// move once interned.
+typedef struct PathTable PathTable;
+
+#define PATH_TABLE_NONE UINT32_MAX
+
+// Create an empty table. Returns NULL on allocation failure.
+PathTable *path_table_create(void);
+
+// Free the table and its paths.
+void path_table_destroy(PathTable *table);
+
+// Store a copy of path and return its ID, or PATH_TABLE_NONE on
+// allocation failure. If stored is not NULL it receives the copy. Every
+// call adds an entry; callers remember the ID of the file they are in
+// instead of looking the path up again.
+uint32_t path_table_intern(PathTable *table, const char *path, const char **stored);
+
+// The path stored under id (NULL if out of range). Do not call while
+// another thread may be interning.
+const char *path_table_get(const PathTable *table, uint32_t id);
+
+// Number of IDs handed out.
+size_t path_table_count(const PathTable *table);
+
+// Allocations the table made so far (arena blocks and index growths).
+uint64_t path_table_allocations(const PathTable *table);
+
+#endif /* PATH_TABLE_H */
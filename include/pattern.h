@@ -0,0 +1,57 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum {
+    PATTERN_NODE_EMPTY = 0,
+    PATTERN_NODE_CHARSET,
+    PATTERN_NODE_CONCAT,
+    PATTERN_NODE_ALTERNATE,
+    PATTERN_NODE_REPEAT,
+    PATTERN_NODE_BEGIN_LINE,
+    PATTERN_NODE_END_LINE
+} pattern_node_kind_t;
+
+#define PATTERN_REPEAT_UNBOUNDED -1
+
+// Syntax tree for the POSIX ERE subset used by the rule table.
+// CONCAT and ALTERNATE use left/right, REPEAT uses left only.
+typedef struct PatternNode {
+    pattern_node_kind_t kind;
+    // CHARSET: 256-bit membership set, already case-folded for REG_ICASE.
+    unsigned char set[32];
+    int repeat_min;
+    int repeat_max;
+    struct PatternNode *left;
+    struct PatternNode *right;
+} PatternNode;
+
+// Set of lowercase literals of which every match must contain at least one.
+typedef struct {
+    char **items;
+    size_t count;
+} PatternLiteralSet;
+
+// Parse an ERE with regcomp flags (REG_EXTENDED, REG_ICASE).
+// Returns NULL for syntax outside the supported subset or on allocation failure.
+PatternNode *pattern_parse(const char *pattern, int flags);
+
+// Free a syntax tree returned by pattern_parse.
+void pattern_free(PatternNode *node);
+
+// True if byte is a member of a CHARSET node.
+bool pattern_charset_contains(const PatternNode *node, unsigned char byte);
+
+// Minimum number of bytes any match needs.
+size_t pattern_min_length(const PatternNode *node);
+
+// Collect the required literals of a pattern. An empty set means the pattern
+// has no usable literal and must always be evaluated. Returns 0 on success.
+int pattern_required_literals(const PatternNode *node, PatternLiteralSet *literals);
+
+// Free the strings held by a literal set.
+void pattern_literal_set_free(PatternLiteralSet *literals);
+
+#endif /* PATTERN_H */
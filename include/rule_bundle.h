@@ -0,0 +1,41 @@
+#ifndef RULE_BUNDLE_H
+#define RULE_BUNDLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Versioned file of typed sections, written once and mapped read-only by
+// later runs. Every section starts 8-byte aligned in the file, so images
+// inside it can be used in place.
+#define RULE_BUNDLE_VERSION 1
+
+typedef struct RuleBundle RuleBundle;
+typedef struct RuleBundleWriter RuleBundleWriter;
+
+// Create an empty writer. Returns NULL on allocation failure.
+RuleBundleWriter *rule_bundle_writer_create(void);
+
+// Append a zeroed section of size bytes and return it for the caller to
+// fill before rule_bundle_writer_save. Returns NULL on allocation failure.
+void *rule_bundle_writer_add(RuleBundleWriter *writer, uint32_t kind, size_t size);
+
+// Write every section to path. Returns 0 on success.
+int rule_bundle_writer_save(const RuleBundleWriter *writer, const char *path);
+
+// Free the writer and its sections.
+void rule_bundle_writer_destroy(RuleBundleWriter *writer);
+
+// 1 if path starts with the bundle magic, 0 if not, -1 if unreadable.
+int rule_bundle_probe(const char *path);
+
+// Map a bundle and check its header and section table. Returns NULL if
+// the file is not a bundle of this version and byte order.
+RuleBundle *rule_bundle_open(const char *path);
+
+// First section of kind, or NULL if there is none. *size gets its length.
+const void *rule_bundle_section(const RuleBundle *bundle, uint32_t kind, size_t *size);
+
+// Unmap the bundle; pointers into its sections become invalid.
+void rule_bundle_close(RuleBundle *bundle);
+
+#endif /* RULE_BUNDLE_H */
@@ -1,16 +1,112 @@
 #ifndef RULES_H
 #define RULES_H
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "block_rule.h"
+#include "file_type.h"
+#include "line_cache.h"
 
 typedef struct RulesEngine RulesEngine;
 
+// Rule flag next to the regcomp flags in the rule table and in rules
+// files: with the native engine, match the rule as a fixed-format token
+// (see token_rule.h) if its pattern has that shape. regcomp never sees it.
+#define RULES_FLAG_TOKEN 0x10000
+// Rule flag for rules that match JSON syntax: the rule does not run on
+// text that cannot hold JSON (FILE_TYPE_TEXT, see file_type.h).
+#define RULES_FLAG_JSON 0x20000
+// Rule flags for multi-line rules (see block_rule.h): with
+// rules_scan_stream a match opens a PEM block, the enclosing JSON object or
+// a YAML block scalar, and is reported with the span of the whole block.
+// At most one per rule.
+#define RULES_FLAG_PEM_BLOCK 0x40000
+#define RULES_FLAG_JSON_BLOCK 0x80000
+#define RULES_FLAG_YAML_BLOCK 0x100000
+#define RULES_BLOCK_FLAGS (RULES_FLAG_PEM_BLOCK | RULES_FLAG_JSON_BLOCK | RULES_FLAG_YAML_BLOCK)
+// The rule flags that are not regcomp flags.
+#define RULES_EXTRA_FLAGS (RULES_FLAG_TOKEN | RULES_FLAG_JSON | RULES_BLOCK_FLAGS)
+
 typedef enum {
     SEVERITY_LOW = 0,
     SEVERITY_MEDIUM,
     SEVERITY_HIGH
 } severity_t;
 
+typedef enum {
+    // Built-in lazy DFA; rules it cannot express fall back to regcomp.
+    RULES_ENGINE_NATIVE = 0,
+    // POSIX regcomp/regexec for every rule.
+    RULES_ENGINE_REGEX,
+    // Matchers generated at build time for the built-in rules; other rules
+    // use the native engine.
+    RULES_ENGINE_GENERATED
+} rules_engine_t;
+
+// What to do with a line longer than RulesOptions.max_line_length, such as
+// a minified bundle or a one-line JSON dump, so one file cannot stall a
+// worker.
+typedef enum {
+    // Scan the first max_line_length bytes.
+    RULES_LONG_LINE_TRUNCATE = 0,
+    // Scan the whole line in windows of max_line_length bytes that overlap
+    // by a quarter; a match is reported by the first window it starts in.
+    // Matches that cross a window edge, or that depend on what precedes the
+    // window, can be missed. Each window is scanned as if it were a line:
+    // ^ matches at every window start, and a match there can be the suffix
+    // of a token that starts in the window before.
+    RULES_LONG_LINE_WINDOW,
+    // Do not scan the line; rules_scan_stream stops the input there (see
+    // RulesStream.long_line).
+    RULES_LONG_LINE_SKIP
+} rules_long_line_t;
+
+typedef struct {
+    rules_engine_t engine;
+    // Count calls, time, bytes and matches per rule (see rules_get_profile).
+    bool profile;
+    // Rules file (see rules_file.h) or bundle written by rules_save_bundle;
+    // NULL for the built-in rules. A bundle keeps the engine it was
+    // compiled with.
+    const char *rules_path;
+    // Comma-separated rule names or fnmatch globs. Only rules matching
+    // include (all if NULL), not matching exclude and at least min_severity
+    // are compiled; a name or glob that matches no rule is an error.
+    const char *include;
+    const char *exclude;
+    severity_t min_severity;
+    // Report HIGH_ENTROPY_STRING (MEDIUM) for runs of at least
+    // entropy_min_length base64/hex characters with at least
+    // entropy_threshold bits per character (see entropy.h); 0 turns the
+    // detector off. It is not a rule, so include/exclude do not apply.
+    double entropy_threshold;
+    size_t entropy_min_length;
+    // Remember the matches of repeated lines in a cache of at most this
+    // many bytes (see line_cache.h) and replay them instead of running the
+    // rules again; 0 turns it off. Like the profile, the cache is not
+    // synchronized: use one engine per thread, e.g. one rules_clone per
+    // worker. Replayed matches are not counted in the profile.
+    size_t line_cache_bytes;
+    // Lines handed to the rules that are longer than this many bytes are
+    // handled by long_lines; 0 means no limit. Lines the literal filter
+    // rules out cost no matching and do not count.
+    size_t max_line_length;
+    rules_long_line_t long_lines;
+} RulesOptions;
+
+// Work done by one rule's matcher. A call is one regexec or one native or
+// generated search; bytes is the text handed to those calls.
+typedef struct {
+    const char *rule_name;
+    uint64_t calls;
+    uint64_t nanoseconds;
+    uint64_t bytes;
+    uint64_t matches;
+} RuleProfile;
+
 // Called for each match found in a line.
 // start/end are byte offsets in the line.
 typedef void (*rules_match_callback)(const char *rule_name,
@@ -19,13 +115,63 @@ typedef void (*rules_match_callback)(const char *rule_name,
                                      size_t end,
                                      void *user_data);
 
+// Where a match starts and ends as 1-based lines and columns; end_column
+// is the column of its last byte.
+typedef struct {
+    size_t start_line;
+    size_t start_column;
+    size_t end_line;
+    size_t end_column;
+} RulesSpan;
+
+// Called for each match of a multi-line rule found by rules_scan_stream.
+typedef void (*rules_span_callback)(const char *rule_name,
+                                    severity_t severity,
+                                    const RulesSpan *span,
+                                    void *user_data);
+
+// At most this many blocks are open at once in a stream; a multi-line
+// match beyond that is reported without its block.
+#define RULES_STREAM_BLOCKS 4
+
+typedef struct {
+    const char *rule_name;
+    severity_t severity;
+    // The match, until the block ends.
+    RulesSpan span;
+    // Offset in the current buffer of the next line to feed to the block.
+    size_t next;
+    BlockState block;
+} RulesStreamBlock;
+
+// Multi-line rule state of one input (a file), carried from one
+// rules_scan_stream call to the next. Its size is fixed, so memory does
+// not grow with the input.
+typedef struct {
+    RulesStreamBlock blocks[RULES_STREAM_BLOCKS];
+    size_t count;
+    // Line number of the line RULES_LONG_LINE_SKIP skipped, or 0. Nothing
+    // from there on is scanned.
+    size_t long_line;
+} RulesStream;
+
 struct RulesEngine {
     void *implementation;
 };
 
+// Fill options with the defaults (native engine, built-in rules).
+void rules_default_options(RulesOptions *options);
+
 // Initialize and compile the default rules. Returns 0 on success.
 int rules_init(RulesEngine *engine);
 
+// Same as rules_init with explicit options (NULL means defaults).
+int rules_init_with_options(RulesEngine *engine, const RulesOptions *options);
+
+// Compile an independent engine with the same rules and options as source,
+// so each worker thread can own one. Returns 0 on success.
+int rules_clone(const RulesEngine *source, RulesEngine *clone);
+
 // Free the rules engine.
 void rules_destroy(RulesEngine *engine);
 
@@ -36,4 +182,117 @@ void rules_scan_line(const RulesEngine *engine,
                      rules_match_callback callback,
                      void *user_data);
 
+// Scan a buffer of '\n'-separated lines (a trailing '\r' is not part of its
+// line) with the same matches as rules_scan_line on each line. start/end are
+// byte offsets in the buffer; line numbers are left to the caller.
+void rules_scan_buffer(const RulesEngine *engine,
+                       const char *buffer,
+                       size_t length,
+                       rules_match_callback callback,
+                       void *user_data);
+
+// rules_scan_buffer for the contents of a file of the given type: rules
+// routed to other file types (RULES_FLAG_JSON) are not run.
+void rules_scan_file_buffer(const RulesEngine *engine,
+                            file_type_t type,
+                            const char *buffer,
+                            size_t length,
+                            rules_match_callback callback,
+                            void *user_data);
+
+// Start a stream with no open blocks.
+void rules_stream_init(RulesStream *stream);
+
+// rules_scan_file_buffer for the next buffer of the input of stream, whose
+// first line is line first_line. Buffers hold whole lines, except for the
+// last one of the input. Matches of multi-line rules (RULES_BLOCK_FLAGS)
+// go to span_callback once their block ends, possibly in a later buffer;
+// the others go to callback as before. Outside a stream, rules_scan_line
+// and rules_scan_buffer report a multi-line match like any other.
+void rules_scan_stream(const RulesEngine *engine,
+                       RulesStream *stream,
+                       file_type_t type,
+                       const char *buffer,
+                       size_t length,
+                       size_t first_line,
+                       rules_match_callback callback,
+                       rules_span_callback span_callback,
+                       void *user_data);
+
+// For line first_line of stream, over max_line_length and cut by the
+// caller instead of being read whole: with RULES_LONG_LINE_SKIP, count it
+// and stop the stream there as rules_scan_stream would (see
+// RulesStream.long_line) and return true, even if the literal filter would
+// have ruled the line out. Returns false with the other policies.
+bool rules_stream_skip_long_line(const RulesEngine *engine, RulesStream *stream, size_t first_line);
+
+// Feed the blocks still open in stream the lines of buffer, the input
+// that follows, without matching them, and report the ones that end. Used
+// when the input was scanned in parts, so that a part's blocks can end in
+// the next part.
+void rules_stream_follow(RulesStream *stream,
+                         const char *buffer,
+                         size_t length,
+                         rules_span_callback span_callback,
+                         void *user_data);
+
+// End the input: report the blocks still open. A block without its end is
+// reported as the match alone.
+void rules_stream_finish(RulesStream *stream, rules_span_callback span_callback, void *user_data);
+
+// Write the compiled rules to path as a bundle that rules_init_with_options
+// maps instead of recompiling. Returns 0 on success.
+int rules_save_bundle(const RulesEngine *engine, const char *path);
+
+// Number of rules in the engine.
+size_t rules_count(const RulesEngine *engine);
+
+// Name of rule index (in rule order), or NULL if out of range. Index
+// rules_count() is reserved for the entropy detector, which is not a
+// compiled rule, and names ENTROPY_RULE_NAME.
+const char *rules_name(const RulesEngine *engine, size_t index);
+
+// Index (in rule order) of the rule called rule_name, rules_count() for
+// ENTROPY_RULE_NAME, or rules_count() + 1 if there is none. The names
+// handed to the match callbacks are found by pointer, without comparing
+// the text. Clones of an engine have the same rule order.
+size_t rules_index(const RulesEngine *engine, const char *rule_name);
+
+// "LOW", "MEDIUM" or "HIGH".
+const char *rules_severity_label(severity_t severity);
+
+// Parse a severity label (case-insensitive). Returns 0 on success.
+int rules_parse_severity(const char *text, severity_t *severity);
+
+// List the compiled rules and how many were available before selection,
+// as a table or as a JSON object.
+void rules_print_active(const RulesEngine *engine, FILE *out);
+void rules_print_active_json(const RulesEngine *engine, FILE *out);
+
+// Copy the profile of every rule (in rule order) into profiles[0..capacity).
+// Returns the number of rules, or 0 if profiling is off. The counters are
+// not synchronized: profile an engine from one thread at a time, e.g. one
+// rules_clone per worker.
+size_t rules_get_profile(const RulesEngine *engine, RuleProfile *profiles, size_t capacity);
+
+// Add the profile, line cache and long line counters of src (a clone of
+// dest) to dest.
+void rules_merge_profile(RulesEngine *dest, const RulesEngine *src);
+
+// Line cache counters of the engine plus those merged into it. Returns
+// false if the line cache is off.
+bool rules_get_line_cache_stats(const RulesEngine *engine, LineCacheStats *stats);
+
+// Lines over max_line_length that the engine and those merged into it
+// truncated, windowed or skipped.
+uint64_t rules_get_long_lines(const RulesEngine *engine);
+
+// options.max_line_length of the engine; 0 means no limit.
+size_t rules_get_max_line_length(const RulesEngine *engine);
+
+// Print the profile sorted by time, as a table or as a JSON object,
+// followed by the line cache counters if the cache is on.
+void rules_print_profile(const RulesEngine *engine, FILE *out);
+void rules_print_profile_json(const RulesEngine *engine, FILE *out);
+
 #endif
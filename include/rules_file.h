@@ -0,0 +1,38 @@
+#ifndef RULES_FILE_H
+#define RULES_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "rules.h"
+
+// A rule read from a rules file. Strings point into RulesFile.text.
+typedef struct {
+    const char *name;
+    severity_t severity;
+    const char *pattern;
+    int flags;
+} RuleDefinition;
+
+// Rules file: one rule per line as "NAME SEVERITY FLAGS PATTERN", where
+// SEVERITY is LOW, MEDIUM or HIGH, FLAGS is "-" or a comma-separated list
+// of "icase", "token" (RULES_FLAG_TOKEN), "json" (RULES_FLAG_JSON) and one
+// of "pem_block", "json_block" or "yaml_block" (RULES_FLAG_*_BLOCK), and
+// PATTERN is a POSIX extended regex running to the end of the line. Blank
+// lines and lines starting with '#' are ignored; "@replace-defaults" on
+// its own line drops the built-in rules.
+typedef struct {
+    RuleDefinition *rules;
+    size_t count;
+    bool replace_defaults;
+    char *text;
+} RulesFile;
+
+// Read and check path. Problems are reported on stderr with their line
+// number. Returns 0 on success.
+int rules_file_load(const char *path, RulesFile *file);
+
+// Free the rules and their text.
+void rules_file_free(RulesFile *file);
+
+#endif /* RULES_FILE_H */
@@ -3,11 +3,48 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
+#include "io_ring.h"
+#include "path_table.h"
 #include "rules.h"
 
-typedef struct ScannerFindingNode ScannerFindingNode;
+typedef struct ScannerFinding ScannerFinding;
+typedef struct StringsScan StringsScan;
+
+// An input the long line guard skipped (RULES_LONG_LINE_SKIP), listed in
+// the report with the reason.
+typedef struct {
+    char *path;
+    // The line over the limit or, for the strings of a binary file
+    // (at_offset), the byte offset of the string over it.
+    size_t position;
+    bool at_offset;
+} ScannerSkip;
+
+// How file contents are read (--io).
+typedef enum {
+    // mmap for regular files of SCANNER_MMAP_MIN_SIZE and more, read()
+    // for the rest.
+    SCANNER_IO_AUTO = 0,
+    // read() into a buffer of io_buffer_size bytes, carrying a partial
+    // last line over to the next read.
+    SCANNER_IO_READ,
+    // Map regular files and scan them in place.
+    SCANNER_IO_MMAP,
+    // io_uring: scanner_scan_paths keeps the opens and first reads of up
+    // to SCANNER_URING_DEPTH files in flight and scans each file as its
+    // read completes. Files larger than one read continue as with AUTO.
+    SCANNER_IO_URING
+} scanner_io_t;
+
+#define SCANNER_READ_BUFFER_SIZE 8192
+#define SCANNER_MMAP_MIN_SIZE (256 * 1024)
+#define SCANNER_URING_DEPTH 32
+// Large inputs are scanned in parts of at least this many bytes, cut at
+// newlines, so several threads can share one file (see ScannerPart).
+#define SCANNER_PART_SIZE (4 * 1024 * 1024)
 
 typedef struct {
     RulesEngine *rules;
@@ -16,11 +53,46 @@ typedef struct {
     size_t files_scanned;
     size_t files_skipped;
     bool scan_failed;
-    ScannerFindingNode *findings_head;
-    ScannerFindingNode *findings_tail;
+    // Inputs the long line guard skipped, sorted by path.
+    ScannerSkip *skips;
+    size_t skip_count;
+    // Skip known-irrelevant files and route rules by file type (on by
+    // default, see file_type.h).
+    bool classify_files;
+    // Scan binary files for printable strings instead of skipping them;
+    // their findings are at byte offsets (off by default).
+    bool scan_binaries;
+    // Findings in the order they were found; the reports sort them unless
+    // findings_sorted is set.
+    ScannerFinding *findings;
+    size_t finding_capacity;
+    bool findings_sorted;
+    // Paths of the findings, owned or shared with other scanners (see
+    // scanner_share_paths), and the ID of the file being scanned.
+    PathTable *paths;
+    bool owns_paths;
+    const char *current_path;
+    uint32_t current_path_id;
+    // Read buffer kept from file to file, and the allocations made for it
+    // and for the findings (see scanner_allocations).
+    char *read_buffer;
+    size_t read_capacity;
+    uint64_t allocations;
+    // State of the strings scan of binary files (scan_binaries), kept
+    // from file to file like the read buffer.
+    StringsScan *strings;
+    // How files are read and the size of one read (SCANNER_IO_AUTO and
+    // SCANNER_READ_BUFFER_SIZE unless set after scanner_init).
+    scanner_io_t io;
+    size_t io_buffer_size;
+    // SCANNER_IO_URING: the ring and one read buffer per file in flight,
+    // created on first use.
+    IoRing *ring;
+    char *ring_buffers;
 } ScannerContext;
 
 // Initialize the scanner with a rules engine (rules are not owned).
+// File classification is on.
 void scanner_init(ScannerContext *scanner, RulesEngine *rules);
 
 // Print a human-readable report to out (stdout if NULL).
@@ -29,16 +101,102 @@ void scanner_print_report(const ScannerContext *scanner, FILE *out);
 // Print a JSON report to out (stdout if NULL).
 void scanner_print_report_json(const ScannerContext *scanner, FILE *out);
 
-// Free memory used by the stored findings.
+// Heap allocations made while scanning: read buffer growths, finding
+// storage and path table blocks. A scan allocates per file at most, never
+// per line.
+uint64_t scanner_allocations(const ScannerContext *scanner);
+
+// Print the number of files and allocations for --profile-rules, as text
+// or as a JSON object on its own line.
+void scanner_print_profile(const ScannerContext *scanner, FILE *out);
+void scanner_print_profile_json(const ScannerContext *scanner, FILE *out);
+
+// Free memory used by the stored findings and the read buffer.
 void scanner_destroy(ScannerContext *scanner);
 
-// Merge results from src into dest.
+// Store the paths of scanner's findings in owner's table, so merging them
+// into owner needs no remapping. Call before scanner stores findings;
+// owner must outlive them. Returns 0 on success, -1 on allocation failure.
+int scanner_share_paths(ScannerContext *scanner, ScannerContext *owner);
+
+// Sort the stored findings into report order. Storing another finding
+// clears the sorted state.
+void scanner_sort_findings(ScannerContext *scanner);
+
+// Move the results of src into dest, leaving src without findings. The
+// findings are moved, not copied; if both sides are sorted, the result is
+// merged in report order and stays sorted.
 void scanner_merge(ScannerContext *dest, ScannerContext *src);
 
 // Scan one file path. Returns 0 on success, -1 on error.
 int scanner_scan_path(ScannerContext *scanner, const char *path);
 
+// Scan count paths. With SCANNER_IO_URING the files are opened and read
+// concurrently; otherwise this is scanner_scan_path on each. Returns 0 if
+// every path was scanned, -1 if any failed.
+int scanner_scan_paths(ScannerContext *scanner, char *const *paths, size_t count);
+
 // Scan standard input. Returns 0 on success, -1 on error.
 int scanner_scan_stdin(ScannerContext *scanner);
 
+// Whether the first bytes of an input show it is of a skipped type or, if
+// binaries are not scanned, binary. *type is refined by content and set to
+// FILE_TYPE_BINARY for binary content.
+bool scanner_sniff_skip(const ScannerContext *scanner, file_type_t *type, const char *data, size_t length);
+
+// How much of a line over the rules' max_line_length input read in parts
+// keeps; the rest of the line is dropped unread up to its newline, so a
+// huge line does not grow the read buffer. One byte more than the limit
+// plus one for a carriage return, so the long line guard still fires on
+// the kept part. 0 without a limit.
+size_t scanner_long_line_keep(const ScannerContext *scanner);
+
+// Scan a binary input for printable strings (see scan_binaries): the
+// length bytes at head, which were read from file_descriptor, then the
+// rest of it (-1 if there is no more). Memory use does not grow with the
+// input. Returns 0 when done, 1 if the long line guard skipped the input,
+// -1 on error.
+int scanner_scan_binary(ScannerContext *scanner,
+                        const char *path,
+                        const char *head,
+                        size_t length,
+                        int file_descriptor);
+
+// Map path read-only to scan it in parts, after the checks by name and
+// first bytes that scanner_scan_path makes. Returns 0 with the file in
+// *data and *length and its type in *type, 1 if the file is skipped
+// (counted in scanner), or -1 if it could not be mapped; scanner_scan_path
+// then scans it whole. Release the mapping with scanner_unmap_file.
+int scanner_map_file(ScannerContext *scanner, const char *path, file_type_t *type, const char **data, size_t *length);
+void scanner_unmap_file(const char *data, size_t length);
+
+// A run of lines of one input, scanned on its own so that several threads
+// can share a large input. Parts are scanned in any order and joined in
+// input order, which numbers their lines and lets a multi-line block that
+// opens in one part end in the next. Not for RULES_LONG_LINE_SKIP, which
+// stops the whole input at a line.
+typedef struct {
+    // Whole lines, except at the end of the input; set by the caller.
+    const char *data;
+    size_t length;
+    const char *path;
+    file_type_t type;
+    // Set by scanner_scan_part: the newlines in data, the findings with
+    // lines counted from 1 and the blocks still open at the end.
+    size_t lines;
+    ScannerContext scanner;
+    RulesStream stream;
+} ScannerPart;
+
+// Scan the lines of part with rules, storing its paths in owner's table
+// (see scanner_share_paths) if owner is not NULL.
+void scanner_scan_part(ScannerPart *part, RulesEngine *rules, ScannerContext *owner);
+
+// Move the findings of parts[0], whose first line is line first_line of
+// the input, into dest, and free the part's scanner. Blocks still open at
+// its end are fed the lines of parts[1..count), the input after it, and
+// ended there if ended is set. Returns false, changing nothing, if a block
+// needs input past parts[count - 1] and ended is not set.
+bool scanner_join_part(ScannerContext *dest, ScannerPart *const *parts, size_t count, bool ended, size_t first_line);
+
 #endif /* SCANNER_H */
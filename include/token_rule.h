@@ -0,0 +1,42 @@
+#ifndef TOKEN_RULE_H
+#define TOKEN_RULE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pattern.h"
+
+// Longest prefix a token rule may have (one bit per position).
+#define TOKEN_RULE_MAX_PREFIX 32
+#define TOKEN_RULE_UNBOUNDED UINT32_MAX
+
+// Fixed-format token such as AKIA[0-9A-Z]{16} or gh[ousr]_[A-Za-z0-9]{36,}:
+// a fixed-length prefix of byte classes followed by one counted run of a
+// single class. The prefix is found with a shift-and pass and the run is
+// checked with a lookup table, with the same leftmost-longest matches as
+// regexec. The struct is flat so it can be stored in a bundle as is.
+typedef struct {
+    uint32_t prefix_length;
+    uint32_t run_min;
+    // TOKEN_RULE_UNBOUNDED if the run has no upper bound.
+    uint32_t run_max;
+    uint32_t reserved;
+    // Bit i of prefix[byte] is set if byte may appear at prefix position i.
+    uint32_t prefix[256];
+    // 1 if byte may appear in the run.
+    unsigned char run[256];
+} TokenRule;
+
+// Fill rule from pattern if it has the token shape (already case-folded
+// for REG_ICASE by pattern_parse). Returns false for any other shape.
+bool token_rule_compile(const PatternNode *pattern, TokenRule *rule);
+
+// True if rule is well-formed, e.g. after reading it back from a file.
+bool token_rule_check(const TokenRule *rule);
+
+// Leftmost-longest match in text[0..length). Returns true and fills
+// start/end if found.
+bool token_rule_find(const TokenRule *rule, const char *text, size_t length, size_t *start, size_t *end);
+
+#endif /* TOKEN_RULE_H */
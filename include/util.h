@@ -1,6 +1,12 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <stddef.h>
+#include <stdio.h>
+
 char *duplicate_string(const char *text);
 
+// Write text as a JSON string literal (null for NULL).
+void json_write_string(FILE *out, const char *text);
+
 #endif /* UTIL_H */
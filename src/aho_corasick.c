@@ -0,0 +1,355 @@
+#include "aho_corasick.h"
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+
+typedef struct {
+    char *text;
+    size_t id;
+} AhoLiteral;
+
+struct AhoCorasick {
+    AhoLiteral *literals;
+    size_t literal_count;
+    bool built;
+
+    // Bytes are mapped to classes; class 0 collects bytes in no literal.
+    unsigned char class_of[256];
+    size_t class_count;
+
+    // Full transition table: delta[state * class_count + class].
+    uint32_t *delta;
+    size_t state_count;
+
+    // Output ids per state, already including those of the failure chain.
+    uint32_t *output_start;
+    uint32_t *output_count;
+    uint32_t *outputs;
+    size_t output_total;
+
+    // Tables point into a serialized image owned by the caller.
+    bool borrowed;
+};
+
+AhoCorasick *aho_corasick_create(void) {
+    return calloc(1, sizeof(AhoCorasick));
+}
+
+int aho_corasick_add(AhoCorasick *automaton, const char *literal, size_t id) {
+    if (!automaton || automaton->built || !literal || literal[0] == '\0') {
+        return -1;
+    }
+
+    AhoLiteral *resized = realloc(automaton->literals,
+                                  (automaton->literal_count + 1) * sizeof(*resized));
+    if (!resized) {
+        return -1;
+    }
+    automaton->literals = resized;
+
+    char *copy = duplicate_string(literal);
+    if (!copy) {
+        return -1;
+    }
+    automaton->literals[automaton->literal_count].text = copy;
+    automaton->literals[automaton->literal_count].id = id;
+    automaton->literal_count++;
+    return 0;
+}
+
+static void assign_classes(AhoCorasick *automaton) {
+    memset(automaton->class_of, 0, sizeof(automaton->class_of));
+    size_t next_class = 1;
+    for (size_t i = 0; i < automaton->literal_count; ++i) {
+        for (const unsigned char *ptr = (const unsigned char *)automaton->literals[i].text; *ptr; ++ptr) {
+            unsigned char lower = (unsigned char)tolower(*ptr);
+            if (automaton->class_of[lower] == 0) {
+                automaton->class_of[lower] = (unsigned char)next_class++;
+                automaton->class_of[toupper(lower)] = automaton->class_of[lower];
+            }
+        }
+    }
+    automaton->class_count = next_class;
+}
+
+int aho_corasick_build(AhoCorasick *automaton) {
+    if (!automaton || automaton->built) {
+        return -1;
+    }
+
+    assign_classes(automaton);
+    size_t classes = automaton->class_count;
+
+    size_t max_states = 1;
+    for (size_t i = 0; i < automaton->literal_count; ++i) {
+        max_states += strlen(automaton->literals[i].text);
+    }
+
+    // Trie edges use UINT32_MAX for "no child" until the BFS fills them in.
+    uint32_t *delta = malloc(max_states * classes * sizeof(*delta));
+    uint32_t *fail = calloc(max_states, sizeof(*fail));
+    uint32_t *queue = malloc(max_states * sizeof(*queue));
+    size_t *own_count = calloc(max_states, sizeof(*own_count));
+    automaton->output_start = calloc(max_states, sizeof(uint32_t));
+    automaton->output_count = calloc(max_states, sizeof(uint32_t));
+    if (!delta || !fail || !queue || !own_count || !automaton->output_start || !automaton->output_count) {
+        free(delta);
+        free(fail);
+        free(queue);
+        free(own_count);
+        return -1;
+    }
+    memset(delta, 0xFF, max_states * classes * sizeof(*delta));
+
+    // Insert every literal into the trie.
+    size_t state_count = 1;
+    uint32_t *terminal = malloc((automaton->literal_count + 1) * sizeof(*terminal));
+    if (!terminal) {
+        free(delta);
+        free(fail);
+        free(queue);
+        free(own_count);
+        return -1;
+    }
+    for (size_t i = 0; i < automaton->literal_count; ++i) {
+        uint32_t state = 0;
+        for (const unsigned char *ptr = (const unsigned char *)automaton->literals[i].text; *ptr; ++ptr) {
+            size_t index = (size_t)state * classes + automaton->class_of[*ptr];
+            if (delta[index] == UINT32_MAX) {
+                delta[index] = (uint32_t)state_count++;
+            }
+            state = delta[index];
+        }
+        terminal[i] = state;
+        own_count[state]++;
+    }
+
+    // Breadth-first pass: failure links and the complete transition table.
+    size_t head = 0;
+    size_t tail = 0;
+    for (size_t c = 0; c < classes; ++c) {
+        if (delta[c] == UINT32_MAX) {
+            delta[c] = 0;
+        } else {
+            fail[delta[c]] = 0;
+            queue[tail++] = delta[c];
+        }
+    }
+    while (head < tail) {
+        uint32_t state = queue[head++];
+        for (size_t c = 0; c < classes; ++c) {
+            size_t index = (size_t)state * classes + c;
+            uint32_t fallback = delta[(size_t)fail[state] * classes + c];
+            if (delta[index] == UINT32_MAX) {
+                delta[index] = fallback;
+            } else {
+                fail[delta[index]] = fallback;
+                queue[tail++] = delta[index];
+            }
+        }
+    }
+
+    // Flatten outputs; BFS order guarantees fail[state] is complete first.
+    size_t total_outputs = 0;
+    for (size_t i = 0; i < tail; ++i) {
+        uint32_t state = queue[i];
+        automaton->output_count[state] = own_count[state] + automaton->output_count[fail[state]];
+        total_outputs += automaton->output_count[state];
+    }
+    automaton->outputs = malloc((total_outputs + 1) * sizeof(uint32_t));
+    if (!automaton->outputs) {
+        free(terminal);
+        free(delta);
+        free(fail);
+        free(queue);
+        free(own_count);
+        return -1;
+    }
+    size_t position = 0;
+    for (size_t i = 0; i < tail; ++i) {
+        uint32_t state = queue[i];
+        automaton->output_start[state] = (uint32_t)position;
+        for (size_t j = 0; j < automaton->literal_count; ++j) {
+            if (terminal[j] == state) {
+                automaton->outputs[position++] = (uint32_t)automaton->literals[j].id;
+            }
+        }
+        uint32_t parent = fail[state];
+        for (size_t j = 0; j < automaton->output_count[parent]; ++j) {
+            automaton->outputs[position++] = automaton->outputs[automaton->output_start[parent] + j];
+        }
+    }
+
+    free(terminal);
+    free(fail);
+    free(queue);
+    free(own_count);
+
+    automaton->delta = delta;
+    automaton->state_count = state_count;
+    automaton->output_total = total_outputs;
+    automaton->built = true;
+    return 0;
+}
+
+void aho_corasick_mark(const AhoCorasick *automaton,
+                       const char *text,
+                       size_t length,
+                       unsigned char *marks) {
+    if (!automaton || !automaton->built || !text || !marks) {
+        return;
+    }
+
+    const uint32_t *delta = automaton->delta;
+    const unsigned char *class_of = automaton->class_of;
+    size_t classes = automaton->class_count;
+    const unsigned char *bytes = (const unsigned char *)text;
+    uint32_t state = 0;
+    for (size_t i = 0; i < length; ++i) {
+        state = delta[(size_t)state * classes + class_of[bytes[i]]];
+        size_t count = automaton->output_count[state];
+        if (count > 0) {
+            const uint32_t *ids = automaton->outputs + automaton->output_start[state];
+            for (size_t j = 0; j < count; ++j) {
+                marks[ids[j]] = 1;
+            }
+        }
+    }
+}
+
+bool aho_corasick_find(const AhoCorasick *automaton, const char *text, size_t length, size_t *end) {
+    if (!automaton || !automaton->built || !text || !end) {
+        return false;
+    }
+
+    const uint32_t *delta = automaton->delta;
+    const unsigned char *class_of = automaton->class_of;
+    size_t classes = automaton->class_count;
+    const unsigned char *bytes = (const unsigned char *)text;
+    uint32_t state = 0;
+    for (size_t i = 0; i < length; ++i) {
+        state = delta[(size_t)state * classes + class_of[bytes[i]]];
+        if (automaton->output_count[state] > 0) {
+            *end = i + 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Serialized image: AhoImageHeader, class_of[256], then the uint32_t
+// arrays delta, output_start, output_count and outputs.
+typedef struct {
+    uint64_t class_count;
+    uint64_t state_count;
+    uint64_t output_total;
+} AhoImageHeader;
+
+static size_t image_size(size_t class_count, size_t state_count, size_t output_total) {
+    return sizeof(AhoImageHeader) + 256 +
+           (state_count * class_count + state_count * 2 + output_total) * sizeof(uint32_t);
+}
+
+size_t aho_corasick_serialize(const AhoCorasick *automaton, void *out) {
+    if (!automaton || !automaton->built) {
+        return 0;
+    }
+    size_t size = image_size(automaton->class_count, automaton->state_count, automaton->output_total);
+    if (!out) {
+        return size;
+    }
+
+    AhoImageHeader header;
+    header.class_count = automaton->class_count;
+    header.state_count = automaton->state_count;
+    header.output_total = automaton->output_total;
+    unsigned char *cursor = out;
+    memcpy(cursor, &header, sizeof(header));
+    cursor += sizeof(header);
+    memcpy(cursor, automaton->class_of, 256);
+    cursor += 256;
+    size_t delta_size = automaton->state_count * automaton->class_count * sizeof(uint32_t);
+    memcpy(cursor, automaton->delta, delta_size);
+    cursor += delta_size;
+    memcpy(cursor, automaton->output_start, automaton->state_count * sizeof(uint32_t));
+    cursor += automaton->state_count * sizeof(uint32_t);
+    memcpy(cursor, automaton->output_count, automaton->state_count * sizeof(uint32_t));
+    cursor += automaton->state_count * sizeof(uint32_t);
+    memcpy(cursor, automaton->outputs, automaton->output_total * sizeof(uint32_t));
+    return size;
+}
+
+AhoCorasick *aho_corasick_load(const void *data, size_t size, size_t id_count) {
+    AhoImageHeader header;
+    if (!data || size < sizeof(header) + 256 || ((uintptr_t)data & 7) != 0) {
+        return NULL;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.class_count == 0 || header.class_count > 256 || header.state_count == 0 ||
+        header.state_count > UINT32_MAX || header.output_total > UINT32_MAX ||
+        size != image_size(header.class_count, header.state_count, header.output_total)) {
+        return NULL;
+    }
+
+    AhoCorasick *automaton = calloc(1, sizeof(*automaton));
+    if (!automaton) {
+        return NULL;
+    }
+    const unsigned char *cursor = (const unsigned char *)data + sizeof(header);
+    memcpy(automaton->class_of, cursor, 256);
+    cursor += 256;
+    automaton->class_count = header.class_count;
+    automaton->state_count = header.state_count;
+    automaton->output_total = header.output_total;
+    automaton->delta = (uint32_t *)cursor;
+    cursor += header.state_count * header.class_count * sizeof(uint32_t);
+    automaton->output_start = (uint32_t *)cursor;
+    cursor += header.state_count * sizeof(uint32_t);
+    automaton->output_count = (uint32_t *)cursor;
+    cursor += header.state_count * sizeof(uint32_t);
+    automaton->outputs = (uint32_t *)cursor;
+    automaton->borrowed = true;
+    automaton->built = true;
+
+    // Reject images that would index outside their own tables.
+    bool valid = true;
+    for (size_t c = 0; c < 256 && valid; ++c) {
+        valid = automaton->class_of[c] < header.class_count;
+    }
+    for (size_t i = 0; i < header.state_count * header.class_count && valid; ++i) {
+        valid = automaton->delta[i] < header.state_count;
+    }
+    for (size_t i = 0; i < header.state_count && valid; ++i) {
+        valid = (uint64_t)automaton->output_start[i] + automaton->output_count[i] <= header.output_total;
+    }
+    for (size_t i = 0; i < header.output_total && valid; ++i) {
+        valid = automaton->outputs[i] < id_count;
+    }
+    if (!valid) {
+        free(automaton);
+        return NULL;
+    }
+    return automaton;
+}
+
+void aho_corasick_destroy(AhoCorasick *automaton) {
+    if (!automaton) {
+        return;
+    }
+    for (size_t i = 0; i < automaton->literal_count; ++i) {
+        free(automaton->literals[i].text);
+    }
+    free(automaton->literals);
+    if (!automaton->borrowed) {
+        free(automaton->delta);
+        free(automaton->output_start);
+        free(automaton->output_count);
+        free(automaton->outputs);
+    }
+    free(automaton);
+}
@@ -1,5 +1,6 @@
 #include "app.h"
 
+#include <stdbool.h>
 #include <stdio.h>
 
 #include "cli.h"
@@ -22,10 +23,41 @@ int app_run(int argc, char **argv) {
         return parse_result;
     }
 
+    RulesEngine rules;
+    RulesOptions rules_options;
+    rules_default_options(&rules_options);
+    rules_options.engine = config.engine;
+    rules_options.profile = config.profile_rules;
+    rules_options.rules_path = config.rules_path;
+    rules_options.include = config.rules_include;
+    rules_options.exclude = config.rules_exclude;
+    rules_options.min_severity = config.min_severity;
+    rules_options.entropy_threshold = config.entropy_threshold;
+    rules_options.entropy_min_length = (size_t)config.entropy_min_length;
+    rules_options.line_cache_bytes = (size_t)config.line_cache_mb << 20;
+    rules_options.max_line_length = (size_t)config.max_line_kb << 10;
+    rules_options.long_lines = config.long_lines;
+    bool rule_selection = config.rules_include || config.rules_exclude || config.min_severity != SEVERITY_LOW;
+
+    if (config.compile_rules) {
+        int exit_code = 0;
+        if (rules_init_with_options(&rules, &rules_options) != 0) {
+            fprintf(stderr, "ERROR: failed to initialize rules engine.\n");
+            exit_code = 1;
+        } else {
+            if (rules_save_bundle(&rules, config.bundle_path) != 0) {
+                fprintf(stderr, "ERROR: failed to write rules bundle %s.\n", config.bundle_path);
+                exit_code = 1;
+            }
+            rules_destroy(&rules);
+        }
+        free_config(&config);
+        return exit_code;
+    }
+
     print_config(&config);
 
-    RulesEngine rules;
-    if (rules_init(&rules) != 0) {
+    if (rules_init_with_options(&rules, &rules_options) != 0) {
         fprintf(stderr, "ERROR: failed to initialize rules engine.\n");
         free_config(&config);
         return 1;
@@ -61,6 +93,22 @@ int app_run(int argc, char **argv) {
     } else {
         scanner_print_report(&scanner, out);
     }
+    if (rule_selection) {
+        if (config.json_output) {
+            rules_print_active_json(&rules, out);
+        } else {
+            rules_print_active(&rules, out);
+        }
+    }
+    if (config.profile_rules) {
+        if (config.json_output) {
+            rules_print_profile_json(&rules, out);
+            scanner_print_profile_json(&scanner, out);
+        } else {
+            rules_print_profile(&rules, out);
+            scanner_print_profile(&scanner, out);
+        }
+    }
     if (out != stdout) {
         fclose(out);
     }
@@ -0,0 +1,98 @@
+#include "arena.h"
+
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t used;
+    size_t capacity;
+    alignas(max_align_t) unsigned char data[];
+};
+
+void arena_init(Arena *arena, size_t block_size) {
+    arena->blocks = NULL;
+    arena->block_size = block_size;
+    arena->allocations = 0;
+}
+
+void arena_destroy(Arena *arena) {
+    if (!arena) {
+        return;
+    }
+    ArenaBlock *block = arena->blocks;
+    while (block) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->blocks = NULL;
+}
+
+void arena_reset(Arena *arena) {
+    if (!arena) {
+        return;
+    }
+    // Keep a block of the regular size; oversized ones are freed.
+    ArenaBlock *kept = NULL;
+    ArenaBlock *block = arena->blocks;
+    while (block) {
+        ArenaBlock *next = block->next;
+        if (!kept && block->capacity == arena->block_size) {
+            kept = block;
+        } else {
+            free(block);
+        }
+        block = next;
+    }
+    if (kept) {
+        kept->next = NULL;
+        kept->used = 0;
+    }
+    arena->blocks = kept;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    if (!arena) {
+        return NULL;
+    }
+    size_t align = alignof(max_align_t);
+    size = (size + align - 1) & ~(align - 1);
+
+    ArenaBlock *block = arena->blocks;
+    if (!block || block->capacity - block->used < size) {
+        size_t capacity = size > arena->block_size ? size : arena->block_size;
+        block = malloc(sizeof(*block) + capacity);
+        if (!block) {
+            return NULL;
+        }
+        block->used = 0;
+        block->capacity = capacity;
+        arena->allocations++;
+        if (arena->blocks && size > arena->block_size) {
+            // An oversized allocation: keep filling the current block.
+            block->next = arena->blocks->next;
+            arena->blocks->next = block;
+        } else {
+            block->next = arena->blocks;
+            arena->blocks = block;
+        }
+    }
+
+    void *result = block->data + block->used;
+    block->used += size;
+    return result;
+}
+
+char *arena_copy_string(Arena *arena, const char *text) {
+    if (!text) {
+        return NULL;
+    }
+    size_t length = strlen(text);
+    char *copy = arena_alloc(arena, length + 1);
+    if (copy) {
+        memcpy(copy, text, length + 1);
+    }
+    return copy;
+}
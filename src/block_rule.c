@@ -0,0 +1,183 @@
+#include "block_rule.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define BLOCK_NOT_FOUND SIZE_MAX
+
+static size_t find(const char *text, size_t from, size_t length, const char *needle) {
+    size_t needle_length = strlen(needle);
+    while (from + needle_length <= length) {
+        const char *hit = memchr(text + from, needle[0], length - from - needle_length + 1);
+        if (!hit) {
+            break;
+        }
+        size_t offset = (size_t)(hit - text);
+        if (memcmp(hit, needle, needle_length) == 0) {
+            return offset;
+        }
+        from = offset + 1;
+    }
+    return BLOCK_NOT_FOUND;
+}
+
+// Offset just past "-----END ...-----" in line[from..length).
+static size_t pem_end(const char *line, size_t from, size_t length) {
+    size_t marker = find(line, from, length, "-----END");
+    if (marker == BLOCK_NOT_FOUND) {
+        return BLOCK_NOT_FOUND;
+    }
+    size_t close = find(line, marker + 8, length, "-----");
+    return close == BLOCK_NOT_FOUND ? BLOCK_NOT_FOUND : close + 5;
+}
+
+// Offset just past the brace that closes the object, or BLOCK_NOT_FOUND
+// with the state updated for the next line.
+static size_t json_end(BlockState *state, const char *line, size_t from, size_t length) {
+    for (size_t i = from; i < length; ++i) {
+        char current = line[i];
+        if (state->in_string) {
+            if (state->escaped) {
+                state->escaped = false;
+            } else if (current == '\\') {
+                state->escaped = true;
+            } else if (current == '"') {
+                state->in_string = false;
+            }
+        } else if (current == '"') {
+            state->in_string = true;
+        } else if (current == '{') {
+            state->depth++;
+        } else if (current == '}' && --state->depth == 0) {
+            return i + 1;
+        }
+    }
+    return BLOCK_NOT_FOUND;
+}
+
+static size_t leading_spaces(const char *line, size_t length) {
+    size_t count = 0;
+    while (count < length && line[count] == ' ') {
+        count++;
+    }
+    return count;
+}
+
+static bool is_blank(const char *line, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        if (line[i] != ' ' && line[i] != '\t' && line[i] != '\r') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// True if the value after the first ':' at or after start is a block
+// scalar header: '|' or '>', an optional chomping and indentation
+// indicator, and at most a comment.
+static bool yaml_block_header(const char *line, size_t length, size_t start) {
+    const char *colon = memchr(line + start, ':', length - start);
+    if (!colon) {
+        return false;
+    }
+    size_t i = (size_t)(colon - line) + 1;
+    while (i < length && (line[i] == ' ' || line[i] == '\t')) {
+        i++;
+    }
+    if (i == length || (line[i] != '|' && line[i] != '>')) {
+        return false;
+    }
+    i++;
+    for (size_t indicators = 0; indicators < 2 && i < length; ++indicators, ++i) {
+        if (line[i] != '+' && line[i] != '-' && (line[i] < '1' || line[i] > '9')) {
+            break;
+        }
+    }
+    while (i < length && (line[i] == ' ' || line[i] == '\t')) {
+        i++;
+    }
+    return i == length || line[i] == '#';
+}
+
+// Indentation of the key on line, past any "- " of sequence entries.
+static size_t yaml_key_indent(const char *line, size_t length) {
+    size_t i = leading_spaces(line, length);
+    while (i < length && line[i] == '-' && (i + 1 == length || line[i + 1] == ' ')) {
+        i++;
+        i += leading_spaces(line + i, length - i);
+    }
+    return i;
+}
+
+static block_rule_status_t close_at(BlockState *state, size_t column) {
+    state->end_lines = state->lines;
+    state->end_column = column;
+    return BLOCK_RULE_CLOSED;
+}
+
+block_rule_status_t block_rule_open(BlockState *state,
+                                    block_rule_kind_t kind,
+                                    const char *line,
+                                    size_t length,
+                                    size_t start,
+                                    size_t end) {
+    memset(state, 0, sizeof(*state));
+    state->kind = kind;
+    size_t close = BLOCK_NOT_FOUND;
+    switch (kind) {
+    case BLOCK_RULE_PEM:
+        close = pem_end(line, end, length);
+        break;
+    case BLOCK_RULE_JSON:
+        // The match is a member of the object.
+        state->depth = 1;
+        close = json_end(state, line, end, length);
+        break;
+    case BLOCK_RULE_YAML:
+        if (!yaml_block_header(line, length, start)) {
+            return BLOCK_RULE_SINGLE;
+        }
+        state->indent = yaml_key_indent(line, length);
+        // Until a deeper line follows, the block is the header.
+        state->end_column = length;
+        return BLOCK_RULE_OPEN;
+    default:
+        return BLOCK_RULE_SINGLE;
+    }
+    return close == BLOCK_NOT_FOUND ? BLOCK_RULE_OPEN : close_at(state, close);
+}
+
+block_rule_status_t block_rule_next_line(BlockState *state, const char *line, size_t length) {
+    if (++state->lines > BLOCK_RULE_MAX_LINES) {
+        return BLOCK_RULE_UNTERMINATED;
+    }
+    size_t close = BLOCK_NOT_FOUND;
+    switch (state->kind) {
+    case BLOCK_RULE_PEM:
+        close = pem_end(line, 0, length);
+        break;
+    case BLOCK_RULE_JSON:
+        // JSON strings cannot hold a raw newline.
+        state->in_string = false;
+        state->escaped = false;
+        close = json_end(state, line, 0, length);
+        break;
+    case BLOCK_RULE_YAML:
+        if (is_blank(line, length)) {
+            return BLOCK_RULE_OPEN;
+        }
+        if (leading_spaces(line, length) <= state->indent) {
+            return BLOCK_RULE_CLOSED;
+        }
+        state->end_lines = state->lines;
+        state->end_column = length;
+        return BLOCK_RULE_OPEN;
+    default:
+        return BLOCK_RULE_UNTERMINATED;
+    }
+    return close == BLOCK_NOT_FOUND ? BLOCK_RULE_OPEN : close_at(state, close);
+}
+
+block_rule_status_t block_rule_finish(BlockState *state) {
+    return state->kind == BLOCK_RULE_YAML ? BLOCK_RULE_CLOSED : BLOCK_RULE_UNTERMINATED;
+}
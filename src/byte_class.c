@@ -0,0 +1,373 @@
+#include "byte_class.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define BYTE_CLASS_X86 1
+#include <immintrin.h>
+#endif
+
+// Vector counts are kept per byte lane and summed before a lane can wrap.
+#define BYTE_CLASS_MAX_ROUNDS 255
+
+typedef struct {
+    const char *name;
+    size_t (*count_control)(const unsigned char *data, size_t length);
+    size_t (*find_nul)(const unsigned char *data, size_t length);
+    size_t (*count)(const char *text, size_t length, char byte);
+    const char *(*find_last)(const char *text, size_t length, char byte);
+    size_t (*find_set)(const ByteClassSet *set, const unsigned char *data, size_t length);
+} ByteClassKernels;
+
+void byte_class_set_init(ByteClassSet *set, const unsigned char members[256]) {
+    memset(set, 0, sizeof(*set));
+    for (unsigned int byte = 0; byte < 256; ++byte) {
+        if (!members[byte]) {
+            continue;
+        }
+        set->table[byte] = 1;
+        unsigned char bit = (unsigned char)(1u << ((byte >> 4) & 7));
+        if (byte < 0x80) {
+            set->low[byte & 0x0F] |= bit;
+        } else {
+            set->high_low[byte & 0x0F] |= bit;
+        }
+        if (set->count < BYTE_CLASS_SET_LIST) {
+            set->list[set->count] = (unsigned char)byte;
+        }
+        set->count++;
+    }
+}
+
+static bool is_control(unsigned char byte) {
+    return byte < 0x09 || (byte > 0x0D && byte < 0x20);
+}
+
+static size_t scalar_count_control(const unsigned char *data, size_t length) {
+    size_t count = 0;
+    for (size_t i = 0; i < length; ++i) {
+        count += is_control(data[i]);
+    }
+    return count;
+}
+
+static size_t scalar_find_nul(const unsigned char *data, size_t length) {
+    const unsigned char *nul = length > 0 ? memchr(data, '\0', length) : NULL;
+    return nul ? (size_t)(nul - data) : length;
+}
+
+static size_t scalar_count(const char *text, size_t length, char byte) {
+    size_t count = 0;
+    const char *limit = text + length;
+    while (text < limit) {
+        const char *hit = memchr(text, byte, (size_t)(limit - text));
+        if (!hit) {
+            break;
+        }
+        count++;
+        text = hit + 1;
+    }
+    return count;
+}
+
+// Eight bytes at a time from the end.
+static const char *scalar_find_last(const char *text, size_t length, char byte) {
+    const uint64_t ones = 0x0101010101010101ull;
+    const uint64_t highs = 0x8080808080808080ull;
+    const uint64_t pattern = ones * (unsigned char)byte;
+    while (length >= sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, text + length - sizeof(word), sizeof(word));
+        word ^= pattern;
+        // Nonzero if any byte of word is zero, i.e. matched byte.
+        if (((word - ones) & ~word & highs) != 0) {
+            break;
+        }
+        length -= sizeof(word);
+    }
+    while (length > 0) {
+        if (text[length - 1] == byte) {
+            return text + length - 1;
+        }
+        length--;
+    }
+    return NULL;
+}
+
+static size_t scalar_find_set(const ByteClassSet *set, const unsigned char *data, size_t length) {
+    size_t i = 0;
+    while (i < length && !set->table[data[i]]) {
+        i++;
+    }
+    return i;
+}
+
+static const ByteClassKernels scalar_kernels = {
+    "scalar", scalar_count_control, scalar_find_nul, scalar_count, scalar_find_last, scalar_find_set,
+};
+
+#ifdef BYTE_CLASS_X86
+// Bytes in [low, low + count): after subtracting low, a saturating
+// subtract of count - 1 leaves zero exactly for those.
+static __m128i sse2_in_range(__m128i bytes, char low, char count) {
+    __m128i offset = _mm_sub_epi8(bytes, _mm_set1_epi8(low));
+    return _mm_cmpeq_epi8(_mm_subs_epu8(offset, _mm_set1_epi8((char)(count - 1))), _mm_setzero_si128());
+}
+
+static __m128i sse2_control(__m128i bytes) {
+    return _mm_or_si128(sse2_in_range(bytes, 0x00, 0x09), sse2_in_range(bytes, 0x0E, 0x12));
+}
+
+// Sum of the byte lanes of counts.
+static size_t sse2_sum(__m128i counts) {
+    uint64_t sums[2];
+    _mm_storeu_si128((__m128i *)sums, _mm_sad_epu8(counts, _mm_setzero_si128()));
+    return (size_t)(sums[0] + sums[1]);
+}
+
+static size_t sse2_count_control(const unsigned char *data, size_t length) {
+    size_t total = 0;
+    size_t i = 0;
+    while (i + 16 <= length) {
+        __m128i counts = _mm_setzero_si128();
+        // Matching lanes are -1, so subtracting them counts.
+        for (int round = 0; round < BYTE_CLASS_MAX_ROUNDS && i + 16 <= length; ++round, i += 16) {
+            counts = _mm_sub_epi8(counts, sse2_control(_mm_loadu_si128((const __m128i *)(data + i))));
+        }
+        total += sse2_sum(counts);
+    }
+    return total + scalar_count_control(data + i, length - i);
+}
+
+static size_t sse2_find_nul(const unsigned char *data, size_t length) {
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i input = _mm_loadu_si128((const __m128i *)(data + i));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(input, _mm_setzero_si128()));
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+    return i + scalar_find_nul(data + i, length - i);
+}
+
+static size_t sse2_count(const char *text, size_t length, char byte) {
+    const __m128i pattern = _mm_set1_epi8(byte);
+    size_t total = 0;
+    size_t i = 0;
+    while (i + 16 <= length) {
+        __m128i counts = _mm_setzero_si128();
+        for (int round = 0; round < BYTE_CLASS_MAX_ROUNDS && i + 16 <= length; ++round, i += 16) {
+            __m128i input = _mm_loadu_si128((const __m128i *)(text + i));
+            counts = _mm_sub_epi8(counts, _mm_cmpeq_epi8(input, pattern));
+        }
+        total += sse2_sum(counts);
+    }
+    return total + scalar_count(text + i, length - i, byte);
+}
+
+static const char *sse2_find_last(const char *text, size_t length, char byte) {
+    const __m128i pattern = _mm_set1_epi8(byte);
+    for (; length >= 16; length -= 16) {
+        __m128i input = _mm_loadu_si128((const __m128i *)(text + length - 16));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(input, pattern));
+        if (mask) {
+            return text + length - 16 + (31 - __builtin_clz(mask));
+        }
+    }
+    return scalar_find_last(text, length, byte);
+}
+
+// Without a byte shuffle, only small sets are worth comparing against.
+static size_t sse2_find_set(const ByteClassSet *set, const unsigned char *data, size_t length) {
+    if (set->count > BYTE_CLASS_SET_LIST) {
+        return scalar_find_set(set, data, length);
+    }
+    if (set->count == 0) {
+        return length;
+    }
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i input = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i hits = _mm_setzero_si128();
+        for (size_t k = 0; k < set->count; ++k) {
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi8(input, _mm_set1_epi8((char)set->list[k])));
+        }
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(hits);
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+    return i + scalar_find_set(set, data + i, length - i);
+}
+
+static const ByteClassKernels sse2_kernels = {
+    "sse2", sse2_count_control, sse2_find_nul, sse2_count, sse2_find_last, sse2_find_set,
+};
+
+__attribute__((target("avx2"))) static __m256i avx2_in_range(__m256i bytes, char low, char count) {
+    __m256i offset = _mm256_sub_epi8(bytes, _mm256_set1_epi8(low));
+    return _mm256_cmpeq_epi8(_mm256_subs_epu8(offset, _mm256_set1_epi8((char)(count - 1))),
+                             _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2"))) static __m256i avx2_control(__m256i bytes) {
+    return _mm256_or_si256(avx2_in_range(bytes, 0x00, 0x09), avx2_in_range(bytes, 0x0E, 0x12));
+}
+
+__attribute__((target("avx2"))) static size_t avx2_sum(__m256i counts) {
+    uint64_t sums[4];
+    _mm256_storeu_si256((__m256i *)sums, _mm256_sad_epu8(counts, _mm256_setzero_si256()));
+    return (size_t)(sums[0] + sums[1] + sums[2] + sums[3]);
+}
+
+__attribute__((target("avx2"))) static size_t avx2_count_control(const unsigned char *data, size_t length) {
+    size_t total = 0;
+    size_t i = 0;
+    while (i + 32 <= length) {
+        __m256i counts = _mm256_setzero_si256();
+        for (int round = 0; round < BYTE_CLASS_MAX_ROUNDS && i + 32 <= length; ++round, i += 32) {
+            counts = _mm256_sub_epi8(counts, avx2_control(_mm256_loadu_si256((const __m256i *)(data + i))));
+        }
+        total += avx2_sum(counts);
+    }
+    return total + sse2_count_control(data + i, length - i);
+}
+
+__attribute__((target("avx2"))) static size_t avx2_find_nul(const unsigned char *data, size_t length) {
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i input = _mm256_loadu_si256((const __m256i *)(data + i));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(input, _mm256_setzero_si256()));
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+    return i + scalar_find_nul(data + i, length - i);
+}
+
+__attribute__((target("avx2"))) static size_t avx2_count(const char *text, size_t length, char byte) {
+    const __m256i pattern = _mm256_set1_epi8(byte);
+    size_t total = 0;
+    size_t i = 0;
+    while (i + 32 <= length) {
+        __m256i counts = _mm256_setzero_si256();
+        for (int round = 0; round < BYTE_CLASS_MAX_ROUNDS && i + 32 <= length; ++round, i += 32) {
+            __m256i input = _mm256_loadu_si256((const __m256i *)(text + i));
+            counts = _mm256_sub_epi8(counts, _mm256_cmpeq_epi8(input, pattern));
+        }
+        total += avx2_sum(counts);
+    }
+    return total + sse2_count(text + i, length - i, byte);
+}
+
+__attribute__((target("avx2"))) static const char *avx2_find_last(const char *text, size_t length, char byte) {
+    const __m256i pattern = _mm256_set1_epi8(byte);
+    for (; length >= 32; length -= 32) {
+        __m256i input = _mm256_loadu_si256((const __m256i *)(text + length - 32));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(input, pattern));
+        if (mask) {
+            return text + length - 32 + (31 - __builtin_clz(mask));
+        }
+    }
+    return scalar_find_last(text, length, byte);
+}
+
+static const unsigned char nibble_bits[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+
+// Any set: the low nibble picks the bits of the high nibbles in the set
+// (from low or high_low by the byte's top bit), the high nibble picks one.
+__attribute__((target("avx2"))) static size_t avx2_find_set(const ByteClassSet *set,
+                                                            const unsigned char *data,
+                                                            size_t length) {
+    if (length < 32) {
+        return scalar_find_set(set, data, length);
+    }
+    const __m256i low = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)set->low));
+    const __m256i high_low = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)set->high_low));
+    const __m256i bits = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)nibble_bits));
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i input = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i low_nibbles = _mm256_and_si256(input, nibble);
+        __m256i high_nibbles = _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble);
+        __m256i column = _mm256_blendv_epi8(_mm256_shuffle_epi8(low, low_nibbles),
+                                            _mm256_shuffle_epi8(high_low, low_nibbles),
+                                            input);
+        __m256i misses = _mm256_cmpeq_epi8(_mm256_and_si256(column, _mm256_shuffle_epi8(bits, high_nibbles)),
+                                           _mm256_setzero_si256());
+        unsigned int mask = ~(unsigned int)_mm256_movemask_epi8(misses);
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+    return i + scalar_find_set(set, data + i, length - i);
+}
+
+static const ByteClassKernels avx2_kernels = {
+    "avx2", avx2_count_control, avx2_find_nul, avx2_count, avx2_find_last, avx2_find_set,
+};
+#endif
+
+// Picked on first use; every thread picks the same, so a race is harmless.
+static const ByteClassKernels *active_kernels;
+
+bool byte_class_use_kernel(const char *name) {
+    if (!name) {
+        return false;
+    }
+    const ByteClassKernels *kernels = NULL;
+    if (strcmp(name, "scalar") == 0) {
+        kernels = &scalar_kernels;
+    }
+#ifdef BYTE_CLASS_X86
+    if (strcmp(name, "sse2") == 0) {
+        kernels = &sse2_kernels;
+    }
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+        kernels = &avx2_kernels;
+    }
+#endif
+    if (!kernels) {
+        return false;
+    }
+    __atomic_store_n(&active_kernels, kernels, __ATOMIC_RELAXED);
+    return true;
+}
+
+static const ByteClassKernels *current_kernels(void) {
+    const ByteClassKernels *kernels = __atomic_load_n(&active_kernels, __ATOMIC_RELAXED);
+    if (kernels) {
+        return kernels;
+    }
+    if (!byte_class_use_kernel("avx2") && !byte_class_use_kernel("sse2")) {
+        byte_class_use_kernel("scalar");
+    }
+    return __atomic_load_n(&active_kernels, __ATOMIC_RELAXED);
+}
+
+const char *byte_class_kernel(void) {
+    return current_kernels()->name;
+}
+
+size_t byte_class_count_control(const unsigned char *data, size_t length) {
+    return current_kernels()->count_control(data, length);
+}
+
+size_t byte_class_find_nul(const unsigned char *data, size_t length) {
+    return current_kernels()->find_nul(data, length);
+}
+
+size_t byte_class_count(const char *text, size_t length, char byte) {
+    return current_kernels()->count(text, length, byte);
+}
+
+const char *byte_class_find_last(const char *text, size_t length, char byte) {
+    return current_kernels()->find_last(text, length, byte);
+}
+
+size_t byte_class_find_set(const ByteClassSet *set, const unsigned char *data, size_t length) {
+    return current_kernels()->find_set(set, data, length);
+}
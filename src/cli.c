@@ -4,8 +4,88 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "entropy.h"
 #include "util.h"
 
+static int parse_engine(const char *text, rules_engine_t *out_engine) {
+    if (!text || !out_engine) {
+        return -1;
+    }
+    if (strcmp(text, "native") == 0) {
+        *out_engine = RULES_ENGINE_NATIVE;
+    } else if (strcmp(text, "regex") == 0) {
+        *out_engine = RULES_ENGINE_REGEX;
+    } else if (strcmp(text, "generated") == 0) {
+        *out_engine = RULES_ENGINE_GENERATED;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static int parse_long_lines(const char *text, rules_long_line_t *out_policy) {
+    if (!text || !out_policy) {
+        return -1;
+    }
+    if (strcmp(text, "truncate") == 0) {
+        *out_policy = RULES_LONG_LINE_TRUNCATE;
+    } else if (strcmp(text, "window") == 0) {
+        *out_policy = RULES_LONG_LINE_WINDOW;
+    } else if (strcmp(text, "skip") == 0) {
+        *out_policy = RULES_LONG_LINE_SKIP;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static int parse_io(const char *text, scanner_io_t *out_io) {
+    if (!text || !out_io) {
+        return -1;
+    }
+    if (strcmp(text, "auto") == 0) {
+        *out_io = SCANNER_IO_AUTO;
+    } else if (strcmp(text, "read") == 0) {
+        *out_io = SCANNER_IO_READ;
+    } else if (strcmp(text, "mmap") == 0) {
+        *out_io = SCANNER_IO_MMAP;
+    } else if (strcmp(text, "uring") == 0) {
+        *out_io = SCANNER_IO_URING;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// Append value to a comma-separated list, so repeated options accumulate.
+static int append_list(char **list, const char *value) {
+    size_t old_length = *list ? strlen(*list) : 0;
+    size_t value_length = strlen(value);
+    char *joined = realloc(*list, old_length + value_length + 2);
+    if (!joined) {
+        return -1;
+    }
+    if (old_length > 0) {
+        joined[old_length++] = ',';
+    }
+    memcpy(joined + old_length, value, value_length + 1);
+    *list = joined;
+    return 0;
+}
+
+static int parse_double(const char *text, double *out_value) {
+    if (!text || !out_value || text[0] == '\0') {
+        return -1;
+    }
+    char *end_ptr = NULL;
+    double parsed = strtod(text, &end_ptr);
+    if (!end_ptr || *end_ptr != '\0') {
+        return -1;
+    }
+    *out_value = parsed;
+    return 0;
+}
+
 static int parse_int(const char *text, int *out_value) {
     if (!text || !out_value) {
         return -1;
@@ -29,6 +109,11 @@ int parse_arguments(int argc, char **argv, Config *config) {
     int i = 1;
     const char *prog = (argc > 0) ? argv[0] : "app";
 
+    if (argc > 1 && strcmp(argv[1], "compile-rules") == 0) {
+        config->compile_rules = true;
+        i++;
+    }
+
     while (i < argc) {
         const char *arg = argv[i];
 
@@ -73,10 +158,264 @@ int parse_arguments(int argc, char **argv, Config *config) {
                 fprintf(stderr, "ERROR: invalid --threads value: %s\n", value ? value : "(null)");
                 return 2;
             }
+        } else if (strncmp(arg, "--line-cache", 12) == 0) {
+            const char *value = NULL;
+            if (strcmp(arg, "--line-cache") == 0) {
+                if (i + 1 >= argc) {
+                    fprintf(stderr, "ERROR: --line-cache requires a value.\n");
+                    return 2;
+                }
+                value = argv[++i];
+            } else if (arg[12] == '=') {
+                value = arg + 13;
+            } else {
+                fprintf(stderr, "ERROR: invalid --line-cache usage: %s\n", arg);
+                return 2;
+            }
+
+            if (parse_int(value, &config->line_cache_mb) != 0 || config->line_cache_mb < 0 ||
+                config->line_cache_mb > MAX_LINE_CACHE_MB) {
+                fprintf(stderr, "ERROR: invalid --line-cache value: %s\n", value ? value : "(null)");
+                return 2;
+            }
+        } else if (strncmp(arg, "--max-line-length", 17) == 0) {
+            const char *value = NULL;
+            if (strcmp(arg, "--max-line-length") == 0) {
+                if (i + 1 >= argc) {
+                    fprintf(stderr, "ERROR: --max-line-length requires a value.\n");
+                    return 2;
+                }
+                value = argv[++i];
+            } else if (arg[17] == '=') {
+                value = arg + 18;
+            } else {
+                fprintf(stderr, "ERROR: invalid --max-line-length usage: %s\n", arg);
+                return 2;
+            }
+
+            if (parse_int(value, &config->max_line_kb) != 0 || config->max_line_kb < 0 ||
+                config->max_line_kb > MAX_LINE_LENGTH_KB) {
+                fprintf(stderr, "ERROR: invalid --max-line-length value: %s\n", value ? value : "(null)");
+                return 2;
+            }
+        } else if (strncmp(arg, "--long-lines", 12) == 0) {
+            const char *value = NULL;
+            if (strcmp(arg, "--long-lines") == 0) {
+                if (i + 1 >= argc) {
+                    fprintf(stderr, "ERROR: --long-lines requires a value.\n");
+                    return 2;
+                }
+                value = argv[++i];
+            } else if (arg[12] == '=') {
+                value = arg + 13;
+            } else {
+                fprintf(stderr, "ERROR: invalid --long-lines usage: %s\n", arg);
+                return 2;
+            }
+
+            if (parse_long_lines(value, &config->long_lines) != 0) {
+                fprintf(stderr, "ERROR: invalid --long-lines value: %s\n", value ? value : "(null)");
+                return 2;
+            }
+        } else if (strncmp(arg, "--split-size", 12) == 0) {
+            const char *value = NULL;
+            if (strcmp(arg, "--split-size") == 0) {
+                if (i + 1 >= argc) {
+                    fprintf(stderr, "ERROR: --split-size requires a value.\n");
+                    return 2;
+                }
+                value = argv[++i];
+            } else if (arg[12] == '=') {
+                value = arg + 13;
+            } else {
+                fprintf(stderr, "ERROR: invalid --split-size usage: %s\n", arg);
+                return 2;
+            }
+
+            if (parse_int(value, &config->split_mb) != 0 || config->split_mb < 0 || config->split_mb > MAX_SPLIT_MB) {
+                fprintf(stderr, "ERROR: invalid --split-size value: %s\n", value ? value : "(null)");
+                return 2;
+            }
+        } else if (strncmp(arg, "--io-buffer", 11) == 0) {
+            const char *value = NULL;
+            if (strcmp(arg, "--io-buffer") == 0) {
+                if (i + 1 >= argc) {
+                    fprintf(stderr, "ERROR: --io-buffer requires a value.\n");
+                    return 2;
+                }
+                value = argv[++i];
+            } else if (arg[11] == '=') {
+                value = arg + 12;
+            } else {
+                fprintf(stderr, "ERROR: invalid --io-buffer usage: %s\n", arg);
+                return 2;
+            }
+
+            if (parse_int(value, &config->io_buffer_kb) != 0 || config->io_buffer_kb < MIN_IO_BUFFER_KB ||
+                config->io_buffer_kb > MAX_IO_BUFFER_KB) {
+                fprintf(stderr, "ERROR: invalid --io-buffer value: %s\n", value ? value : "(null)");
+                return 2;
+            }
+        } else if (strncmp(arg, "--io", 4) == 0) {
+            const char *value = NULL;
+            if (strcmp(arg, "--io") == 0) {
+                if (i + 1 >= argc) {
+                    fprintf(stderr, "ERROR: --io requires a value.\n");
+                    return 2;
+                }
+                value = argv[++i];
+            } else if (arg[4] == '=') {
+                value = arg + 5;
+            } else {
+                fprintf(stderr, "ERROR: invalid --io usage: %s\n", arg);
+                return 2;
+            }
+
+            if (parse_io(value, &config->io) != 0) {
+                fprintf(stderr, "ERROR: invalid --io value: %s\n", value ? value : "(null)");
+                return 2;
+            }
+        } else if (strncmp(arg, "--engine", 8) == 0) {
+            const char *value = NULL;
+            if (strcmp(arg, "--engine") == 0) {
+                if (i + 1 >= argc) {
+                    fprintf(stderr, "ERROR: --engine requires a value.\n");
+                    return 2;
+                }
+                value = argv[++i];
+            } else if (arg[8] == '=') {
+                value = arg + 9;
+            } else {
+                fprintf(stderr, "ERROR: invalid --engine usage: %s\n", arg);
+                return 2;
+            }
+
+            if (parse_engine(value, &config->engine) != 0) {
+                fprintf(stderr, "ERROR: invalid --engine value: %s\n", value ? value : "(null)");
+                return 2;
+            }
+        } else if (strncmp(arg, "--rules-include", 15) == 0 || strncmp(arg, "--rules-exclude", 15) == 0) {
+            const char *option = strncmp(arg, "--rules-include", 15) == 0 ? "--rules-include" : "--rules-exclude";
+            char **list = option[8] == 'i' ? &config->rules_include : &config->rules_exclude;
+            const char *value = NULL;
+            if (strcmp(arg, option) == 0) {
+                if (i + 1 >= argc) {
+                    fprintf(stderr, "ERROR: %s requires a value.\n", option);
+                    return 2;
+                }
+                value = argv[++i];
+            } else if (arg[15] == '=') {
+                value = arg + 16;
+            } else {
+                fprintf(stderr, "ERROR: invalid %s usage: %s\n", option, arg);
+                return 2;
+            }
+
+            if (!value || value[0] == '\0') {
+                fprintf(stderr, "ERROR: invalid %s value.\n", option);
+                return 2;
+            }
+            if (append_list(list, value) != 0) {
+                fprintf(stderr, "ERROR: could not copy %s value.\n", option);
+                return 2;
+            }
+        } else if (strncmp(arg, "--min-severity", 14) == 0) {
+            const char *value = NULL;
+            if (strcmp(arg, "--min-severity") == 0) {
+                if (i + 1 >= argc) {
+                    fprintf(stderr, "ERROR: --min-severity requires a value.\n");
+                    return 2;
+                }
+                value = argv[++i];
+            } else if (arg[14] == '=') {
+                value = arg + 15;
+            } else {
+                fprintf(stderr, "ERROR: invalid --min-severity usage: %s\n", arg);
+                return 2;
+            }
+
+            if (rules_parse_severity(value, &config->min_severity) != 0) {
+                fprintf(stderr, "ERROR: invalid --min-severity value: %s\n", value ? value : "(null)");
+                return 2;
+            }
+        } else if (strncmp(arg, "--entropy-min-length", 20) == 0) {
+            const char *value = NULL;
+            if (strcmp(arg, "--entropy-min-length") == 0) {
+                if (i + 1 >= argc) {
+                    fprintf(stderr, "ERROR: --entropy-min-length requires a value.\n");
+                    return 2;
+                }
+                value = argv[++i];
+            } else if (arg[20] == '=') {
+                value = arg + 21;
+            } else {
+                fprintf(stderr, "ERROR: invalid --entropy-min-length usage: %s\n", arg);
+                return 2;
+            }
+
+            if (parse_int(value, &config->entropy_min_length) != 0 || config->entropy_min_length < 1 ||
+                config->entropy_min_length > ENTROPY_MAX_LENGTH) {
+                fprintf(stderr, "ERROR: invalid --entropy-min-length value: %s\n", value ? value : "(null)");
+                return 2;
+            }
+        } else if (strncmp(arg, "--entropy", 9) == 0) {
+            const char *value = NULL;
+            if (strcmp(arg, "--entropy") == 0) {
+                if (i + 1 >= argc) {
+                    fprintf(stderr, "ERROR: --entropy requires a value.\n");
+                    return 2;
+                }
+                value = argv[++i];
+            } else if (arg[9] == '=') {
+                value = arg + 10;
+            } else {
+                fprintf(stderr, "ERROR: invalid --entropy usage: %s\n", arg);
+                return 2;
+            }
+
+            if (parse_double(value, &config->entropy_threshold) != 0 || !(config->entropy_threshold > 0.0) ||
+                config->entropy_threshold > 8.0) {
+                fprintf(stderr, "ERROR: invalid --entropy value: %s\n", value ? value : "(null)");
+                return 2;
+            }
+        } else if (strncmp(arg, "--rules", 7) == 0) {
+            const char *value = NULL;
+            if (strcmp(arg, "--rules") == 0) {
+                if (i + 1 >= argc) {
+                    fprintf(stderr, "ERROR: --rules requires a value.\n");
+                    return 2;
+                }
+                value = argv[++i];
+            } else if (arg[7] == '=') {
+                value = arg + 8;
+            } else {
+                fprintf(stderr, "ERROR: invalid --rules usage: %s\n", arg);
+                return 2;
+            }
+
+            if (!value || value[0] == '\0') {
+                fprintf(stderr, "ERROR: invalid --rules value.\n");
+                return 2;
+            }
+            if (config->rules_path) {
+                fprintf(stderr, "ERROR: multiple --rules values provided.\n");
+                return 2;
+            }
+            config->rules_path = duplicate_string(value);
+            if (!config->rules_path) {
+                fprintf(stderr, "ERROR: could not copy --rules value.\n");
+                return 2;
+            }
         } else if (strcmp(arg, "--stdin") == 0) {
             config->stdin_mode = true;
         } else if (strcmp(arg, "--json") == 0) {
             config->json_output = true;
+        } else if (strcmp(arg, "--profile-rules") == 0) {
+            config->profile_rules = true;
+        } else if (strcmp(arg, "--all-files") == 0) {
+            config->all_files = true;
+        } else if (strcmp(arg, "--scan-binaries") == 0) {
+            config->scan_binaries = true;
         } else if (strncmp(arg, "--out", 5) == 0) {
             const char *value = NULL;
             if (strcmp(arg, "--out") == 0) {
@@ -108,6 +447,16 @@ int parse_arguments(int argc, char **argv, Config *config) {
         } else if (arg[0] == '-') {
             fprintf(stderr, "ERROR: unknown flag. Use --help to see valid options.\n");
             return 2;
+        } else if (config->compile_rules) {
+            if (config->bundle_path) {
+                fprintf(stderr, "ERROR: extra argument: %s\n", arg);
+                return 2;
+            }
+            config->bundle_path = duplicate_string(arg);
+            if (!config->bundle_path) {
+                fprintf(stderr, "ERROR: could not copy bundle path.\n");
+                return 2;
+            }
         } else {
             if (!config->root_path) {
                 config->root_path = duplicate_string(arg);
@@ -124,6 +473,14 @@ int parse_arguments(int argc, char **argv, Config *config) {
         i++;
     }
 
+    if (config->compile_rules) {
+        if (!config->bundle_path) {
+            fprintf(stderr, "ERROR: compile-rules requires an output file.\n");
+            return 2;
+        }
+        return 0;
+    }
+
     if (config->stdin_mode && config->root_path) {
         fprintf(stderr, "ERROR: --stdin cannot be combined with a path.\n");
         return 2;
@@ -180,12 +537,32 @@ void print_config(const Config *config) {
 void print_help(const char *program_name) {
     printf("%s %s (Linux/WSL)\n", APP_NAME, APP_VERSION);
     printf("Usage: %s [OPTIONS] <path>\n", program_name);
+    printf("       %s compile-rules [--rules FILE] [--engine NAME] [selection] <bundle>\n", program_name);
     printf("Options:\n");
     printf("  -h, --help         Show this help text\n");
     printf("      --max-depth N  Limit how deep we recurse (default: -1 for unlimited)\n");
     printf("                     Example: %s --max-depth 3 path/to/scan\n", program_name);
     printf("      --threads N    Number of worker threads (default: 0 for auto)\n");
     printf("                     Example: %s --threads 4 path/to/scan\n", program_name);
+    printf("      --engine NAME  Rule matcher: native (default), regex or generated\n");
+    printf("                     Example: %s --engine regex path/to/scan\n", program_name);
+    printf("      --rules FILE   Add or replace rules from FILE, or load a compiled bundle\n");
+    printf("                     Example: %s --rules team.rules path/to/scan\n", program_name);
+    printf("      --rules-include LIST\n");
+    printf("                     Only run rules whose name matches LIST (comma-separated names or globs)\n");
+    printf("                     Example: %s --rules-include 'AWS_*,GITHUB_TOKEN' path/to/scan\n", program_name);
+    printf("      --rules-exclude LIST\n");
+    printf("                     Do not run rules whose name matches LIST\n");
+    printf("                     Example: %s --rules-exclude 'FIREBASE_*' path/to/scan\n", program_name);
+    printf("      --min-severity LEVEL\n");
+    printf("                     Only run rules of LEVEL (LOW, MEDIUM, HIGH) or above\n");
+    printf("                     Example: %s --min-severity HIGH path/to/scan\n", program_name);
+    printf("      --entropy BITS Also report HIGH_ENTROPY_STRING for base64/hex runs of at least BITS\n");
+    printf("                     bits per character (4.5 is a good start; hex runs need 2/3 of it)\n");
+    printf("                     Example: %s --entropy 4.5 path/to/scan\n", program_name);
+    printf("      --entropy-min-length N\n");
+    printf("                     Shortest run --entropy looks at (default: %d)\n", ENTROPY_DEFAULT_MIN_LENGTH);
+    printf("                     Example: %s --entropy 4.5 --entropy-min-length 32 path/to/scan\n", program_name);
     printf("      --stdin        Read from STDIN instead of a file path\n");
     printf("                     Example:\n");
     printf("                       %s --stdin <<'EOF'\n", program_name);
@@ -195,5 +572,40 @@ void print_help(const char *program_name) {
     printf("                     Example: %s --json path/to/scan\n", program_name);
     printf("      --out FILE     Write results to FILE instead of stdout\n");
     printf("                     Example: %s --out report.txt path/to/scan\n", program_name);
+    printf("      --profile-rules\n");
+    printf("                     Print calls, time, bytes and matches per rule after the report\n");
+    printf("                     Example: %s --profile-rules path/to/scan\n", program_name);
+    printf("      --line-cache MB\n");
+    printf("                     Replay the findings of repeated lines from a cache of MB MiB per\n");
+    printf("                     worker instead of matching them again (default: 0 for off)\n");
+    printf("                     Example: %s --line-cache 64 path/to/logs\n", program_name);
+    printf("      --max-line-length KB\n");
+    printf("                     Guard against minified or one-line files: lines over KB KiB are\n");
+    printf("                     handled as --long-lines says (default: 0 for no limit)\n");
+    printf("                     Example: %s --max-line-length 1024 path/to/scan\n", program_name);
+    printf("      --long-lines POLICY\n");
+    printf("                     truncate (default) scans the first KB KiB of a long line, window\n");
+    printf("                     scans all of it in overlapping windows, skip skips the file\n");
+    printf("                     Example: %s --max-line-length 1024 --long-lines skip path/to/scan\n", program_name);
+    printf("      --io MODE      How files are read: auto (default) maps files of 256 KiB and more\n");
+    printf("                     and reads the rest, read, mmap, or uring to keep the opens and\n");
+    printf("                     reads of %d files in flight per thread\n", SCANNER_URING_DEPTH);
+    printf("                     Example: %s --io uring path/on/nfs\n", program_name);
+    printf("      --io-buffer KB Size of one read in KiB (default: %d)\n", SCANNER_READ_BUFFER_SIZE / 1024);
+    printf("                     Example: %s --io read --io-buffer 256 path/to/scan\n", program_name);
+    printf("      --split-size MB\n");
+    printf("                     With several threads, scan files of MB MiB and more, and stdin,\n");
+    printf("                     in parts on all threads (default: %d, 0 turns it off)\n", DEFAULT_SPLIT_MB);
+    printf("                     Example: %s --threads 8 --split-size 256 dumps/\n", program_name);
+    printf("      --all-files    Scan images, fonts, media, archives and lockfiles too, and run\n");
+    printf("                     every rule on every file\n");
+    printf("                     Example: %s --all-files path/to/scan\n", program_name);
+    printf("      --scan-binaries\n");
+    printf("                     Scan binary files for strings of 8 or more printable characters\n");
+    printf("                     instead of skipping them; findings give the byte offset\n");
+    printf("                     Example: %s --scan-binaries build/\n", program_name);
     printf("\nNote: Provide a path (default: current directory) or use --stdin.\n");
+    printf("compile-rules writes the compiled rules to <bundle>; pass it to --rules\n");
+    printf("to start without compiling. Example: %s compile-rules --rules team.rules team.bundle\n",
+           program_name);
 }
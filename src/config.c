@@ -2,6 +2,8 @@
 
 #include <stdlib.h>
 
+#include "entropy.h"
+
 void init_config(Config *config) {
     if (!config) {
         return;
@@ -12,6 +14,24 @@ void init_config(Config *config) {
     config->json_output = false;
     config->threads = DEFAULT_THREADS;
     config->output_path = NULL;
+    config->engine = RULES_ENGINE_NATIVE;
+    config->profile_rules = false;
+    config->all_files = false;
+    config->scan_binaries = false;
+    config->rules_path = NULL;
+    config->rules_include = NULL;
+    config->rules_exclude = NULL;
+    config->min_severity = SEVERITY_LOW;
+    config->entropy_threshold = 0.0;
+    config->entropy_min_length = ENTROPY_DEFAULT_MIN_LENGTH;
+    config->line_cache_mb = 0;
+    config->max_line_kb = 0;
+    config->long_lines = RULES_LONG_LINE_TRUNCATE;
+    config->io = SCANNER_IO_AUTO;
+    config->io_buffer_kb = SCANNER_READ_BUFFER_SIZE / 1024;
+    config->split_mb = DEFAULT_SPLIT_MB;
+    config->compile_rules = false;
+    config->bundle_path = NULL;
 }
 
 void free_config(Config *config) {
@@ -22,4 +42,12 @@ void free_config(Config *config) {
     config->root_path = NULL;
     free(config->output_path);
     config->output_path = NULL;
+    free(config->rules_path);
+    config->rules_path = NULL;
+    free(config->rules_include);
+    config->rules_include = NULL;
+    free(config->rules_exclude);
+    config->rules_exclude = NULL;
+    free(config->bundle_path);
+    config->bundle_path = NULL;
 }
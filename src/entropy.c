@@ -0,0 +1,299 @@
+#include "entropy.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define ENTROPY_X86 1
+#include <immintrin.h>
+#endif
+
+#define ENTROPY_BLOCK 64
+#define ENTROPY_NONE SIZE_MAX
+
+enum {
+    ENTROPY_ALPHABET = 1,
+    ENTROPY_DIGIT = 2,
+    ENTROPY_LETTER = 4,
+    // Alphabet byte that is not a hex digit.
+    ENTROPY_NOT_HEX = 8
+};
+
+// Bit i of the result is set if bytes[i] is in the alphabet.
+typedef uint64_t (*entropy_mask_fn)(const unsigned char *bytes);
+
+struct EntropyDetector {
+    double threshold;
+    double hex_threshold;
+    size_t min_length;
+    entropy_mask_fn mask;
+    const char *kernel;
+    unsigned char classes[256];
+    // c * log2(c) for every count a run can have.
+    double count_log[ENTROPY_MAX_LENGTH + 1];
+};
+
+static unsigned char byte_class(unsigned char byte) {
+    if (byte >= '0' && byte <= '9') {
+        return ENTROPY_ALPHABET | ENTROPY_DIGIT;
+    }
+    unsigned char lower = (unsigned char)(byte | 0x20);
+    if (lower >= 'a' && lower <= 'z') {
+        return (unsigned char)(ENTROPY_ALPHABET | ENTROPY_LETTER | (lower > 'f' ? ENTROPY_NOT_HEX : 0));
+    }
+    if (byte == '+' || byte == '/' || byte == '=' || byte == '_' || byte == '-') {
+        return ENTROPY_ALPHABET | ENTROPY_NOT_HEX;
+    }
+    return 0;
+}
+
+static uint64_t scalar_mask_length(const unsigned char *bytes, size_t length) {
+    uint64_t mask = 0;
+    for (size_t i = 0; i < length; ++i) {
+        mask |= (uint64_t)(byte_class(bytes[i]) & ENTROPY_ALPHABET) << i;
+    }
+    return mask;
+}
+
+static uint64_t scalar_mask(const unsigned char *bytes) {
+    return scalar_mask_length(bytes, ENTROPY_BLOCK);
+}
+
+#ifdef ENTROPY_X86
+// Bytes in [low, low + count): after subtracting low, a saturating
+// subtract of count - 1 leaves zero exactly for those.
+static __m128i sse2_in_range(__m128i bytes, char low, char count) {
+    __m128i offset = _mm_sub_epi8(bytes, _mm_set1_epi8(low));
+    return _mm_cmpeq_epi8(_mm_subs_epu8(offset, _mm_set1_epi8((char)(count - 1))), _mm_setzero_si128());
+}
+
+static uint64_t sse2_mask16(const unsigned char *bytes) {
+    __m128i input = _mm_loadu_si128((const __m128i *)bytes);
+    __m128i hits = _mm_or_si128(sse2_in_range(input, '0', 10),
+                                sse2_in_range(_mm_or_si128(input, _mm_set1_epi8(0x20)), 'a', 26));
+    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(input, _mm_set1_epi8('+')));
+    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(input, _mm_set1_epi8('/')));
+    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(input, _mm_set1_epi8('=')));
+    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(input, _mm_set1_epi8('_')));
+    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(input, _mm_set1_epi8('-')));
+    return (uint64_t)(uint16_t)_mm_movemask_epi8(hits);
+}
+
+static uint64_t sse2_mask(const unsigned char *bytes) {
+    return sse2_mask16(bytes) | sse2_mask16(bytes + 16) << 16 | sse2_mask16(bytes + 32) << 32 |
+           sse2_mask16(bytes + 48) << 48;
+}
+
+__attribute__((target("avx2"))) static __m256i avx2_in_range(__m256i bytes, char low, char count) {
+    __m256i offset = _mm256_sub_epi8(bytes, _mm256_set1_epi8(low));
+    return _mm256_cmpeq_epi8(_mm256_subs_epu8(offset, _mm256_set1_epi8((char)(count - 1))),
+                             _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2"))) static uint64_t avx2_mask32(const unsigned char *bytes) {
+    __m256i input = _mm256_loadu_si256((const __m256i *)bytes);
+    __m256i hits = _mm256_or_si256(avx2_in_range(input, '0', 10),
+                                   avx2_in_range(_mm256_or_si256(input, _mm256_set1_epi8(0x20)), 'a', 26));
+    hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(input, _mm256_set1_epi8('+')));
+    hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(input, _mm256_set1_epi8('/')));
+    hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(input, _mm256_set1_epi8('=')));
+    hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(input, _mm256_set1_epi8('_')));
+    hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(input, _mm256_set1_epi8('-')));
+    return (uint64_t)(uint32_t)_mm256_movemask_epi8(hits);
+}
+
+__attribute__((target("avx2"))) static uint64_t avx2_mask(const unsigned char *bytes) {
+    return avx2_mask32(bytes) | avx2_mask32(bytes + 32) << 32;
+}
+#endif
+
+bool entropy_detector_use_kernel(EntropyDetector *detector, const char *name) {
+    if (!detector || !name) {
+        return false;
+    }
+    if (strcmp(name, "scalar") == 0) {
+        detector->mask = scalar_mask;
+        detector->kernel = "scalar";
+        return true;
+    }
+#ifdef ENTROPY_X86
+    if (strcmp(name, "sse2") == 0) {
+        detector->mask = sse2_mask;
+        detector->kernel = "sse2";
+        return true;
+    }
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+        detector->mask = avx2_mask;
+        detector->kernel = "avx2";
+        return true;
+    }
+#endif
+    return false;
+}
+
+EntropyDetector *entropy_detector_create(double threshold, size_t min_length) {
+    if (!(threshold > 0.0) || min_length == 0) {
+        return NULL;
+    }
+    EntropyDetector *detector = calloc(1, sizeof(*detector));
+    if (!detector) {
+        return NULL;
+    }
+    detector->threshold = threshold;
+    detector->hex_threshold = threshold * 2.0 / 3.0;
+    detector->min_length = min_length;
+    for (unsigned int byte = 0; byte < 256; ++byte) {
+        detector->classes[byte] = byte_class((unsigned char)byte);
+    }
+    for (size_t count = 1; count <= ENTROPY_MAX_LENGTH; ++count) {
+        detector->count_log[count] = (double)count * log2((double)count);
+    }
+    if (!entropy_detector_use_kernel(detector, "avx2") && !entropy_detector_use_kernel(detector, "sse2")) {
+        entropy_detector_use_kernel(detector, "scalar");
+    }
+    return detector;
+}
+
+void entropy_detector_destroy(EntropyDetector *detector) {
+    free(detector);
+}
+
+const char *entropy_detector_kernel(const EntropyDetector *detector) {
+    return detector ? detector->kernel : NULL;
+}
+
+// True if the run is reported: short runs, blobs, runs without both
+// letters and digits and runs below the threshold are not.
+static bool run_qualifies(const EntropyDetector *detector, const unsigned char *run, size_t length) {
+    if (length < detector->min_length || length > ENTROPY_MAX_LENGTH) {
+        return false;
+    }
+    uint16_t counts[256];
+    memset(counts, 0, sizeof(counts));
+    unsigned char seen = 0;
+    for (size_t i = 0; i < length; ++i) {
+        counts[run[i]]++;
+        seen |= detector->classes[run[i]];
+    }
+    if ((seen & (ENTROPY_DIGIT | ENTROPY_LETTER)) != (ENTROPY_DIGIT | ENTROPY_LETTER)) {
+        return false;
+    }
+    // H = log2(n) - sum(c * log2(c)) / n; each distinct byte is summed
+    // once, when its count is cleared.
+    double sum = 0.0;
+    for (size_t i = 0; i < length; ++i) {
+        if (counts[run[i]] != 0) {
+            sum += detector->count_log[counts[run[i]]];
+            counts[run[i]] = 0;
+        }
+    }
+    double entropy = (detector->count_log[length] - sum) / (double)length;
+    double threshold = (seen & ENTROPY_NOT_HEX) ? detector->threshold : detector->hex_threshold;
+    return entropy >= threshold;
+}
+
+// Bit i is set if bits i..i+count-1 of mask are all set. Zeros shift in
+// from the top, so runs reaching bit 63 are cut off.
+static uint64_t run_starts(uint64_t mask, size_t count) {
+    if (count > ENTROPY_BLOCK) {
+        return 0;
+    }
+    uint64_t result = mask;
+    for (size_t covered = 1; covered < count;) {
+        size_t shift = covered < count - covered ? covered : count - covered;
+        result &= result >> shift;
+        covered += shift;
+    }
+    return result;
+}
+
+bool entropy_detector_next(const EntropyDetector *detector,
+                           const char *text,
+                           size_t length,
+                           size_t from,
+                           size_t *start,
+                           size_t *end) {
+    if (!detector || !text || from >= length) {
+        return false;
+    }
+    const unsigned char *bytes = (const unsigned char *)text;
+    const unsigned char *classes = detector->classes;
+    if (from > 0 && (classes[bytes[from - 1]] & ENTROPY_ALPHABET)) {
+        while (from < length && (classes[bytes[from]] & ENTROPY_ALPHABET)) {
+            from++;
+        }
+    }
+
+    // Start of the run that reaches the end of the previous block. The
+    // common case, a block of short words, takes no unpredictable branch.
+    size_t open = ENTROPY_NONE;
+    size_t position = from;
+    while (position < length) {
+        size_t block = length - position < ENTROPY_BLOCK ? length - position : ENTROPY_BLOCK;
+        uint64_t mask = block == ENTROPY_BLOCK ? detector->mask(bytes + position)
+                                               : scalar_mask_length(bytes + position, block);
+        if (mask == UINT64_MAX) {
+            open = open == ENTROPY_NONE ? position : open;
+            position += block;
+            continue;
+        }
+
+        // The open run ends at the first byte outside the alphabet.
+        size_t run_start = open == ENTROPY_NONE ? position : open;
+        size_t done = open == ENTROPY_NONE ? 0 : (size_t)__builtin_ctzll(~mask);
+        size_t run_end = position + done;
+        if (run_end - run_start >= detector->min_length &&
+            run_qualifies(detector, bytes + run_start, run_end - run_start)) {
+            *start = run_start;
+            *end = run_end;
+            return true;
+        }
+        // A run reaching the top of the block stays open. Partial blocks
+        // have no bits there.
+        uint64_t rest = mask & (UINT64_MAX << done);
+        size_t top = (size_t)__builtin_clzll(~rest);
+        open = top ? position + ENTROPY_BLOCK - top : ENTROPY_NONE;
+        rest &= UINT64_MAX >> top;
+
+        // Runs inside the block; only those of min_length or more are looked at.
+        uint64_t long_runs = run_starts(rest, detector->min_length);
+        while (long_runs) {
+            run_start = (size_t)__builtin_ctzll(long_runs);
+            run_end = run_start + (size_t)__builtin_ctzll(~(rest >> run_start));
+            if (run_qualifies(detector, bytes + position + run_start, run_end - run_start)) {
+                *start = position + run_start;
+                *end = position + run_end;
+                return true;
+            }
+            long_runs &= UINT64_MAX << run_end;
+        }
+        position += block;
+    }
+    if (open != ENTROPY_NONE && run_qualifies(detector, bytes + open, length - open)) {
+        *start = open;
+        *end = length;
+        return true;
+    }
+    return false;
+}
+
+double entropy_bits(const char *text, size_t length) {
+    if (!text || length == 0) {
+        return 0.0;
+    }
+    size_t counts[256];
+    memset(counts, 0, sizeof(counts));
+    for (size_t i = 0; i < length; ++i) {
+        counts[(unsigned char)text[i]]++;
+    }
+    double entropy = 0.0;
+    for (size_t byte = 0; byte < 256; ++byte) {
+        if (counts[byte] != 0) {
+            double probability = (double)counts[byte] / (double)length;
+            entropy -= probability * log2(probability);
+        }
+    }
+    return entropy;
+}
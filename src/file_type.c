@@ -0,0 +1,128 @@
+#include "file_type.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+typedef struct {
+    const char *name;
+    file_type_t type;
+} FileTypeEntry;
+
+// Sorted case-insensitively for bsearch.
+static const FileTypeEntry EXTENSIONS[] = {
+    {"7z", FILE_TYPE_SKIP}, {"a", FILE_TYPE_BINARY}, {"aac", FILE_TYPE_SKIP}, {"apk", FILE_TYPE_SKIP},
+    {"asc", FILE_TYPE_TEXT}, {"avi", FILE_TYPE_SKIP}, {"avif", FILE_TYPE_SKIP}, {"bmp", FILE_TYPE_SKIP},
+    {"bz2", FILE_TYPE_SKIP}, {"cer", FILE_TYPE_TEXT}, {"class", FILE_TYPE_BINARY}, {"crt", FILE_TYPE_TEXT},
+    {"dex", FILE_TYPE_BINARY}, {"dll", FILE_TYPE_BINARY}, {"dmg", FILE_TYPE_SKIP}, {"dylib", FILE_TYPE_BINARY},
+    {"eot", FILE_TYPE_SKIP}, {"exe", FILE_TYPE_BINARY}, {"flac", FILE_TYPE_SKIP}, {"flv", FILE_TYPE_SKIP},
+    {"gif", FILE_TYPE_SKIP}, {"gz", FILE_TYPE_SKIP}, {"har", FILE_TYPE_JSON}, {"heic", FILE_TYPE_SKIP},
+    {"icns", FILE_TYPE_SKIP}, {"ico", FILE_TYPE_SKIP}, {"ipa", FILE_TYPE_SKIP}, {"ipynb", FILE_TYPE_JSON},
+    {"iso", FILE_TYPE_SKIP}, {"jar", FILE_TYPE_SKIP}, {"jpeg", FILE_TYPE_SKIP}, {"jpg", FILE_TYPE_SKIP},
+    {"json", FILE_TYPE_JSON}, {"json5", FILE_TYPE_JSON}, {"jsonc", FILE_TYPE_JSON}, {"key", FILE_TYPE_TEXT},
+    {"lib", FILE_TYPE_BINARY}, {"lock", FILE_TYPE_SKIP}, {"m4a", FILE_TYPE_SKIP}, {"m4v", FILE_TYPE_SKIP},
+    {"mkv", FILE_TYPE_SKIP}, {"mov", FILE_TYPE_SKIP}, {"mp3", FILE_TYPE_SKIP}, {"mp4", FILE_TYPE_SKIP},
+    {"o", FILE_TYPE_BINARY}, {"obj", FILE_TYPE_BINARY}, {"oga", FILE_TYPE_SKIP}, {"ogg", FILE_TYPE_SKIP},
+    {"opus", FILE_TYPE_SKIP}, {"otf", FILE_TYPE_SKIP}, {"pdf", FILE_TYPE_SKIP}, {"pem", FILE_TYPE_TEXT},
+    {"png", FILE_TYPE_SKIP}, {"psd", FILE_TYPE_SKIP}, {"pub", FILE_TYPE_TEXT}, {"pyc", FILE_TYPE_BINARY},
+    {"pyo", FILE_TYPE_BINARY}, {"rar", FILE_TYPE_SKIP}, {"so", FILE_TYPE_BINARY}, {"tar", FILE_TYPE_SKIP},
+    {"tfstate", FILE_TYPE_JSON}, {"tgz", FILE_TYPE_SKIP}, {"tif", FILE_TYPE_SKIP}, {"tiff", FILE_TYPE_SKIP},
+    {"ttf", FILE_TYPE_SKIP}, {"war", FILE_TYPE_SKIP}, {"wasm", FILE_TYPE_BINARY}, {"wav", FILE_TYPE_SKIP},
+    {"webm", FILE_TYPE_SKIP}, {"webmanifest", FILE_TYPE_JSON}, {"webp", FILE_TYPE_SKIP}, {"wmv", FILE_TYPE_SKIP},
+    {"woff", FILE_TYPE_SKIP}, {"woff2", FILE_TYPE_SKIP}, {"xz", FILE_TYPE_SKIP}, {"zip", FILE_TYPE_SKIP},
+    {"zst", FILE_TYPE_SKIP},
+};
+
+// Whole file names that decide the type before the extension does.
+static const FileTypeEntry FILE_NAMES[] = {
+    {".babelrc", FILE_TYPE_JSON}, {".eslintrc", FILE_TYPE_JSON}, {".htpasswd", FILE_TYPE_TEXT},
+    {".netrc", FILE_TYPE_TEXT}, {"go.sum", FILE_TYPE_SKIP}, {"id_dsa", FILE_TYPE_TEXT},
+    {"id_ecdsa", FILE_TYPE_TEXT}, {"id_ed25519", FILE_TYPE_TEXT}, {"id_rsa", FILE_TYPE_TEXT},
+    {"npm-shrinkwrap.json", FILE_TYPE_SKIP}, {"package-lock.json", FILE_TYPE_SKIP},
+    {"packages.lock.json", FILE_TYPE_SKIP}, {"pnpm-lock.yaml", FILE_TYPE_SKIP},
+    {"service_account.json", FILE_TYPE_JSON},
+};
+
+typedef struct {
+    size_t offset;
+    const char *bytes;
+    size_t length;
+} FileSignature;
+
+#define SIGNATURE(offset, bytes) {offset, bytes, sizeof(bytes) - 1}
+
+// Leading bytes of binary formats. Text files do not start with these,
+// and most of them would fail is_binary_buffer later anyway; matching
+// them here is definitive and cheaper. Compressed or media formats hold no
+// readable strings and are skipped; compiled code is FILE_TYPE_BINARY.
+static const FileSignature SKIP_SIGNATURES[] = {
+    SIGNATURE(0, "\x89PNG\r\n\x1a\n"), SIGNATURE(0, "\xff\xd8\xff"), SIGNATURE(0, "GIF87a"),
+    SIGNATURE(0, "GIF89a"), SIGNATURE(0, "II*\0"), SIGNATURE(0, "MM\0*"), SIGNATURE(0, "8BPS\0\x01"),
+    SIGNATURE(0, "RIFF"), SIGNATURE(4, "ftyp"), SIGNATURE(0, "\x1a\x45\xdf\xa3"), SIGNATURE(0, "OggS\0"),
+    SIGNATURE(0, "fLaC\0\0\0\x22"), SIGNATURE(0, "ID3\x02"), SIGNATURE(0, "ID3\x03"), SIGNATURE(0, "ID3\x04"),
+    SIGNATURE(0, "wOFF"), SIGNATURE(0, "wOF2"), SIGNATURE(0, "OTTO\0"), SIGNATURE(0, "%PDF-"),
+    SIGNATURE(0, "PK\x03\x04"), SIGNATURE(0, "PK\x05\x06"), SIGNATURE(0, "\x1f\x8b"),
+    SIGNATURE(0, "\xfd" "7zXZ\0"), SIGNATURE(0, "\x28\xb5\x2f\xfd"), SIGNATURE(0, "7z\xbc\xaf\x27\x1c"),
+    SIGNATURE(0, "Rar!\x1a\x07"),
+};
+
+static const FileSignature BINARY_SIGNATURES[] = {
+    SIGNATURE(0, "\x7f" "ELF"), SIGNATURE(0, "\xca\xfe\xba\xbe"), SIGNATURE(0, "\xfe\xed\xfa\xce"),
+    SIGNATURE(0, "\xfe\xed\xfa\xcf"), SIGNATURE(0, "\xce\xfa\xed\xfe"), SIGNATURE(0, "\xcf\xfa\xed\xfe"),
+    SIGNATURE(0, "\0asm"),
+};
+
+static int compare_entry(const void *key, const void *entry) {
+    return strcasecmp((const char *)key, ((const FileTypeEntry *)entry)->name);
+}
+
+static const FileTypeEntry *find_entry(const FileTypeEntry *entries, size_t count, const char *name) {
+    return bsearch(name, entries, count, sizeof(*entries), compare_entry);
+}
+
+file_type_t file_type_from_path(const char *path) {
+    if (!path) {
+        return FILE_TYPE_UNKNOWN;
+    }
+    const char *slash = strrchr(path, '/');
+    const char *name = slash ? slash + 1 : path;
+
+    const FileTypeEntry *entry = find_entry(FILE_NAMES, sizeof(FILE_NAMES) / sizeof(FILE_NAMES[0]), name);
+    if (entry) {
+        return entry->type;
+    }
+    const char *dot = strrchr(name, '.');
+    if (!dot || dot[1] == '\0') {
+        return FILE_TYPE_UNKNOWN;
+    }
+    entry = find_entry(EXTENSIONS, sizeof(EXTENSIONS) / sizeof(EXTENSIONS[0]), dot + 1);
+    return entry ? entry->type : FILE_TYPE_UNKNOWN;
+}
+
+static bool has_signature(const FileSignature *signatures,
+                          size_t count,
+                          const unsigned char *head,
+                          size_t length) {
+    for (size_t i = 0; i < count; ++i) {
+        const FileSignature *signature = &signatures[i];
+        if (length >= signature->offset + signature->length &&
+            memcmp(head + signature->offset, signature->bytes, signature->length) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+file_type_t file_type_sniff(file_type_t type, const unsigned char *head, size_t length) {
+    if (!head) {
+        return type;
+    }
+    if (has_signature(SKIP_SIGNATURES, sizeof(SKIP_SIGNATURES) / sizeof(SKIP_SIGNATURES[0]), head, length)) {
+        return FILE_TYPE_SKIP;
+    }
+    if (has_signature(BINARY_SIGNATURES, sizeof(BINARY_SIGNATURES) / sizeof(BINARY_SIGNATURES[0]), head, length)) {
+        return FILE_TYPE_BINARY;
+    }
+    return type;
+}
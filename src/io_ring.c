@@ -0,0 +1,251 @@
+#include "io_ring.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+
+struct IoRing {
+    int fd;
+    // Submission queue: the kernel consumes from head, we produce at tail.
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    // Completion queue: the kernel produces at tail, we consume at head.
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+    // Queued but not yet handed to the kernel.
+    unsigned pending;
+    void *sq_memory;
+    size_t sq_size;
+    void *cq_memory;
+    size_t cq_size;
+    size_t sqes_size;
+};
+
+static unsigned *ring_field(void *memory, uint32_t offset) {
+    return (unsigned *)((char *)memory + offset);
+}
+
+IoRing *io_ring_create(unsigned entries) {
+    IoRing *ring = calloc(1, sizeof(*ring));
+    if (!ring) {
+        return NULL;
+    }
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0) {
+        free(ring);
+        return NULL;
+    }
+
+    ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        ring->sq_size = ring->sq_size > ring->cq_size ? ring->sq_size : ring->cq_size;
+    }
+    ring->sq_memory = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                           IORING_OFF_SQ_RING);
+    if (ring->sq_memory == MAP_FAILED) {
+        ring->sq_memory = NULL;
+        io_ring_destroy(ring);
+        return NULL;
+    }
+    if (single_mmap) {
+        ring->cq_memory = ring->sq_memory;
+    } else {
+        ring->cq_memory = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                               IORING_OFF_CQ_RING);
+        if (ring->cq_memory == MAP_FAILED) {
+            ring->cq_memory = NULL;
+            io_ring_destroy(ring);
+            return NULL;
+        }
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                      IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        io_ring_destroy(ring);
+        return NULL;
+    }
+
+    ring->sq_head = ring_field(ring->sq_memory, params.sq_off.head);
+    ring->sq_tail = ring_field(ring->sq_memory, params.sq_off.tail);
+    ring->sq_mask = *ring_field(ring->sq_memory, params.sq_off.ring_mask);
+    ring->sq_entries = params.sq_entries;
+    ring->sq_array = ring_field(ring->sq_memory, params.sq_off.array);
+    ring->cq_head = ring_field(ring->cq_memory, params.cq_off.head);
+    ring->cq_tail = ring_field(ring->cq_memory, params.cq_off.tail);
+    ring->cq_mask = *ring_field(ring->cq_memory, params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)((char *)ring->cq_memory + params.cq_off.cqes);
+    return ring;
+}
+
+void io_ring_destroy(IoRing *ring) {
+    if (!ring) {
+        return;
+    }
+    if (ring->sqes) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_memory && ring->cq_memory != ring->sq_memory) {
+        munmap(ring->cq_memory, ring->cq_size);
+    }
+    if (ring->sq_memory) {
+        munmap(ring->sq_memory, ring->sq_size);
+    }
+    close(ring->fd);
+    free(ring);
+}
+
+bool io_ring_supported(void) {
+    IoRing *ring = io_ring_create(1);
+    io_ring_destroy(ring);
+    return ring != NULL;
+}
+
+static struct io_uring_sqe *next_sqe(IoRing *ring) {
+    unsigned tail = *ring->sq_tail;
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (tail - head >= ring->sq_entries) {
+        return NULL;
+    }
+    unsigned index = tail & ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    return sqe;
+}
+
+static void push_sqe(IoRing *ring) {
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail + 1, __ATOMIC_RELEASE);
+    ring->pending++;
+}
+
+int io_ring_queue_open(IoRing *ring, const char *path, int flags, uint64_t user_data) {
+    struct io_uring_sqe *sqe = ring ? next_sqe(ring) : NULL;
+    if (!sqe) {
+        return -1;
+    }
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uint64_t)(uintptr_t)path;
+    sqe->open_flags = (uint32_t)flags;
+    sqe->user_data = user_data;
+    push_sqe(ring);
+    return 0;
+}
+
+int io_ring_queue_read(IoRing *ring, int fd, void *buffer, size_t length, uint64_t offset, uint64_t user_data) {
+    struct io_uring_sqe *sqe = ring ? next_sqe(ring) : NULL;
+    if (!sqe) {
+        return -1;
+    }
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buffer;
+    sqe->len = (uint32_t)length;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+    push_sqe(ring);
+    return 0;
+}
+
+int io_ring_submit(IoRing *ring, unsigned wait_for) {
+    if (!ring) {
+        return -1;
+    }
+    unsigned flags = wait_for > 0 ? IORING_ENTER_GETEVENTS : 0;
+    while (ring->pending > 0 || wait_for > 0) {
+        long submitted = syscall(__NR_io_uring_enter, ring->fd, ring->pending, wait_for, flags, NULL, 0);
+        if (submitted < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        ring->pending -= (unsigned)submitted;
+        if (ring->pending == 0) {
+            break;
+        }
+    }
+    return 0;
+}
+
+bool io_ring_next(IoRing *ring, uint64_t *user_data, int *result) {
+    if (!ring) {
+        return false;
+    }
+    unsigned head = *ring->cq_head;
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    const struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+    *user_data = cqe->user_data;
+    *result = cqe->res;
+    __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+#else
+
+IoRing *io_ring_create(unsigned entries) {
+    (void)entries;
+    return NULL;
+}
+
+void io_ring_destroy(IoRing *ring) {
+    (void)ring;
+}
+
+bool io_ring_supported(void) {
+    return false;
+}
+
+int io_ring_queue_open(IoRing *ring, const char *path, int flags, uint64_t user_data) {
+    (void)ring;
+    (void)path;
+    (void)flags;
+    (void)user_data;
+    return -1;
+}
+
+int io_ring_queue_read(IoRing *ring, int fd, void *buffer, size_t length, uint64_t offset, uint64_t user_data) {
+    (void)ring;
+    (void)fd;
+    (void)buffer;
+    (void)length;
+    (void)offset;
+    (void)user_data;
+    return -1;
+}
+
+int io_ring_submit(IoRing *ring, unsigned wait_for) {
+    (void)ring;
+    (void)wait_for;
+    return -1;
+}
+
+bool io_ring_next(IoRing *ring, uint64_t *user_data, int *result) {
+    (void)ring;
+    (void)user_data;
+    (void)result;
+    return false;
+}
+
+#endif
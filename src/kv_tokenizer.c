@@ -0,0 +1,878 @@
+#include "kv_tokenizer.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "byte_class.h"
+
+// Limits on the keys one rule may expand to; larger sets stay with the
+// rule's own matcher.
+#define KV_MAX_KEYS_PER_RULE 64
+#define KV_MAX_KEY_LENGTH 32
+// Bounded repeats inside a key are expanded up to this count.
+#define KV_MAX_KEY_REPEAT 4
+// Displacements tried per bucket before the table is doubled.
+#define KV_MAX_DISPLACEMENT 65536
+#define KV_HASH_BASIS 2166136261u
+#define KV_NONE UINT32_MAX
+
+enum {
+    // Preceded by '^' or a byte of boundary.
+    KV_RULE_BOUNDARY = 1,
+    // The value starts after a [[:space:]]* run.
+    KV_RULE_VALUE_SPACES = 2,
+    // The value's first byte must be in value_first.
+    KV_RULE_VALUE_FIRST = 4
+};
+
+typedef struct {
+    uint32_t id;
+    uint32_t flags;
+    // Shortest text the pattern can match after the separator.
+    uint32_t value_min_length;
+    uint32_t reserved;
+    unsigned char boundary[32];
+    unsigned char separators[32];
+    unsigned char value_first[32];
+} KvRule;
+
+// One key of one rule. Keys with the same text are chained through next,
+// and only the first of a chain is in the hash table.
+typedef struct {
+    uint32_t offset;
+    uint32_t length;
+    uint32_t rule;
+    uint32_t next;
+} KvKey;
+
+struct KvTokenizer {
+    KvRule *rules;
+    size_t rule_count;
+    KvKey *keys;
+    size_t key_count;
+    // Lowercase key text; keys point into it.
+    char *text;
+    size_t text_size;
+    bool built;
+
+    // Perfect hash over the key texts, read right to left so a walk from
+    // the separator extends the hash one byte per step. The hash picks a
+    // bucket, and the bucket's displacement was chosen at build time so no
+    // two keys share a slot.
+    uint32_t *slots;
+    size_t slot_count;
+    uint32_t *displacements;
+    size_t bucket_count;
+
+    // Derived from the rules when built or loaded.
+    ByteClassSet separators;
+    size_t max_key_length;
+
+    // Tables point into a serialized image owned by the caller.
+    bool borrowed;
+};
+
+static void set_add(unsigned char *set, unsigned char byte) {
+    set[byte >> 3] |= (unsigned char)(1u << (byte & 7));
+}
+
+static bool set_has(const unsigned char *set, unsigned char byte) {
+    return (set[byte >> 3] & (1u << (byte & 7))) != 0;
+}
+
+static bool is_space(unsigned char byte) {
+    return byte == ' ' || (byte >= 0x09 && byte <= 0x0D);
+}
+
+// Bytes a key may consist of; quotes allow JSON keys such as "type".
+static bool is_key_byte(unsigned char byte) {
+    return (byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z') || (byte >= '0' && byte <= '9') ||
+           byte == '_' || byte == '-' || byte == '"';
+}
+
+static unsigned char lower_byte(unsigned char byte) {
+    return byte >= 'A' && byte <= 'Z' ? (unsigned char)(byte - 'A' + 'a') : byte;
+}
+
+static uint32_t hash_step(uint32_t hash, unsigned char byte) {
+    return (hash ^ byte) * 16777619u;
+}
+
+static size_t hash_slot(const KvTokenizer *tokenizer, uint32_t hash) {
+    uint32_t mixed = (hash ^ tokenizer->displacements[hash & (tokenizer->bucket_count - 1)]) * 2654435761u;
+    return (mixed ^ (mixed >> 16)) & (tokenizer->slot_count - 1);
+}
+
+KvTokenizer *kv_tokenizer_create(void) {
+    return calloc(1, sizeof(KvTokenizer));
+}
+
+static bool is_space_run(const PatternNode *node) {
+    if (!node || node->kind != PATTERN_NODE_REPEAT || node->repeat_min != 0 ||
+        node->repeat_max != PATTERN_REPEAT_UNBOUNDED || node->left->kind != PATTERN_NODE_CHARSET) {
+        return false;
+    }
+    for (unsigned int byte = 0; byte < 256; ++byte) {
+        if (pattern_charset_contains(node->left, (unsigned char)byte) != is_space((unsigned char)byte)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// '^' on its own or (^|[set]) in either order.
+static bool read_boundary(const PatternNode *node, unsigned char *set) {
+    memset(set, 0, 32);
+    if (node->kind == PATTERN_NODE_BEGIN_LINE) {
+        return true;
+    }
+    if (node->kind != PATTERN_NODE_ALTERNATE) {
+        return false;
+    }
+    const PatternNode *other = NULL;
+    if (node->left->kind == PATTERN_NODE_BEGIN_LINE) {
+        other = node->right;
+    } else if (node->right->kind == PATTERN_NODE_BEGIN_LINE) {
+        other = node->left;
+    }
+    if (!other || other->kind != PATTERN_NODE_CHARSET) {
+        return false;
+    }
+    memcpy(set, other->set, 32);
+    return true;
+}
+
+static size_t count_items(const PatternNode *node) {
+    if (node->kind != PATTERN_NODE_CONCAT) {
+        return 1;
+    }
+    return count_items(node->left) + count_items(node->right);
+}
+
+static void collect_items(const PatternNode *node, const PatternNode **items, size_t *count) {
+    if (node->kind != PATTERN_NODE_CONCAT) {
+        items[(*count)++] = node;
+        return;
+    }
+    collect_items(node->left, items, count);
+    collect_items(node->right, items, count);
+}
+
+// Add the bytes a match of node can start with to set. Returns true if
+// node can also match the empty string.
+static bool first_bytes(const PatternNode *node, unsigned char *set) {
+    switch (node->kind) {
+    case PATTERN_NODE_CHARSET:
+        for (size_t i = 0; i < 32; ++i) {
+            set[i] |= node->set[i];
+        }
+        return false;
+    case PATTERN_NODE_CONCAT:
+        return first_bytes(node->left, set) && first_bytes(node->right, set);
+    case PATTERN_NODE_ALTERNATE: {
+        bool left = first_bytes(node->left, set);
+        bool right = first_bytes(node->right, set);
+        return left || right;
+    }
+    case PATTERN_NODE_REPEAT:
+        return first_bytes(node->left, set) || node->repeat_min == 0;
+    case PATTERN_NODE_EMPTY:
+    case PATTERN_NODE_BEGIN_LINE:
+    case PATTERN_NODE_END_LINE:
+    default:
+        return true;
+    }
+}
+
+static int key_set_add(PatternLiteralSet *keys, const char *text, size_t length) {
+    for (size_t i = 0; i < keys->count; ++i) {
+        if (strlen(keys->items[i]) == length && memcmp(keys->items[i], text, length) == 0) {
+            return 0;
+        }
+    }
+    if (keys->count == KV_MAX_KEYS_PER_RULE) {
+        return 1;
+    }
+    char **resized = realloc(keys->items, (keys->count + 1) * sizeof(*resized));
+    if (!resized) {
+        return -1;
+    }
+    keys->items = resized;
+    char *copy = malloc(length + 1);
+    if (!copy) {
+        return -1;
+    }
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    keys->items[keys->count++] = copy;
+    return 0;
+}
+
+// Every concatenation of a string of left with one of right.
+static int key_set_cross(const PatternLiteralSet *left, const PatternLiteralSet *right, PatternLiteralSet *out) {
+    memset(out, 0, sizeof(*out));
+    char buffer[2 * KV_MAX_KEY_LENGTH + 1];
+    for (size_t i = 0; i < left->count; ++i) {
+        for (size_t j = 0; j < right->count; ++j) {
+            size_t left_length = strlen(left->items[i]);
+            size_t right_length = strlen(right->items[j]);
+            if (left_length + right_length > KV_MAX_KEY_LENGTH) {
+                return 1;
+            }
+            memcpy(buffer, left->items[i], left_length);
+            memcpy(buffer + left_length, right->items[j], right_length);
+            int result = key_set_add(out, buffer, left_length + right_length);
+            if (result != 0) {
+                return result;
+            }
+        }
+    }
+    return 0;
+}
+
+// Expand the key part of a pattern into the lowercase strings it matches.
+// Returns 0 on success, 1 if the language is not a small set of words and
+// -1 on allocation failure; out must be freed in every case.
+static int expand_keys(const PatternNode *node, PatternLiteralSet *out) {
+    memset(out, 0, sizeof(*out));
+    switch (node->kind) {
+    case PATTERN_NODE_EMPTY:
+        return key_set_add(out, "", 0);
+    case PATTERN_NODE_CHARSET:
+        for (unsigned int byte = 0; byte < 256; ++byte) {
+            if (!pattern_charset_contains(node, (unsigned char)byte)) {
+                continue;
+            }
+            if (!is_key_byte((unsigned char)byte)) {
+                return 1;
+            }
+            char text = (char)lower_byte((unsigned char)byte);
+            int result = key_set_add(out, &text, 1);
+            if (result != 0) {
+                return result;
+            }
+        }
+        return 0;
+    case PATTERN_NODE_ALTERNATE:
+    case PATTERN_NODE_CONCAT: {
+        PatternLiteralSet left;
+        PatternLiteralSet right;
+        int result = expand_keys(node->left, &left);
+        if (result == 0) {
+            result = expand_keys(node->right, &right);
+        } else {
+            memset(&right, 0, sizeof(right));
+        }
+        if (result == 0 && node->kind == PATTERN_NODE_CONCAT) {
+            result = key_set_cross(&left, &right, out);
+        }
+        for (size_t i = 0; result == 0 && node->kind == PATTERN_NODE_ALTERNATE && i < left.count + right.count; ++i) {
+            const char *text = i < left.count ? left.items[i] : right.items[i - left.count];
+            result = key_set_add(out, text, strlen(text));
+        }
+        pattern_literal_set_free(&left);
+        pattern_literal_set_free(&right);
+        return result;
+    }
+    case PATTERN_NODE_REPEAT: {
+        if (node->repeat_max == PATTERN_REPEAT_UNBOUNDED || node->repeat_max > KV_MAX_KEY_REPEAT) {
+            return 1;
+        }
+        PatternLiteralSet child;
+        PatternLiteralSet current;
+        memset(&current, 0, sizeof(current));
+        int result = expand_keys(node->left, &child);
+        if (result == 0) {
+            result = key_set_add(&current, "", 0);
+        }
+        // current holds the strings of exactly count copies.
+        for (int count = 0; result == 0 && count <= node->repeat_max; ++count) {
+            for (size_t i = 0; result == 0 && count >= node->repeat_min && i < current.count; ++i) {
+                result = key_set_add(out, current.items[i], strlen(current.items[i]));
+            }
+            if (result == 0 && count < node->repeat_max) {
+                PatternLiteralSet longer;
+                result = key_set_cross(&current, &child, &longer);
+                pattern_literal_set_free(&current);
+                current = longer;
+            }
+        }
+        pattern_literal_set_free(&child);
+        pattern_literal_set_free(&current);
+        return result;
+    }
+    case PATTERN_NODE_BEGIN_LINE:
+    case PATTERN_NODE_END_LINE:
+    default:
+        return 1;
+    }
+}
+
+static int append_key(KvTokenizer *tokenizer, const char *text, size_t rule) {
+    size_t length = strlen(text);
+    KvKey *keys = realloc(tokenizer->keys, (tokenizer->key_count + 1) * sizeof(*keys));
+    if (!keys) {
+        return -1;
+    }
+    tokenizer->keys = keys;
+    char *resized = realloc(tokenizer->text, tokenizer->text_size + length + 1);
+    if (!resized) {
+        return -1;
+    }
+    tokenizer->text = resized;
+    memcpy(tokenizer->text + tokenizer->text_size, text, length + 1);
+
+    KvKey *key = &tokenizer->keys[tokenizer->key_count++];
+    key->offset = (uint32_t)tokenizer->text_size;
+    key->length = (uint32_t)length;
+    key->rule = (uint32_t)rule;
+    key->next = KV_NONE;
+    tokenizer->text_size += length + 1;
+    return 0;
+}
+
+// Split the pattern into boundary, key, spaces, separator and value, or
+// return 0 if it does not have that shape.
+static int read_rule(const PatternNode *const *items, size_t count, KvRule *rule, PatternLiteralSet *keys) {
+    memset(rule, 0, sizeof(*rule));
+    memset(keys, 0, sizeof(*keys));
+    size_t index = 0;
+    if (count > 0 && read_boundary(items[0], rule->boundary)) {
+        rule->flags |= KV_RULE_BOUNDARY;
+        index++;
+    }
+    size_t key_start = index;
+    while (index < count && !is_space_run(items[index])) {
+        index++;
+    }
+    // Key, spaces and separator are required.
+    if (index == key_start || index + 1 >= count || items[index + 1]->kind != PATTERN_NODE_CHARSET) {
+        return 0;
+    }
+    const PatternNode *separator = items[index + 1];
+    bool any_separator = false;
+    for (unsigned int byte = 0; byte < 256; ++byte) {
+        if (!pattern_charset_contains(separator, (unsigned char)byte)) {
+            continue;
+        }
+        if (byte != ':' && byte != '=') {
+            return 0;
+        }
+        set_add(rule->separators, (unsigned char)byte);
+        any_separator = true;
+    }
+    if (!any_separator) {
+        return 0;
+    }
+
+    for (size_t i = key_start; i < index; ++i) {
+        PatternLiteralSet part;
+        PatternLiteralSet joined;
+        int result = expand_keys(items[i], &part);
+        if (result == 0 && i == key_start) {
+            *keys = part;
+            continue;
+        }
+        if (result == 0) {
+            result = key_set_cross(keys, &part, &joined);
+            pattern_literal_set_free(keys);
+            *keys = joined;
+        }
+        pattern_literal_set_free(&part);
+        if (result != 0) {
+            return result < 0 ? -1 : 0;
+        }
+    }
+    for (size_t i = 0; i < keys->count; ++i) {
+        if (keys->items[i][0] == '\0') {
+            return 0;
+        }
+    }
+
+    // Checks a candidate's value can be held to without deciding the match.
+    size_t value = index + 2;
+    for (size_t i = value; i < count; ++i) {
+        rule->value_min_length += (uint32_t)pattern_min_length(items[i]);
+    }
+    if (value < count && is_space_run(items[value])) {
+        rule->flags |= KV_RULE_VALUE_SPACES;
+        value++;
+    }
+    bool nullable = true;
+    for (size_t i = value; i < count && nullable; ++i) {
+        nullable = first_bytes(items[i], rule->value_first);
+    }
+    bool space_first = false;
+    for (unsigned int byte = 0; byte < 256; ++byte) {
+        space_first = space_first || (is_space((unsigned char)byte) && set_has(rule->value_first, (unsigned char)byte));
+    }
+    if (!nullable && !(space_first && (rule->flags & KV_RULE_VALUE_SPACES))) {
+        rule->flags |= KV_RULE_VALUE_FIRST;
+    }
+    return 1;
+}
+
+int kv_tokenizer_add(KvTokenizer *tokenizer, const PatternNode *pattern, size_t id) {
+    if (!tokenizer || tokenizer->built || !pattern || id >= KV_NONE) {
+        return -1;
+    }
+    size_t count = count_items(pattern);
+    const PatternNode **items = malloc(count * sizeof(*items));
+    if (!items) {
+        return -1;
+    }
+    count = 0;
+    collect_items(pattern, items, &count);
+
+    KvRule rule;
+    PatternLiteralSet keys;
+    int result = read_rule(items, count, &rule, &keys);
+    free(items);
+    if (result == 1) {
+        KvRule *resized = realloc(tokenizer->rules, (tokenizer->rule_count + 1) * sizeof(*resized));
+        if (!resized) {
+            result = -1;
+        } else {
+            tokenizer->rules = resized;
+            rule.id = (uint32_t)id;
+            tokenizer->rules[tokenizer->rule_count] = rule;
+            for (size_t i = 0; i < keys.count && result == 1; ++i) {
+                if (append_key(tokenizer, keys.items[i], tokenizer->rule_count) != 0) {
+                    result = -1;
+                }
+            }
+            if (result == 1) {
+                tokenizer->rule_count++;
+            }
+        }
+    }
+    pattern_literal_set_free(&keys);
+    return result;
+}
+
+static void derive_tables(KvTokenizer *tokenizer) {
+    unsigned char is_separator[256] = {0};
+    for (size_t i = 0; i < tokenizer->rule_count; ++i) {
+        for (unsigned int byte = 0; byte < 256; ++byte) {
+            if (set_has(tokenizer->rules[i].separators, (unsigned char)byte)) {
+                is_separator[byte] = 1;
+            }
+        }
+    }
+    byte_class_set_init(&tokenizer->separators, is_separator);
+    tokenizer->max_key_length = 0;
+    for (size_t i = 0; i < tokenizer->key_count; ++i) {
+        if (tokenizer->keys[i].length > tokenizer->max_key_length) {
+            tokenizer->max_key_length = tokenizer->keys[i].length;
+        }
+    }
+}
+
+static uint32_t key_hash(const KvTokenizer *tokenizer, const KvKey *key) {
+    const unsigned char *text = (const unsigned char *)tokenizer->text + key->offset;
+    uint32_t hash = KV_HASH_BASIS;
+    for (size_t i = key->length; i-- > 0;) {
+        hash = hash_step(hash, text[i]);
+    }
+    return hash;
+}
+
+// Find a displacement for bucket that puts each of its keys in a free
+// slot. members holds the keys, hashes their hashes.
+static bool place_bucket(KvTokenizer *tokenizer, size_t bucket, const uint32_t *members, size_t count,
+                         const uint32_t *hashes) {
+    for (uint32_t displacement = 0; displacement < KV_MAX_DISPLACEMENT; ++displacement) {
+        tokenizer->displacements[bucket] = displacement;
+        size_t placed = 0;
+        while (placed < count) {
+            size_t slot = hash_slot(tokenizer, hashes[members[placed]]);
+            if (tokenizer->slots[slot] != KV_NONE) {
+                break;
+            }
+            tokenizer->slots[slot] = members[placed++];
+        }
+        if (placed == count) {
+            return true;
+        }
+        while (placed > 0) {
+            tokenizer->slots[hash_slot(tokenizer, hashes[members[--placed]])] = KV_NONE;
+        }
+    }
+    return false;
+}
+
+// Fill the table, largest buckets first while most slots are free.
+// members lists the keys bucket by bucket from bucket_start. Returns false
+// if some bucket found no displacement.
+static bool place_keys(KvTokenizer *tokenizer, const uint32_t *hashes, const uint32_t *members,
+                       const size_t *bucket_start, size_t largest) {
+    for (size_t i = 0; i < tokenizer->slot_count; ++i) {
+        tokenizer->slots[i] = KV_NONE;
+    }
+    for (size_t size = largest; size > 0; --size) {
+        for (size_t bucket = 0; bucket < tokenizer->bucket_count; ++bucket) {
+            size_t count = bucket_start[bucket + 1] - bucket_start[bucket];
+            if (count == size && !place_bucket(tokenizer, bucket, members + bucket_start[bucket], count, hashes)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int kv_tokenizer_build(KvTokenizer *tokenizer) {
+    if (!tokenizer || tokenizer->built) {
+        return -1;
+    }
+    size_t key_count = tokenizer->key_count;
+    bool *heads = malloc((key_count + 1) * sizeof(*heads));
+    uint32_t *hashes = malloc((key_count + 1) * sizeof(*hashes));
+    uint32_t *members = malloc((key_count + 1) * sizeof(*members));
+    if (!heads || !hashes || !members) {
+        free(heads);
+        free(hashes);
+        free(members);
+        return -1;
+    }
+    // Chain keys with equal text so each text takes one slot.
+    size_t head_count = 0;
+    for (size_t i = 0; i < key_count; ++i) {
+        heads[i] = true;
+        hashes[i] = key_hash(tokenizer, &tokenizer->keys[i]);
+    }
+    for (size_t i = 0; i < key_count; ++i) {
+        KvKey *key = &tokenizer->keys[i];
+        head_count += heads[i];
+        for (size_t j = i + 1; j < key_count; ++j) {
+            const KvKey *other = &tokenizer->keys[j];
+            if (other->length == key->length &&
+                memcmp(tokenizer->text + other->offset, tokenizer->text + key->offset, key->length) == 0) {
+                key->next = (uint32_t)j;
+                heads[j] = false;
+                break;
+            }
+        }
+    }
+
+    size_t bucket_count = 1;
+    while (bucket_count * 2 < head_count) {
+        bucket_count *= 2;
+    }
+    size_t slot_count = 1;
+    while (slot_count < head_count * 2) {
+        slot_count *= 2;
+    }
+    tokenizer->displacements = calloc(bucket_count, sizeof(*tokenizer->displacements));
+    tokenizer->bucket_count = bucket_count;
+    size_t *bucket_start = calloc(bucket_count + 1, sizeof(*bucket_start));
+    int result = tokenizer->displacements && bucket_start ? 0 : -1;
+
+    // Group the chain heads by bucket.
+    size_t largest = 0;
+    for (size_t i = 0; result == 0 && i < key_count; ++i) {
+        if (heads[i]) {
+            size_t count = ++bucket_start[(hashes[i] & (bucket_count - 1)) + 1];
+            largest = count > largest ? count : largest;
+        }
+    }
+    for (size_t bucket = 0; result == 0 && bucket < bucket_count; ++bucket) {
+        bucket_start[bucket + 1] += bucket_start[bucket];
+    }
+    size_t *fill = result == 0 ? malloc(bucket_count * sizeof(*fill)) : NULL;
+    if (fill) {
+        memcpy(fill, bucket_start, bucket_count * sizeof(*fill));
+        for (size_t i = 0; i < key_count; ++i) {
+            if (heads[i]) {
+                members[fill[hashes[i] & (bucket_count - 1)]++] = (uint32_t)i;
+            }
+        }
+        free(fill);
+    } else {
+        result = -1;
+    }
+
+    bool placed = false;
+    while (result == 0 && !placed) {
+        uint32_t *slots = realloc(tokenizer->slots, slot_count * sizeof(*slots));
+        if (!slots) {
+            result = -1;
+            break;
+        }
+        tokenizer->slots = slots;
+        tokenizer->slot_count = slot_count;
+        placed = place_keys(tokenizer, hashes, members, bucket_start, largest);
+        slot_count *= 2;
+    }
+    free(bucket_start);
+    free(heads);
+    free(hashes);
+    free(members);
+    if (result != 0) {
+        return -1;
+    }
+    derive_tables(tokenizer);
+    tokenizer->built = true;
+    return 0;
+}
+
+size_t kv_tokenizer_count(const KvTokenizer *tokenizer) {
+    return tokenizer ? tokenizer->rule_count : 0;
+}
+
+size_t kv_tokenizer_id(const KvTokenizer *tokenizer, size_t index) {
+    return tokenizer && index < tokenizer->rule_count ? tokenizer->rules[index].id : 0;
+}
+
+// Separator, boundary and value checks of rule for the key at
+// [key_start, ...) before the separator at separator. Sets *start to the
+// position the match would begin at.
+static bool rule_accepts(const KvRule *rule,
+                         const unsigned char *bytes,
+                         size_t length,
+                         size_t key_start,
+                         size_t separator,
+                         size_t *start) {
+    if (!set_has(rule->separators, bytes[separator])) {
+        return false;
+    }
+    *start = key_start;
+    if (rule->flags & KV_RULE_BOUNDARY) {
+        if (key_start > 0 && !set_has(rule->boundary, bytes[key_start - 1])) {
+            return false;
+        }
+        *start = key_start > 0 ? key_start - 1 : 0;
+    }
+    size_t value = separator + 1;
+    if (length - value < rule->value_min_length) {
+        return false;
+    }
+    if (rule->flags & KV_RULE_VALUE_FIRST) {
+        if (rule->flags & KV_RULE_VALUE_SPACES) {
+            while (value < length && is_space(bytes[value])) {
+                value++;
+            }
+        }
+        if (value == length || !set_has(rule->value_first, bytes[value])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Walk left from the separator at separator over the key and check every
+// rule whose key ends there. With marks, those rules are marked; without,
+// only rule index only counts and its smallest start >= from is returned.
+static bool visit_separator(const KvTokenizer *tokenizer,
+                            const unsigned char *bytes,
+                            size_t length,
+                            size_t separator,
+                            unsigned char *marks,
+                            size_t only,
+                            size_t from,
+                            size_t *start) {
+    size_t key_end = separator;
+    while (key_end > 0 && is_space(bytes[key_end - 1])) {
+        key_end--;
+    }
+
+    bool found = false;
+    uint32_t hash = KV_HASH_BASIS;
+    size_t limit = key_end < tokenizer->max_key_length ? key_end : tokenizer->max_key_length;
+    for (size_t key_length = 1; key_length <= limit; ++key_length) {
+        size_t key_start = key_end - key_length;
+        unsigned char byte = bytes[key_start];
+        if (!is_key_byte(byte)) {
+            break;
+        }
+        hash = hash_step(hash, lower_byte(byte));
+        uint32_t index = tokenizer->slots[hash_slot(tokenizer, hash)];
+        if (index == KV_NONE || tokenizer->keys[index].length != key_length) {
+            continue;
+        }
+        const unsigned char *key = (const unsigned char *)tokenizer->text + tokenizer->keys[index].offset;
+        bool equal = true;
+        for (size_t i = 0; i < key_length && equal; ++i) {
+            equal = lower_byte(bytes[key_start + i]) == key[i];
+        }
+        // Longer keys start further left, so the last start wins.
+        for (; equal && index != KV_NONE; index = tokenizer->keys[index].next) {
+            size_t rule_index = tokenizer->keys[index].rule;
+            const KvRule *rule = &tokenizer->rules[rule_index];
+            size_t rule_start = 0;
+            if (marks ? marks[rule->id] : rule_index != only) {
+                continue;
+            }
+            if (!rule_accepts(rule, bytes, length, key_start, separator, &rule_start)) {
+                continue;
+            }
+            if (marks) {
+                marks[rule->id] = 1;
+            } else if (rule_start >= from) {
+                *start = rule_start;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+// Offset of the first separator of any rule at or after from, or length.
+static size_t next_separator(const KvTokenizer *tokenizer, const unsigned char *bytes, size_t length, size_t from) {
+    if (from >= length) {
+        return length;
+    }
+    return from + byte_class_find_set(&tokenizer->separators, bytes + from, length - from);
+}
+
+void kv_tokenizer_mark(const KvTokenizer *tokenizer, const char *text, size_t length, unsigned char *marks) {
+    if (!tokenizer || !tokenizer->built || !text || !marks || tokenizer->key_count == 0) {
+        return;
+    }
+    const unsigned char *bytes = (const unsigned char *)text;
+    for (size_t i = next_separator(tokenizer, bytes, length, 0); i < length;
+         i = next_separator(tokenizer, bytes, length, i + 1)) {
+        visit_separator(tokenizer, bytes, length, i, marks, 0, 0, NULL);
+    }
+}
+
+bool kv_tokenizer_next(const KvTokenizer *tokenizer,
+                       size_t index,
+                       const char *text,
+                       size_t length,
+                       size_t from,
+                       size_t *start) {
+    if (!tokenizer || !tokenizer->built || !text || !start || index >= tokenizer->rule_count ||
+        tokenizer->key_count == 0) {
+        return false;
+    }
+    // A candidate ends its key before its separator, and the key of a later
+    // separator starts after an earlier separator, so the first separator
+    // with a candidate >= from gives the smallest.
+    const unsigned char *bytes = (const unsigned char *)text;
+    for (size_t i = next_separator(tokenizer, bytes, length, from); i < length;
+         i = next_separator(tokenizer, bytes, length, i + 1)) {
+        if (visit_separator(tokenizer, bytes, length, i, NULL, index, from, start)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Serialized image: KvImageHeader, rules, keys, slots, displacements, then
+// the key text.
+typedef struct {
+    uint64_t rule_count;
+    uint64_t key_count;
+    uint64_t slot_count;
+    uint64_t bucket_count;
+    uint64_t text_size;
+} KvImageHeader;
+
+static size_t image_size(const KvImageHeader *header) {
+    return sizeof(*header) + header->rule_count * sizeof(KvRule) + header->key_count * sizeof(KvKey) +
+           (header->slot_count + header->bucket_count) * sizeof(uint32_t) + header->text_size;
+}
+
+size_t kv_tokenizer_serialize(const KvTokenizer *tokenizer, void *out) {
+    if (!tokenizer || !tokenizer->built) {
+        return 0;
+    }
+    KvImageHeader header;
+    header.rule_count = tokenizer->rule_count;
+    header.key_count = tokenizer->key_count;
+    header.slot_count = tokenizer->slot_count;
+    header.bucket_count = tokenizer->bucket_count;
+    header.text_size = tokenizer->text_size;
+    size_t size = image_size(&header);
+    if (!out) {
+        return size;
+    }
+
+    unsigned char *cursor = out;
+    memcpy(cursor, &header, sizeof(header));
+    cursor += sizeof(header);
+    memcpy(cursor, tokenizer->rules, tokenizer->rule_count * sizeof(KvRule));
+    cursor += tokenizer->rule_count * sizeof(KvRule);
+    memcpy(cursor, tokenizer->keys, tokenizer->key_count * sizeof(KvKey));
+    cursor += tokenizer->key_count * sizeof(KvKey);
+    memcpy(cursor, tokenizer->slots, tokenizer->slot_count * sizeof(uint32_t));
+    cursor += tokenizer->slot_count * sizeof(uint32_t);
+    memcpy(cursor, tokenizer->displacements, tokenizer->bucket_count * sizeof(uint32_t));
+    cursor += tokenizer->bucket_count * sizeof(uint32_t);
+    memcpy(cursor, tokenizer->text, tokenizer->text_size);
+    return size;
+}
+
+KvTokenizer *kv_tokenizer_load(const void *data, size_t size, size_t id_count) {
+    KvImageHeader header;
+    if (!data || size < sizeof(header) || ((uintptr_t)data & 7) != 0) {
+        return NULL;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.rule_count > UINT32_MAX || header.key_count >= KV_NONE || header.slot_count == 0 ||
+        header.slot_count > UINT32_MAX || (header.slot_count & (header.slot_count - 1)) != 0 ||
+        header.bucket_count == 0 || header.bucket_count > UINT32_MAX ||
+        (header.bucket_count & (header.bucket_count - 1)) != 0 || header.text_size > UINT32_MAX ||
+        size != image_size(&header)) {
+        return NULL;
+    }
+
+    KvTokenizer *tokenizer = calloc(1, sizeof(*tokenizer));
+    if (!tokenizer) {
+        return NULL;
+    }
+    const unsigned char *cursor = (const unsigned char *)data + sizeof(header);
+    tokenizer->rule_count = header.rule_count;
+    tokenizer->key_count = header.key_count;
+    tokenizer->slot_count = header.slot_count;
+    tokenizer->text_size = header.text_size;
+    tokenizer->bucket_count = header.bucket_count;
+    tokenizer->rules = (KvRule *)cursor;
+    cursor += header.rule_count * sizeof(KvRule);
+    tokenizer->keys = (KvKey *)cursor;
+    cursor += header.key_count * sizeof(KvKey);
+    tokenizer->slots = (uint32_t *)cursor;
+    cursor += header.slot_count * sizeof(uint32_t);
+    tokenizer->displacements = (uint32_t *)cursor;
+    cursor += header.bucket_count * sizeof(uint32_t);
+    tokenizer->text = (char *)cursor;
+    tokenizer->borrowed = true;
+    tokenizer->built = true;
+
+    // Reject images that would index outside their own tables; chains only
+    // point forward, so they end.
+    bool valid = true;
+    for (size_t i = 0; i < tokenizer->rule_count && valid; ++i) {
+        valid = tokenizer->rules[i].id < id_count;
+    }
+    for (size_t i = 0; i < tokenizer->key_count && valid; ++i) {
+        const KvKey *key = &tokenizer->keys[i];
+        valid = key->length > 0 && key->length <= KV_MAX_KEY_LENGTH &&
+                (uint64_t)key->offset + key->length < header.text_size && key->rule < header.rule_count &&
+                (key->next == KV_NONE || (key->next > i && key->next < header.key_count));
+    }
+    for (size_t i = 0; i < tokenizer->slot_count && valid; ++i) {
+        valid = tokenizer->slots[i] == KV_NONE || tokenizer->slots[i] < header.key_count;
+    }
+    if (!valid) {
+        free(tokenizer);
+        return NULL;
+    }
+    derive_tables(tokenizer);
+    return tokenizer;
+}
+
+void kv_tokenizer_destroy(KvTokenizer *tokenizer) {
+    if (!tokenizer) {
+        return;
+    }
+    if (!tokenizer->borrowed) {
+        free(tokenizer->rules);
+        free(tokenizer->keys);
+        free(tokenizer->slots);
+        free(tokenizer->displacements);
+        free(tokenizer->text);
+    }
+    free(tokenizer);
+}
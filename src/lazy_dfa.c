@@ -0,0 +1,1217 @@
+// Lazy DFA over a Thompson NFA, plus a leftmost-longest NFA search for
+// match offsets. DFA states are sets of NFA instructions, built the first
+// time a transition is taken and kept in a per-thread cache.
+
+#include "lazy_dfa.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Per-pattern limit on expanded instructions (bounded repeats are unrolled).
+#define LAZY_DFA_MAX_PATTERN_INSTRUCTIONS 8192
+// The cache is flushed when it holds this many states.
+#define LAZY_DFA_MAX_STATES 4096
+#define LAZY_DFA_NO_STATE -1
+#define LAZY_DFA_UNKNOWN -2
+
+typedef enum {
+    OP_CHARSET = 0,
+    OP_SPLIT,
+    OP_JUMP,
+    OP_BEGIN_LINE,
+    OP_END_LINE,
+    OP_MATCH
+} opcode_t;
+
+typedef struct {
+    opcode_t op;
+    // Next instruction (x) and second branch for OP_SPLIT (y).
+    uint32_t x;
+    uint32_t y;
+    // Charset index for OP_CHARSET, pattern id for OP_MATCH.
+    uint32_t arg;
+} Instruction;
+
+struct LazyDfa {
+    Instruction *instructions;
+    size_t instruction_count;
+    size_t instruction_capacity;
+
+    unsigned char class_of[256];
+    size_t class_count;
+    // class_member[charset * class_count + class] is 1 if the class matches.
+    unsigned char *class_member;
+    size_t charset_count;
+
+    // Entry instruction per pattern id, UINT32_MAX when not compiled.
+    uint32_t *starts;
+    size_t id_count;
+    // 0 for ids that lazy_dfa_mark leaves out (find only).
+    unsigned char *marked;
+
+    // Arrays point into a serialized image owned by the caller.
+    bool borrowed;
+};
+
+// Serialized images hold the instructions as they are laid out in memory.
+_Static_assert(sizeof(Instruction) == 4 * sizeof(uint32_t), "Instruction must be four uint32_t");
+
+typedef struct {
+    uint32_t pc;
+    size_t start;
+} Thread;
+
+struct LazyDfaCache {
+    const LazyDfa *dfa;
+    size_t max_states;
+    // Anchored caches do not restart patterns after the first byte.
+    bool anchored;
+    // Fail instead of flushing when max_states is reached (table export).
+    bool fixed;
+
+    // State sets live in set_pool; state i owns [set_offset[i], +set_size[i]).
+    uint32_t *set_pool;
+    size_t set_pool_size;
+    size_t set_pool_capacity;
+    size_t *set_offset;
+    size_t *set_size;
+    // Pattern ids that match on entering a state.
+    uint32_t *match_pool;
+    size_t match_pool_size;
+    size_t match_pool_capacity;
+    size_t *match_offset;
+    size_t *match_count;
+    // transitions[state * class_count + class], LAZY_DFA_UNKNOWN if not built.
+    int32_t *transitions;
+    size_t state_count;
+
+    // Open-addressing table from state set to state index.
+    int32_t *table;
+    size_t table_size;
+
+    int32_t start_state;
+    // Closure of all pattern starts away from the line start, added on
+    // every unanchored step; computed once.
+    uint32_t *restart_set;
+    size_t restart_size;
+
+    // Scratch for set construction and the NFA search.
+    uint32_t *visit_generation;
+    uint32_t generation;
+    uint32_t *stack;
+    uint32_t *scratch_set;
+    size_t scratch_size;
+    Thread *current_threads;
+    Thread *next_threads;
+};
+
+static void set_has_bit(const unsigned char *set, unsigned int byte, bool *out) {
+    *out = (set[byte >> 3] & (1u << (byte & 7))) != 0;
+}
+
+static size_t instruction_estimate(const PatternNode *node) {
+    if (!node) {
+        return 0;
+    }
+    switch (node->kind) {
+    case PATTERN_NODE_CHARSET:
+    case PATTERN_NODE_BEGIN_LINE:
+    case PATTERN_NODE_END_LINE:
+        return 1;
+    case PATTERN_NODE_CONCAT:
+        return instruction_estimate(node->left) + instruction_estimate(node->right);
+    case PATTERN_NODE_ALTERNATE:
+        return instruction_estimate(node->left) + instruction_estimate(node->right) + 2;
+    case PATTERN_NODE_REPEAT: {
+        size_t child = instruction_estimate(node->left);
+        size_t copies = (size_t)node->repeat_min;
+        if (node->repeat_max == PATTERN_REPEAT_UNBOUNDED) {
+            copies += 1;
+        } else {
+            copies = (size_t)node->repeat_max;
+        }
+        size_t total = copies * (child + 2);
+        return total > LAZY_DFA_MAX_PATTERN_INSTRUCTIONS ? LAZY_DFA_MAX_PATTERN_INSTRUCTIONS + 1 : total;
+    }
+    case PATTERN_NODE_EMPTY:
+    default:
+        return 0;
+    }
+}
+
+static bool contains_anchor(const PatternNode *node) {
+    if (!node) {
+        return false;
+    }
+    if (node->kind == PATTERN_NODE_BEGIN_LINE || node->kind == PATTERN_NODE_END_LINE) {
+        return true;
+    }
+    return contains_anchor(node->left) || contains_anchor(node->right);
+}
+
+// glibc does not treat anchors inside a repeated group as plain assertions,
+// so those patterns stay with regexec to keep results identical.
+static bool has_repeated_anchor(const PatternNode *node) {
+    if (!node) {
+        return false;
+    }
+    if (node->kind == PATTERN_NODE_REPEAT) {
+        return contains_anchor(node->left);
+    }
+    return has_repeated_anchor(node->left) || has_repeated_anchor(node->right);
+}
+
+bool lazy_dfa_supports(const PatternNode *pattern) {
+    return pattern && !has_repeated_anchor(pattern) &&
+           instruction_estimate(pattern) + 1 <= LAZY_DFA_MAX_PATTERN_INSTRUCTIONS;
+}
+
+static int emit(LazyDfa *dfa, opcode_t op, uint32_t arg, uint32_t *out_pc) {
+    if (dfa->instruction_count == dfa->instruction_capacity) {
+        size_t capacity = dfa->instruction_capacity ? dfa->instruction_capacity * 2 : 256;
+        Instruction *resized = realloc(dfa->instructions, capacity * sizeof(*resized));
+        if (!resized) {
+            return -1;
+        }
+        dfa->instructions = resized;
+        dfa->instruction_capacity = capacity;
+    }
+    uint32_t pc = (uint32_t)dfa->instruction_count++;
+    dfa->instructions[pc].op = op;
+    dfa->instructions[pc].x = pc + 1;
+    dfa->instructions[pc].y = pc + 1;
+    dfa->instructions[pc].arg = arg;
+    if (out_pc) {
+        *out_pc = pc;
+    }
+    return 0;
+}
+
+static int add_charset(LazyDfa *dfa, const unsigned char *set, unsigned char **charsets, uint32_t *out_index) {
+    unsigned char *resized = realloc(*charsets, (dfa->charset_count + 1) * 32);
+    if (!resized) {
+        return -1;
+    }
+    *charsets = resized;
+    memcpy(resized + dfa->charset_count * 32, set, 32);
+    *out_index = (uint32_t)dfa->charset_count++;
+    return 0;
+}
+
+static int compile_node(LazyDfa *dfa, const PatternNode *node, unsigned char **charsets) {
+    switch (node->kind) {
+    case PATTERN_NODE_EMPTY:
+        return 0;
+    case PATTERN_NODE_CHARSET: {
+        uint32_t index = 0;
+        if (add_charset(dfa, node->set, charsets, &index) != 0) {
+            return -1;
+        }
+        return emit(dfa, OP_CHARSET, index, NULL);
+    }
+    case PATTERN_NODE_BEGIN_LINE:
+        return emit(dfa, OP_BEGIN_LINE, 0, NULL);
+    case PATTERN_NODE_END_LINE:
+        return emit(dfa, OP_END_LINE, 0, NULL);
+    case PATTERN_NODE_CONCAT:
+        if (compile_node(dfa, node->left, charsets) != 0) {
+            return -1;
+        }
+        return compile_node(dfa, node->right, charsets);
+    case PATTERN_NODE_ALTERNATE: {
+        // split L1, L2; L1: left; jump end; L2: right; end:
+        uint32_t split = 0;
+        uint32_t jump = 0;
+        if (emit(dfa, OP_SPLIT, 0, &split) != 0 || compile_node(dfa, node->left, charsets) != 0 ||
+            emit(dfa, OP_JUMP, 0, &jump) != 0) {
+            return -1;
+        }
+        dfa->instructions[split].y = (uint32_t)dfa->instruction_count;
+        if (compile_node(dfa, node->right, charsets) != 0) {
+            return -1;
+        }
+        dfa->instructions[jump].x = (uint32_t)dfa->instruction_count;
+        return 0;
+    }
+    case PATTERN_NODE_REPEAT: {
+        for (int i = 0; i < node->repeat_min; ++i) {
+            if (compile_node(dfa, node->left, charsets) != 0) {
+                return -1;
+            }
+        }
+        if (node->repeat_max == PATTERN_REPEAT_UNBOUNDED) {
+            // loop: split body, end; body: child; jump loop; end:
+            uint32_t loop = 0;
+            uint32_t jump = 0;
+            if (emit(dfa, OP_SPLIT, 0, &loop) != 0 || compile_node(dfa, node->left, charsets) != 0 ||
+                emit(dfa, OP_JUMP, 0, &jump) != 0) {
+                return -1;
+            }
+            dfa->instructions[jump].x = loop;
+            dfa->instructions[loop].y = (uint32_t)dfa->instruction_count;
+            return 0;
+        }
+
+        // Optional copies: each split may skip straight to the end.
+        size_t optional = (size_t)(node->repeat_max - node->repeat_min);
+        uint32_t *splits = malloc((optional + 1) * sizeof(*splits));
+        if (!splits) {
+            return -1;
+        }
+        for (size_t i = 0; i < optional; ++i) {
+            if (emit(dfa, OP_SPLIT, 0, &splits[i]) != 0 || compile_node(dfa, node->left, charsets) != 0) {
+                free(splits);
+                return -1;
+            }
+        }
+        for (size_t i = 0; i < optional; ++i) {
+            dfa->instructions[splits[i]].y = (uint32_t)dfa->instruction_count;
+        }
+        free(splits);
+        return 0;
+    }
+    default:
+        return -1;
+    }
+}
+
+// Split bytes into classes that no charset can tell apart.
+static int build_classes(LazyDfa *dfa, const unsigned char *charsets) {
+    unsigned char class_of[256];
+    memset(class_of, 0, sizeof(class_of));
+    size_t class_count = 1;
+
+    for (size_t charset = 0; charset < dfa->charset_count; ++charset) {
+        const unsigned char *set = charsets + charset * 32;
+        // (old class, membership) -> new class.
+        int remap[256][2];
+        for (size_t i = 0; i < 256; ++i) {
+            remap[i][0] = -1;
+            remap[i][1] = -1;
+        }
+        size_t next_count = 0;
+        for (unsigned int byte = 0; byte < 256; ++byte) {
+            bool member = false;
+            set_has_bit(set, byte, &member);
+            int *slot = &remap[class_of[byte]][member ? 1 : 0];
+            if (*slot < 0) {
+                *slot = (int)next_count++;
+            }
+            class_of[byte] = (unsigned char)*slot;
+        }
+        class_count = next_count;
+    }
+
+    memcpy(dfa->class_of, class_of, sizeof(class_of));
+    dfa->class_count = class_count;
+    dfa->class_member = calloc(dfa->charset_count * class_count + 1, 1);
+    if (!dfa->class_member) {
+        return -1;
+    }
+    for (size_t charset = 0; charset < dfa->charset_count; ++charset) {
+        const unsigned char *set = charsets + charset * 32;
+        for (unsigned int byte = 0; byte < 256; ++byte) {
+            bool member = false;
+            set_has_bit(set, byte, &member);
+            if (member) {
+                dfa->class_member[charset * class_count + class_of[byte]] = 1;
+            }
+        }
+    }
+    return 0;
+}
+
+LazyDfa *lazy_dfa_create(PatternNode *const *patterns, size_t count) {
+    return lazy_dfa_create_with_marks(patterns, count, NULL);
+}
+
+LazyDfa *lazy_dfa_create_with_marks(PatternNode *const *patterns, size_t count, const bool *marked) {
+    LazyDfa *dfa = calloc(1, sizeof(*dfa));
+    if (!dfa) {
+        return NULL;
+    }
+    dfa->id_count = count;
+    dfa->starts = malloc((count + 1) * sizeof(*dfa->starts));
+    dfa->marked = malloc(count + 1);
+    if (!dfa->starts || !dfa->marked) {
+        lazy_dfa_destroy(dfa);
+        return NULL;
+    }
+
+    unsigned char *charsets = NULL;
+    for (size_t i = 0; i < count; ++i) {
+        dfa->starts[i] = UINT32_MAX;
+        dfa->marked[i] = !marked || marked[i];
+        if (!patterns[i] || !lazy_dfa_supports(patterns[i])) {
+            continue;
+        }
+        dfa->starts[i] = (uint32_t)dfa->instruction_count;
+        if (compile_node(dfa, patterns[i], &charsets) != 0 || emit(dfa, OP_MATCH, (uint32_t)i, NULL) != 0) {
+            free(charsets);
+            lazy_dfa_destroy(dfa);
+            return NULL;
+        }
+    }
+
+    // An empty program still needs one instruction for the scratch arrays.
+    if (dfa->instruction_count == 0 && emit(dfa, OP_JUMP, 0, NULL) != 0) {
+        free(charsets);
+        lazy_dfa_destroy(dfa);
+        return NULL;
+    }
+
+    int result = build_classes(dfa, charsets);
+    free(charsets);
+    if (result != 0) {
+        lazy_dfa_destroy(dfa);
+        return NULL;
+    }
+    return dfa;
+}
+
+void lazy_dfa_destroy(LazyDfa *dfa) {
+    if (!dfa) {
+        return;
+    }
+    if (!dfa->borrowed) {
+        free(dfa->instructions);
+        free(dfa->class_member);
+        free(dfa->starts);
+        free(dfa->marked);
+    }
+    free(dfa);
+}
+
+// Serialized image: DfaImageHeader, class_of[256], instructions, starts,
+// class_member, then marked.
+typedef struct {
+    uint64_t instruction_count;
+    uint64_t class_count;
+    uint64_t charset_count;
+    uint64_t id_count;
+} DfaImageHeader;
+
+static size_t dfa_image_size(const DfaImageHeader *header) {
+    return sizeof(*header) + 256 + header->instruction_count * sizeof(Instruction) +
+           header->id_count * sizeof(uint32_t) + header->charset_count * header->class_count + 1 +
+           header->id_count;
+}
+
+size_t lazy_dfa_serialize(const LazyDfa *dfa, void *out) {
+    if (!dfa) {
+        return 0;
+    }
+    DfaImageHeader header;
+    header.instruction_count = dfa->instruction_count;
+    header.class_count = dfa->class_count;
+    header.charset_count = dfa->charset_count;
+    header.id_count = dfa->id_count;
+    size_t size = dfa_image_size(&header);
+    if (!out) {
+        return size;
+    }
+
+    unsigned char *cursor = out;
+    memcpy(cursor, &header, sizeof(header));
+    cursor += sizeof(header);
+    memcpy(cursor, dfa->class_of, 256);
+    cursor += 256;
+    memcpy(cursor, dfa->instructions, dfa->instruction_count * sizeof(Instruction));
+    cursor += dfa->instruction_count * sizeof(Instruction);
+    memcpy(cursor, dfa->starts, dfa->id_count * sizeof(uint32_t));
+    cursor += dfa->id_count * sizeof(uint32_t);
+    memcpy(cursor, dfa->class_member, dfa->charset_count * dfa->class_count + 1);
+    cursor += dfa->charset_count * dfa->class_count + 1;
+    memcpy(cursor, dfa->marked, dfa->id_count);
+    return size;
+}
+
+// Instructions must stay inside the program, and every pattern must own
+// the range from its start to its MATCH (prune_matched relies on it).
+static bool dfa_image_valid(const LazyDfa *dfa) {
+    for (size_t c = 0; c < 256; ++c) {
+        if (dfa->class_of[c] >= dfa->class_count) {
+            return false;
+        }
+    }
+    bool any_start = false;
+    for (size_t i = 0; i < dfa->id_count; ++i) {
+        if (dfa->starts[i] != UINT32_MAX && dfa->starts[i] >= dfa->instruction_count) {
+            return false;
+        }
+        any_start = any_start || dfa->starts[i] != UINT32_MAX;
+    }
+    // The placeholder instruction of an empty program is never run.
+    for (size_t pc = 0; pc < dfa->instruction_count && any_start; ++pc) {
+        const Instruction *instruction = &dfa->instructions[pc];
+        if (instruction->op != OP_MATCH && instruction->x >= dfa->instruction_count) {
+            return false;
+        }
+        switch (instruction->op) {
+        case OP_SPLIT:
+            if (instruction->y >= dfa->instruction_count) {
+                return false;
+            }
+            break;
+        case OP_CHARSET:
+            if (instruction->arg >= dfa->charset_count) {
+                return false;
+            }
+            break;
+        case OP_MATCH:
+            if (instruction->arg >= dfa->id_count || dfa->starts[instruction->arg] > pc) {
+                return false;
+            }
+            break;
+        case OP_JUMP:
+        case OP_BEGIN_LINE:
+        case OP_END_LINE:
+            break;
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+LazyDfa *lazy_dfa_load(const void *data, size_t size, size_t id_count) {
+    DfaImageHeader header;
+    if (!data || size < sizeof(header) + 256 || ((uintptr_t)data & 7) != 0) {
+        return NULL;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.instruction_count == 0 || header.instruction_count > UINT32_MAX ||
+        header.class_count == 0 || header.class_count > 256 || header.charset_count > UINT32_MAX ||
+        header.id_count != id_count || size != dfa_image_size(&header)) {
+        return NULL;
+    }
+
+    LazyDfa *dfa = calloc(1, sizeof(*dfa));
+    if (!dfa) {
+        return NULL;
+    }
+    const unsigned char *cursor = (const unsigned char *)data + sizeof(header);
+    memcpy(dfa->class_of, cursor, 256);
+    cursor += 256;
+    dfa->instruction_count = header.instruction_count;
+    dfa->instruction_capacity = header.instruction_count;
+    dfa->class_count = header.class_count;
+    dfa->charset_count = header.charset_count;
+    dfa->id_count = header.id_count;
+    dfa->instructions = (Instruction *)cursor;
+    cursor += header.instruction_count * sizeof(Instruction);
+    dfa->starts = (uint32_t *)cursor;
+    cursor += header.id_count * sizeof(uint32_t);
+    dfa->class_member = (unsigned char *)cursor;
+    cursor += header.charset_count * header.class_count + 1;
+    dfa->marked = (unsigned char *)cursor;
+    dfa->borrowed = true;
+    if (!dfa_image_valid(dfa)) {
+        free(dfa);
+        return NULL;
+    }
+    return dfa;
+}
+
+static void next_generation(LazyDfaCache *cache) {
+    cache->generation++;
+    if (cache->generation == 0) {
+        memset(cache->visit_generation, 0, cache->dfa->instruction_count * sizeof(uint32_t));
+        cache->generation = 1;
+    }
+}
+
+// Follow epsilon edges from pc and add the reached CHARSET, END_LINE and
+// MATCH instructions to the scratch set. '^' only holds at position 0 and
+// '$' is only followed once the end of the line is reached.
+static void closure_into_scratch(LazyDfaCache *cache, uint32_t pc, bool at_line_start, bool at_line_end) {
+    const Instruction *instructions = cache->dfa->instructions;
+    size_t depth = 0;
+    cache->stack[depth++] = pc;
+    while (depth > 0) {
+        uint32_t current = cache->stack[--depth];
+        if (cache->visit_generation[current] == cache->generation) {
+            continue;
+        }
+        cache->visit_generation[current] = cache->generation;
+        const Instruction *instruction = &instructions[current];
+        switch (instruction->op) {
+        case OP_SPLIT:
+            cache->stack[depth++] = instruction->y;
+            cache->stack[depth++] = instruction->x;
+            break;
+        case OP_JUMP:
+            cache->stack[depth++] = instruction->x;
+            break;
+        case OP_BEGIN_LINE:
+            if (at_line_start) {
+                cache->stack[depth++] = instruction->x;
+            }
+            break;
+        case OP_END_LINE:
+            if (at_line_end) {
+                cache->stack[depth++] = instruction->x;
+            } else {
+                cache->scratch_set[cache->scratch_size++] = current;
+            }
+            break;
+        case OP_CHARSET:
+        case OP_MATCH:
+            cache->scratch_set[cache->scratch_size++] = current;
+            break;
+        }
+    }
+}
+
+static void add_all_starts(LazyDfaCache *cache, bool at_line_start) {
+    const LazyDfa *dfa = cache->dfa;
+    for (size_t i = 0; i < dfa->id_count; ++i) {
+        if (dfa->starts[i] != UINT32_MAX && dfa->marked[i]) {
+            closure_into_scratch(cache, dfa->starts[i], at_line_start, false);
+        }
+    }
+}
+
+// Add the restart closure to the scratch set being built. Closures are
+// unions, so skipping instructions already present gives the same set.
+static void add_restarts(LazyDfaCache *cache) {
+    for (size_t i = 0; i < cache->restart_size; ++i) {
+        uint32_t pc = cache->restart_set[i];
+        if (cache->visit_generation[pc] != cache->generation) {
+            cache->visit_generation[pc] = cache->generation;
+            cache->scratch_set[cache->scratch_size++] = pc;
+        }
+    }
+}
+
+static void cache_reset(LazyDfaCache *cache) {
+    cache->set_pool_size = 0;
+    cache->match_pool_size = 0;
+    cache->state_count = 0;
+    cache->start_state = LAZY_DFA_NO_STATE;
+    for (size_t i = 0; i < cache->table_size; ++i) {
+        cache->table[i] = LAZY_DFA_NO_STATE;
+    }
+}
+
+static LazyDfaCache *cache_create(const LazyDfa *dfa, size_t max_states, bool anchored, bool fixed) {
+    if (!dfa) {
+        return NULL;
+    }
+    LazyDfaCache *cache = calloc(1, sizeof(*cache));
+    if (!cache) {
+        return NULL;
+    }
+    cache->dfa = dfa;
+    cache->max_states = max_states;
+    cache->anchored = anchored;
+    cache->fixed = fixed;
+
+    size_t instructions = dfa->instruction_count;
+    cache->table_size = 1;
+    while (cache->table_size < max_states * 2) {
+        cache->table_size *= 2;
+    }
+    cache->table = malloc(cache->table_size * sizeof(*cache->table));
+    cache->set_offset = malloc(max_states * sizeof(*cache->set_offset));
+    cache->set_size = malloc(max_states * sizeof(*cache->set_size));
+    cache->match_offset = malloc(max_states * sizeof(*cache->match_offset));
+    cache->match_count = malloc(max_states * sizeof(*cache->match_count));
+    cache->transitions = malloc(max_states * dfa->class_count * sizeof(*cache->transitions));
+    cache->visit_generation = calloc(instructions, sizeof(*cache->visit_generation));
+    cache->stack = malloc((instructions * 2 + 2) * sizeof(*cache->stack));
+    cache->scratch_set = malloc(instructions * sizeof(*cache->scratch_set));
+    cache->restart_set = malloc(instructions * sizeof(*cache->restart_set));
+    cache->current_threads = malloc(instructions * sizeof(*cache->current_threads));
+    cache->next_threads = malloc(instructions * sizeof(*cache->next_threads));
+    if (!cache->table || !cache->set_offset || !cache->set_size || !cache->match_offset ||
+        !cache->match_count || !cache->transitions || !cache->visit_generation || !cache->stack ||
+        !cache->scratch_set || !cache->restart_set || !cache->current_threads || !cache->next_threads) {
+        lazy_dfa_cache_destroy(cache);
+        return NULL;
+    }
+    cache_reset(cache);
+
+    next_generation(cache);
+    cache->scratch_size = 0;
+    add_all_starts(cache, false);
+    cache->restart_size = cache->scratch_size;
+    memcpy(cache->restart_set, cache->scratch_set, cache->restart_size * sizeof(*cache->restart_set));
+    return cache;
+}
+
+LazyDfaCache *lazy_dfa_cache_create(const LazyDfa *dfa) {
+    return cache_create(dfa, LAZY_DFA_MAX_STATES, false, false);
+}
+
+void lazy_dfa_cache_destroy(LazyDfaCache *cache) {
+    if (!cache) {
+        return;
+    }
+    free(cache->set_pool);
+    free(cache->match_pool);
+    free(cache->set_offset);
+    free(cache->set_size);
+    free(cache->match_offset);
+    free(cache->match_count);
+    free(cache->transitions);
+    free(cache->table);
+    free(cache->visit_generation);
+    free(cache->stack);
+    free(cache->scratch_set);
+    free(cache->restart_set);
+    free(cache->current_threads);
+    free(cache->next_threads);
+    free(cache);
+}
+
+// Sets are sorted on every transition, so avoid qsort's indirect compare.
+static void sort_pcs(uint32_t *set, size_t size) {
+    while (size > 16) {
+        uint32_t pivot = set[size / 2];
+        size_t left = 0;
+        size_t right = size - 1;
+        for (;;) {
+            while (set[left] < pivot) {
+                ++left;
+            }
+            while (set[right] > pivot) {
+                --right;
+            }
+            if (left >= right) {
+                break;
+            }
+            uint32_t swap = set[left];
+            set[left++] = set[right];
+            set[right--] = swap;
+        }
+        // Recurse into the smaller half, loop on the larger one.
+        size_t split = right + 1;
+        if (split < size - split) {
+            sort_pcs(set, split);
+            set += split;
+            size -= split;
+        } else {
+            sort_pcs(set + split, size - split);
+            size = split;
+        }
+    }
+    for (size_t i = 1; i < size; ++i) {
+        uint32_t value = set[i];
+        size_t j = i;
+        while (j > 0 && set[j - 1] > value) {
+            set[j] = set[j - 1];
+            --j;
+        }
+        set[j] = value;
+    }
+}
+
+static size_t hash_set(const uint32_t *set, size_t size) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= set[i];
+        hash *= 1099511628211ULL;
+    }
+    return (size_t)hash;
+}
+
+static int reserve_pool(uint32_t **pool, size_t *capacity, size_t needed) {
+    if (needed <= *capacity) {
+        return 0;
+    }
+    size_t next = *capacity ? *capacity : 1024;
+    while (next < needed) {
+        next *= 2;
+    }
+    uint32_t *resized = realloc(*pool, next * sizeof(*resized));
+    if (!resized) {
+        return -1;
+    }
+    *pool = resized;
+    *capacity = next;
+    return 0;
+}
+
+// A pattern that matches in a set has been reported for this line; its
+// other threads could only report it again. Dropping them keeps marking
+// DFAs small when patterns end in loops like [^[:space:]]+. set is sorted,
+// and a pattern owns [starts[id], pc of its MATCH].
+static size_t prune_matched(const LazyDfa *dfa, uint32_t *set, size_t size) {
+    // Walk down from the highest pc: a MATCH is the last instruction of its
+    // pattern, so everything below it down to the pattern start is dropped.
+    uint32_t low = UINT32_MAX;
+    size_t kept = size;
+    for (size_t i = size; i-- > 0;) {
+        const Instruction *instruction = &dfa->instructions[set[i]];
+        if (instruction->op == OP_MATCH) {
+            low = dfa->starts[instruction->arg];
+        } else if (set[i] >= low) {
+            continue;
+        }
+        set[--kept] = set[i];
+    }
+    if (kept > 0) {
+        memmove(set, set + kept, (size - kept) * sizeof(*set));
+    }
+    return kept;
+}
+
+// Intern the scratch set as a state. Flushes the cache when it is full,
+// which invalidates every state index handed out before.
+static int32_t intern_scratch_state(LazyDfaCache *cache, bool *flushed) {
+    const LazyDfa *dfa = cache->dfa;
+    uint32_t *set = cache->scratch_set;
+    size_t size = cache->scratch_size;
+    sort_pcs(set, size);
+    if (!cache->anchored) {
+        size -= prune_matched(dfa, set, size);
+        cache->scratch_size = size;
+    }
+
+    size_t mask = cache->table_size - 1;
+    size_t slot = hash_set(set, size) & mask;
+    while (cache->table[slot] != LAZY_DFA_NO_STATE) {
+        int32_t state = cache->table[slot];
+        if (cache->set_size[state] == size &&
+            memcmp(cache->set_pool + cache->set_offset[state], set, size * sizeof(*set)) == 0) {
+            return state;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    if (cache->state_count == cache->max_states) {
+        if (cache->fixed) {
+            return LAZY_DFA_NO_STATE;
+        }
+        cache_reset(cache);
+        *flushed = true;
+        slot = hash_set(set, size) & mask;
+    }
+
+    size_t matches = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (dfa->instructions[set[i]].op == OP_MATCH) {
+            matches++;
+        }
+    }
+    if (reserve_pool(&cache->set_pool, &cache->set_pool_capacity, cache->set_pool_size + size + 1) != 0 ||
+        reserve_pool(&cache->match_pool, &cache->match_pool_capacity, cache->match_pool_size + matches + 1) != 0) {
+        return LAZY_DFA_NO_STATE;
+    }
+
+    int32_t state = (int32_t)cache->state_count++;
+    cache->set_offset[state] = cache->set_pool_size;
+    cache->set_size[state] = size;
+    memcpy(cache->set_pool + cache->set_pool_size, set, size * sizeof(*set));
+    cache->set_pool_size += size;
+
+    cache->match_offset[state] = cache->match_pool_size;
+    cache->match_count[state] = matches;
+    for (size_t i = 0; i < size; ++i) {
+        if (dfa->instructions[set[i]].op == OP_MATCH) {
+            cache->match_pool[cache->match_pool_size++] = dfa->instructions[set[i]].arg;
+        }
+    }
+
+    int32_t *row = cache->transitions + (size_t)state * dfa->class_count;
+    for (size_t i = 0; i < dfa->class_count; ++i) {
+        row[i] = LAZY_DFA_UNKNOWN;
+    }
+    cache->table[slot] = state;
+    return state;
+}
+
+static int32_t start_state(LazyDfaCache *cache) {
+    if (cache->start_state == LAZY_DFA_NO_STATE) {
+        next_generation(cache);
+        cache->scratch_size = 0;
+        add_all_starts(cache, true);
+        bool flushed = false;
+        cache->start_state = intern_scratch_state(cache, &flushed);
+    }
+    return cache->start_state;
+}
+
+// Build the transition of state on byte class; unanchored, so every step
+// also restarts all patterns at the new position.
+static int32_t build_transition(LazyDfaCache *cache, int32_t state, size_t byte_class) {
+    const LazyDfa *dfa = cache->dfa;
+    next_generation(cache);
+    cache->scratch_size = 0;
+
+    const uint32_t *set = cache->set_pool + cache->set_offset[state];
+    size_t size = cache->set_size[state];
+    for (size_t i = 0; i < size; ++i) {
+        const Instruction *instruction = &dfa->instructions[set[i]];
+        if (instruction->op == OP_CHARSET &&
+            dfa->class_member[instruction->arg * dfa->class_count + byte_class]) {
+            closure_into_scratch(cache, instruction->x, false, false);
+        }
+    }
+    if (!cache->anchored) {
+        add_restarts(cache);
+    }
+
+    bool flushed = false;
+    int32_t next = intern_scratch_state(cache, &flushed);
+    if (next != LAZY_DFA_NO_STATE && !flushed) {
+        cache->transitions[(size_t)state * dfa->class_count + byte_class] = next;
+    }
+    return next;
+}
+
+// Patterns waiting on '$' match if the line ends in this state.
+static void mark_end_of_line(LazyDfaCache *cache, int32_t state, bool at_line_start, unsigned char *marks) {
+    const LazyDfa *dfa = cache->dfa;
+    const uint32_t *set = cache->set_pool + cache->set_offset[state];
+    size_t size = cache->set_size[state];
+
+    // Copy first: the closure below reuses the scratch set.
+    size_t pending = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (dfa->instructions[set[i]].op == OP_END_LINE) {
+            cache->current_threads[pending++].pc = dfa->instructions[set[i]].x;
+        }
+    }
+    if (pending == 0) {
+        return;
+    }
+
+    next_generation(cache);
+    cache->scratch_size = 0;
+    for (size_t i = 0; i < pending; ++i) {
+        closure_into_scratch(cache, cache->current_threads[i].pc, at_line_start, true);
+    }
+    for (size_t i = 0; i < cache->scratch_size; ++i) {
+        const Instruction *instruction = &dfa->instructions[cache->scratch_set[i]];
+        if (instruction->op == OP_MATCH) {
+            marks[instruction->arg] = 1;
+        }
+    }
+}
+
+int lazy_dfa_mark(LazyDfaCache *cache, const char *text, size_t length, unsigned char *marks) {
+    if (!cache || !text || !marks) {
+        return -1;
+    }
+    const LazyDfa *dfa = cache->dfa;
+    const unsigned char *bytes = (const unsigned char *)text;
+
+    int32_t state = start_state(cache);
+    if (state == LAZY_DFA_NO_STATE) {
+        return -1;
+    }
+    for (size_t i = 0;; ++i) {
+        size_t matches = cache->match_count[state];
+        if (matches > 0) {
+            const uint32_t *ids = cache->match_pool + cache->match_offset[state];
+            for (size_t j = 0; j < matches; ++j) {
+                marks[ids[j]] = 1;
+            }
+        }
+        if (i == length) {
+            break;
+        }
+        size_t byte_class = dfa->class_of[bytes[i]];
+        int32_t next = cache->transitions[(size_t)state * dfa->class_count + byte_class];
+        if (next < 0) {
+            next = build_transition(cache, state, byte_class);
+            if (next == LAZY_DFA_NO_STATE) {
+                return -1;
+            }
+        }
+        state = next;
+    }
+
+    mark_end_of_line(cache, state, length == 0, marks);
+    return 0;
+}
+
+static int append_ids(LazyDfaTable *table, size_t *capacity, const unsigned char *marks, size_t id_count) {
+    for (size_t id = 0; id < id_count; ++id) {
+        if (!marks[id]) {
+            continue;
+        }
+        if (table->id_count == *capacity) {
+            size_t next = *capacity ? *capacity * 2 : 64;
+            uint32_t *resized = realloc(table->ids, next * sizeof(*resized));
+            if (!resized) {
+                return -1;
+            }
+            table->ids = resized;
+            *capacity = next;
+        }
+        table->ids[table->id_count++] = (uint32_t)id;
+    }
+    return 0;
+}
+
+// Collect the '$' matches of state into the table's id pool.
+static int export_end_of_line(LazyDfaCache *cache,
+                              int32_t state,
+                              bool at_line_start,
+                              unsigned char *marks,
+                              LazyDfaTable *table,
+                              size_t *capacity,
+                              size_t *offset,
+                              size_t *count) {
+    size_t id_count = cache->dfa->id_count;
+    memset(marks, 0, id_count);
+    mark_end_of_line(cache, state, at_line_start, marks);
+    *offset = table->id_count;
+    int result = append_ids(table, capacity, marks, id_count);
+    *count = table->id_count - *offset;
+    return result;
+}
+
+static int export_states(LazyDfaCache *cache, LazyDfaTable *table) {
+    const LazyDfa *dfa = cache->dfa;
+    int32_t start = start_state(cache);
+    if (start == LAZY_DFA_NO_STATE) {
+        return -1;
+    }
+    int32_t start_inner = start;
+    if (cache->anchored) {
+        next_generation(cache);
+        cache->scratch_size = 0;
+        add_all_starts(cache, false);
+        bool flushed = false;
+        start_inner = intern_scratch_state(cache, &flushed);
+        if (start_inner == LAZY_DFA_NO_STATE) {
+            return -1;
+        }
+    }
+
+    // Newly interned states are appended, so one sweep reaches them all.
+    for (size_t state = 0; state < cache->state_count; ++state) {
+        for (size_t byte_class = 0; byte_class < dfa->class_count; ++byte_class) {
+            if (cache->transitions[state * dfa->class_count + byte_class] < 0 &&
+                build_transition(cache, (int32_t)state, byte_class) == LAZY_DFA_NO_STATE) {
+                return -1;
+            }
+        }
+    }
+
+    size_t states = cache->state_count;
+    table->state_count = states;
+    table->class_count = dfa->class_count;
+    memcpy(table->class_of, dfa->class_of, sizeof(table->class_of));
+    table->start = (uint32_t)start;
+    table->start_inner = (uint32_t)start_inner;
+    table->dead = UINT32_MAX;
+    table->next = malloc(states * dfa->class_count * sizeof(*table->next));
+    table->match_offset = malloc(states * sizeof(size_t));
+    table->match_count = malloc(states * sizeof(size_t));
+    table->eol_offset = malloc(states * sizeof(size_t));
+    table->eol_count = malloc(states * sizeof(size_t));
+    unsigned char *marks = malloc(dfa->id_count + 1);
+    if (!table->next || !table->match_offset || !table->match_count || !table->eol_offset ||
+        !table->eol_count || !marks) {
+        free(marks);
+        return -1;
+    }
+    for (size_t i = 0; i < states * dfa->class_count; ++i) {
+        table->next[i] = (uint32_t)cache->transitions[i];
+    }
+
+    size_t capacity = 0;
+    int result = 0;
+    for (size_t state = 0; state < states && result == 0; ++state) {
+        if (cache->set_size[state] == 0) {
+            table->dead = (uint32_t)state;
+        }
+        memset(marks, 0, dfa->id_count);
+        const uint32_t *ids = cache->match_pool + cache->match_offset[state];
+        for (size_t j = 0; j < cache->match_count[state]; ++j) {
+            marks[ids[j]] = 1;
+        }
+        table->match_offset[state] = table->id_count;
+        result = append_ids(table, &capacity, marks, dfa->id_count);
+        table->match_count[state] = table->id_count - table->match_offset[state];
+        if (result == 0) {
+            result = export_end_of_line(cache, (int32_t)state, false, marks, table, &capacity,
+                                        &table->eol_offset[state], &table->eol_count[state]);
+        }
+    }
+    if (result == 0) {
+        result = export_end_of_line(cache, start, true, marks, table, &capacity,
+                                    &table->empty_offset, &table->empty_count);
+    }
+    free(marks);
+    return result;
+}
+
+int lazy_dfa_export(const LazyDfa *dfa, bool anchored, size_t max_states, LazyDfaTable *table) {
+    if (!dfa || !table || max_states == 0) {
+        return -1;
+    }
+    memset(table, 0, sizeof(*table));
+    LazyDfaCache *cache = cache_create(dfa, max_states, anchored, true);
+    if (!cache) {
+        return -1;
+    }
+    int result = export_states(cache, table);
+    lazy_dfa_cache_destroy(cache);
+    if (result != 0) {
+        lazy_dfa_table_free(table);
+    }
+    return result;
+}
+
+void lazy_dfa_table_free(LazyDfaTable *table) {
+    if (!table) {
+        return;
+    }
+    free(table->next);
+    free(table->match_offset);
+    free(table->match_count);
+    free(table->eol_offset);
+    free(table->eol_count);
+    free(table->ids);
+    memset(table, 0, sizeof(*table));
+}
+
+typedef struct {
+    bool found;
+    size_t start;
+    size_t end;
+} SearchResult;
+
+static void record_match(SearchResult *result, size_t start, size_t end) {
+    if (!result->found || start < result->start || (start == result->start && end > result->end)) {
+        result->found = true;
+        result->start = start;
+        result->end = end;
+    }
+}
+
+// Add a thread and its epsilon closure at position. Threads are added in
+// increasing start order, so the first visit of an instruction keeps the
+// leftmost start.
+static void add_thread(LazyDfaCache *cache,
+                       Thread *list,
+                       size_t *list_size,
+                       uint32_t pc,
+                       size_t start,
+                       size_t position,
+                       size_t length,
+                       SearchResult *result) {
+    const Instruction *instructions = cache->dfa->instructions;
+    size_t depth = 0;
+    cache->stack[depth++] = pc;
+    while (depth > 0) {
+        uint32_t current = cache->stack[--depth];
+        if (cache->visit_generation[current] == cache->generation) {
+            continue;
+        }
+        cache->visit_generation[current] = cache->generation;
+        const Instruction *instruction = &instructions[current];
+        switch (instruction->op) {
+        case OP_SPLIT:
+            cache->stack[depth++] = instruction->y;
+            cache->stack[depth++] = instruction->x;
+            break;
+        case OP_JUMP:
+            cache->stack[depth++] = instruction->x;
+            break;
+        case OP_BEGIN_LINE:
+            if (position == 0) {
+                cache->stack[depth++] = instruction->x;
+            }
+            break;
+        case OP_END_LINE:
+            if (position == length) {
+                cache->stack[depth++] = instruction->x;
+            }
+            break;
+        case OP_MATCH:
+            record_match(result, start, position);
+            break;
+        case OP_CHARSET:
+            list[*list_size].pc = current;
+            list[*list_size].start = start;
+            (*list_size)++;
+            break;
+        }
+    }
+}
+
+// Leftmost-longest search for matches of id that start at or before
+// last_start; threads are only started up to there.
+static bool search(LazyDfaCache *cache,
+                   size_t id,
+                   const char *text,
+                   size_t length,
+                   size_t first_start,
+                   size_t last_start,
+                   size_t *start,
+                   size_t *end) {
+    if (!cache || !text || id >= cache->dfa->id_count || cache->dfa->starts[id] == UINT32_MAX ||
+        first_start > length) {
+        return false;
+    }
+    const LazyDfa *dfa = cache->dfa;
+    const unsigned char *bytes = (const unsigned char *)text;
+    uint32_t entry = dfa->starts[id];
+
+    SearchResult result = {false, 0, 0};
+    Thread *current = cache->current_threads;
+    Thread *next = cache->next_threads;
+    size_t current_size = 0;
+
+    next_generation(cache);
+    for (size_t position = first_start;; ++position) {
+        // New starts only while no match is known; later starts cannot win.
+        if (!result.found && position <= last_start) {
+            add_thread(cache, current, &current_size, entry, position, position, length, &result);
+        }
+        if (position == length || current_size == 0) {
+            if (result.found || position == length || position >= last_start) {
+                break;
+            }
+            next_generation(cache);
+            continue;
+        }
+
+        next_generation(cache);
+        size_t next_size = 0;
+        size_t byte_class = dfa->class_of[bytes[position]];
+        for (size_t i = 0; i < current_size; ++i) {
+            const Thread *thread = &current[i];
+            if (result.found && thread->start > result.start) {
+                continue;
+            }
+            const Instruction *instruction = &dfa->instructions[thread->pc];
+            if (dfa->class_member[instruction->arg * dfa->class_count + byte_class]) {
+                add_thread(cache, next, &next_size, instruction->x, thread->start, position + 1, length, &result);
+            }
+        }
+
+        Thread *swap = current;
+        current = next;
+        next = swap;
+        current_size = next_size;
+    }
+
+    if (result.found) {
+        *start = result.start;
+        *end = result.end;
+    }
+    return result.found;
+}
+
+bool lazy_dfa_find(LazyDfaCache *cache,
+                   size_t id,
+                   const char *text,
+                   size_t length,
+                   size_t *start,
+                   size_t *end) {
+    return search(cache, id, text, length, 0, length, start, end);
+}
+
+bool lazy_dfa_match_at(LazyDfaCache *cache, size_t id, const char *text, size_t length, size_t start, size_t *end) {
+    size_t found = 0;
+    return search(cache, id, text, length, start, start, &found, end);
+}
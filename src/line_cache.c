@@ -0,0 +1,239 @@
+#include "line_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Lines per sampling window, and windows skipped after a poor one.
+#define LINE_CACHE_WINDOW 1024
+#define LINE_CACHE_SKIP_WINDOWS 15
+
+// Matches followed by the line bytes.
+typedef struct {
+    uint64_t hash;
+    uint32_t tag;
+    uint32_t match_count;
+    size_t length;
+    size_t size;
+    bool referenced;
+    LineCacheMatch matches[];
+} LineCacheEntry;
+
+// One entry per slot; a line that maps to an occupied slot replaces it.
+// seen is the hash of the last line that missed here without being
+// admitted.
+typedef struct {
+    LineCacheEntry *entry;
+    uint64_t seen;
+} LineCacheSlot;
+
+struct LineCache {
+    LineCacheSlot *slots;
+    size_t mask;
+    size_t max_bytes;
+    size_t bytes;
+    // CLOCK hand for evictions when the cap is reached.
+    size_t hand;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t bypassed;
+    // Lookups in the current window, those that were repeats (a hit or an
+    // admission), and lines left to bypass.
+    size_t window_lookups;
+    size_t window_repeats;
+    size_t bypass;
+};
+
+LineCache *line_cache_create(size_t max_bytes) {
+    if (max_bytes < LINE_CACHE_MIN_BYTES) {
+        return NULL;
+    }
+    LineCache *cache = calloc(1, sizeof(*cache));
+    if (!cache) {
+        return NULL;
+    }
+    // The slot table takes at most a thirty-second of the cap.
+    size_t slot_count = 16;
+    while (slot_count * 2 * sizeof(LineCacheSlot) <= max_bytes / 32) {
+        slot_count *= 2;
+    }
+    cache->slots = calloc(slot_count, sizeof(LineCacheSlot));
+    if (!cache->slots) {
+        free(cache);
+        return NULL;
+    }
+    cache->mask = slot_count - 1;
+    cache->max_bytes = max_bytes;
+    cache->bytes = sizeof(*cache) + slot_count * sizeof(LineCacheSlot);
+    return cache;
+}
+
+void line_cache_destroy(LineCache *cache) {
+    if (!cache) {
+        return;
+    }
+    for (size_t i = 0; i <= cache->mask; ++i) {
+        free(cache->slots[i].entry);
+    }
+    free(cache->slots);
+    free(cache);
+}
+
+bool line_cache_active(LineCache *cache) {
+    if (cache->bypass > 0) {
+        cache->bypass--;
+        cache->bypassed++;
+        return false;
+    }
+    if (cache->window_lookups == LINE_CACHE_WINDOW) {
+        if (cache->window_repeats < LINE_CACHE_WINDOW / 16) {
+            cache->bypass = LINE_CACHE_WINDOW * LINE_CACHE_SKIP_WINDOWS;
+        }
+        cache->window_lookups = 0;
+        cache->window_repeats = 0;
+        if (cache->bypass > 0) {
+            cache->bypass--;
+            cache->bypassed++;
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint64_t mix(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+uint64_t line_cache_hash(uint32_t tag, const char *line, size_t length) {
+    uint64_t hash = 0x9e3779b97f4a7c15ULL ^ tag ^ ((uint64_t)length << 32);
+    size_t offset = 0;
+    for (; offset + 8 <= length; offset += 8) {
+        uint64_t word;
+        memcpy(&word, line + offset, sizeof(word));
+        hash = (hash ^ word) * 0x9fb21c651e98df25ULL;
+        hash ^= hash >> 29;
+    }
+    if (offset < length) {
+        uint64_t word = 0;
+        memcpy(&word, line + offset, length - offset);
+        hash = (hash ^ word) * 0x9fb21c651e98df25ULL;
+        hash ^= hash >> 29;
+    }
+    return mix(hash);
+}
+
+static const char *entry_line(const LineCacheEntry *entry) {
+    return (const char *)(entry->matches + entry->match_count);
+}
+
+bool line_cache_lookup(LineCache *cache,
+                       uint64_t hash,
+                       uint32_t tag,
+                       const char *line,
+                       size_t length,
+                       const LineCacheMatch **matches,
+                       size_t *count) {
+    LineCacheSlot *slot = &cache->slots[hash & cache->mask];
+    LineCacheEntry *entry = slot->entry;
+    cache->window_lookups++;
+    if (entry && entry->hash == hash && entry->tag == tag && entry->length == length &&
+        memcmp(entry_line(entry), line, length) == 0) {
+        entry->referenced = true;
+        cache->window_repeats++;
+        cache->hits++;
+        *matches = entry->matches;
+        *count = entry->match_count;
+        return true;
+    }
+    cache->misses++;
+    return false;
+}
+
+static void evict(LineCache *cache, LineCacheSlot *slot) {
+    cache->bytes -= slot->entry->size;
+    free(slot->entry);
+    slot->entry = NULL;
+    cache->evictions++;
+}
+
+// Evict entries other than keep, in CLOCK order, until size more bytes
+// fit. Returns false if they cannot.
+static bool make_room(LineCache *cache, const LineCacheSlot *keep, size_t size) {
+    if (size > cache->max_bytes) {
+        return false;
+    }
+    // Two sweeps clear every reference bit, so this ends.
+    for (size_t step = 0; cache->bytes + size > cache->max_bytes && step < 2 * (cache->mask + 1); ++step) {
+        LineCacheSlot *slot = &cache->slots[cache->hand];
+        cache->hand = (cache->hand + 1) & cache->mask;
+        if (slot == keep || !slot->entry) {
+            continue;
+        }
+        if (slot->entry->referenced) {
+            slot->entry->referenced = false;
+            continue;
+        }
+        evict(cache, slot);
+    }
+    return cache->bytes + size <= cache->max_bytes;
+}
+
+bool line_cache_store(LineCache *cache,
+                      uint64_t hash,
+                      uint32_t tag,
+                      const char *line,
+                      size_t length,
+                      const LineCacheMatch *matches,
+                      size_t count) {
+    LineCacheSlot *slot = &cache->slots[hash & cache->mask];
+    if (slot->seen != hash) {
+        slot->seen = hash;
+        return false;
+    }
+    if (count > UINT32_MAX) {
+        return false;
+    }
+    size_t size = sizeof(LineCacheEntry) + count * sizeof(LineCacheMatch) + length;
+    if (slot->entry) {
+        evict(cache, slot);
+    }
+    if (!make_room(cache, slot, size)) {
+        return false;
+    }
+    LineCacheEntry *entry = malloc(size);
+    if (!entry) {
+        return false;
+    }
+    entry->hash = hash;
+    entry->tag = tag;
+    entry->match_count = (uint32_t)count;
+    entry->length = length;
+    entry->size = size;
+    entry->referenced = false;
+    if (count > 0) {
+        memcpy(entry->matches, matches, count * sizeof(LineCacheMatch));
+    }
+    memcpy((char *)(entry->matches + count), line, length);
+    slot->entry = entry;
+    slot->seen = 0;
+    cache->bytes += size;
+    cache->window_repeats++;
+    return true;
+}
+
+void line_cache_stats(const LineCache *cache, LineCacheStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (!cache) {
+        return;
+    }
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->evictions = cache->evictions;
+    stats->bypassed = cache->bypassed;
+    stats->bytes = cache->bytes;
+}
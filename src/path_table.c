@@ -0,0 +1,82 @@
+#include "path_table.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "arena.h"
+
+// Paths are copied into blocks of this size.
+#define PATH_TABLE_BLOCK_SIZE (64 * 1024)
+
+struct PathTable {
+    pthread_mutex_t mutex;
+    Arena strings;
+    const char **paths;
+    size_t count;
+    size_t capacity;
+    // Growths of paths; the arena counts its own blocks.
+    uint64_t allocations;
+};
+
+PathTable *path_table_create(void) {
+    PathTable *table = calloc(1, sizeof(*table));
+    if (!table) {
+        return NULL;
+    }
+    if (pthread_mutex_init(&table->mutex, NULL) != 0) {
+        free(table);
+        return NULL;
+    }
+    arena_init(&table->strings, PATH_TABLE_BLOCK_SIZE);
+    return table;
+}
+
+void path_table_destroy(PathTable *table) {
+    if (!table) {
+        return;
+    }
+    arena_destroy(&table->strings);
+    free(table->paths);
+    pthread_mutex_destroy(&table->mutex);
+    free(table);
+}
+
+uint32_t path_table_intern(PathTable *table, const char *path, const char **stored) {
+    if (!table || !path) {
+        return PATH_TABLE_NONE;
+    }
+
+    uint32_t id = PATH_TABLE_NONE;
+    pthread_mutex_lock(&table->mutex);
+    if (table->count == table->capacity && table->count < PATH_TABLE_NONE) {
+        size_t capacity = table->capacity ? table->capacity * 2 : 64;
+        const char **grown = realloc(table->paths, capacity * sizeof(*grown));
+        if (grown) {
+            table->paths = grown;
+            table->capacity = capacity;
+            table->allocations++;
+        }
+    }
+    const char *copy = table->count < table->capacity ? arena_copy_string(&table->strings, path) : NULL;
+    if (copy) {
+        id = (uint32_t)table->count;
+        table->paths[table->count++] = copy;
+        if (stored) {
+            *stored = copy;
+        }
+    }
+    pthread_mutex_unlock(&table->mutex);
+    return id;
+}
+
+const char *path_table_get(const PathTable *table, uint32_t id) {
+    return table && id < table->count ? table->paths[id] : NULL;
+}
+
+size_t path_table_count(const PathTable *table) {
+    return table ? table->count : 0;
+}
+
+uint64_t path_table_allocations(const PathTable *table) {
+    return table ? table->allocations + table->strings.allocations : 0;
+}
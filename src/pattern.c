@@ -0,0 +1,795 @@
+#include "pattern.h"
+
+#include <ctype.h>
+#include <regex.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+
+// Bounded repeats are expanded by the matchers, so keep them small.
+#define PATTERN_MAX_REPEAT 255
+// Limits for the literal sets tracked during extraction.
+#define PATTERN_MAX_EXACT 16
+#define PATTERN_MAX_REQUIRED 32
+// Charsets with up to this many case-folded bytes still count as literals.
+#define PATTERN_MAX_LITERAL_CLASS 4
+
+typedef struct {
+    const char *text;
+    size_t position;
+    bool icase;
+    bool failed;
+} PatternParser;
+
+static PatternNode *parse_alternation(PatternParser *parser);
+
+static PatternNode *new_node(pattern_node_kind_t kind) {
+    PatternNode *node = calloc(1, sizeof(*node));
+    if (node) {
+        node->kind = kind;
+    }
+    return node;
+}
+
+static PatternNode *new_binary(pattern_node_kind_t kind, PatternNode *left, PatternNode *right) {
+    PatternNode *node = new_node(kind);
+    if (!node) {
+        pattern_free(left);
+        pattern_free(right);
+        return NULL;
+    }
+    node->left = left;
+    node->right = right;
+    return node;
+}
+
+void pattern_free(PatternNode *node) {
+    if (!node) {
+        return;
+    }
+    pattern_free(node->left);
+    pattern_free(node->right);
+    free(node);
+}
+
+static void set_add(unsigned char *set, unsigned char byte) {
+    set[byte >> 3] |= (unsigned char)(1u << (byte & 7));
+}
+
+static bool set_has(const unsigned char *set, unsigned char byte) {
+    return (set[byte >> 3] & (1u << (byte & 7))) != 0;
+}
+
+bool pattern_charset_contains(const PatternNode *node, unsigned char byte) {
+    return node && node->kind == PATTERN_NODE_CHARSET && set_has(node->set, byte);
+}
+
+// REG_ICASE in the C locale folds the positive set before negation.
+static void set_fold_case(unsigned char *set) {
+    for (int byte = 'a'; byte <= 'z'; ++byte) {
+        int upper = byte - 'a' + 'A';
+        if (set_has(set, (unsigned char)byte) || set_has(set, (unsigned char)upper)) {
+            set_add(set, (unsigned char)byte);
+            set_add(set, (unsigned char)upper);
+        }
+    }
+}
+
+static void set_negate(unsigned char *set) {
+    for (size_t i = 0; i < 32; ++i) {
+        set[i] = (unsigned char)~set[i];
+    }
+    // NUL terminates the line for regexec and can never match.
+    set[0] &= (unsigned char)~1u;
+}
+
+static bool class_contains(const char *name, size_t length, int byte) {
+    // Explicit ASCII classes, identical to the C locale used by the scanner.
+    if (length == 5 && strncmp(name, "alpha", 5) == 0) {
+        return (byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z');
+    }
+    if (length == 5 && strncmp(name, "digit", 5) == 0) {
+        return byte >= '0' && byte <= '9';
+    }
+    if (length == 5 && strncmp(name, "alnum", 5) == 0) {
+        return class_contains("alpha", 5, byte) || class_contains("digit", 5, byte);
+    }
+    if (length == 5 && strncmp(name, "upper", 5) == 0) {
+        return byte >= 'A' && byte <= 'Z';
+    }
+    if (length == 5 && strncmp(name, "lower", 5) == 0) {
+        return byte >= 'a' && byte <= 'z';
+    }
+    if (length == 5 && strncmp(name, "space", 5) == 0) {
+        return byte == ' ' || (byte >= 0x09 && byte <= 0x0D);
+    }
+    if (length == 5 && strncmp(name, "blank", 5) == 0) {
+        return byte == ' ' || byte == '\t';
+    }
+    if (length == 5 && strncmp(name, "cntrl", 5) == 0) {
+        return byte < 0x20 || byte == 0x7F;
+    }
+    if (length == 5 && strncmp(name, "print", 5) == 0) {
+        return byte >= 0x20 && byte < 0x7F;
+    }
+    if (length == 5 && strncmp(name, "graph", 5) == 0) {
+        return byte > 0x20 && byte < 0x7F;
+    }
+    if (length == 5 && strncmp(name, "punct", 5) == 0) {
+        return class_contains("graph", 5, byte) && !class_contains("alnum", 5, byte);
+    }
+    if (length == 6 && strncmp(name, "xdigit", 6) == 0) {
+        return class_contains("digit", 5, byte) || (byte >= 'a' && byte <= 'f') ||
+               (byte >= 'A' && byte <= 'F');
+    }
+    return false;
+}
+
+static bool is_known_class(const char *name, size_t length) {
+    static const char *const names[] = {"alpha", "digit", "alnum", "upper", "lower", "space",
+                                        "blank", "cntrl", "print", "graph", "punct", "xdigit"};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+        if (strlen(names[i]) == length && strncmp(names[i], name, length) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static PatternNode *parse_bracket(PatternParser *parser) {
+    const char *text = parser->text;
+    PatternNode *node = new_node(PATTERN_NODE_CHARSET);
+    if (!node) {
+        parser->failed = true;
+        return NULL;
+    }
+
+    bool negate = false;
+    if (text[parser->position] == '^') {
+        negate = true;
+        parser->position++;
+    }
+
+    bool first = true;
+    while (true) {
+        char current = text[parser->position];
+        if (current == '\0') {
+            goto fail;
+        }
+        if (current == ']' && !first) {
+            parser->position++;
+            break;
+        }
+        first = false;
+
+        if (current == '[' && text[parser->position + 1] == ':') {
+            const char *name = text + parser->position + 2;
+            const char *close = strstr(name, ":]");
+            if (!close || !is_known_class(name, (size_t)(close - name))) {
+                goto fail;
+            }
+            for (int byte = 1; byte < 256; ++byte) {
+                if (class_contains(name, (size_t)(close - name), byte)) {
+                    set_add(node->set, (unsigned char)byte);
+                }
+            }
+            parser->position = (size_t)(close - text) + 2;
+            continue;
+        }
+        if (current == '[' && (text[parser->position + 1] == '=' || text[parser->position + 1] == '.')) {
+            // Equivalence classes and collating symbols are left to regcomp.
+            goto fail;
+        }
+
+        unsigned char low = (unsigned char)current;
+        parser->position++;
+        if (text[parser->position] == '-' && text[parser->position + 1] != ']' &&
+            text[parser->position + 1] != '\0') {
+            unsigned char high = (unsigned char)text[parser->position + 1];
+            if (high == '[' || high < low) {
+                goto fail;
+            }
+            for (int byte = low; byte <= high; ++byte) {
+                set_add(node->set, (unsigned char)byte);
+            }
+            parser->position += 2;
+        } else {
+            set_add(node->set, low);
+        }
+    }
+
+    if (parser->icase) {
+        set_fold_case(node->set);
+    }
+    if (negate) {
+        set_negate(node->set);
+    }
+    return node;
+
+fail:
+    parser->failed = true;
+    pattern_free(node);
+    return NULL;
+}
+
+static PatternNode *literal_node(PatternParser *parser, unsigned char byte) {
+    PatternNode *node = new_node(PATTERN_NODE_CHARSET);
+    if (!node) {
+        parser->failed = true;
+        return NULL;
+    }
+    set_add(node->set, byte);
+    if (parser->icase) {
+        set_fold_case(node->set);
+    }
+    return node;
+}
+
+static PatternNode *parse_atom(PatternParser *parser) {
+    char current = parser->text[parser->position];
+    switch (current) {
+    case '(': {
+        parser->position++;
+        PatternNode *inner = NULL;
+        if (parser->text[parser->position] == ')') {
+            inner = new_node(PATTERN_NODE_EMPTY);
+            if (!inner) {
+                parser->failed = true;
+                return NULL;
+            }
+        } else {
+            inner = parse_alternation(parser);
+            if (!inner) {
+                return NULL;
+            }
+        }
+        if (parser->text[parser->position] != ')') {
+            pattern_free(inner);
+            parser->failed = true;
+            return NULL;
+        }
+        parser->position++;
+        return inner;
+    }
+    case '[':
+        parser->position++;
+        return parse_bracket(parser);
+    case '.': {
+        parser->position++;
+        PatternNode *node = new_node(PATTERN_NODE_CHARSET);
+        if (!node) {
+            parser->failed = true;
+            return NULL;
+        }
+        set_negate(node->set);
+        return node;
+    }
+    case '^':
+    case '$': {
+        parser->position++;
+        PatternNode *node = new_node(current == '^' ? PATTERN_NODE_BEGIN_LINE : PATTERN_NODE_END_LINE);
+        if (!node) {
+            parser->failed = true;
+        }
+        return node;
+    }
+    case '\\': {
+        unsigned char escaped = (unsigned char)parser->text[parser->position + 1];
+        // GNU word operators and back-references are left to regcomp.
+        if (escaped == '\0' || isalnum(escaped) || escaped == '<' || escaped == '>' ||
+            escaped == '`' || escaped == '\'') {
+            parser->failed = true;
+            return NULL;
+        }
+        parser->position += 2;
+        return literal_node(parser, escaped);
+    }
+    case '*':
+    case '+':
+    case '?':
+    case '{':
+    case ')':
+    case '|':
+    case '\0':
+        parser->failed = true;
+        return NULL;
+    default:
+        parser->position++;
+        return literal_node(parser, (unsigned char)current);
+    }
+}
+
+static int parse_bound(PatternParser *parser, int *out_value) {
+    const char *text = parser->text;
+    if (!isdigit((unsigned char)text[parser->position])) {
+        return -1;
+    }
+    int value = 0;
+    while (isdigit((unsigned char)text[parser->position])) {
+        value = value * 10 + (text[parser->position] - '0');
+        if (value > PATTERN_MAX_REPEAT) {
+            return -1;
+        }
+        parser->position++;
+    }
+    *out_value = value;
+    return 0;
+}
+
+static PatternNode *parse_piece(PatternParser *parser) {
+    PatternNode *atom = parse_atom(parser);
+    if (!atom) {
+        return NULL;
+    }
+
+    while (true) {
+        char current = parser->text[parser->position];
+        int min = 0;
+        int max = 0;
+        if (current == '*') {
+            min = 0;
+            max = PATTERN_REPEAT_UNBOUNDED;
+            parser->position++;
+        } else if (current == '+') {
+            min = 1;
+            max = PATTERN_REPEAT_UNBOUNDED;
+            parser->position++;
+        } else if (current == '?') {
+            min = 0;
+            max = 1;
+            parser->position++;
+        } else if (current == '{') {
+            parser->position++;
+            if (parse_bound(parser, &min) != 0) {
+                goto fail;
+            }
+            max = min;
+            if (parser->text[parser->position] == ',') {
+                parser->position++;
+                if (parser->text[parser->position] == '}') {
+                    max = PATTERN_REPEAT_UNBOUNDED;
+                } else if (parse_bound(parser, &max) != 0 || max < min) {
+                    goto fail;
+                }
+            }
+            if (parser->text[parser->position] != '}') {
+                goto fail;
+            }
+            parser->position++;
+        } else {
+            return atom;
+        }
+
+        PatternNode *repeat = new_node(PATTERN_NODE_REPEAT);
+        if (!repeat) {
+            goto fail;
+        }
+        repeat->repeat_min = min;
+        repeat->repeat_max = max;
+        repeat->left = atom;
+        atom = repeat;
+    }
+
+fail:
+    parser->failed = true;
+    pattern_free(atom);
+    return NULL;
+}
+
+static PatternNode *parse_concatenation(PatternParser *parser) {
+    PatternNode *result = NULL;
+    while (true) {
+        char current = parser->text[parser->position];
+        if (current == '\0' || current == '|' || current == ')') {
+            break;
+        }
+        PatternNode *piece = parse_piece(parser);
+        if (!piece) {
+            pattern_free(result);
+            return NULL;
+        }
+        if (!result) {
+            result = piece;
+        } else {
+            result = new_binary(PATTERN_NODE_CONCAT, result, piece);
+            if (!result) {
+                parser->failed = true;
+                return NULL;
+            }
+        }
+    }
+
+    if (!result) {
+        result = new_node(PATTERN_NODE_EMPTY);
+        if (!result) {
+            parser->failed = true;
+        }
+    }
+    return result;
+}
+
+static PatternNode *parse_alternation(PatternParser *parser) {
+    PatternNode *result = parse_concatenation(parser);
+    while (result && parser->text[parser->position] == '|') {
+        parser->position++;
+        PatternNode *next = parse_concatenation(parser);
+        if (!next) {
+            pattern_free(result);
+            return NULL;
+        }
+        result = new_binary(PATTERN_NODE_ALTERNATE, result, next);
+        if (!result) {
+            parser->failed = true;
+        }
+    }
+    return result;
+}
+
+PatternNode *pattern_parse(const char *pattern, int flags) {
+    if (!pattern || !(flags & REG_EXTENDED) || (flags & (REG_NEWLINE | REG_NOSUB)) != 0) {
+        return NULL;
+    }
+
+    PatternParser parser = {pattern, 0, (flags & REG_ICASE) != 0, false};
+    PatternNode *root = parse_alternation(&parser);
+    if (!root || parser.failed || pattern[parser.position] != '\0') {
+        pattern_free(root);
+        return NULL;
+    }
+    return root;
+}
+
+size_t pattern_min_length(const PatternNode *node) {
+    if (!node) {
+        return 0;
+    }
+    switch (node->kind) {
+    case PATTERN_NODE_CHARSET:
+        return 1;
+    case PATTERN_NODE_CONCAT:
+        return pattern_min_length(node->left) + pattern_min_length(node->right);
+    case PATTERN_NODE_ALTERNATE: {
+        size_t left = pattern_min_length(node->left);
+        size_t right = pattern_min_length(node->right);
+        return left < right ? left : right;
+    }
+    case PATTERN_NODE_REPEAT:
+        return (size_t)node->repeat_min * pattern_min_length(node->left);
+    case PATTERN_NODE_EMPTY:
+    case PATTERN_NODE_BEGIN_LINE:
+    case PATTERN_NODE_END_LINE:
+    default:
+        return 0;
+    }
+}
+
+// Literal extraction: every node yields either an exact set of the strings it
+// can match (lowercased, small sets only) or a required set of which every
+// match contains one member. Both are supersets, so filtering stays safe.
+typedef struct {
+    bool exact_valid;
+    PatternLiteralSet exact;
+    PatternLiteralSet required;
+} LiteralInfo;
+
+void pattern_literal_set_free(PatternLiteralSet *literals) {
+    if (!literals) {
+        return;
+    }
+    for (size_t i = 0; i < literals->count; ++i) {
+        free(literals->items[i]);
+    }
+    free(literals->items);
+    literals->items = NULL;
+    literals->count = 0;
+}
+
+static int literal_set_add(PatternLiteralSet *literals, const char *text) {
+    for (size_t i = 0; i < literals->count; ++i) {
+        if (strcmp(literals->items[i], text) == 0) {
+            return 0;
+        }
+    }
+    char **resized = realloc(literals->items, (literals->count + 1) * sizeof(*resized));
+    if (!resized) {
+        return -1;
+    }
+    literals->items = resized;
+    literals->items[literals->count] = duplicate_string(text);
+    if (!literals->items[literals->count]) {
+        return -1;
+    }
+    literals->count++;
+    return 0;
+}
+
+static int literal_set_union(PatternLiteralSet *dest, const PatternLiteralSet *src) {
+    for (size_t i = 0; i < src->count; ++i) {
+        if (literal_set_add(dest, src->items[i]) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int literal_set_cross(PatternLiteralSet *dest,
+                             const PatternLiteralSet *left,
+                             const PatternLiteralSet *right) {
+    for (size_t i = 0; i < left->count; ++i) {
+        size_t left_length = strlen(left->items[i]);
+        for (size_t j = 0; j < right->count; ++j) {
+            size_t right_length = strlen(right->items[j]);
+            char *joined = malloc(left_length + right_length + 1);
+            if (!joined) {
+                return -1;
+            }
+            memcpy(joined, left->items[i], left_length);
+            memcpy(joined + left_length, right->items[j], right_length + 1);
+            int result = literal_set_add(dest, joined);
+            free(joined);
+            if (result != 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Shortest member length; 0 means the set cannot filter anything.
+static size_t literal_set_score(const PatternLiteralSet *literals) {
+    if (literals->count == 0) {
+        return 0;
+    }
+    size_t best = strlen(literals->items[0]);
+    for (size_t i = 1; i < literals->count; ++i) {
+        size_t length = strlen(literals->items[i]);
+        if (length < best) {
+            best = length;
+        }
+    }
+    return best;
+}
+
+static void literal_info_free(LiteralInfo *info) {
+    pattern_literal_set_free(&info->exact);
+    pattern_literal_set_free(&info->required);
+    info->exact_valid = false;
+}
+
+// Move the best filter of info into out (exact set if usable, else required).
+static void literal_info_take_required(LiteralInfo *info, PatternLiteralSet *out) {
+    PatternLiteralSet *chosen = &info->required;
+    if (info->exact_valid && literal_set_score(&info->exact) > 0) {
+        chosen = &info->exact;
+    }
+    *out = *chosen;
+    chosen->items = NULL;
+    chosen->count = 0;
+    literal_info_free(info);
+}
+
+static int literal_info_exact_single(LiteralInfo *info, const char *text) {
+    info->exact_valid = true;
+    return literal_set_add(&info->exact, text);
+}
+
+static int analyze_literals(const PatternNode *node, LiteralInfo *info);
+
+// Keep the more selective of best and candidate in best; free the other.
+static void literal_set_keep_best(PatternLiteralSet *best, PatternLiteralSet *candidate) {
+    size_t best_score = literal_set_score(best);
+    size_t candidate_score = literal_set_score(candidate);
+    if (candidate_score > best_score ||
+        (candidate_score == best_score && candidate_score > 0 && candidate->count < best->count)) {
+        PatternLiteralSet swap = *best;
+        *best = *candidate;
+        *candidate = swap;
+    }
+    pattern_literal_set_free(candidate);
+}
+
+static size_t count_concat_items(const PatternNode *node) {
+    if (node->kind != PATTERN_NODE_CONCAT) {
+        return 1;
+    }
+    return count_concat_items(node->left) + count_concat_items(node->right);
+}
+
+static void collect_concat_items(const PatternNode *node, const PatternNode **items, size_t *count) {
+    if (node->kind != PATTERN_NODE_CONCAT) {
+        items[(*count)++] = node;
+        return;
+    }
+    collect_concat_items(node->left, items, count);
+    collect_concat_items(node->right, items, count);
+}
+
+// Walk a concatenation left to right, growing runs of exact strings and
+// keeping the most selective run or required set seen.
+static int analyze_concat_literals(const PatternNode *node, LiteralInfo *info) {
+    size_t item_count = count_concat_items(node);
+    const PatternNode **items = malloc(item_count * sizeof(*items));
+    if (!items) {
+        return -1;
+    }
+    size_t collected = 0;
+    collect_concat_items(node, items, &collected);
+
+    PatternLiteralSet run = {NULL, 0};
+    PatternLiteralSet best = {NULL, 0};
+    bool all_exact = true;
+    int result = literal_set_add(&run, "");
+
+    for (size_t i = 0; i < item_count && result == 0; ++i) {
+        LiteralInfo child;
+        result = analyze_literals(items[i], &child);
+        if (result != 0) {
+            literal_info_free(&child);
+            break;
+        }
+
+        if (child.exact_valid && run.count * child.exact.count <= PATTERN_MAX_EXACT) {
+            PatternLiteralSet next = {NULL, 0};
+            result = literal_set_cross(&next, &run, &child.exact);
+            pattern_literal_set_free(&run);
+            run = next;
+            literal_info_free(&child);
+            continue;
+        }
+
+        all_exact = false;
+        literal_set_keep_best(&best, &run);
+        if (child.exact_valid) {
+            run = child.exact;
+            child.exact.items = NULL;
+            child.exact.count = 0;
+            literal_info_free(&child);
+        } else {
+            PatternLiteralSet required;
+            literal_info_take_required(&child, &required);
+            literal_set_keep_best(&best, &required);
+            result = literal_set_add(&run, "");
+        }
+    }
+    free(items);
+
+    if (result != 0) {
+        pattern_literal_set_free(&run);
+        pattern_literal_set_free(&best);
+        return -1;
+    }
+    if (all_exact) {
+        info->exact_valid = true;
+        info->exact = run;
+        pattern_literal_set_free(&best);
+        return 0;
+    }
+    literal_set_keep_best(&best, &run);
+    info->required = best;
+    return 0;
+}
+
+static int analyze_literals(const PatternNode *node, LiteralInfo *info) {
+    memset(info, 0, sizeof(*info));
+    switch (node->kind) {
+    case PATTERN_NODE_EMPTY:
+    case PATTERN_NODE_BEGIN_LINE:
+    case PATTERN_NODE_END_LINE:
+        return literal_info_exact_single(info, "");
+    case PATTERN_NODE_CHARSET: {
+        bool folded[256] = {false};
+        size_t distinct = 0;
+        for (int byte = 1; byte < 256; ++byte) {
+            if (set_has(node->set, (unsigned char)byte)) {
+                int lower = tolower(byte);
+                if (!folded[lower]) {
+                    folded[lower] = true;
+                    distinct++;
+                }
+            }
+        }
+        if (distinct == 0 || distinct > PATTERN_MAX_LITERAL_CLASS) {
+            return 0;
+        }
+        info->exact_valid = true;
+        for (int byte = 1; byte < 256; ++byte) {
+            if (folded[byte]) {
+                char text[2] = {(char)byte, '\0'};
+                if (literal_set_add(&info->exact, text) != 0) {
+                    return -1;
+                }
+            }
+        }
+        return 0;
+    }
+    case PATTERN_NODE_CONCAT:
+        return analyze_concat_literals(node, info);
+    case PATTERN_NODE_ALTERNATE: {
+        LiteralInfo left;
+        LiteralInfo right;
+        if (analyze_literals(node->left, &left) != 0) {
+            literal_info_free(&left);
+            return -1;
+        }
+        if (analyze_literals(node->right, &right) != 0) {
+            literal_info_free(&left);
+            literal_info_free(&right);
+            return -1;
+        }
+
+        int result = 0;
+        if (left.exact_valid && right.exact_valid &&
+            left.exact.count + right.exact.count <= PATTERN_MAX_EXACT) {
+            info->exact_valid = true;
+            result = literal_set_union(&info->exact, &left.exact);
+            if (result == 0) {
+                result = literal_set_union(&info->exact, &right.exact);
+            }
+            literal_info_free(&left);
+            literal_info_free(&right);
+            return result;
+        }
+
+        PatternLiteralSet left_required;
+        PatternLiteralSet right_required;
+        literal_info_take_required(&left, &left_required);
+        literal_info_take_required(&right, &right_required);
+
+        // One of the branches must be present; a branch without literals
+        // makes the whole alternation unfilterable.
+        if (literal_set_score(&left_required) > 0 && literal_set_score(&right_required) > 0 &&
+            left_required.count + right_required.count <= PATTERN_MAX_REQUIRED) {
+            info->required = left_required;
+            result = literal_set_union(&info->required, &right_required);
+        } else {
+            pattern_literal_set_free(&left_required);
+        }
+        pattern_literal_set_free(&right_required);
+        return result;
+    }
+    case PATTERN_NODE_REPEAT: {
+        if (node->repeat_min == 0 && node->repeat_max != 1) {
+            return 0;
+        }
+        LiteralInfo child;
+        if (analyze_literals(node->left, &child) != 0) {
+            literal_info_free(&child);
+            return -1;
+        }
+        if (node->repeat_max == 1) {
+            *info = child;
+            if (node->repeat_min == 0) {
+                if (info->exact_valid) {
+                    return literal_set_add(&info->exact, "");
+                }
+                pattern_literal_set_free(&info->required);
+            }
+            return 0;
+        }
+        literal_info_take_required(&child, &info->required);
+        return 0;
+    }
+    default:
+        return 0;
+    }
+}
+
+int pattern_required_literals(const PatternNode *node, PatternLiteralSet *literals) {
+    if (!node || !literals) {
+        return -1;
+    }
+    literals->items = NULL;
+    literals->count = 0;
+
+    LiteralInfo info;
+    if (analyze_literals(node, &info) != 0) {
+        literal_info_free(&info);
+        return -1;
+    }
+    literal_info_take_required(&info, literals);
+    if (literal_set_score(literals) == 0) {
+        pattern_literal_set_free(literals);
+    }
+    return 0;
+}
@@ -0,0 +1,225 @@
+#include "rule_bundle.h"
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char BUNDLE_MAGIC[8] = {'S', 'G', 'R', 'U', 'L', 'E', 'S', '\0'};
+
+// Written in native byte order; a reader on another byte order sees a
+// different value and rejects the file.
+#define BUNDLE_BYTE_ORDER 0x01020304u
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t section_count;
+    uint32_t reserved;
+    uint64_t file_size;
+} BundleHeader;
+
+typedef struct {
+    uint32_t kind;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+} BundleSectionEntry;
+
+typedef struct {
+    uint32_t kind;
+    unsigned char *data;
+    size_t size;
+} WriterSection;
+
+struct RuleBundleWriter {
+    WriterSection *sections;
+    size_t section_count;
+};
+
+struct RuleBundle {
+    void *map;
+    size_t size;
+    const BundleSectionEntry *sections;
+    size_t section_count;
+};
+
+static uint64_t align8(uint64_t value) {
+    return (value + 7u) & ~(uint64_t)7u;
+}
+
+RuleBundleWriter *rule_bundle_writer_create(void) {
+    return calloc(1, sizeof(RuleBundleWriter));
+}
+
+void *rule_bundle_writer_add(RuleBundleWriter *writer, uint32_t kind, size_t size) {
+    if (!writer) {
+        return NULL;
+    }
+    WriterSection *resized = realloc(writer->sections, (writer->section_count + 1) * sizeof(*resized));
+    if (!resized) {
+        return NULL;
+    }
+    writer->sections = resized;
+
+    // One extra byte keeps empty sections addressable.
+    unsigned char *data = calloc(size + 1, 1);
+    if (!data) {
+        return NULL;
+    }
+    writer->sections[writer->section_count].kind = kind;
+    writer->sections[writer->section_count].data = data;
+    writer->sections[writer->section_count].size = size;
+    writer->section_count++;
+    return data;
+}
+
+int rule_bundle_writer_save(const RuleBundleWriter *writer, const char *path) {
+    if (!writer || !path) {
+        return -1;
+    }
+
+    BundleHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BUNDLE_MAGIC, sizeof(header.magic));
+    header.version = RULE_BUNDLE_VERSION;
+    header.byte_order = BUNDLE_BYTE_ORDER;
+    header.section_count = (uint32_t)writer->section_count;
+
+    BundleSectionEntry *entries = calloc(writer->section_count + 1, sizeof(*entries));
+    if (!entries) {
+        return -1;
+    }
+    uint64_t offset = align8(sizeof(header) + writer->section_count * sizeof(*entries));
+    for (size_t i = 0; i < writer->section_count; ++i) {
+        entries[i].kind = writer->sections[i].kind;
+        entries[i].offset = offset;
+        entries[i].size = writer->sections[i].size;
+        offset = align8(offset + writer->sections[i].size);
+    }
+    header.file_size = offset;
+
+    FILE *out = fopen(path, "wb");
+    if (!out) {
+        free(entries);
+        return -1;
+    }
+    static const unsigned char padding[8] = {0};
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+    if (ok && writer->section_count > 0) {
+        ok = fwrite(entries, sizeof(*entries), writer->section_count, out) == writer->section_count;
+    }
+    uint64_t written = sizeof(header) + writer->section_count * sizeof(*entries);
+    for (size_t i = 0; ok && i < writer->section_count; ++i) {
+        size_t gap = (size_t)(entries[i].offset - written);
+        ok = fwrite(padding, 1, gap, out) == gap;
+        if (ok && writer->sections[i].size > 0) {
+            ok = fwrite(writer->sections[i].data, writer->sections[i].size, 1, out) == 1;
+        }
+        written = entries[i].offset + entries[i].size;
+    }
+    if (ok) {
+        size_t gap = (size_t)(header.file_size - written);
+        ok = fwrite(padding, 1, gap, out) == gap;
+    }
+    free(entries);
+    if (fclose(out) != 0) {
+        ok = false;
+    }
+    return ok ? 0 : -1;
+}
+
+void rule_bundle_writer_destroy(RuleBundleWriter *writer) {
+    if (!writer) {
+        return;
+    }
+    for (size_t i = 0; i < writer->section_count; ++i) {
+        free(writer->sections[i].data);
+    }
+    free(writer->sections);
+    free(writer);
+}
+
+int rule_bundle_probe(const char *path) {
+    if (!path) {
+        return -1;
+    }
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return -1;
+    }
+    char magic[sizeof(BUNDLE_MAGIC)];
+    size_t read = fread(magic, 1, sizeof(magic), file);
+    fclose(file);
+    return read == sizeof(magic) && memcmp(magic, BUNDLE_MAGIC, sizeof(magic)) == 0 ? 1 : 0;
+}
+
+RuleBundle *rule_bundle_open(const char *path) {
+    if (!path) {
+        return NULL;
+    }
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(BundleHeader)) {
+        close(fd);
+        return NULL;
+    }
+    size_t size = (size_t)info.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    const BundleHeader *header = map;
+    const BundleSectionEntry *sections = (const BundleSectionEntry *)(header + 1);
+    bool valid = memcmp(header->magic, BUNDLE_MAGIC, sizeof(BUNDLE_MAGIC)) == 0 &&
+                 header->version == RULE_BUNDLE_VERSION && header->byte_order == BUNDLE_BYTE_ORDER &&
+                 header->file_size == size &&
+                 header->section_count <= (size - sizeof(*header)) / sizeof(*sections);
+    for (size_t i = 0; valid && i < header->section_count; ++i) {
+        valid = sections[i].offset % 8 == 0 && sections[i].offset <= size &&
+                sections[i].size <= size - sections[i].offset;
+    }
+    RuleBundle *bundle = valid ? calloc(1, sizeof(*bundle)) : NULL;
+    if (!bundle) {
+        munmap(map, size);
+        return NULL;
+    }
+    bundle->map = map;
+    bundle->size = size;
+    bundle->sections = sections;
+    bundle->section_count = header->section_count;
+    return bundle;
+}
+
+const void *rule_bundle_section(const RuleBundle *bundle, uint32_t kind, size_t *size) {
+    if (!bundle) {
+        return NULL;
+    }
+    for (size_t i = 0; i < bundle->section_count; ++i) {
+        if (bundle->sections[i].kind == kind) {
+            if (size) {
+                *size = (size_t)bundle->sections[i].size;
+            }
+            return (const unsigned char *)bundle->map + bundle->sections[i].offset;
+        }
+    }
+    return NULL;
+}
+
+void rule_bundle_close(RuleBundle *bundle) {
+    if (!bundle) {
+        return;
+    }
+    munmap(bundle->map, bundle->size);
+    free(bundle);
+}
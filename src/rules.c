@@ -1,11 +1,30 @@
-
-
 #include "rules.h"
 
+#include <fnmatch.h>
+#include <pthread.h>
 #include <regex.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "aho_corasick.h"
+#include "byte_class.h"
+#include "entropy.h"
+#include "generated_rules.h"
+#include "kv_tokenizer.h"
+#include "lazy_dfa.h"
+#include "pattern.h"
+#include "rule_bundle.h"
+#include "rules_file.h"
+#include "token_rule.h"
+#include "util.h"
+
+// Candidate marks for up to this many rules live on the stack.
+#define RULES_STACK_MARKS 256
+#define ENTROPY_SEVERITY SEVERITY_MEDIUM
 
 typedef struct {
     const char *name;
@@ -16,58 +35,139 @@ typedef struct {
     bool compiled;
 } RegexRule;
 
+// How a rule is evaluated and what a line must offer before it runs.
+typedef struct {
+    size_t min_length;
+    bool has_literal;
+    // Evaluated by the lazy DFA instead of regexec.
+    bool native;
+    // Evaluated by the matcher generated at build time.
+    bool generated;
+    size_t generated_index;
+    // Native rule whose candidates come from the key/value tokenizer.
+    bool key_value;
+    size_t key_value_index;
+    // Native rule found by its fixed-format token matcher; the DFA still
+    // marks it.
+    bool token;
+    size_t token_index;
+} RuleMatcher;
+
+// A rule with one of RULES_BLOCK_FLAGS. Matches carry the name pointer of
+// their rule, so that is what they are looked up by.
+typedef struct {
+    const char *name;
+    block_rule_kind_t kind;
+} MultiLineRule;
+
 typedef struct {
+    // Options the engine was built with, reused by rules_clone.
+    RulesOptions options;
     RegexRule *rules;
     size_t rule_count;
+    // Rules defined before --rules-include/--rules-exclude/--min-severity.
+    size_t available_count;
+    RuleMatcher *matchers;
+    // Per-rule counters, NULL unless options.profile is set.
+    RuleProfile *profile;
+    // Required literals of the regexec rules; ids are rule indices.
+    AhoCorasick *literals;
+    bool has_literals;
+    // Required literals of every rule, used to find candidate lines in a
+    // buffer. Only usable as a filter if every rule has a literal.
+    AhoCorasick *line_literals;
+    size_t line_literal_rules;
+    // At least one rule uses a generated matcher.
+    bool has_generated;
+
+    // Native program for all rules it supports (NULL with RULES_ENGINE_REGEX).
+    // Key/value rules are left out of its marking pass.
+    LazyDfa *native;
+    // Key/value rules among the native ones, NULL if there are none.
+    KvTokenizer *key_values;
+    // Token matchers of the native rules with RULES_FLAG_TOKEN.
+    TokenRule *tokens;
+    size_t token_count;
+    // Rules whose matches open blocks in rules_scan_stream.
+    MultiLineRule *multi_line;
+    size_t multi_line_count;
+    // Unlabeled high-entropy strings, NULL unless enabled in the options.
+    EntropyDetector *entropy;
+    // Matches of repeated lines, NULL unless enabled in the options, and
+    // the counters merged from clones.
+    LineCache *line_cache;
+    LineCacheStats merged_line_cache;
+    // Lines over options.max_line_length, and those merged from clones.
+    uint64_t long_lines;
+    uint64_t merged_long_lines;
+    // DFA caches, one per scanning thread, owned here for cleanup.
+    pthread_key_t cache_key;
+    bool cache_key_created;
+    pthread_mutex_t cache_mutex;
+    LazyDfaCache **caches;
+    size_t cache_count;
+
+    // Copy of options.rules_path and the storage the rule strings point
+    // into when they do not come from DEFAULT_RULES.
+    char *rules_path;
+    char *include;
+    char *exclude;
+    RulesFile rules_file;
+    RuleBundle *bundle;
 } RulesImpl;
 
+// Bundle sections written by rules_save_bundle.
+enum {
+    BUNDLE_SECTION_META = 1,
+    BUNDLE_SECTION_RULES,
+    BUNDLE_SECTION_STRINGS,
+    BUNDLE_SECTION_NATIVE,
+    BUNDLE_SECTION_LITERALS,
+    BUNDLE_SECTION_LINE_LITERALS,
+    BUNDLE_SECTION_KEY_VALUES,
+    BUNDLE_SECTION_TOKENS
+};
+
+typedef enum {
+    BUNDLE_RULE_REGEX = 0,
+    BUNDLE_RULE_NATIVE,
+    BUNDLE_RULE_GENERATED
+} bundle_rule_kind_t;
+
+typedef struct {
+    uint32_t engine;
+    uint32_t rule_count;
+    uint32_t available_count;
+    uint32_t line_literal_rules;
+    uint32_t has_literals;
+    uint32_t reserved;
+} BundleMeta;
+
+// Name and pattern are offsets into the strings section. Generated rules
+// are looked up again by pattern, so a bundle only loads into a build that
+// generated the same matcher.
+typedef struct {
+    uint32_t name;
+    uint32_t pattern;
+    uint32_t severity;
+    uint32_t flags;
+    uint32_t kind;
+    uint32_t min_length;
+    uint32_t has_literal;
+    uint32_t reserved;
+} BundleRule;
+
+// Token matcher of rule index.
+typedef struct {
+    uint32_t rule;
+    uint32_t reserved;
+    TokenRule token;
+} BundleToken;
+
 static const RegexRule DEFAULT_RULES[] = {
-    {"GENERIC_PASSWORD_KV", SEVERITY_HIGH, "(^|[^[:alnum:]_-])(password|passwort)[[:space:]]*[:=][[:space:]]*[^[:space:]]+", REG_ICASE | REG_EXTENDED, {0}, false},
-    {"GENERIC_APIKEY_KV", SEVERITY_MEDIUM, "(^|[^[:alnum:]_-])api[_-]?key[[:space:]]*[:=][[:space:]]*[^[:space:]]+", REG_ICASE | REG_EXTENDED, {0}, false},
-    {"GENERIC_SECRET_KV", SEVERITY_HIGH, "(^|[^[:alnum:]_-])secret[[:space:]]*[:=][[:space:]]*[^[:space:]]{8,}", REG_ICASE | REG_EXTENDED, {0}, false},
-    {"GENERIC_TOKEN_KV", SEVERITY_HIGH, "(^|[^[:alnum:]_-])(access|refresh|id)?_?token[[:space:]]*[:=][[:space:]]*[^[:space:]]+", REG_ICASE | REG_EXTENDED, {0}, false},
-    {"GENERIC_BEARER", SEVERITY_HIGH, "(^|[^[:alnum:]_-])bearer[[:space:]]+[A-Za-z0-9._-]{10,}", REG_ICASE | REG_EXTENDED, {0}, false},
-    {"GENERIC_AUTH_KV", SEVERITY_MEDIUM, "(^|[^[:alnum:]_-])auth(entication|orization)?[[:space:]]*[:=][[:space:]]*[^[:space:]]+", REG_ICASE | REG_EXTENDED, {0}, false},
-    {"GENERIC_CLIENT_SECRET_KV", SEVERITY_HIGH, "(^|[^[:alnum:]_-])client[_-]?secret[[:space:]]*[:=][[:space:]]*[^[:space:]]+", REG_ICASE | REG_EXTENDED, {0}, false},
-    {"GENERIC_PRIVATE_KEY_PEM", SEVERITY_HIGH, "-----BEGIN[[:space:]]+(RSA|EC|DSA|OPENSSH)?[[:space:]]*PRIVATE[[:space:]]+KEY-----", REG_ICASE | REG_EXTENDED, {0}, false},
-
-    {"GOOGLE_API_KEY", SEVERITY_HIGH, "AIza[0-9A-Za-z_-]{35}", REG_ICASE | REG_EXTENDED, {0}, false},
-    {"GOOGLE_OAUTH_CLIENT_ID", SEVERITY_MEDIUM, "[0-9]+-[A-Za-z0-9_]+\\.apps\\.googleusercontent\\.com", REG_ICASE | REG_EXTENDED, {0}, false},
-    {"GOOGLE_SERVICE_ACCOUNT_EMAIL", SEVERITY_MEDIUM, "[A-Za-z0-9._%+-]+@[^[:space:]]+\\.gserviceaccount\\.com", REG_ICASE | REG_EXTENDED, {0}, false},
-    {"GOOGLE_SERVICE_ACCOUNT_KV", SEVERITY_HIGH, "\"type\"[[:space:]]*:[[:space:]]*\"service_account\"", REG_ICASE | REG_EXTENDED, {0}, false},
-    {"GOOGLE_PRIVATE_KEY_ID_KV", SEVERITY_HIGH, "\"private_key_id\"[[:space:]]*:[[:space:]]*\"[A-Za-z0-9]+\"", REG_ICASE | REG_EXTENDED, {0}, false},
-
-    {"FIREBASE_API_KEY_KV", SEVERITY_HIGH, "firebase[_-]?api[_-]?key[[:space:]]*[:=][[:space:]]*[^[:space:]]+", REG_ICASE | REG_EXTENDED, {0}, false},
-    {"FIREBASE_DATABASE_URL", SEVERITY_MEDIUM, "https://[A-Za-z0-9-]+\\.(firebaseio\\.com|firebasedatabase\\.app)", REG_ICASE | REG_EXTENDED, {0}, false},
-    {"FIREBASE_PROJECT_ID_KV", SEVERITY_MEDIUM, "project[_-]?id[[:space:]]*[:=][[:space:]]*[^[:space:]]+", REG_ICASE | REG_EXTENDED, {0}, false},
-    {"FIREBASE_MESSAGING_SENDER_ID_KV", SEVERITY_MEDIUM, "messaging[_-]?sender[_-]?id[[:space:]]*[:=][[:space:]]*[^[:space:]]+", REG_ICASE | REG_EXTENDED, {0}, false},
-    {"FIREBASE_APP_ID", SEVERITY_LOW, "app[_-]?id[[:space:]]*[:=][[:space:]]*1:[0-9]+:(android|ios|web):[A-Za-z0-9]+", REG_ICASE | REG_EXTENDED, {0}, false},
-    {"FIREBASE_STORAGE_BUCKET", SEVERITY_LOW, "storage[_-]?bucket[[:space:]]*[:=][[:space:]]*[A-Za-z0-9._-]+\\.appspot\\.com", REG_ICASE | REG_EXTENDED, {0}, false},
-    {"FIREBASE_MEASUREMENT_ID", SEVERITY_LOW, "measurement[_-]?id[[:space:]]*[:=][[:space:]]*G-[A-Za-z0-9]+", REG_ICASE | REG_EXTENDED, {0}, false},
-
-    {"GOOGLE_ANALYTICS_ID", SEVERITY_LOW, "analytics[_-]?id[[:space:]]*[:=][[:space:]]*(UA-[0-9]{4,}-[0-9]+|G-[A-Za-z0-9]+)", REG_ICASE | REG_EXTENDED, {0}, false},
-
-    {"GITHUB_TOKEN", SEVERITY_HIGH, "gh[ousr]_[A-Za-z0-9]{36,}", REG_ICASE | REG_EXTENDED, {0}, false},
-    {"GITHUB_CLASSIC_TOKEN", SEVERITY_HIGH, "ghp_[A-Za-z0-9]{36,}", REG_ICASE | REG_EXTENDED, {0}, false},
-
-    {"GITLAB_TOKEN", SEVERITY_HIGH, "glpat-[A-Za-z0-9_-]{20,}", REG_ICASE | REG_EXTENDED, {0}, false},
-
-    {"SLACK_TOKEN", SEVERITY_HIGH, "xox[baprs]-[A-Za-z0-9-]{10,48}", REG_ICASE | REG_EXTENDED, {0}, false},
-
-    {"JWT_TOKEN", SEVERITY_MEDIUM, "eyJ[A-Za-z0-9_-]+\\.[A-Za-z0-9._-]+\\.[A-Za-z0-9._-]+", REG_ICASE | REG_EXTENDED, {0}, false},
-
-    {"WEBHOOK_URL", SEVERITY_MEDIUM, "https?://[^[:space:]]*webhook[^[:space:]]*", REG_ICASE | REG_EXTENDED, {0}, false},
-    {"STRIPE_SECRET_KEY", SEVERITY_HIGH, "sk_live_[A-Za-z0-9]{24,}", REG_ICASE | REG_EXTENDED, {0}, false},
-    {"SENDGRID_API_KEY", SEVERITY_HIGH, "SG\\.[A-Za-z0-9_-]{10,}\\.[A-Za-z0-9_-]{10,}", REG_ICASE | REG_EXTENDED, {0}, false},
-    {"TWILIO_ACCOUNT_SID", SEVERITY_MEDIUM, "AC[a-f0-9]{32}", REG_ICASE | REG_EXTENDED, {0}, false},
-    {"TWILIO_AUTH_TOKEN_KV", SEVERITY_HIGH, "twilio[_-]?auth[_-]?token[[:space:]]*[:=][[:space:]]*[A-Za-z0-9]{32}", REG_ICASE | REG_EXTENDED, {0}, false},
-    {"SMTP_PASSWORD_KV", SEVERITY_MEDIUM, "smtp[_-]?password[[:space:]]*[:=][[:space:]]*[^[:space:]]+", REG_ICASE | REG_EXTENDED, {0}, false},
-
-    {"AWS_ACCESS_KEY_ID", SEVERITY_HIGH, "AKIA[0-9A-Z]{16}", REG_ICASE | REG_EXTENDED, {0}, false},
-    {"AWS_SECRET_ACCESS_KEY_KV", SEVERITY_HIGH, "aws[_-]?secret[_-]?access[_-]?key[[:space:]]*[:=][[:space:]]*[A-Za-z0-9/+=]{40}", REG_ICASE | REG_EXTENDED, {0}, false},
-
-    {"DATABASE_URL_KV", SEVERITY_MEDIUM, "(^|[^[:alnum:]_-])(database|db)[_-]?url[[:space:]]*[:=][[:space:]]*[^[:space:]]+", REG_ICASE | REG_EXTENDED, {0}, false},
-    {"JDBC_URL", SEVERITY_MEDIUM, "jdbc:[A-Za-z0-9]+:[^[:space:]]+", REG_ICASE | REG_EXTENDED, {0}, false}
+#define DEFAULT_RULE(name, severity, pattern, flags) {name, severity, pattern, flags, {0}, false},
+#include "default_rules.def"
+#undef DEFAULT_RULE
 };
 
 static void free_rules_impl(RulesImpl *rules_impl) {
@@ -81,12 +181,35 @@ static void free_rules_impl(RulesImpl *rules_impl) {
         }
     }
 
+    if (rules_impl->cache_key_created) {
+        pthread_key_delete(rules_impl->cache_key);
+        pthread_mutex_destroy(&rules_impl->cache_mutex);
+    }
+    for (size_t i = 0; i < rules_impl->cache_count; ++i) {
+        lazy_dfa_cache_destroy(rules_impl->caches[i]);
+    }
+    free(rules_impl->caches);
+    lazy_dfa_destroy(rules_impl->native);
+    kv_tokenizer_destroy(rules_impl->key_values);
+    free(rules_impl->tokens);
+    free(rules_impl->multi_line);
+    entropy_detector_destroy(rules_impl->entropy);
+    line_cache_destroy(rules_impl->line_cache);
+    aho_corasick_destroy(rules_impl->literals);
+    aho_corasick_destroy(rules_impl->line_literals);
+    free(rules_impl->matchers);
+    free(rules_impl->profile);
     free(rules_impl->rules);
+    rules_file_free(&rules_impl->rules_file);
+    rule_bundle_close(rules_impl->bundle);
+    free(rules_impl->rules_path);
+    free(rules_impl->include);
+    free(rules_impl->exclude);
     free(rules_impl);
 }
 
 static int compile_rule(RegexRule *rule) {
-    int result = regcomp(&rule->regex, rule->pattern, rule->flags);
+    int result = regcomp(&rule->regex, rule->pattern, rule->flags & ~RULES_EXTRA_FLAGS);
     if (result != 0) {
         return -1;
     }
@@ -94,33 +217,597 @@ static int compile_rule(RegexRule *rule) {
     return 0;
 }
 
+// Add the required literals of a rule to the line filter and, for regexec
+// rules, to the per-line prefilter.
+static int add_rule_literals(RulesImpl *rules_impl, size_t index, const char *const *literals, size_t count) {
+    RuleMatcher *matcher = &rules_impl->matchers[index];
+    for (size_t i = 0; i < count; ++i) {
+        if (aho_corasick_add(rules_impl->line_literals, literals[i], index) != 0) {
+            return -1;
+        }
+        if (!matcher->native && !matcher->generated &&
+            aho_corasick_add(rules_impl->literals, literals[i], index) != 0) {
+            return -1;
+        }
+    }
+    if (count > 0) {
+        rules_impl->line_literal_rules++;
+    }
+    if (!matcher->native && !matcher->generated) {
+        matcher->has_literal = count > 0;
+        rules_impl->has_literals = rules_impl->has_literals || matcher->has_literal;
+    }
+    return 0;
+}
+
+// Record the minimum length and the required literals of a parsed rule.
+static int add_rule_prefilter(RulesImpl *rules_impl, size_t index, const PatternNode *root) {
+    rules_impl->matchers[index].min_length = pattern_min_length(root);
+
+    PatternLiteralSet literals;
+    if (pattern_required_literals(root, &literals) != 0) {
+        return -1;
+    }
+    int result = add_rule_literals(rules_impl, index, (const char *const *)literals.items, literals.count);
+    pattern_literal_set_free(&literals);
+    return result;
+}
+
+// Give rule index a token matcher if its pattern has the token shape;
+// other patterns stay with the DFA.
+static int add_token_rule(RulesImpl *rules_impl, size_t index, const PatternNode *root) {
+    TokenRule token;
+    if (!token_rule_compile(root, &token)) {
+        return 0;
+    }
+    TokenRule *resized = realloc(rules_impl->tokens, (rules_impl->token_count + 1) * sizeof(*resized));
+    if (!resized) {
+        return -1;
+    }
+    rules_impl->tokens = resized;
+    rules_impl->tokens[rules_impl->token_count] = token;
+    rules_impl->matchers[index].token = true;
+    rules_impl->matchers[index].token_index = rules_impl->token_count++;
+    return 0;
+}
+
+static int init_thread_caches(RulesImpl *rules_impl) {
+    if (pthread_mutex_init(&rules_impl->cache_mutex, NULL) != 0) {
+        return -1;
+    }
+    if (pthread_key_create(&rules_impl->cache_key, NULL) != 0) {
+        pthread_mutex_destroy(&rules_impl->cache_mutex);
+        return -1;
+    }
+    rules_impl->cache_key_created = true;
+    return 0;
+}
+
+// Parse every rule, hand the supported ones to the native engine and
+// compile the rest with regcomp behind the literal prefilter.
+static int compile_rules(RulesImpl *rules_impl, const RulesOptions *options) {
+    rules_impl->matchers = calloc(rules_impl->rule_count, sizeof(RuleMatcher));
+    rules_impl->literals = aho_corasick_create();
+    rules_impl->line_literals = aho_corasick_create();
+    rules_impl->key_values = kv_tokenizer_create();
+    PatternNode **patterns = calloc(rules_impl->rule_count, sizeof(*patterns));
+    bool *marked = calloc(rules_impl->rule_count, sizeof(*marked));
+    if (!rules_impl->matchers || !rules_impl->literals || !rules_impl->line_literals ||
+        !rules_impl->key_values || !patterns || !marked) {
+        free(patterns);
+        free(marked);
+        return -1;
+    }
+
+    int result = 0;
+    bool any_native = false;
+    for (size_t i = 0; i < rules_impl->rule_count && result == 0; ++i) {
+        RegexRule *rule = &rules_impl->rules[i];
+        RuleMatcher *matcher = &rules_impl->matchers[i];
+        // Built-in rules need no parsing or compiling with the generated engine.
+        int generated = -1;
+        if (options->engine == RULES_ENGINE_GENERATED) {
+            generated = generated_rules_lookup(rule->pattern, rule->flags & ~RULES_EXTRA_FLAGS);
+        }
+        if (generated >= 0) {
+            matcher->generated = true;
+            matcher->generated_index = (size_t)generated;
+            matcher->min_length = generated_rules_min_length(matcher->generated_index);
+            rules_impl->has_generated = true;
+            const char *const *literals = generated_rules_literals(matcher->generated_index);
+            size_t literal_count = 0;
+            while (literals && literals[literal_count]) {
+                literal_count++;
+            }
+            result = add_rule_literals(rules_impl, i, literals, literal_count);
+            continue;
+        }
+
+        PatternNode *root = pattern_parse(rule->pattern, rule->flags);
+        if (root && options->engine != RULES_ENGINE_REGEX && lazy_dfa_supports(root)) {
+            matcher->native = true;
+            any_native = true;
+            marked[i] = true;
+            if (rule->flags & RULES_FLAG_TOKEN) {
+                result = add_token_rule(rules_impl, i, root);
+            }
+            if (result == 0 && !matcher->token) {
+                // Key/value rules are marked by the tokenizer instead of the DFA.
+                matcher->key_value_index = kv_tokenizer_count(rules_impl->key_values);
+                int key_value = kv_tokenizer_add(rules_impl->key_values, root, i);
+                matcher->key_value = key_value == 1;
+                marked[i] = key_value == 0;
+                result = key_value < 0 ? -1 : 0;
+            }
+        } else {
+            result = compile_rule(rule);
+        }
+        if (result == 0 && root) {
+            result = add_rule_prefilter(rules_impl, i, root);
+        }
+        patterns[i] = root;
+        if (!matcher->native) {
+            patterns[i] = NULL;
+            pattern_free(root);
+        }
+    }
+
+    if (result == 0 && any_native) {
+        rules_impl->native = lazy_dfa_create_with_marks(patterns, rules_impl->rule_count, marked);
+        if (!rules_impl->native) {
+            result = -1;
+        }
+    }
+    for (size_t i = 0; i < rules_impl->rule_count; ++i) {
+        pattern_free(patterns[i]);
+    }
+    free(patterns);
+    free(marked);
+
+    if (result == 0 && kv_tokenizer_count(rules_impl->key_values) == 0) {
+        kv_tokenizer_destroy(rules_impl->key_values);
+        rules_impl->key_values = NULL;
+    } else if (result == 0) {
+        result = kv_tokenizer_build(rules_impl->key_values);
+    }
+
+    if (result == 0 && rules_impl->native) {
+        result = init_thread_caches(rules_impl);
+    }
+    if (result == 0) {
+        result = aho_corasick_build(rules_impl->literals);
+    }
+    if (result == 0) {
+        result = aho_corasick_build(rules_impl->line_literals);
+    }
+    return result;
+}
+
+// Built-in rules, with rules of the same name replaced by the file's and
+// the others appended (or only the file's with @replace-defaults).
+static int load_rules_file(RulesImpl *rules_impl) {
+    RulesFile *file = &rules_impl->rules_file;
+    if (rules_file_load(rules_impl->rules_path, file) != 0) {
+        return -1;
+    }
+
+    size_t default_count = file->replace_defaults ? 0 : sizeof(DEFAULT_RULES) / sizeof(DEFAULT_RULES[0]);
+    rules_impl->rules = calloc(default_count + file->count + 1, sizeof(RegexRule));
+    if (!rules_impl->rules) {
+        return -1;
+    }
+    for (size_t i = 0; i < default_count; ++i) {
+        rules_impl->rules[i] = DEFAULT_RULES[i];
+    }
+    rules_impl->rule_count = default_count;
+    for (size_t i = 0; i < file->count; ++i) {
+        const RuleDefinition *definition = &file->rules[i];
+        size_t index = rules_impl->rule_count;
+        for (size_t j = 0; j < default_count; ++j) {
+            if (strcmp(rules_impl->rules[j].name, definition->name) == 0) {
+                index = j;
+                break;
+            }
+        }
+        RegexRule *rule = &rules_impl->rules[index];
+        memset(rule, 0, sizeof(*rule));
+        rule->name = definition->name;
+        rule->severity = definition->severity;
+        rule->pattern = definition->pattern;
+        rule->flags = definition->flags;
+        if (index == rules_impl->rule_count) {
+            rules_impl->rule_count++;
+        }
+    }
+    if (rules_impl->rule_count == 0) {
+        fprintf(stderr, "ERROR: rules file %s defines no rules.\n", rules_impl->rules_path);
+        return -1;
+    }
+    return 0;
+}
+
+// True if name matches one of the comma-separated globs in list. Sets
+// used[i] for every glob i that matched.
+static bool matches_rule_list(const char *list, const char *name, bool *used) {
+    bool matched = false;
+    size_t index = 0;
+    const char *item = list;
+    while (item) {
+        const char *comma = strchr(item, ',');
+        size_t length = comma ? (size_t)(comma - item) : strlen(item);
+        char glob[256];
+        if (length > 0 && length < sizeof(glob)) {
+            memcpy(glob, item, length);
+            glob[length] = '\0';
+            if (fnmatch(glob, name, 0) == 0) {
+                used[index] = true;
+                matched = true;
+            }
+        }
+        index++;
+        item = comma ? comma + 1 : NULL;
+    }
+    return matched;
+}
+
+// Report every glob of list that matched no rule, and every empty item (a
+// stray comma), so a typo cannot silently change which rules run.
+static int check_rule_list(const char *option, const char *list, const bool *used) {
+    int result = 0;
+    size_t index = 0;
+    const char *item = list;
+    while (item) {
+        const char *comma = strchr(item, ',');
+        int length = (int)(comma ? (size_t)(comma - item) : strlen(item));
+        if (length == 0) {
+            fprintf(stderr, "ERROR: %s has an empty rule name (item %zu of \"%s\").\n", option, index + 1, list);
+            result = -1;
+        } else if (!used[index]) {
+            fprintf(stderr, "ERROR: %s %.*s matches no rule.\n", option, length, item);
+            result = -1;
+        }
+        index++;
+        item = comma ? comma + 1 : NULL;
+    }
+    return result;
+}
+
+static size_t rule_list_length(const char *list) {
+    size_t count = list ? 1 : 0;
+    for (const char *ptr = list; ptr && *ptr; ++ptr) {
+        count += *ptr == ',';
+    }
+    return count;
+}
+
+// Drop the rules the options deselect before anything is compiled, so
+// they cost nothing while scanning.
+static int select_rules(RulesImpl *rules_impl, const RulesOptions *options) {
+    rules_impl->available_count = rules_impl->rule_count;
+    const char *include = rules_impl->include;
+    const char *exclude = rules_impl->exclude;
+    if (!include && !exclude && options->min_severity == SEVERITY_LOW) {
+        return 0;
+    }
+
+    bool *include_used = calloc(rule_list_length(include) + 1, sizeof(bool));
+    bool *exclude_used = calloc(rule_list_length(exclude) + 1, sizeof(bool));
+    if (!include_used || !exclude_used) {
+        free(include_used);
+        free(exclude_used);
+        return -1;
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < rules_impl->rule_count; ++i) {
+        const RegexRule *rule = &rules_impl->rules[i];
+        bool selected = !include || matches_rule_list(include, rule->name, include_used);
+        if (exclude && matches_rule_list(exclude, rule->name, exclude_used)) {
+            selected = false;
+        }
+        if (selected && rule->severity >= options->min_severity) {
+            rules_impl->rules[kept++] = *rule;
+        }
+    }
+    rules_impl->rule_count = kept;
+
+    int result = 0;
+    if (include && check_rule_list("--rules-include", include, include_used) != 0) {
+        result = -1;
+    }
+    if (exclude && check_rule_list("--rules-exclude", exclude, exclude_used) != 0) {
+        result = -1;
+    }
+    if (result == 0 && kept == 0) {
+        fprintf(stderr, "ERROR: the rule selection leaves no rules to run.\n");
+        result = -1;
+    }
+    free(include_used);
+    free(exclude_used);
+    return result;
+}
+
+static const char *bundle_string(const char *strings, size_t size, uint32_t offset) {
+    return offset < size ? strings + offset : NULL;
+}
+
+// Restore the compiled state from a bundle. Only the regexec fallback
+// rules are compiled again; every table is used from the mapping.
+static int load_rules_bundle(RulesImpl *rules_impl) {
+    rules_impl->bundle = rule_bundle_open(rules_impl->rules_path);
+    if (!rules_impl->bundle) {
+        fprintf(stderr, "ERROR: %s is not a rules bundle of version %d.\n",
+                rules_impl->rules_path, RULE_BUNDLE_VERSION);
+        return -1;
+    }
+
+    const RuleBundle *bundle = rules_impl->bundle;
+    size_t meta_size = 0;
+    size_t records_size = 0;
+    size_t strings_size = 0;
+    const BundleMeta *meta = rule_bundle_section(bundle, BUNDLE_SECTION_META, &meta_size);
+    const BundleRule *records = rule_bundle_section(bundle, BUNDLE_SECTION_RULES, &records_size);
+    const char *strings = rule_bundle_section(bundle, BUNDLE_SECTION_STRINGS, &strings_size);
+    bool valid = meta && meta_size == sizeof(*meta) && meta->rule_count > 0 &&
+                 meta->engine <= RULES_ENGINE_GENERATED && meta->line_literal_rules <= meta->rule_count &&
+                 meta->available_count >= meta->rule_count &&
+                 records && records_size == (size_t)meta->rule_count * sizeof(*records) &&
+                 strings && strings_size > 0 && strings[strings_size - 1] == '\0';
+    if (valid) {
+        rules_impl->rule_count = meta->rule_count;
+        rules_impl->rules = calloc(rules_impl->rule_count, sizeof(RegexRule));
+        rules_impl->matchers = calloc(rules_impl->rule_count, sizeof(RuleMatcher));
+        if (!rules_impl->rules || !rules_impl->matchers) {
+            return -1;
+        }
+        rules_impl->options.engine = (rules_engine_t)meta->engine;
+        rules_impl->available_count = meta->available_count;
+        rules_impl->line_literal_rules = meta->line_literal_rules;
+        rules_impl->has_literals = meta->has_literals != 0;
+    }
+
+    bool any_native = false;
+    for (size_t i = 0; valid && i < rules_impl->rule_count; ++i) {
+        const BundleRule *record = &records[i];
+        RegexRule *rule = &rules_impl->rules[i];
+        RuleMatcher *matcher = &rules_impl->matchers[i];
+        rule->name = bundle_string(strings, strings_size, record->name);
+        rule->pattern = bundle_string(strings, strings_size, record->pattern);
+        rule->severity = (severity_t)record->severity;
+        rule->flags = (int)record->flags;
+        matcher->min_length = record->min_length;
+        matcher->has_literal = record->has_literal != 0;
+        valid = rule->name && rule->pattern && record->severity <= SEVERITY_HIGH;
+        if (!valid) {
+            break;
+        }
+        if (record->kind == BUNDLE_RULE_NATIVE) {
+            matcher->native = true;
+            any_native = true;
+        } else if (record->kind == BUNDLE_RULE_GENERATED) {
+            int generated = generated_rules_lookup(rule->pattern, rule->flags & ~RULES_EXTRA_FLAGS);
+            if (generated < 0) {
+                fprintf(stderr, "ERROR: rules bundle %s needs a generated matcher for %s "
+                                "that this build does not have.\n", rules_impl->rules_path, rule->name);
+                return -1;
+            }
+            matcher->generated = true;
+            matcher->generated_index = (size_t)generated;
+            rules_impl->has_generated = true;
+        } else if (record->kind != BUNDLE_RULE_REGEX || compile_rule(rule) != 0) {
+            valid = false;
+        }
+    }
+
+    if (valid) {
+        size_t size = 0;
+        const void *image = rule_bundle_section(bundle, BUNDLE_SECTION_LITERALS, &size);
+        rules_impl->literals = aho_corasick_load(image, size, rules_impl->rule_count);
+        image = rule_bundle_section(bundle, BUNDLE_SECTION_LINE_LITERALS, &size);
+        rules_impl->line_literals = aho_corasick_load(image, size, rules_impl->rule_count);
+        valid = rules_impl->literals && rules_impl->line_literals;
+    }
+    if (valid && any_native) {
+        size_t size = 0;
+        const void *image = rule_bundle_section(bundle, BUNDLE_SECTION_NATIVE, &size);
+        rules_impl->native = lazy_dfa_load(image, size, rules_impl->rule_count);
+        valid = rules_impl->native && init_thread_caches(rules_impl) == 0;
+    }
+    size_t key_values_size = 0;
+    const void *key_values = rule_bundle_section(bundle, BUNDLE_SECTION_KEY_VALUES, &key_values_size);
+    if (valid && key_values) {
+        rules_impl->key_values = kv_tokenizer_load(key_values, key_values_size, rules_impl->rule_count);
+        valid = rules_impl->key_values != NULL;
+        for (size_t i = 0; valid && i < kv_tokenizer_count(rules_impl->key_values); ++i) {
+            RuleMatcher *matcher = &rules_impl->matchers[kv_tokenizer_id(rules_impl->key_values, i)];
+            valid = matcher->native && !matcher->key_value;
+            matcher->key_value = true;
+            matcher->key_value_index = i;
+        }
+    }
+    size_t tokens_size = 0;
+    const BundleToken *tokens = rule_bundle_section(bundle, BUNDLE_SECTION_TOKENS, &tokens_size);
+    if (valid && tokens) {
+        valid = tokens_size > 0 && tokens_size % sizeof(*tokens) == 0;
+        rules_impl->token_count = tokens_size / sizeof(*tokens);
+        rules_impl->tokens = calloc(rules_impl->token_count, sizeof(TokenRule));
+        if (valid && !rules_impl->tokens) {
+            return -1;
+        }
+        for (size_t i = 0; valid && i < rules_impl->token_count; ++i) {
+            valid = tokens[i].rule < rules_impl->rule_count && token_rule_check(&tokens[i].token);
+            RuleMatcher *matcher = valid ? &rules_impl->matchers[tokens[i].rule] : NULL;
+            valid = valid && matcher->native && !matcher->key_value && !matcher->token;
+            if (valid) {
+                rules_impl->tokens[i] = tokens[i].token;
+                matcher->token = true;
+                matcher->token_index = i;
+            }
+        }
+    }
+    if (!valid) {
+        fprintf(stderr, "ERROR: rules bundle %s is damaged.\n", rules_impl->rules_path);
+        return -1;
+    }
+    return 0;
+}
+
+static block_rule_kind_t block_kind(int flags) {
+    if (flags & RULES_FLAG_PEM_BLOCK) {
+        return BLOCK_RULE_PEM;
+    }
+    if (flags & RULES_FLAG_JSON_BLOCK) {
+        return BLOCK_RULE_JSON;
+    }
+    if (flags & RULES_FLAG_YAML_BLOCK) {
+        return BLOCK_RULE_YAML;
+    }
+    return BLOCK_RULE_NONE;
+}
+
+static int collect_multi_line_rules(RulesImpl *rules_impl) {
+    for (size_t i = 0; i < rules_impl->rule_count; ++i) {
+        if (!(rules_impl->rules[i].flags & RULES_BLOCK_FLAGS)) {
+            continue;
+        }
+        MultiLineRule *resized =
+            realloc(rules_impl->multi_line, (rules_impl->multi_line_count + 1) * sizeof(*resized));
+        if (!resized) {
+            return -1;
+        }
+        rules_impl->multi_line = resized;
+        resized[rules_impl->multi_line_count].name = rules_impl->rules[i].name;
+        resized[rules_impl->multi_line_count].kind = block_kind(rules_impl->rules[i].flags);
+        rules_impl->multi_line_count++;
+    }
+    return 0;
+}
+
+void rules_default_options(RulesOptions *options) {
+    if (!options) {
+        return;
+    }
+    options->engine = RULES_ENGINE_NATIVE;
+    options->profile = false;
+    options->rules_path = NULL;
+    options->include = NULL;
+    options->exclude = NULL;
+    options->min_severity = SEVERITY_LOW;
+    options->entropy_threshold = 0.0;
+    options->entropy_min_length = ENTROPY_DEFAULT_MIN_LENGTH;
+    options->line_cache_bytes = 0;
+    options->max_line_length = 0;
+    options->long_lines = RULES_LONG_LINE_TRUNCATE;
+}
+
 int rules_init(RulesEngine *engine) {
+    RulesOptions options;
+    rules_default_options(&options);
+    return rules_init_with_options(engine, &options);
+}
+
+int rules_init_with_options(RulesEngine *engine, const RulesOptions *options) {
     memset(engine, 0, sizeof(*engine));
 
+    RulesOptions defaults;
+    if (!options) {
+        rules_default_options(&defaults);
+        options = &defaults;
+    }
+
     RulesImpl *rules_impl = calloc(1, sizeof(RulesImpl));
     if (!rules_impl) {
         return -1;
     }
+    rules_impl->options = *options;
 
-    rules_impl->rule_count = sizeof(DEFAULT_RULES) / sizeof(DEFAULT_RULES[0]);
-    rules_impl->rules = calloc(rules_impl->rule_count, sizeof(RegexRule));
-    if (!rules_impl->rules) {
-        free(rules_impl);
+    int result = 0;
+    // Keep private copies so clones do not depend on the caller's strings.
+    if (options->include) {
+        rules_impl->include = duplicate_string(options->include);
+        rules_impl->options.include = rules_impl->include;
+        result = rules_impl->include ? 0 : -1;
+    }
+    if (result == 0 && options->exclude) {
+        rules_impl->exclude = duplicate_string(options->exclude);
+        rules_impl->options.exclude = rules_impl->exclude;
+        result = rules_impl->exclude ? 0 : -1;
+    }
+    if (result == 0 && options->rules_path) {
+        rules_impl->rules_path = duplicate_string(options->rules_path);
+        rules_impl->options.rules_path = rules_impl->rules_path;
+        result = rules_impl->rules_path ? 0 : -1;
+    }
+
+    bool selection = options->include || options->exclude || options->min_severity != SEVERITY_LOW;
+    if (result != 0) {
+        // Out of memory.
+    } else if (rules_impl->rules_path && rule_bundle_probe(rules_impl->rules_path) == 1) {
+        if (selection) {
+            fprintf(stderr, "ERROR: rule selection cannot be applied to the compiled bundle %s; "
+                            "pass it to compile-rules instead.\n", rules_impl->rules_path);
+            result = -1;
+        } else {
+            result = load_rules_bundle(rules_impl);
+        }
+    } else {
+        if (rules_impl->rules_path) {
+            result = load_rules_file(rules_impl);
+        } else {
+            rules_impl->rule_count = sizeof(DEFAULT_RULES) / sizeof(DEFAULT_RULES[0]);
+            rules_impl->rules = calloc(rules_impl->rule_count, sizeof(RegexRule));
+            if (!rules_impl->rules) {
+                result = -1;
+            }
+            for (size_t i = 0; i < rules_impl->rule_count && result == 0; ++i) {
+                rules_impl->rules[i] = DEFAULT_RULES[i];
+            }
+        }
+        if (result == 0) {
+            result = select_rules(rules_impl, options);
+        }
+        if (result == 0) {
+            result = compile_rules(rules_impl, options);
+        }
+    }
+    if (result == 0) {
+        result = collect_multi_line_rules(rules_impl);
+    }
+    if (result == 0 && options->entropy_threshold > 0.0 && options->min_severity <= ENTROPY_SEVERITY) {
+        rules_impl->entropy = entropy_detector_create(options->entropy_threshold, options->entropy_min_length);
+        result = rules_impl->entropy ? 0 : -1;
+    }
+    if (result == 0 && options->line_cache_bytes > 0) {
+        rules_impl->line_cache = line_cache_create(options->line_cache_bytes);
+        result = rules_impl->line_cache ? 0 : -1;
+    }
+    if (result != 0) {
+        free_rules_impl(rules_impl);
         return -1;
     }
 
-    for (size_t i = 0; i < rules_impl->rule_count; ++i) {
-        rules_impl->rules[i] = DEFAULT_RULES[i];
-        if (compile_rule(&rules_impl->rules[i]) != 0) {
+    if (options->profile) {
+        rules_impl->profile = calloc(rules_impl->rule_count, sizeof(RuleProfile));
+        if (!rules_impl->profile) {
             free_rules_impl(rules_impl);
             return -1;
         }
+        for (size_t i = 0; i < rules_impl->rule_count; ++i) {
+            rules_impl->profile[i].rule_name = rules_impl->rules[i].name;
+        }
     }
 
     engine->implementation = rules_impl;
     return 0;
 }
 
+int rules_clone(const RulesEngine *source, RulesEngine *clone) {
+    if (!source || !source->implementation || !clone) {
+        return -1;
+    }
+    const RulesImpl *rules_impl = (const RulesImpl *)source->implementation;
+    return rules_init_with_options(clone, &rules_impl->options);
+}
+
 void rules_destroy(RulesEngine *engine) {
     if (!engine || !engine->implementation) {
         return;
@@ -130,38 +817,1158 @@ void rules_destroy(RulesEngine *engine) {
     engine->implementation = NULL;
 }
 
-void rules_scan_line(const RulesEngine *engine,
-                     const char *line,
-                     size_t length,
-                     rules_match_callback callback,
-                     void *user_data) {
-    if (!engine || !engine->implementation || !line || !callback) {
-        return;
+// DFA states are cached per thread so the hot path never takes a lock.
+static LazyDfaCache *thread_cache(RulesImpl *rules_impl) {
+    LazyDfaCache *cache = pthread_getspecific(rules_impl->cache_key);
+    if (cache) {
+        return cache;
+    }
+
+    cache = lazy_dfa_cache_create(rules_impl->native);
+    if (!cache) {
+        return NULL;
+    }
+    pthread_mutex_lock(&rules_impl->cache_mutex);
+    LazyDfaCache **resized = realloc(rules_impl->caches, (rules_impl->cache_count + 1) * sizeof(*resized));
+    if (resized) {
+        rules_impl->caches = resized;
+        rules_impl->caches[rules_impl->cache_count++] = cache;
+    }
+    pthread_mutex_unlock(&rules_impl->cache_mutex);
+    if (!resized || pthread_setspecific(rules_impl->cache_key, cache) != 0) {
+        if (!resized) {
+            lazy_dfa_cache_destroy(cache);
+        }
+        return NULL;
+    }
+    return cache;
+}
+
+static uint64_t profile_clock(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+// Count one matcher call; matches are counted where they are reported.
+static void profile_call(RuleProfile *profile, uint64_t started, size_t bytes) {
+    profile->calls++;
+    profile->bytes += bytes;
+    profile->nanoseconds += profile_clock() - started;
+}
+
+// regexec stops at the first NUL, so each search only sees the text up to
+// the next NUL after offset. REG_STARTEND bounds it for lines that are not
+// NUL-terminated, such as lines inside a buffer. The NUL is looked for once
+// per segment, not once per match, which would be quadratic on a long line
+// with many matches.
+static void scan_regex_rule(const RegexRule *rule,
+                            RuleProfile *profile,
+                            const char *line,
+                            size_t length,
+                            size_t base,
+                            rules_match_callback callback,
+                            void *user_data) {
+    size_t offset = 0;
+    size_t segment_end = strnlen(line, length);
+
+    // Scan the same line for multiple matches.
+    while (offset <= length) {
+        if (offset > segment_end) {
+            segment_end = offset + strnlen(line + offset, length - offset);
+        }
+        regmatch_t match;
+        size_t segment = segment_end - offset;
+        match.rm_so = 0;
+        match.rm_eo = (regoff_t)segment;
+        uint64_t started = profile ? profile_clock() : 0;
+        int result = regexec(&rule->regex, line + offset, 1, &match, REG_STARTEND);
+        if (profile) {
+            profile_call(profile, started, segment);
+        }
+        if (result != 0) {
+            break;
+        }
+
+        size_t start = offset + (size_t)match.rm_so;
+        size_t end = offset + (size_t)match.rm_eo;
+        if (end <= start) {
+            // Avoid getting stuck on empty matches.
+            offset++;
+            continue;
+        }
+
+        if (profile) {
+            profile->matches++;
+        }
+        callback(rule->name, rule->severity, base + start, base + end, user_data);
+        offset = end;
+    }
+}
+
+static bool find_compiled(const RulesImpl *rules_impl,
+                          LazyDfaCache *cache,
+                          const RuleMatcher *matcher,
+                          size_t index,
+                          const char *text,
+                          size_t length,
+                          size_t *start,
+                          size_t *end) {
+    if (matcher->generated) {
+        return generated_rules_find(matcher->generated_index, text, length, start, end);
+    }
+    if (matcher->token) {
+        return token_rule_find(&rules_impl->tokens[matcher->token_index], text, length, start, end);
+    }
+    if (!matcher->key_value) {
+        return lazy_dfa_find(cache, index, text, length, start, end);
+    }
+    // Every match starts at a candidate, so the first candidate the DFA
+    // confirms is the leftmost match.
+    size_t from = 0;
+    while (kv_tokenizer_next(rules_impl->key_values, matcher->key_value_index, text, length, from, start)) {
+        if (lazy_dfa_match_at(cache, index, text, length, *start, end)) {
+            return true;
+        }
+        from = *start + 1;
+    }
+    return false;
+}
+
+// Same loop as scan_regex_rule for native and generated rules.
+static void scan_compiled_rule(const RulesImpl *rules_impl,
+                               LazyDfaCache *cache,
+                               const RuleMatcher *matcher,
+                               size_t index,
+                               const RegexRule *rule,
+                               RuleProfile *profile,
+                               const char *line,
+                               size_t length,
+                               size_t base,
+                               rules_match_callback callback,
+                               void *user_data) {
+    size_t offset = 0;
+    size_t segment_end = strnlen(line, length);
+
+    while (offset <= length) {
+        if (offset > segment_end) {
+            segment_end = offset + strnlen(line + offset, length - offset);
+        }
+        size_t start = 0;
+        size_t end = 0;
+        uint64_t started = profile ? profile_clock() : 0;
+        bool found = find_compiled(rules_impl, cache, matcher, index, line + offset, segment_end - offset, &start, &end);
+        if (profile) {
+            profile_call(profile, started, segment_end - offset);
+        }
+        if (!found) {
+            break;
+        }
+
+        start += offset;
+        end += offset;
+        if (end <= start) {
+            offset++;
+            continue;
+        }
+
+        if (profile) {
+            profile->matches++;
+        }
+        callback(rule->name, rule->severity, base + start, base + end, user_data);
+        offset = end;
+    }
+}
+
+// Scan one line; reported offsets are shifted by base. Rules with
+// RULES_FLAG_JSON only run if json is set.
+static void scan_line(RulesImpl *rules_impl,
+                      LazyDfaCache *cache,
+                      bool json,
+                      const char *line,
+                      size_t length,
+                      size_t base,
+                      rules_match_callback callback,
+                      void *user_data) {
+    // One pass picks the rules that can possibly match this line: the
+    // native DFA reports its rules directly, the key/value tokenizer its
+    // key/value rules and the literal prefilter the regexec rules.
+    // Generated rules keep their marks after the others.
+    size_t generated_count = rules_impl->has_generated ? generated_rules_count() : 0;
+    size_t mark_count = rules_impl->rule_count + generated_count;
+    unsigned char stack_marks[RULES_STACK_MARKS];
+    unsigned char *marks = stack_marks;
+    if (mark_count > RULES_STACK_MARKS) {
+        marks = malloc(mark_count);
+    }
+    bool native_marked = false;
+    unsigned char *generated_marks = NULL;
+    if (marks) {
+        memset(marks, 0, mark_count);
+        size_t text_length = strnlen(line, length);
+        if (rules_impl->has_literals) {
+            aho_corasick_mark(rules_impl->literals, line, length, marks);
+        }
+        if (cache) {
+            native_marked = lazy_dfa_mark(cache, line, text_length, marks) == 0;
+        }
+        if (rules_impl->key_values) {
+            kv_tokenizer_mark(rules_impl->key_values, line, text_length, marks);
+        }
+        if (generated_count > 0) {
+            generated_marks = marks + rules_impl->rule_count;
+            generated_rules_mark(line, text_length, generated_marks);
+        }
     }
 
-    const RulesImpl *rules_impl = (const RulesImpl *)engine->implementation;
     for (size_t i = 0; i < rules_impl->rule_count; ++i) {
         const RegexRule *rule = &rules_impl->rules[i];
-        size_t offset = 0;
-
-        // Scan the same line for multiple matches.
-        while (offset <= length) {
-            regmatch_t match;
-            int result = regexec(&rule->regex, line + offset, 1, &match, 0);
-            if (result != 0) {
-                break;
+        const RuleMatcher *matcher = &rules_impl->matchers[i];
+        RuleProfile *profile = rules_impl->profile ? &rules_impl->profile[i] : NULL;
+        if (length < matcher->min_length || (!json && (rule->flags & RULES_FLAG_JSON))) {
+            continue;
+        }
+        if (matcher->generated) {
+            if (generated_marks && !generated_marks[matcher->generated_index]) {
+                continue;
             }
-
-            size_t start = offset + (size_t)match.rm_so;
-            size_t end = offset + (size_t)match.rm_eo;
-            if (end <= start) {
-                // Avoid getting stuck on empty matches.
-                offset++;
+            scan_compiled_rule(rules_impl, cache, matcher, i, rule, profile, line, length, base, callback, user_data);
+            continue;
+        }
+        if (matcher->native) {
+            if (native_marked && !marks[i]) {
                 continue;
             }
-
-            callback(rule->name, rule->severity, start, end, user_data);
-            offset = end;
+            scan_compiled_rule(rules_impl, cache, matcher, i, rule, profile, line, length, base, callback, user_data);
+            continue;
         }
+        if (marks && matcher->has_literal && !marks[i]) {
+            continue;
+        }
+        scan_regex_rule(rule, profile, line, length, base, callback, user_data);
+    }
+
+    if (marks != stack_marks) {
+        free(marks);
+    }
+}
+
+// Forwards the matches of a line while recording them for the line cache.
+typedef struct {
+    const RulesImpl *rules_impl;
+    rules_match_callback callback;
+    void *user_data;
+    size_t base;
+    LineCacheMatch *matches;
+    size_t count;
+    size_t capacity;
+    bool heap;
+    bool failed;
+} LineRecorder;
+
+static void record_match(const char *rule_name,
+                         severity_t severity,
+                         size_t start,
+                         size_t end,
+                         void *user_data) {
+    LineRecorder *recorder = (LineRecorder *)user_data;
+    recorder->callback(rule_name, severity, start, end, recorder->user_data);
+    if (recorder->failed) {
+        return;
+    }
+    if (recorder->count == recorder->capacity) {
+        size_t capacity = recorder->capacity * 2;
+        LineCacheMatch *grown = recorder->heap ? realloc(recorder->matches, capacity * sizeof(*grown))
+                                               : malloc(capacity * sizeof(*grown));
+        if (!grown) {
+            recorder->failed = true;
+            return;
+        }
+        if (!recorder->heap) {
+            memcpy(grown, recorder->matches, recorder->count * sizeof(*grown));
+        }
+        recorder->matches = grown;
+        recorder->capacity = capacity;
+        recorder->heap = true;
+    }
+    // Matches carry the rule's own name pointer.
+    size_t rule = 0;
+    while (rule < recorder->rules_impl->rule_count && recorder->rules_impl->rules[rule].name != rule_name) {
+        rule++;
+    }
+    if (rule == recorder->rules_impl->rule_count) {
+        recorder->failed = true;
+        return;
+    }
+    LineCacheMatch *match = &recorder->matches[recorder->count++];
+    match->rule = (uint32_t)rule;
+    match->start = (uint32_t)(start - recorder->base);
+    match->end = (uint32_t)(end - recorder->base);
+}
+
+// scan_line behind the line cache: a line seen before replays its matches.
+static void scan_line_cached(RulesImpl *rules_impl,
+                             LazyDfaCache *cache,
+                             bool json,
+                             const char *line,
+                             size_t length,
+                             size_t base,
+                             rules_match_callback callback,
+                             void *user_data) {
+    if (!rules_impl->line_cache || length > UINT32_MAX || !line_cache_active(rules_impl->line_cache)) {
+        scan_line(rules_impl, cache, json, line, length, base, callback, user_data);
+        return;
+    }
+    uint32_t tag = json ? 1 : 0;
+    uint64_t hash = line_cache_hash(tag, line, length);
+    const LineCacheMatch *matches = NULL;
+    size_t count = 0;
+    if (line_cache_lookup(rules_impl->line_cache, hash, tag, line, length, &matches, &count)) {
+        for (size_t i = 0; i < count; ++i) {
+            const RegexRule *rule = &rules_impl->rules[matches[i].rule];
+            callback(rule->name, rule->severity, base + matches[i].start, base + matches[i].end, user_data);
+        }
+        return;
+    }
+
+    LineCacheMatch stack_matches[16];
+    LineRecorder recorder = {rules_impl, callback, user_data, base, stack_matches, 0, 16, false, false};
+    scan_line(rules_impl, cache, json, line, length, base, record_match, &recorder);
+    if (!recorder.failed) {
+        line_cache_store(rules_impl->line_cache, hash, tag, line, length, recorder.matches, recorder.count);
+    }
+    if (recorder.heap) {
+        free(recorder.matches);
+    }
+}
+
+// Matches of a window that start before the next window does.
+typedef struct {
+    rules_match_callback callback;
+    void *user_data;
+    size_t limit;
+} WindowFilter;
+
+static void window_match(const char *rule_name, severity_t severity, size_t start, size_t end, void *user_data) {
+    const WindowFilter *filter = (const WindowFilter *)user_data;
+    if (start < filter->limit) {
+        filter->callback(rule_name, severity, start, end, filter->user_data);
+    }
+}
+
+// scan_line_cached for a line over options.max_line_length, as
+// options.long_lines says. Returns false if the line is skipped.
+static bool scan_long_line(RulesImpl *rules_impl,
+                           LazyDfaCache *cache,
+                           bool json,
+                           const char *line,
+                           size_t length,
+                           size_t base,
+                           rules_match_callback callback,
+                           void *user_data) {
+    size_t window = rules_impl->options.max_line_length;
+    rules_impl->long_lines++;
+    switch (rules_impl->options.long_lines) {
+    case RULES_LONG_LINE_SKIP:
+        return false;
+    case RULES_LONG_LINE_WINDOW: {
+        // Consecutive windows overlap by a quarter of a window.
+        size_t step = window - window / 4;
+        size_t offset = 0;
+        while (length - offset > window) {
+            WindowFilter filter = {callback, user_data, base + offset + step};
+            scan_line_cached(rules_impl, cache, json, line + offset, window, base + offset, window_match, &filter);
+            offset += step;
+        }
+        scan_line_cached(rules_impl, cache, json, line + offset, length - offset, base + offset, callback, user_data);
+        return true;
+    }
+    case RULES_LONG_LINE_TRUNCATE:
+    default:
+        scan_line_cached(rules_impl, cache, json, line, window, base, callback, user_data);
+        return true;
+    }
+}
+
+// scan_line_cached with the long line guard. Returns false if the line is
+// skipped.
+static bool scan_line_guarded(RulesImpl *rules_impl,
+                              LazyDfaCache *cache,
+                              bool json,
+                              const char *line,
+                              size_t length,
+                              size_t base,
+                              rules_match_callback callback,
+                              void *user_data) {
+    size_t limit = rules_impl->options.max_line_length;
+    if (limit > 0 && length > limit) {
+        return scan_long_line(rules_impl, cache, json, line, length, base, callback, user_data);
+    }
+    scan_line_cached(rules_impl, cache, json, line, length, base, callback, user_data);
+    return true;
+}
+
+// Next high-entropy run of a line or buffer. It is found ahead of the
+// rules, so the detector makes a single pass however many lines there are.
+// line_start and line_end bound the line of the last run found; next_line
+// is where the lines not looked at yet begin.
+typedef struct {
+    bool found;
+    size_t start;
+    size_t end;
+    size_t line_start;
+    size_t line_end;
+    size_t next_line;
+} EntropyCursor;
+
+// Find the first run at or after from into cursor. Long lines get the
+// policy of the rules: with RULES_LONG_LINE_TRUNCATE only runs within the
+// first max_line_length bytes count, with RULES_LONG_LINE_SKIP none do.
+// Windows cover the whole line, so RULES_LONG_LINE_WINDOW sees every run.
+static void entropy_cursor_find(const RulesImpl *rules_impl,
+                                const char *text,
+                                size_t length,
+                                EntropyCursor *cursor,
+                                size_t from) {
+    size_t limit = rules_impl->options.max_line_length;
+    bool guarded = limit > 0 && rules_impl->options.long_lines != RULES_LONG_LINE_WINDOW;
+    for (;;) {
+        cursor->found = entropy_detector_next(rules_impl->entropy, text, length, from, &cursor->start, &cursor->end);
+        if (!cursor->found || !guarded) {
+            return;
+        }
+        // Runs never span a newline, so the run is within one line.
+        if (cursor->start >= cursor->next_line) {
+            const char *previous =
+                byte_class_find_last(text + cursor->next_line, cursor->start - cursor->next_line, '\n');
+            cursor->line_start = previous ? (size_t)(previous - text) + 1 : cursor->next_line;
+            const char *newline = memchr(text + cursor->start, '\n', length - cursor->start);
+            cursor->line_end = newline ? (size_t)(newline - text) : length;
+            cursor->next_line = cursor->line_end + 1;
+        }
+        size_t line_length = cursor->line_end - cursor->line_start;
+        if (cursor->line_end < length && line_length > 0 && text[cursor->line_end - 1] == '\r') {
+            line_length--;
+        }
+        if (line_length <= limit) {
+            return;
+        }
+        if (rules_impl->options.long_lines == RULES_LONG_LINE_TRUNCATE) {
+            // The run may be cut at the limit, so look again in the part of
+            // the line that is scanned.
+            size_t scanned_end = cursor->line_start + limit;
+            if (cursor->start < scanned_end &&
+                entropy_detector_next(rules_impl->entropy, text, scanned_end, cursor->start, &cursor->start,
+                                      &cursor->end)) {
+                return;
+            }
+        }
+        from = cursor->line_end;
+    }
+}
+
+static void entropy_cursor_init(const RulesImpl *rules_impl, const char *text, size_t length, EntropyCursor *cursor) {
+    cursor->found = false;
+    cursor->line_start = 0;
+    cursor->line_end = 0;
+    cursor->next_line = 0;
+    if (rules_impl->entropy) {
+        entropy_cursor_find(rules_impl, text, length, cursor, 0);
+    }
+}
+
+// Report the runs that start before limit. Runs never span a newline, so
+// reporting up to each line keeps matches in line order.
+static void report_entropy(const RulesImpl *rules_impl,
+                           const char *text,
+                           size_t length,
+                           EntropyCursor *cursor,
+                           size_t limit,
+                           rules_match_callback callback,
+                           void *user_data) {
+    while (cursor->found && cursor->start < limit) {
+        callback(ENTROPY_RULE_NAME, ENTROPY_SEVERITY, cursor->start, cursor->end, user_data);
+        entropy_cursor_find(rules_impl, text, length, cursor, cursor->end);
+    }
+}
+
+void rules_scan_line(const RulesEngine *engine,
+                     const char *line,
+                     size_t length,
+                     rules_match_callback callback,
+                     void *user_data) {
+    if (!engine || !engine->implementation || !line || !callback) {
+        return;
+    }
+
+    RulesImpl *rules_impl = (RulesImpl *)engine->implementation;
+
+    LazyDfaCache *cache = NULL;
+    if (rules_impl->native) {
+        cache = thread_cache(rules_impl);
+        if (!cache) {
+            return;
+        }
+    }
+    scan_line_guarded(rules_impl, cache, true, line, length, 0, callback, user_data);
+    EntropyCursor entropy;
+    entropy_cursor_init(rules_impl, line, length, &entropy);
+    report_entropy(rules_impl, line, length, &entropy, length, callback, user_data);
+}
+
+void rules_scan_buffer(const RulesEngine *engine,
+                       const char *buffer,
+                       size_t length,
+                       rules_match_callback callback,
+                       void *user_data) {
+    rules_scan_file_buffer(engine, FILE_TYPE_UNKNOWN, buffer, length, callback, user_data);
+}
+
+// rules_scan_file_buffer. With stop_at_skipped, scanning ends at a line
+// skipped by RULES_LONG_LINE_SKIP. Returns the offset of that line, or
+// length.
+static size_t scan_file_buffer(RulesImpl *rules_impl,
+                               file_type_t type,
+                               const char *buffer,
+                               size_t length,
+                               bool stop_at_skipped,
+                               rules_match_callback callback,
+                               void *user_data) {
+    LazyDfaCache *cache = NULL;
+    if (rules_impl->native) {
+        cache = thread_cache(rules_impl);
+        if (!cache) {
+            return length;
+        }
+    }
+
+    // No required literal spans a newline, so one literal pass over the
+    // buffer finds every line a rule can match; the others are skipped
+    // without calling into the per-line matchers. Entropy runs on skipped
+    // lines are reported before the next scanned line, so matches keep
+    // the order of rules_scan_line.
+    bool filter_lines = rules_impl->line_literal_rules == rules_impl->rule_count;
+    bool json = type != FILE_TYPE_TEXT;
+    EntropyCursor entropy;
+    entropy_cursor_init(rules_impl, buffer, length, &entropy);
+    size_t offset = 0;
+    while (offset < length) {
+        size_t line_start = offset;
+        if (filter_lines) {
+            size_t hit = 0;
+            if (!aho_corasick_find(rules_impl->line_literals, buffer + offset, length - offset, &hit)) {
+                break;
+            }
+            const char *previous = byte_class_find_last(buffer + offset, hit, '\n');
+            line_start = previous ? (size_t)(previous - buffer) + 1 : offset;
+        }
+
+        const char *newline = memchr(buffer + line_start, '\n', length - line_start);
+        size_t line_end = newline ? (size_t)(newline - buffer) : length;
+        size_t line_length = line_end - line_start;
+        if (newline && line_length > 0 && buffer[line_end - 1] == '\r') {
+            line_length--;
+        }
+        report_entropy(rules_impl, buffer, length, &entropy, line_start, callback, user_data);
+        if (!scan_line_guarded(rules_impl, cache, json, buffer + line_start, line_length, line_start, callback,
+                               user_data) &&
+            stop_at_skipped) {
+            return line_start;
+        }
+        report_entropy(rules_impl, buffer, length, &entropy, line_end, callback, user_data);
+        offset = line_end + 1;
+    }
+    report_entropy(rules_impl, buffer, length, &entropy, length, callback, user_data);
+    return length;
+}
+
+void rules_scan_file_buffer(const RulesEngine *engine,
+                            file_type_t type,
+                            const char *buffer,
+                            size_t length,
+                            rules_match_callback callback,
+                            void *user_data) {
+    if (!engine || !engine->implementation || !buffer || !callback) {
+        return;
+    }
+    scan_file_buffer((RulesImpl *)engine->implementation, type, buffer, length, false, callback, user_data);
+}
+
+// One rules_scan_stream call: the buffer, how far its lines are counted
+// and where the matches go.
+typedef struct {
+    const RulesImpl *rules_impl;
+    RulesStream *stream;
+    const char *buffer;
+    size_t length;
+    size_t counted_offset;
+    size_t counted_line;
+    rules_match_callback callback;
+    rules_span_callback span_callback;
+    void *user_data;
+} StreamScan;
+
+// Report a block that closed or was given up.
+static void emit_block(const StreamScan *scan, RulesStreamBlock *block, block_rule_status_t status) {
+    if (status == BLOCK_RULE_CLOSED) {
+        block->span.end_line = block->span.start_line + block->block.end_lines;
+        block->span.end_column = block->block.end_column;
+    }
+    scan->span_callback(block->rule_name, block->severity, &block->span, scan->user_data);
+}
+
+// Report block index of the stream and drop it.
+static void report_block(StreamScan *scan, size_t index, block_rule_status_t status) {
+    RulesStream *stream = scan->stream;
+    RulesStreamBlock *block = &stream->blocks[index];
+    emit_block(scan, block, status);
+    memmove(block, block + 1, (stream->count - index - 1) * sizeof(*block));
+    stream->count--;
+}
+
+// Feed the open blocks the lines before offset target.
+static void advance_blocks(StreamScan *scan, size_t target) {
+    RulesStream *stream = scan->stream;
+    for (size_t i = 0; i < stream->count;) {
+        RulesStreamBlock *block = &stream->blocks[i];
+        block_rule_status_t status = BLOCK_RULE_OPEN;
+        while (status == BLOCK_RULE_OPEN && block->next < target) {
+            const char *line = scan->buffer + block->next;
+            const char *newline = memchr(line, '\n', scan->length - block->next);
+            size_t line_length = newline ? (size_t)(newline - line) : scan->length - block->next;
+            block->next += newline ? line_length + 1 : line_length;
+            if (line_length > 0 && line[line_length - 1] == '\r') {
+                line_length--;
+            }
+            status = block_rule_next_line(&block->block, line, line_length);
+        }
+        if (status == BLOCK_RULE_OPEN) {
+            i++;
+        } else {
+            report_block(scan, i, status);
+        }
+    }
+}
+
+static block_rule_kind_t multi_line_kind(const RulesImpl *rules_impl, const char *rule_name) {
+    for (size_t i = 0; i < rules_impl->multi_line_count; ++i) {
+        if (rules_impl->multi_line[i].name == rule_name) {
+            return rules_impl->multi_line[i].kind;
+        }
+    }
+    return BLOCK_RULE_NONE;
+}
+
+// Match callback of rules_scan_stream: multi-line matches open blocks, the
+// others are passed on.
+static void stream_match(const char *rule_name, severity_t severity, size_t start, size_t end, void *user_data) {
+    StreamScan *scan = (StreamScan *)user_data;
+    block_rule_kind_t kind = multi_line_kind(scan->rules_impl, rule_name);
+    if (kind == BLOCK_RULE_NONE) {
+        scan->callback(rule_name, severity, start, end, scan->user_data);
+        return;
+    }
+
+    // Lines arrive in order, so the line start is searched for and lines
+    // are counted from the last counted line on, not from the buffer start.
+    const char *buffer = scan->buffer;
+    size_t from = start >= scan->counted_offset ? scan->counted_offset : 0;
+    const char *previous = byte_class_find_last(buffer + from, start - from, '\n');
+    size_t line_start = previous ? (size_t)(previous - buffer) + 1 : from;
+    if (line_start > scan->counted_offset) {
+        scan->counted_line +=
+            byte_class_count(buffer + scan->counted_offset, line_start - scan->counted_offset, '\n');
+        scan->counted_offset = line_start;
+    }
+    advance_blocks(scan, line_start);
+
+    const char *newline = memchr(buffer + start, '\n', scan->length - start);
+    size_t line_end = newline ? (size_t)(newline - buffer) : scan->length;
+    size_t line_length = line_end - line_start;
+    if (newline && line_length > 0 && buffer[line_end - 1] == '\r') {
+        line_length--;
+    }
+    BlockState state;
+    block_rule_status_t status =
+        block_rule_open(&state, kind, buffer + line_start, line_length, start - line_start, end - line_start);
+    if (status == BLOCK_RULE_SINGLE) {
+        scan->callback(rule_name, severity, start, end, scan->user_data);
+        return;
+    }
+
+    RulesStream *stream = scan->stream;
+    RulesStreamBlock block;
+    block.rule_name = rule_name;
+    block.severity = severity;
+    block.span.start_line = scan->counted_line;
+    block.span.start_column = start - line_start + 1;
+    block.span.end_line = scan->counted_line;
+    block.span.end_column = end > start ? end - line_start : start - line_start + 1;
+    block.next = newline ? line_end + 1 : scan->length;
+    block.block = state;
+    if (status == BLOCK_RULE_OPEN && stream->count < RULES_STREAM_BLOCKS) {
+        stream->blocks[stream->count++] = block;
+    } else {
+        emit_block(scan, &block, status == BLOCK_RULE_OPEN ? BLOCK_RULE_UNTERMINATED : status);
+    }
+}
+
+void rules_stream_init(RulesStream *stream) {
+    if (stream) {
+        memset(stream, 0, sizeof(*stream));
+    }
+}
+
+void rules_scan_stream(const RulesEngine *engine,
+                       RulesStream *stream,
+                       file_type_t type,
+                       const char *buffer,
+                       size_t length,
+                       size_t first_line,
+                       rules_match_callback callback,
+                       rules_span_callback span_callback,
+                       void *user_data) {
+    if (!engine || !engine->implementation || !stream || !buffer || !callback || !span_callback ||
+        stream->long_line > 0) {
+        return;
+    }
+    RulesImpl *rules_impl = (RulesImpl *)engine->implementation;
+    size_t stop = length;
+    if (rules_impl->multi_line_count == 0) {
+        stop = scan_file_buffer(rules_impl, type, buffer, length, true, callback, user_data);
+    } else {
+        StreamScan scan = {rules_impl, stream, buffer, length, 0, first_line, callback, span_callback, user_data};
+        for (size_t i = 0; i < stream->count; ++i) {
+            stream->blocks[i].next = 0;
+        }
+        stop = scan_file_buffer(rules_impl, type, buffer, length, true, stream_match, &scan);
+        advance_blocks(&scan, stop);
+    }
+    if (stop < length) {
+        size_t line = first_line;
+        for (size_t i = 0; i < stop; ++i) {
+            line += buffer[i] == '\n';
+        }
+        stream->long_line = line;
+    }
+}
+
+bool rules_stream_skip_long_line(const RulesEngine *engine, RulesStream *stream, size_t first_line) {
+    if (!engine || !engine->implementation || !stream) {
+        return false;
+    }
+    RulesImpl *rules_impl = (RulesImpl *)engine->implementation;
+    if (rules_impl->options.long_lines != RULES_LONG_LINE_SKIP) {
+        return false;
+    }
+    if (stream->long_line == 0) {
+        rules_impl->long_lines++;
+        stream->long_line = first_line;
+    }
+    return true;
+}
+
+void rules_stream_follow(RulesStream *stream,
+                         const char *buffer,
+                         size_t length,
+                         rules_span_callback span_callback,
+                         void *user_data) {
+    if (!stream || !buffer || !span_callback || stream->count == 0) {
+        return;
+    }
+    StreamScan scan;
+    memset(&scan, 0, sizeof(scan));
+    scan.stream = stream;
+    scan.buffer = buffer;
+    scan.length = length;
+    scan.span_callback = span_callback;
+    scan.user_data = user_data;
+    for (size_t i = 0; i < stream->count; ++i) {
+        stream->blocks[i].next = 0;
+    }
+    advance_blocks(&scan, length);
+}
+
+void rules_stream_finish(RulesStream *stream, rules_span_callback span_callback, void *user_data) {
+    if (!stream || !span_callback) {
+        return;
+    }
+    StreamScan scan;
+    memset(&scan, 0, sizeof(scan));
+    scan.stream = stream;
+    scan.span_callback = span_callback;
+    scan.user_data = user_data;
+    while (stream->count > 0) {
+        report_block(&scan, 0, block_rule_finish(&stream->blocks[0].block));
+    }
+}
+
+static int add_literals_section(RuleBundleWriter *writer, uint32_t kind, const AhoCorasick *automaton) {
+    size_t size = aho_corasick_serialize(automaton, NULL);
+    void *image = rule_bundle_writer_add(writer, kind, size);
+    if (!image) {
+        return -1;
+    }
+    aho_corasick_serialize(automaton, image);
+    return 0;
+}
+
+int rules_save_bundle(const RulesEngine *engine, const char *path) {
+    if (!engine || !engine->implementation || !path) {
+        return -1;
+    }
+    const RulesImpl *rules_impl = (const RulesImpl *)engine->implementation;
+    RuleBundleWriter *writer = rule_bundle_writer_create();
+    if (!writer) {
+        return -1;
+    }
+
+    size_t strings_size = 0;
+    for (size_t i = 0; i < rules_impl->rule_count; ++i) {
+        strings_size += strlen(rules_impl->rules[i].name) + strlen(rules_impl->rules[i].pattern) + 2;
+    }
+    BundleMeta *meta = rule_bundle_writer_add(writer, BUNDLE_SECTION_META, sizeof(*meta));
+    BundleRule *records = rule_bundle_writer_add(writer, BUNDLE_SECTION_RULES,
+                                                 rules_impl->rule_count * sizeof(*records));
+    char *strings = rule_bundle_writer_add(writer, BUNDLE_SECTION_STRINGS, strings_size);
+    int result = meta && records && strings && strings_size <= UINT32_MAX ? 0 : -1;
+
+    if (result == 0) {
+        meta->engine = (uint32_t)rules_impl->options.engine;
+        meta->rule_count = (uint32_t)rules_impl->rule_count;
+        meta->available_count = (uint32_t)rules_impl->available_count;
+        meta->line_literal_rules = (uint32_t)rules_impl->line_literal_rules;
+        meta->has_literals = rules_impl->has_literals ? 1u : 0u;
+        size_t offset = 0;
+        for (size_t i = 0; i < rules_impl->rule_count; ++i) {
+            const RegexRule *rule = &rules_impl->rules[i];
+            const RuleMatcher *matcher = &rules_impl->matchers[i];
+            BundleRule *record = &records[i];
+            record->name = (uint32_t)offset;
+            strcpy(strings + offset, rule->name);
+            offset += strlen(rule->name) + 1;
+            record->pattern = (uint32_t)offset;
+            strcpy(strings + offset, rule->pattern);
+            offset += strlen(rule->pattern) + 1;
+            record->severity = (uint32_t)rule->severity;
+            record->flags = (uint32_t)rule->flags;
+            record->kind = matcher->generated ? BUNDLE_RULE_GENERATED
+                           : matcher->native  ? BUNDLE_RULE_NATIVE
+                                              : BUNDLE_RULE_REGEX;
+            record->min_length = (uint32_t)matcher->min_length;
+            record->has_literal = matcher->has_literal ? 1u : 0u;
+        }
+    }
+
+    if (result == 0 && rules_impl->native) {
+        size_t size = lazy_dfa_serialize(rules_impl->native, NULL);
+        void *image = rule_bundle_writer_add(writer, BUNDLE_SECTION_NATIVE, size);
+        if (image) {
+            lazy_dfa_serialize(rules_impl->native, image);
+        } else {
+            result = -1;
+        }
+    }
+    if (result == 0 && rules_impl->key_values) {
+        size_t size = kv_tokenizer_serialize(rules_impl->key_values, NULL);
+        void *image = rule_bundle_writer_add(writer, BUNDLE_SECTION_KEY_VALUES, size);
+        if (image) {
+            kv_tokenizer_serialize(rules_impl->key_values, image);
+        } else {
+            result = -1;
+        }
+    }
+    if (result == 0 && rules_impl->token_count > 0) {
+        BundleToken *tokens = rule_bundle_writer_add(writer, BUNDLE_SECTION_TOKENS,
+                                                     rules_impl->token_count * sizeof(*tokens));
+        for (size_t i = 0; tokens && i < rules_impl->rule_count; ++i) {
+            const RuleMatcher *matcher = &rules_impl->matchers[i];
+            if (matcher->token) {
+                tokens[matcher->token_index].rule = (uint32_t)i;
+                tokens[matcher->token_index].token = rules_impl->tokens[matcher->token_index];
+            }
+        }
+        result = tokens ? 0 : -1;
+    }
+    if (result == 0) {
+        result = add_literals_section(writer, BUNDLE_SECTION_LITERALS, rules_impl->literals);
+    }
+    if (result == 0) {
+        result = add_literals_section(writer, BUNDLE_SECTION_LINE_LITERALS, rules_impl->line_literals);
+    }
+    if (result == 0) {
+        result = rule_bundle_writer_save(writer, path);
+    }
+    rule_bundle_writer_destroy(writer);
+    return result;
+}
+
+size_t rules_count(const RulesEngine *engine) {
+    if (!engine || !engine->implementation) {
+        return 0;
+    }
+    return ((const RulesImpl *)engine->implementation)->rule_count;
+}
+
+const char *rules_name(const RulesEngine *engine, size_t index) {
+    if (!engine || !engine->implementation) {
+        return NULL;
+    }
+    const RulesImpl *rules_impl = (const RulesImpl *)engine->implementation;
+    if (index == rules_impl->rule_count) {
+        return ENTROPY_RULE_NAME;
+    }
+    return index < rules_impl->rule_count ? rules_impl->rules[index].name : NULL;
+}
+
+size_t rules_index(const RulesEngine *engine, const char *rule_name) {
+    if (!engine || !engine->implementation || !rule_name) {
+        return 0;
+    }
+    const RulesImpl *rules_impl = (const RulesImpl *)engine->implementation;
+    for (size_t i = 0; i < rules_impl->rule_count; ++i) {
+        if (rules_impl->rules[i].name == rule_name) {
+            return i;
+        }
+    }
+    if (strcmp(rule_name, ENTROPY_RULE_NAME) == 0) {
+        return rules_impl->rule_count;
+    }
+    for (size_t i = 0; i < rules_impl->rule_count; ++i) {
+        if (strcmp(rules_impl->rules[i].name, rule_name) == 0) {
+            return i;
+        }
+    }
+    return rules_impl->rule_count + 1;
+}
+
+const char *rules_severity_label(severity_t severity) {
+    switch (severity) {
+    case SEVERITY_HIGH:
+        return "HIGH";
+    case SEVERITY_MEDIUM:
+        return "MEDIUM";
+    case SEVERITY_LOW:
+    default:
+        return "LOW";
+    }
+}
+
+int rules_parse_severity(const char *text, severity_t *severity) {
+    if (!text || !severity) {
+        return -1;
+    }
+    if (strcasecmp(text, "LOW") == 0) {
+        *severity = SEVERITY_LOW;
+    } else if (strcasecmp(text, "MEDIUM") == 0) {
+        *severity = SEVERITY_MEDIUM;
+    } else if (strcasecmp(text, "HIGH") == 0) {
+        *severity = SEVERITY_HIGH;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+void rules_print_active(const RulesEngine *engine, FILE *out) {
+    if (!engine || !engine->implementation) {
+        return;
+    }
+    if (!out) {
+        out = stdout;
+    }
+    const RulesImpl *rules_impl = (const RulesImpl *)engine->implementation;
+    fprintf(out, "Active rules (%zu of %zu):\n", rules_impl->rule_count, rules_impl->available_count);
+    for (size_t i = 0; i < rules_impl->rule_count; ++i) {
+        fprintf(out, "  %-6s %s\n", rules_severity_label(rules_impl->rules[i].severity), rules_impl->rules[i].name);
+    }
+}
+
+void rules_print_active_json(const RulesEngine *engine, FILE *out) {
+    if (!engine || !engine->implementation) {
+        return;
+    }
+    if (!out) {
+        out = stdout;
+    }
+    const RulesImpl *rules_impl = (const RulesImpl *)engine->implementation;
+    fprintf(out, "{\"available_rules\":%zu,\"active_rules\":[", rules_impl->available_count);
+    for (size_t i = 0; i < rules_impl->rule_count; ++i) {
+        if (i > 0) {
+            fputc(',', out);
+        }
+        fprintf(out, "{\"rule\":");
+        json_write_string(out, rules_impl->rules[i].name);
+        fprintf(out, ",\"severity\":");
+        json_write_string(out, rules_severity_label(rules_impl->rules[i].severity));
+        fputc('}', out);
+    }
+    fprintf(out, "]}\n");
+}
+
+size_t rules_get_profile(const RulesEngine *engine, RuleProfile *profiles, size_t capacity) {
+    if (!engine || !engine->implementation) {
+        return 0;
+    }
+    const RulesImpl *rules_impl = (const RulesImpl *)engine->implementation;
+    if (!rules_impl->profile) {
+        return 0;
+    }
+    for (size_t i = 0; i < rules_impl->rule_count && i < capacity && profiles; ++i) {
+        profiles[i] = rules_impl->profile[i];
+    }
+    return rules_impl->rule_count;
+}
+
+void rules_merge_profile(RulesEngine *dest, const RulesEngine *src) {
+    if (!dest || !dest->implementation || !src || !src->implementation) {
+        return;
+    }
+    RulesImpl *dest_impl = (RulesImpl *)dest->implementation;
+    const RulesImpl *src_impl = (const RulesImpl *)src->implementation;
+    LineCacheStats line_cache;
+    if (rules_get_line_cache_stats(src, &line_cache)) {
+        dest_impl->merged_line_cache.hits += line_cache.hits;
+        dest_impl->merged_line_cache.misses += line_cache.misses;
+        dest_impl->merged_line_cache.evictions += line_cache.evictions;
+        dest_impl->merged_line_cache.bypassed += line_cache.bypassed;
+        dest_impl->merged_line_cache.bytes += line_cache.bytes;
+    }
+    dest_impl->merged_long_lines += rules_get_long_lines(src);
+    if (!dest_impl->profile || !src_impl->profile || dest_impl->rule_count != src_impl->rule_count) {
+        return;
+    }
+    for (size_t i = 0; i < dest_impl->rule_count; ++i) {
+        dest_impl->profile[i].calls += src_impl->profile[i].calls;
+        dest_impl->profile[i].nanoseconds += src_impl->profile[i].nanoseconds;
+        dest_impl->profile[i].bytes += src_impl->profile[i].bytes;
+        dest_impl->profile[i].matches += src_impl->profile[i].matches;
+    }
+}
+
+bool rules_get_line_cache_stats(const RulesEngine *engine, LineCacheStats *stats) {
+    if (!engine || !engine->implementation || !stats) {
+        return false;
+    }
+    const RulesImpl *rules_impl = (const RulesImpl *)engine->implementation;
+    if (!rules_impl->line_cache) {
+        return false;
+    }
+    line_cache_stats(rules_impl->line_cache, stats);
+    stats->hits += rules_impl->merged_line_cache.hits;
+    stats->misses += rules_impl->merged_line_cache.misses;
+    stats->evictions += rules_impl->merged_line_cache.evictions;
+    stats->bypassed += rules_impl->merged_line_cache.bypassed;
+    stats->bytes += rules_impl->merged_line_cache.bytes;
+    return true;
+}
+
+uint64_t rules_get_long_lines(const RulesEngine *engine) {
+    if (!engine || !engine->implementation) {
+        return 0;
+    }
+    const RulesImpl *rules_impl = (const RulesImpl *)engine->implementation;
+    return rules_impl->long_lines + rules_impl->merged_long_lines;
+}
+
+size_t rules_get_max_line_length(const RulesEngine *engine) {
+    if (!engine || !engine->implementation) {
+        return 0;
+    }
+    const RulesImpl *rules_impl = (const RulesImpl *)engine->implementation;
+    return rules_impl->options.max_line_length;
+}
+
+static int compare_profile(const void *a, const void *b) {
+    const RuleProfile *left = (const RuleProfile *)a;
+    const RuleProfile *right = (const RuleProfile *)b;
+    if (left->nanoseconds != right->nanoseconds) {
+        return left->nanoseconds < right->nanoseconds ? 1 : -1;
+    }
+    return strcmp(left->rule_name, right->rule_name);
+}
+
+// Profile sorted by time, most expensive first. Returns NULL if off.
+static RuleProfile *sorted_profile(const RulesEngine *engine, size_t *count) {
+    *count = rules_get_profile(engine, NULL, 0);
+    if (*count == 0) {
+        return NULL;
+    }
+    RuleProfile *profiles = malloc(*count * sizeof(*profiles));
+    if (!profiles) {
+        return NULL;
+    }
+    rules_get_profile(engine, profiles, *count);
+    qsort(profiles, *count, sizeof(*profiles), compare_profile);
+    return profiles;
+}
+
+void rules_print_profile(const RulesEngine *engine, FILE *out) {
+    if (!out) {
+        out = stdout;
+    }
+    size_t count = 0;
+    RuleProfile *profiles = sorted_profile(engine, &count);
+    if (!profiles) {
+        return;
+    }
+
+    fprintf(out, "Rule profile (sorted by time):\n");
+    fprintf(out, "  %-32s %12s %12s %14s %10s\n", "RULE", "CALLS", "TIME_MS", "BYTES", "MATCHES");
+    for (size_t i = 0; i < count; ++i) {
+        fprintf(out, "  %-32s %12llu %12.3f %14llu %10llu\n",
+                profiles[i].rule_name,
+                (unsigned long long)profiles[i].calls,
+                (double)profiles[i].nanoseconds / 1e6,
+                (unsigned long long)profiles[i].bytes,
+                (unsigned long long)profiles[i].matches);
+    }
+    LineCacheStats line_cache;
+    if (rules_get_line_cache_stats(engine, &line_cache)) {
+        fprintf(out, "Line cache: %llu hits, %llu misses, %llu bypassed, %llu evictions, %zu bytes\n",
+                (unsigned long long)line_cache.hits,
+                (unsigned long long)line_cache.misses,
+                (unsigned long long)line_cache.bypassed,
+                (unsigned long long)line_cache.evictions,
+                line_cache.bytes);
+    }
+    free(profiles);
+}
+
+void rules_print_profile_json(const RulesEngine *engine, FILE *out) {
+    if (!out) {
+        out = stdout;
+    }
+    size_t count = 0;
+    RuleProfile *profiles = sorted_profile(engine, &count);
+    if (!profiles) {
+        return;
+    }
+
+    fprintf(out, "{\"rule_profile\":[");
+    for (size_t i = 0; i < count; ++i) {
+        if (i > 0) {
+            fputc(',', out);
+        }
+        fprintf(out, "{\"rule\":");
+        json_write_string(out, profiles[i].rule_name);
+        fprintf(out, ",\"calls\":%llu,\"ns\":%llu,\"bytes\":%llu,\"matches\":%llu}",
+                (unsigned long long)profiles[i].calls,
+                (unsigned long long)profiles[i].nanoseconds,
+                (unsigned long long)profiles[i].bytes,
+                (unsigned long long)profiles[i].matches);
+    }
+    fprintf(out, "]");
+    LineCacheStats line_cache;
+    if (rules_get_line_cache_stats(engine, &line_cache)) {
+        fprintf(out, ",\"line_cache\":{\"hits\":%llu,\"misses\":%llu,\"bypassed\":%llu,\"evictions\":%llu,"
+                     "\"bytes\":%zu}",
+                (unsigned long long)line_cache.hits,
+                (unsigned long long)line_cache.misses,
+                (unsigned long long)line_cache.bypassed,
+                (unsigned long long)line_cache.evictions,
+                line_cache.bytes);
     }
+    fprintf(out, "}\n");
+    free(profiles);
 }
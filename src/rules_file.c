@@ -0,0 +1,208 @@
+#include "rules_file.h"
+
+#include <ctype.h>
+#include <regex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "pattern.h"
+#include "token_rule.h"
+
+static char *read_text(const char *path) {
+    FILE *in = fopen(path, "rb");
+    if (!in) {
+        return NULL;
+    }
+    size_t capacity = 4096;
+    size_t length = 0;
+    char *text = malloc(capacity);
+    while (text) {
+        length += fread(text + length, 1, capacity - length - 1, in);
+        if (length < capacity - 1) {
+            break;
+        }
+        capacity *= 2;
+        char *resized = realloc(text, capacity);
+        if (!resized) {
+            free(text);
+        }
+        text = resized;
+    }
+    if (text && ferror(in)) {
+        free(text);
+        text = NULL;
+    }
+    fclose(in);
+    if (text) {
+        text[length] = '\0';
+    }
+    return text;
+}
+
+// Split off the next blank-separated field and return it, or NULL if the
+// line has no more fields.
+static char *next_field(char **cursor) {
+    char *start = *cursor;
+    while (*start == ' ' || *start == '\t') {
+        start++;
+    }
+    if (*start == '\0') {
+        *cursor = start;
+        return NULL;
+    }
+    char *end = start;
+    while (*end != '\0' && *end != ' ' && *end != '\t') {
+        end++;
+    }
+    if (*end != '\0') {
+        *end++ = '\0';
+    }
+    *cursor = end;
+    return start;
+}
+
+// "-" or a comma-separated list of "icase", "token", "json" and at most
+// one of "pem_block", "json_block" and "yaml_block".
+static int parse_flags(const char *text, int *flags) {
+    *flags = REG_EXTENDED;
+    if (strcmp(text, "-") == 0) {
+        return 0;
+    }
+    const char *item = text;
+    while (item) {
+        const char *comma = strchr(item, ',');
+        size_t length = comma ? (size_t)(comma - item) : strlen(item);
+        if (length == 5 && strncasecmp(item, "icase", 5) == 0) {
+            *flags |= REG_ICASE;
+        } else if (length == 5 && strncasecmp(item, "token", 5) == 0) {
+            *flags |= RULES_FLAG_TOKEN;
+        } else if (length == 4 && strncasecmp(item, "json", 4) == 0) {
+            *flags |= RULES_FLAG_JSON;
+        } else if (length == 9 && strncasecmp(item, "pem_block", 9) == 0 && !(*flags & RULES_BLOCK_FLAGS)) {
+            *flags |= RULES_FLAG_PEM_BLOCK;
+        } else if (length == 10 && strncasecmp(item, "json_block", 10) == 0 && !(*flags & RULES_BLOCK_FLAGS)) {
+            *flags |= RULES_FLAG_JSON_BLOCK;
+        } else if (length == 10 && strncasecmp(item, "yaml_block", 10) == 0 && !(*flags & RULES_BLOCK_FLAGS)) {
+            *flags |= RULES_FLAG_YAML_BLOCK;
+        } else {
+            return -1;
+        }
+        item = comma ? comma + 1 : NULL;
+    }
+    return 0;
+}
+
+// A token rule must have the shape token_rule_compile accepts, so the
+// flag cannot be silently ignored.
+static bool is_token_pattern(const char *pattern, int flags) {
+    PatternNode *root = pattern_parse(pattern, flags & ~RULES_EXTRA_FLAGS);
+    TokenRule token;
+    bool valid = root && token_rule_compile(root, &token);
+    pattern_free(root);
+    return valid;
+}
+
+static int parse_rule(const char *path, size_t line_number, char *line, RulesFile *file) {
+    char *cursor = line;
+    char *name = next_field(&cursor);
+    char *severity_text = next_field(&cursor);
+    char *flags_text = next_field(&cursor);
+    while (*cursor == ' ' || *cursor == '\t') {
+        cursor++;
+    }
+    char *pattern = cursor;
+    if (!name || !severity_text || !flags_text || pattern[0] == '\0') {
+        fprintf(stderr, "ERROR: rules file %s line %zu: expected NAME SEVERITY FLAGS PATTERN.\n",
+                path, line_number);
+        return -1;
+    }
+
+    RuleDefinition rule;
+    rule.name = name;
+    rule.pattern = pattern;
+    if (rules_parse_severity(severity_text, &rule.severity) != 0) {
+        fprintf(stderr, "ERROR: rules file %s line %zu: invalid severity %s.\n", path, line_number, severity_text);
+        return -1;
+    }
+    if (parse_flags(flags_text, &rule.flags) != 0) {
+        fprintf(stderr, "ERROR: rules file %s line %zu: invalid flags %s.\n", path, line_number, flags_text);
+        return -1;
+    }
+    for (size_t i = 0; i < file->count; ++i) {
+        if (strcmp(file->rules[i].name, name) == 0) {
+            fprintf(stderr, "ERROR: rules file %s line %zu: duplicate rule %s.\n", path, line_number, name);
+            return -1;
+        }
+    }
+    regex_t regex;
+    if (regcomp(&regex, pattern, (rule.flags & ~RULES_EXTRA_FLAGS) | REG_NOSUB) != 0) {
+        fprintf(stderr, "ERROR: rules file %s line %zu: invalid pattern for %s.\n", path, line_number, name);
+        return -1;
+    }
+    regfree(&regex);
+    if ((rule.flags & RULES_FLAG_TOKEN) && !is_token_pattern(pattern, rule.flags)) {
+        fprintf(stderr, "ERROR: rules file %s line %zu: %s is not a fixed prefix followed by one "
+                        "counted character class, as the token flag needs.\n", path, line_number, name);
+        return -1;
+    }
+
+    RuleDefinition *resized = realloc(file->rules, (file->count + 1) * sizeof(*resized));
+    if (!resized) {
+        return -1;
+    }
+    file->rules = resized;
+    file->rules[file->count++] = rule;
+    return 0;
+}
+
+int rules_file_load(const char *path, RulesFile *file) {
+    if (!path || !file) {
+        return -1;
+    }
+    memset(file, 0, sizeof(*file));
+    file->text = read_text(path);
+    if (!file->text) {
+        fprintf(stderr, "ERROR: could not read rules file %s.\n", path);
+        return -1;
+    }
+
+    size_t line_number = 0;
+    char *line = file->text;
+    while (line) {
+        line_number++;
+        char *newline = strchr(line, '\n');
+        if (newline) {
+            *newline = '\0';
+        }
+        size_t length = strlen(line);
+        while (length > 0 && isspace((unsigned char)line[length - 1])) {
+            line[--length] = '\0';
+        }
+        char *start = line;
+        while (*start == ' ' || *start == '\t') {
+            start++;
+        }
+
+        if (*start == '\0' || *start == '#') {
+            // Blank line or comment.
+        } else if (strcmp(start, "@replace-defaults") == 0) {
+            file->replace_defaults = true;
+        } else if (parse_rule(path, line_number, start, file) != 0) {
+            rules_file_free(file);
+            return -1;
+        }
+        line = newline ? newline + 1 : NULL;
+    }
+    return 0;
+}
+
+void rules_file_free(RulesFile *file) {
+    if (!file) {
+        return;
+    }
+    free(file->rules);
+    free(file->text);
+    memset(file, 0, sizeof(*file));
+}
@@ -2,48 +2,82 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include "byte_class.h"
 #include "config.h"
+#include "file_type.h"
 #include "util.h"
 
-#define SCAN_BUFFER_SIZE 8192
+// Bytes looked at to tell binary files and file types by content.
+#define SCAN_SNIFF_SIZE 8192
+// A read buffer grown past this for a long line is released after the file.
+#define SCAN_BUFFER_KEEP_SIZE (1024 * 1024)
+// --scan-binaries: strings of at least SCAN_STRINGS_MIN printable bytes
+// are collected into a buffer of SCAN_STRINGS_SIZE bytes, one per line, and
+// the ring keeps the offsets of the strings a finding can refer to: those
+// in the buffer and the lines an open multi-line block started on.
+#define SCAN_STRINGS_MIN 8
+#define SCAN_STRINGS_SIZE (32 * 1024)
+#define SCAN_STRINGS_RING 4096
+// Mapped binary files are scanned in windows of this size, dropping the
+// pages of each window once its strings are out.
+#define SCAN_STRINGS_WINDOW (1024 * 1024)
 
-typedef struct ScannerFindingNode {
-    char *rule_name;
-    severity_t severity;
-    char *path;
+_Static_assert(SCAN_STRINGS_RING >= SCAN_STRINGS_SIZE / (SCAN_STRINGS_MIN + 1) + BLOCK_RULE_MAX_LINES,
+               "the offset ring must cover a full buffer of strings and an open block");
+
+// A finding in 32 bytes: the rule is its index in the engine and the path
+// an ID in the scanner's PathTable. Columns past 4 GiB are clamped.
+// Findings in a binary file's strings have column 0, and line_number is
+// the byte offset of the match in the file.
+struct ScannerFinding {
     size_t line_number;
-    size_t column;
-    struct ScannerFindingNode *next;
-} ScannerFindingNode;
+    uint32_t column;
+    // Where a multi-line match ends: end_lines lines further (0 for other
+    // matches), at end_column.
+    uint32_t end_column;
+    uint32_t path;
+    // Position in the order of arrival, so ties keep it when sorted.
+    uint32_t order;
+    uint16_t rule;
+    uint16_t end_lines;
+    uint8_t severity;
+};
 
+// Matches in a buffer of whole lines. Line numbers are resolved on demand
+// by counting newlines from the last resolved match forward.
 typedef struct {
     ScannerContext *scanner;
     const char *path;
-    size_t line_number;
-} LineContext;
+    const char *buffer;
+    // Line number of the first line in buffer.
+    size_t first_line;
+    // Offset up to which newlines were counted, the line number there and
+    // the offset where that line starts.
+    size_t counted_offset;
+    size_t counted_line;
+    size_t line_start;
+    // For the strings of a binary file, the file offset where the string
+    // on line n starts is run_offsets[n % SCAN_STRINGS_RING]; NULL for text.
+    const size_t *run_offsets;
+} ChunkContext;
 
 // Heuristic to skip binary files.
 bool is_binary_buffer(const unsigned char *buffer, size_t length) {
     if (!buffer || length == 0) {
         return false;
     }
-
-    size_t non_printable = 0;
-    for (size_t i = 0; i < length; ++i) {
-        unsigned char current = buffer[i];
-        if (current == '\0') {
-            return true;
-        }
-        if (current < 0x09 || (current > 0x0D && current < 0x20)) {
-            non_printable++;
-        }
+    if (byte_class_find_nul(buffer, length) < length) {
+        return true;
     }
-
+    size_t non_printable = byte_class_count_control(buffer, length);
     return (double)non_printable / (double)length > 0.3;
 }
 
@@ -51,21 +85,51 @@ void scanner_init(ScannerContext *scanner, RulesEngine *rules) {
     scanner->rules = rules;
     scanner->finding_count = 0;
     scanner->highest_severity = SEVERITY_LOW;
-    scanner->findings_head = NULL;
-    scanner->findings_tail = NULL;
+    scanner->findings = NULL;
+    scanner->finding_capacity = 0;
+    scanner->findings_sorted = false;
+    scanner->paths = NULL;
+    scanner->owns_paths = false;
+    scanner->current_path = NULL;
+    scanner->current_path_id = PATH_TABLE_NONE;
+    scanner->read_buffer = NULL;
+    scanner->strings = NULL;
+    scanner->read_capacity = 0;
+    scanner->allocations = 0;
+    scanner->io = SCANNER_IO_AUTO;
+    scanner->io_buffer_size = SCANNER_READ_BUFFER_SIZE;
+    scanner->ring = NULL;
+    scanner->ring_buffers = NULL;
     scanner->files_scanned = 0;
     scanner->files_skipped = 0;
     scanner->scan_failed = false;
+    scanner->skips = NULL;
+    scanner->skip_count = 0;
+    scanner->classify_files = true;
+    scanner->scan_binaries = false;
 }
 
-static int compare_findings(const ScannerFindingNode *a, const ScannerFindingNode *b) {
+static const char *finding_path(const ScannerContext *scanner, const ScannerFinding *finding) {
+    const char *path = path_table_get(scanner->paths, finding->path);
+    return path ? path : "";
+}
+
+static const char *finding_rule(const ScannerContext *scanner, const ScannerFinding *finding) {
+    const char *name = rules_name(scanner->rules, finding->rule);
+    return name ? name : "";
+}
+
+// Report order: severity (highest first), path, line, column and rule.
+static int compare_report_order(const ScannerContext *scanner, const ScannerFinding *a, const ScannerFinding *b) {
     if (a->severity != b->severity) {
         return (int)b->severity - (int)a->severity;
     }
 
-    int path_cmp = strcmp(a->path, b->path);
-    if (path_cmp != 0) {
-        return path_cmp;
+    if (a->path != b->path) {
+        int path_cmp = strcmp(finding_path(scanner, a), finding_path(scanner, b));
+        if (path_cmp != 0) {
+            return path_cmp;
+        }
     }
 
     if (a->line_number != b->line_number) {
@@ -76,7 +140,147 @@ static int compare_findings(const ScannerFindingNode *a, const ScannerFindingNod
         return (a->column < b->column) ? -1 : 1;
     }
 
-    return strcmp(a->rule_name, b->rule_name);
+    if (a->rule == b->rule) {
+        return 0;
+    }
+    return strcmp(finding_rule(scanner, a), finding_rule(scanner, b));
+}
+
+// Report order on records whose path and rule were replaced by their rank
+// (see sort_records), then order of arrival.
+static int compare_sort_keys(const void *left, const void *right) {
+    const ScannerFinding *a = (const ScannerFinding *)left;
+    const ScannerFinding *b = (const ScannerFinding *)right;
+    if (a->severity != b->severity) {
+        return (int)b->severity - (int)a->severity;
+    }
+    if (a->path != b->path) {
+        return (a->path < b->path) ? -1 : 1;
+    }
+    if (a->line_number != b->line_number) {
+        return (a->line_number < b->line_number) ? -1 : 1;
+    }
+    if (a->column != b->column) {
+        return (a->column < b->column) ? -1 : 1;
+    }
+    if (a->rule != b->rule) {
+        return (a->rule < b->rule) ? -1 : 1;
+    }
+    return (a->order < b->order) ? -1 : (a->order > b->order);
+}
+
+typedef struct {
+    const char *text;
+    uint32_t id;
+} SortName;
+
+static int compare_sort_names(const void *left, const void *right) {
+    const SortName *a = (const SortName *)left;
+    const SortName *b = (const SortName *)right;
+    int cmp = strcmp(a->text, b->text);
+    if (cmp != 0) {
+        return cmp;
+    }
+    return (a->id < b->id) ? -1 : (a->id > b->id);
+}
+
+// Sort names[0..count) and fill ranks[id] with the rank of every ID by its
+// text (equal texts share a rank) and first[rank] with the first ID of
+// each rank.
+static void rank_names(SortName *names, size_t count, uint32_t *ranks, uint32_t *first) {
+    qsort(names, count, sizeof(*names), compare_sort_names);
+    uint32_t rank = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (i > 0 && strcmp(names[i].text, names[i - 1].text) != 0) {
+            rank++;
+        }
+        if (i == 0 || rank != ranks[names[i - 1].id]) {
+            first[rank] = names[i].id;
+        }
+        ranks[names[i].id] = rank;
+    }
+}
+
+// Sort records into report order. Paths and rules are ranked by name once,
+// so the sort itself compares integers only and never follows a string.
+// Records of equal paths end up with the same path ID. Returns 0 on
+// success, -1 on allocation failure.
+static int sort_records(const ScannerContext *scanner, ScannerFinding *records, size_t count) {
+    if (count == 0) {
+        return 0;
+    }
+    size_t path_count = path_table_count(scanner->paths);
+    // The rules and the entropy detector (see rules_name), plus one rule
+    // rank for records whose rule the engine does not know.
+    size_t rule_count = rules_count(scanner->rules) + 1;
+    SortName *names = malloc((path_count + rule_count + 1) * sizeof(*names));
+    uint32_t *table = malloc(2 * (path_count + rule_count + 1) * sizeof(*table));
+    if (!names || !table) {
+        free(names);
+        free(table);
+        return -1;
+    }
+    uint32_t *path_ranks = table;
+    uint32_t *path_ids = path_ranks + path_count;
+    uint32_t *rule_ranks = path_ids + path_count;
+    uint32_t *rule_ids = rule_ranks + rule_count + 1;
+
+    for (size_t i = 0; i < path_count; ++i) {
+        names[i].text = path_table_get(scanner->paths, (uint32_t)i);
+        names[i].id = (uint32_t)i;
+    }
+    rank_names(names, path_count, path_ranks, path_ids);
+    for (size_t i = 0; i < rule_count; ++i) {
+        names[i].text = rules_name(scanner->rules, i);
+        names[i].id = (uint32_t)i;
+    }
+    rank_names(names, rule_count, rule_ranks, rule_ids);
+    rule_ranks[rule_count] = (uint32_t)rule_count;
+    rule_ids[rule_count] = (uint32_t)rule_count;
+    free(names);
+
+    for (size_t i = 0; i < count; ++i) {
+        records[i].path = path_ranks[records[i].path];
+        records[i].rule = (uint16_t)rule_ranks[records[i].rule < rule_count ? records[i].rule : rule_count];
+    }
+    qsort(records, count, sizeof(*records), compare_sort_keys);
+    for (size_t i = 0; i < count; ++i) {
+        records[i].path = path_ids[records[i].path];
+        records[i].rule = (uint16_t)rule_ids[records[i].rule];
+        records[i].order = (uint32_t)i;
+    }
+    free(table);
+    return 0;
+}
+
+static PathTable *ensure_paths(ScannerContext *scanner) {
+    if (!scanner->paths) {
+        scanner->paths = path_table_create();
+        scanner->owns_paths = scanner->paths != NULL;
+    }
+    return scanner->paths;
+}
+
+// ID of path in the scanner's table. The file being scanned keeps its ID,
+// so a path is stored once per file rather than once per finding.
+static uint32_t intern_path(ScannerContext *scanner, const char *path) {
+    if (scanner->current_path && strcmp(scanner->current_path, path) == 0) {
+        return scanner->current_path_id;
+    }
+    if (!ensure_paths(scanner)) {
+        return PATH_TABLE_NONE;
+    }
+    const char *stored = NULL;
+    uint32_t id = path_table_intern(scanner->paths, path, &stored);
+    if (id != PATH_TABLE_NONE) {
+        scanner->current_path = stored;
+        scanner->current_path_id = id;
+    }
+    return id;
+}
+
+static uint32_t clamp_u32(size_t value) {
+    return value > UINT32_MAX ? UINT32_MAX : (uint32_t)value;
 }
 
 static int append_finding(ScannerContext *scanner,
@@ -84,93 +288,231 @@ static int append_finding(ScannerContext *scanner,
                           severity_t severity,
                           const char *path,
                           size_t line_number,
-                          size_t column) {
+                          size_t column,
+                          size_t end_line,
+                          size_t end_column) {
     if (!scanner) {
         return -1;
     }
 
-    ScannerFindingNode *node = calloc(1, sizeof(*node));
-    if (!node) {
+    uint32_t path_id = intern_path(scanner, path);
+    if (path_id == PATH_TABLE_NONE) {
         return -1;
     }
 
-    node->rule_name = duplicate_string(rule_name);
-    node->path = duplicate_string(path);
-    if (!node->rule_name || !node->path) {
-        free(node->rule_name);
-        free(node->path);
-        free(node);
-        return -1;
+    // Findings are appended as they come and sorted once for the report,
+    // so storing them stays linear in their number.
+    if (scanner->finding_count == scanner->finding_capacity) {
+        size_t capacity = scanner->finding_capacity ? scanner->finding_capacity * 2 : 64;
+        ScannerFinding *grown = realloc(scanner->findings, capacity * sizeof(*grown));
+        if (!grown) {
+            return -1;
+        }
+        scanner->findings = grown;
+        scanner->finding_capacity = capacity;
+        scanner->allocations++;
     }
 
-    node->severity = severity;
-    node->line_number = line_number;
-    node->column = column;
+    ScannerFinding *finding = &scanner->findings[scanner->finding_count];
+    size_t rule = rules_index(scanner->rules, rule_name);
+    finding->line_number = line_number;
+    finding->column = clamp_u32(column);
+    finding->end_column = clamp_u32(end_column);
+    finding->path = path_id;
+    finding->order = (uint32_t)scanner->finding_count;
+    finding->rule = rule > UINT16_MAX ? UINT16_MAX : (uint16_t)rule;
+    // Multi-line blocks end within BLOCK_RULE_MAX_LINES lines.
+    finding->end_lines = end_line > line_number ? (uint16_t)(end_line - line_number) : 0;
+    finding->severity = (uint8_t)severity;
 
-    if (!scanner->findings_head) {
-        scanner->findings_head = node;
-        scanner->findings_tail = node;
-    } else {
-        // Insert in sorted order to keep report stable.
-        ScannerFindingNode *prev = NULL;
-        ScannerFindingNode *current = scanner->findings_head;
-        while (current && compare_findings(current, node) <= 0) {
-            prev = current;
-            current = current->next;
-        }
+    scanner->finding_count++;
+    scanner->findings_sorted = false;
+    if (severity > scanner->highest_severity) {
+        scanner->highest_severity = severity;
+    }
 
-        if (!prev) {
-            node->next = scanner->findings_head;
-            scanner->findings_head = node;
-        } else {
-            node->next = current;
-            prev->next = node;
-        }
+    return 0;
+}
 
-        if (!node->next) {
-            scanner->findings_tail = node;
+// Add skip to the scanner's list, keeping it sorted by path and position.
+// The path is copied unless take_path is set. Returns 0 on success, -1 on
+// allocation failure.
+static int insert_skip(ScannerContext *scanner, ScannerSkip skip, bool take_path) {
+    ScannerSkip *grown = realloc(scanner->skips, (scanner->skip_count + 1) * sizeof(*grown));
+    if (!grown) {
+        return -1;
+    }
+    scanner->skips = grown;
+    scanner->allocations++;
+    if (!take_path) {
+        skip.path = duplicate_string(skip.path);
+        if (!skip.path) {
+            return -1;
         }
     }
+    size_t index = scanner->skip_count;
+    while (index > 0) {
+        const ScannerSkip *previous = &scanner->skips[index - 1];
+        int order = strcmp(previous->path, skip.path);
+        if (order < 0 || (order == 0 && previous->position <= skip.position)) {
+            break;
+        }
+        index--;
+    }
+    memmove(&scanner->skips[index + 1], &scanner->skips[index], (scanner->skip_count - index) * sizeof(skip));
+    scanner->skips[index] = skip;
+    scanner->skip_count++;
+    return 0;
+}
 
-    scanner->finding_count++;
-    if (severity > scanner->highest_severity) {
-        scanner->highest_severity = severity;
+int scanner_share_paths(ScannerContext *scanner, ScannerContext *owner) {
+    if (!scanner || !owner || !ensure_paths(owner)) {
+        return -1;
+    }
+    if (scanner->owns_paths) {
+        path_table_destroy(scanner->paths);
     }
+    scanner->paths = owner->paths;
+    scanner->owns_paths = false;
+    scanner->current_path = NULL;
+    scanner->current_path_id = PATH_TABLE_NONE;
+    return 0;
+}
 
+void scanner_sort_findings(ScannerContext *scanner) {
+    if (!scanner || scanner->findings_sorted) {
+        return;
+    }
+    if (sort_records(scanner, scanner->findings, scanner->finding_count) != 0) {
+        fprintf(stderr, "ERROR: out of memory while sorting findings.\n");
+        return;
+    }
+    scanner->findings_sorted = true;
+}
+
+// Make room for extra findings in dest's array.
+static int reserve_findings(ScannerContext *scanner, size_t extra) {
+    size_t needed = scanner->finding_count + extra;
+    if (needed <= scanner->finding_capacity) {
+        return 0;
+    }
+    ScannerFinding *grown = realloc(scanner->findings, needed * sizeof(*grown));
+    if (!grown) {
+        return -1;
+    }
+    scanner->findings = grown;
+    scanner->finding_capacity = needed;
+    scanner->allocations++;
     return 0;
 }
 
+// Give src's findings path IDs in dest's table. Each path is copied once.
+static int remap_paths(ScannerContext *dest, ScannerContext *src) {
+    size_t path_count = path_table_count(src->paths);
+    uint32_t *ids = malloc((path_count ? path_count : 1) * sizeof(*ids));
+    if (!ids || !ensure_paths(dest)) {
+        free(ids);
+        return -1;
+    }
+    for (size_t i = 0; i < path_count; ++i) {
+        ids[i] = PATH_TABLE_NONE;
+    }
+    int result = 0;
+    for (size_t i = 0; i < src->finding_count && result == 0; ++i) {
+        uint32_t path = src->findings[i].path;
+        if (ids[path] == PATH_TABLE_NONE) {
+            ids[path] = path_table_intern(dest->paths, path_table_get(src->paths, path), NULL);
+            result = ids[path] == PATH_TABLE_NONE ? -1 : 0;
+        }
+        src->findings[i].path = ids[path];
+    }
+    free(ids);
+    return result;
+}
+
 void scanner_merge(ScannerContext *dest, ScannerContext *src) {
     if (!dest || !src) {
         return;
     }
 
-    ScannerFindingNode *current = src->findings_head;
-    while (current) {
-        append_finding(dest,
-                       current->rule_name,
-                       current->severity,
-                       current->path,
-                       current->line_number,
-                       current->column);
-        current = current->next;
-    }
-
     dest->files_scanned += src->files_scanned;
     dest->files_skipped += src->files_skipped;
     dest->scan_failed = dest->scan_failed || src->scan_failed;
-}
+    dest->allocations += src->allocations;
+    src->allocations = 0;
+    if (src->owns_paths) {
+        // Counted here before src's table goes away.
+        dest->allocations += path_table_allocations(src->paths);
+    }
+    for (size_t i = 0; i < src->skip_count; ++i) {
+        if (insert_skip(dest, src->skips[i], true) != 0) {
+            fprintf(stderr, "ERROR: out of memory while merging skipped files.\n");
+            dest->scan_failed = true;
+            free(src->skips[i].path);
+        }
+    }
+    free(src->skips);
+    src->skips = NULL;
+    src->skip_count = 0;
+    if (src->finding_count == 0) {
+        return;
+    }
+    if (src->highest_severity > dest->highest_severity) {
+        dest->highest_severity = src->highest_severity;
+    }
 
-static const char *severity_label(severity_t severity) {
-    switch (severity) {
-    case SEVERITY_HIGH:
-        return "HIGH";
-    case SEVERITY_MEDIUM:
-        return "MEDIUM";
-    case SEVERITY_LOW:
-    default:
-        return "LOW";
+    if ((src->paths != dest->paths && remap_paths(dest, src) != 0) ||
+        (dest->finding_count > 0 && reserve_findings(dest, src->finding_count) != 0)) {
+        fprintf(stderr, "ERROR: out of memory while merging findings.\n");
+        dest->scan_failed = true;
+        src->finding_count = 0;
+        return;
     }
+
+    if (dest->finding_count == 0) {
+        // Take over the whole array.
+        free(dest->findings);
+        dest->findings = src->findings;
+        dest->finding_count = src->finding_count;
+        dest->finding_capacity = src->finding_capacity;
+        dest->findings_sorted = src->findings_sorted;
+    } else if (dest->findings_sorted && src->findings_sorted) {
+        // Merge from the back so dest's records only move up, into the
+        // room just reserved. On ties dest's findings stay first, as they
+        // arrived first.
+        size_t left = dest->finding_count;
+        size_t right = src->finding_count;
+        size_t out = left + right;
+        while (right > 0) {
+            if (left > 0 &&
+                compare_report_order(dest, &dest->findings[left - 1], &src->findings[right - 1]) > 0) {
+                dest->findings[--out] = dest->findings[--left];
+            } else {
+                dest->findings[--out] = src->findings[--right];
+            }
+        }
+        dest->finding_count += src->finding_count;
+        for (size_t i = 0; i < dest->finding_count; ++i) {
+            dest->findings[i].order = (uint32_t)i;
+        }
+    } else {
+        for (size_t i = 0; i < src->finding_count; ++i) {
+            ScannerFinding *finding = &dest->findings[dest->finding_count];
+            *finding = src->findings[i];
+            finding->order = (uint32_t)dest->finding_count++;
+        }
+        dest->findings_sorted = false;
+    }
+
+    // The records belong to dest now.
+    if (dest->findings != src->findings) {
+        free(src->findings);
+    }
+    src->findings = NULL;
+    src->finding_count = 0;
+    src->finding_capacity = 0;
+    src->findings_sorted = false;
+    src->highest_severity = SEVERITY_LOW;
 }
 
 static const char *severity_color(severity_t severity) {
@@ -185,63 +527,63 @@ static const char *severity_color(severity_t severity) {
     }
 }
 
-static void json_write_string(FILE *out, const char *text) {
-    if (!text) {
-        fputs("null", out);
-        return;
+// Why the long line guard skipped an input.
+static void print_skip_reason(const ScannerSkip *skip, FILE *out) {
+    if (skip->at_offset) {
+        fprintf(out, "the string at offset %zu is over the line length limit", skip->position);
+    } else {
+        fprintf(out, "line %zu is over the line length limit", skip->position);
     }
+}
 
-    const unsigned char *ptr = (const unsigned char *)text;
-    fputc('"', out);
-    while (*ptr) {
-        unsigned char ch = *ptr++;
-        switch (ch) {
-        case '\"':
-            fputs("\\\"", out);
-            break;
-        case '\\':
-            fputs("\\\\", out);
-            break;
-        case '\b':
-            fputs("\\b", out);
-            break;
-        case '\f':
-            fputs("\\f", out);
-            break;
-        case '\n':
-            fputs("\\n", out);
-            break;
-        case '\r':
-            fputs("\\r", out);
-            break;
-        case '\t':
-            fputs("\\t", out);
-            break;
-        default:
-            if (ch < 0x20) {
-                fprintf(out, "\\u%04x", ch);
-            } else {
-                fputc(ch, out);
-            }
-            break;
-        }
+static void print_skips(const ScannerContext *scanner, FILE *out) {
+    if (scanner->skip_count == 0) {
+        return;
+    }
+    fprintf(out, "Skipped:\n");
+    for (size_t i = 0; i < scanner->skip_count; ++i) {
+        fprintf(out, "  %s: ", scanner->skips[i].path);
+        print_skip_reason(&scanner->skips[i], out);
+        fputc('\n', out);
     }
-    fputc('"', out);
 }
 
-static void print_finding(const char *rule_name,
-                          severity_t severity,
-                          const char *path,
-                          size_t line_number,
-                          size_t column,
-                          FILE *out,
-                          bool use_color) {
-    const char *label = severity_label(severity);
+static void print_finding(const ScannerContext *scanner, const ScannerFinding *finding, FILE *out, bool use_color) {
+    severity_t severity = (severity_t)finding->severity;
+    const char *label = rules_severity_label(severity);
     const char *color = use_color ? severity_color(severity) : "";
     const char *reset = use_color ? "\x1b[0m" : "";
-    fprintf(out, "%s[%s]%s %s\n", color, label, reset, rule_name);
-    fprintf(out, "  file: %s:%zu:%zu\n", path, line_number, column);
-    fprintf(out, "  line: %zu, col: %zu\n", line_number, column);
+    fprintf(out, "%s[%s]%s %s\n", color, label, reset, finding_rule(scanner, finding));
+    if (finding->column == 0) {
+        // In the strings of a binary file.
+        fprintf(out, "  file: %s\n", finding_path(scanner, finding));
+        fprintf(out, "  offset: %zu\n", finding->line_number);
+        return;
+    }
+    fprintf(out, "  file: %s:%zu:%u\n", finding_path(scanner, finding), finding->line_number, finding->column);
+    fprintf(out, "  line: %zu, col: %u\n", finding->line_number, finding->column);
+    if (finding->end_lines > 0) {
+        fprintf(out, "  end: line %zu, col %u\n", finding->line_number + finding->end_lines, finding->end_column);
+    }
+}
+
+// A sorted copy of the findings for the report (NULL if they are sorted
+// already, if there are none or on allocation failure; the report then
+// prints them as stored).
+static ScannerFinding *sorted_findings(const ScannerContext *scanner) {
+    if (scanner->finding_count == 0 || scanner->findings_sorted) {
+        return NULL;
+    }
+    ScannerFinding *sorted = malloc(scanner->finding_count * sizeof(*sorted));
+    if (sorted) {
+        memcpy(sorted, scanner->findings, scanner->finding_count * sizeof(*sorted));
+    }
+    if (!sorted || sort_records(scanner, sorted, scanner->finding_count) != 0) {
+        fprintf(stderr, "ERROR: out of memory while sorting findings.\n");
+        free(sorted);
+        return NULL;
+    }
+    return sorted;
 }
 
 void scanner_print_report(const ScannerContext *scanner, FILE *out) {
@@ -272,41 +614,45 @@ void scanner_print_report(const ScannerContext *scanner, FILE *out) {
             status_color = use_color ? "\x1b[33m" : "";
         }
     }
+    // Lines the long line guard truncated, windowed or skipped.
+    char long_lines[48] = "";
+    uint64_t long_line_count = rules_get_long_lines(scanner->rules);
+    if (long_line_count > 0) {
+        snprintf(long_lines, sizeof(long_lines), " | long lines: %llu", (unsigned long long)long_line_count);
+    }
 
     if (scanner->finding_count == 0) {
-        fprintf(out, "Summary: %s%s %s%s - %zu findings | files: %zu scanned, %zu skipped\n",
+        fprintf(out, "Summary: %s%s %s%s - %zu findings | files: %zu scanned, %zu skipped%s\n",
                 status_color,
                 status_icon,
                 status,
                 status_reset,
                 scanner->finding_count,
                 scanner->files_scanned,
-                scanner->files_skipped);
+                scanner->files_skipped,
+                long_lines);
     }
     fprintf(out, "Results:");
     if (scanner->finding_count == 0) {
         fprintf(out, " (no findings)\n");
+        print_skips(scanner, out);
     } else {
-        const ScannerFindingNode *current = scanner->findings_head;
+        ScannerFinding *sorted = sorted_findings(scanner);
         fprintf(out, "\n");
-        while (current) {
-            print_finding(current->rule_name,
-                          current->severity,
-                          current->path,
-                          current->line_number,
-                          current->column,
-                          out,
-                          use_color);
-            current = current->next;
-        }
-        fprintf(out, "Summary: %s%s %s%s - %zu findings | files: %zu scanned, %zu skipped\n",
+        for (size_t i = 0; i < scanner->finding_count; ++i) {
+            print_finding(scanner, sorted ? &sorted[i] : &scanner->findings[i], out, use_color);
+        }
+        free(sorted);
+        print_skips(scanner, out);
+        fprintf(out, "Summary: %s%s %s%s - %zu findings | files: %zu scanned, %zu skipped%s\n",
                 status_color,
                 status_icon,
                 status,
                 status_reset,
                 scanner->finding_count,
                 scanner->files_scanned,
-                scanner->files_skipped);
+                scanner->files_skipped,
+                long_lines);
     }
 }
 
@@ -332,31 +678,84 @@ void scanner_print_report_json(const ScannerContext *scanner, FILE *out) {
     fprintf(out, "{\"summary\":{");
     fprintf(out, "\"status\":");
     json_write_string(out, status);
-    fprintf(out, ",\"findings\":%zu,\"files_scanned\":%zu,\"files_skipped\":%zu,\"scan_failed\":%s}",
+    fprintf(out, ",\"findings\":%zu,\"files_scanned\":%zu,\"files_skipped\":%zu,\"long_lines\":%llu,\"scan_failed\":%s}",
             scanner->finding_count,
             scanner->files_scanned,
             scanner->files_skipped,
+            (unsigned long long)rules_get_long_lines(scanner->rules),
             scanner->scan_failed ? "true" : "false");
     fprintf(out, ",\"findings\":[");
 
-    const ScannerFindingNode *current = scanner->findings_head;
-    bool first = true;
-    while (current) {
-        if (!first) {
+    ScannerFinding *sorted = sorted_findings(scanner);
+    for (size_t i = 0; i < scanner->finding_count; ++i) {
+        const ScannerFinding *current = sorted ? &sorted[i] : &scanner->findings[i];
+        if (i > 0) {
             fputc(',', out);
         }
-        first = false;
         fprintf(out, "{\"severity\":");
-        json_write_string(out, severity_label(current->severity));
+        json_write_string(out, rules_severity_label((severity_t)current->severity));
         fprintf(out, ",\"rule\":");
-        json_write_string(out, current->rule_name);
+        json_write_string(out, finding_rule(scanner, current));
         fprintf(out, ",\"file\":");
-        json_write_string(out, current->path);
-        fprintf(out, ",\"line\":%zu,\"col\":%zu}", current->line_number, current->column);
-        current = current->next;
+        json_write_string(out, finding_path(scanner, current));
+        if (current->column == 0) {
+            fprintf(out, ",\"offset\":%zu", current->line_number);
+        } else {
+            fprintf(out, ",\"line\":%zu,\"col\":%u", current->line_number, current->column);
+        }
+        if (current->end_lines > 0) {
+            fprintf(out,
+                    ",\"end_line\":%zu,\"end_col\":%u",
+                    current->line_number + current->end_lines,
+                    current->end_column);
+        }
+        fputc('}', out);
+    }
+    free(sorted);
+    fprintf(out, "]");
+
+    if (scanner->skip_count > 0) {
+        fprintf(out, ",\"skipped\":[");
+        for (size_t i = 0; i < scanner->skip_count; ++i) {
+            const ScannerSkip *skip = &scanner->skips[i];
+            fprintf(out, "%s{\"file\":", i > 0 ? "," : "");
+            json_write_string(out, skip->path);
+            fprintf(out, ",\"reason\":\"long_line\",\"%s\":%zu}", skip->at_offset ? "offset" : "line", skip->position);
+        }
+        fprintf(out, "]");
+    }
+    fprintf(out, "}\n");
+}
+
+uint64_t scanner_allocations(const ScannerContext *scanner) {
+    if (!scanner) {
+        return 0;
+    }
+    return scanner->allocations + (scanner->owns_paths ? path_table_allocations(scanner->paths) : 0);
+}
+
+void scanner_print_profile(const ScannerContext *scanner, FILE *out) {
+    if (!scanner) {
+        return;
     }
+    if (!out) {
+        out = stdout;
+    }
+    fprintf(out, "Scanner: %zu files, %llu allocations (read buffers, finding storage, paths)\n",
+            scanner->files_scanned + scanner->files_skipped,
+            (unsigned long long)scanner_allocations(scanner));
+}
 
-    fprintf(out, "]}\n");
+void scanner_print_profile_json(const ScannerContext *scanner, FILE *out) {
+    if (!scanner) {
+        return;
+    }
+    if (!out) {
+        out = stdout;
+    }
+    fprintf(out, "{\"scanner_profile\":{\"files\":%zu,\"allocations\":%llu}}\n",
+            scanner->files_scanned + scanner->files_skipped,
+            (unsigned long long)scanner_allocations(scanner));
 }
 
 void scanner_destroy(ScannerContext *scanner) {
@@ -364,22 +763,76 @@ void scanner_destroy(ScannerContext *scanner) {
         return;
     }
 
-    ScannerFindingNode *current = scanner->findings_head;
-    while (current) {
-        ScannerFindingNode *next = current->next;
-        free(current->rule_name);
-        free(current->path);
-        free(current);
-        current = next;
+    free(scanner->findings);
+    free(scanner->read_buffer);
+    free(scanner->strings);
+    io_ring_destroy(scanner->ring);
+    free(scanner->ring_buffers);
+    if (scanner->owns_paths) {
+        path_table_destroy(scanner->paths);
     }
+    for (size_t i = 0; i < scanner->skip_count; ++i) {
+        free(scanner->skips[i].path);
+    }
+    free(scanner->skips);
 
-    scanner->findings_head = NULL;
-    scanner->findings_tail = NULL;
+    scanner->findings = NULL;
+    scanner->read_buffer = NULL;
+    scanner->read_capacity = 0;
+    scanner->strings = NULL;
+    scanner->allocations = 0;
+    scanner->ring = NULL;
+    scanner->ring_buffers = NULL;
+    scanner->paths = NULL;
+    scanner->owns_paths = false;
+    scanner->current_path = NULL;
+    scanner->current_path_id = PATH_TABLE_NONE;
+    scanner->finding_capacity = 0;
+    scanner->findings_sorted = false;
     scanner->finding_count = 0;
     scanner->highest_severity = SEVERITY_LOW;
     scanner->files_scanned = 0;
     scanner->files_skipped = 0;
     scanner->scan_failed = false;
+    scanner->skips = NULL;
+    scanner->skip_count = 0;
+}
+
+// Count newlines up to offset. Matches arrive line by line, so this
+// normally continues from the previous match instead of the buffer start.
+static void resolve_line(ChunkContext *chunk, size_t offset) {
+    if (offset < chunk->counted_offset) {
+        chunk->counted_offset = 0;
+        chunk->counted_line = chunk->first_line;
+        chunk->line_start = 0;
+    }
+    const char *cursor = chunk->buffer + chunk->counted_offset;
+    const char *last_newline = byte_class_find_last(cursor, offset - chunk->counted_offset, '\n');
+    if (last_newline) {
+        chunk->counted_line += byte_class_count(cursor, (size_t)(last_newline - cursor) + 1, '\n');
+        chunk->line_start = (size_t)(last_newline + 1 - chunk->buffer);
+    }
+    chunk->counted_offset = offset;
+}
+
+// Store a match at line and column of the chunk, or at its offset in the
+// file for the strings of a binary file.
+static void store_finding(ChunkContext *chunk,
+                          const char *rule_name,
+                          severity_t severity,
+                          size_t line,
+                          size_t column,
+                          size_t end_line,
+                          size_t end_column) {
+    if (chunk->run_offsets) {
+        line = chunk->run_offsets[line % SCAN_STRINGS_RING] + column - 1;
+        column = 0;
+        end_line = 0;
+        end_column = 0;
+    }
+    if (append_finding(chunk->scanner, rule_name, severity, chunk->path, line, column, end_line, end_column) != 0) {
+        fprintf(stderr, "ERROR: out of memory while storing findings.\n");
+    }
 }
 
 static void match_callback(const char *rule_name,
@@ -388,81 +841,456 @@ static void match_callback(const char *rule_name,
                            size_t end,
                            void *user_data) {
     (void)end;
-    LineContext *line_context = (LineContext *)user_data;
-    size_t column = start + 1;
-    if (append_finding(line_context->scanner,
-                       rule_name,
-                       severity,
-                       line_context->path,
-                       line_context->line_number,
-                       column) != 0) {
-        fprintf(stderr, "ERROR: out of memory while storing findings.\n");
+    ChunkContext *chunk = (ChunkContext *)user_data;
+    resolve_line(chunk, start);
+    size_t column = start - chunk->line_start + 1;
+    store_finding(chunk, rule_name, severity, chunk->counted_line, column, 0, 0);
+}
+
+static void span_callback(const char *rule_name, severity_t severity, const RulesSpan *span, void *user_data) {
+    ChunkContext *chunk = (ChunkContext *)user_data;
+    store_finding(chunk, rule_name, severity, span->start_line, span->start_column, span->end_line, span->end_column);
+}
+
+// Scan whole lines in buffer[0..length), the next part of stream. Returns
+// the number of newlines.
+static size_t scan_chunk(ScannerContext *scanner,
+                         RulesStream *stream,
+                         const char *path,
+                         file_type_t type,
+                         const char *buffer,
+                         size_t length,
+                         size_t first_line) {
+    ChunkContext chunk;
+    chunk.scanner = scanner;
+    chunk.path = path;
+    chunk.buffer = buffer;
+    chunk.first_line = first_line;
+    chunk.counted_offset = 0;
+    chunk.counted_line = first_line;
+    chunk.line_start = 0;
+    chunk.run_offsets = NULL;
+
+    rules_scan_stream(scanner->rules, stream, type, buffer, length, first_line, match_callback, span_callback, &chunk);
+    resolve_line(&chunk, length);
+    return chunk.counted_line - first_line;
+}
+
+// The end of a file's stream: the long line guard and blocks still open,
+// reported at offsets if run_offsets is set (see ChunkContext). Returns 1
+// if the long line guard skipped the file.
+static int end_stream(ScannerContext *scanner, RulesStream *stream, const char *path, const size_t *run_offsets) {
+    int result = 0;
+    if (stream->long_line > 0) {
+        ScannerSkip skip;
+        skip.path = (char *)path;
+        skip.at_offset = run_offsets != NULL;
+        skip.position = run_offsets ? run_offsets[stream->long_line % SCAN_STRINGS_RING] : stream->long_line;
+        fprintf(stderr, "WARNING: skipped %s: ", path);
+        print_skip_reason(&skip, stderr);
+        fprintf(stderr, ".\n");
+        if (insert_skip(scanner, skip, false) != 0) {
+            fprintf(stderr, "ERROR: out of memory while storing skipped files.\n");
+        }
+        result = 1;
     }
+    ChunkContext chunk;
+    memset(&chunk, 0, sizeof(chunk));
+    chunk.scanner = scanner;
+    chunk.path = path;
+    chunk.run_offsets = run_offsets;
+    rules_stream_finish(stream, span_callback, &chunk);
+    return result;
 }
 
-static void scan_line(ScannerContext *scanner,
-                      const char *path,
-                      const char *line,
-                      size_t length,
-                      size_t line_number) {
-    LineContext line_context;
-    line_context.scanner = scanner;
-    line_context.path = path;
-    line_context.line_number = line_number;
+// The rest of a file after its last whole line, then the end of the file:
+// the partial last line, the long line guard and blocks still open.
+// Returns 1 if the long line guard skipped the file.
+static int finish_file(ScannerContext *scanner,
+                       RulesStream *stream,
+                       const char *path,
+                       file_type_t type,
+                       const char *rest,
+                       size_t length,
+                       size_t line_number) {
+    if (length > 0) {
+        scan_chunk(scanner, stream, path, type, rest, length, line_number);
+    }
+    return end_stream(scanner, stream, path, NULL);
+}
+
+// Whether a file of type is skipped by its name: known-irrelevant formats,
+// and binaries unless they are scanned for strings.
+static bool skip_by_name(const ScannerContext *scanner, file_type_t type) {
+    return type == FILE_TYPE_SKIP || (type == FILE_TYPE_BINARY && !scanner->scan_binaries);
+}
+
+// Only the first SCAN_SNIFF_SIZE bytes are looked at, whatever the backend
+// and read size. Binary content turns *type into FILE_TYPE_BINARY.
+bool scanner_sniff_skip(const ScannerContext *scanner, file_type_t *type, const char *data, size_t length) {
+    if (length > SCAN_SNIFF_SIZE) {
+        length = SCAN_SNIFF_SIZE;
+    }
+    if (scanner->classify_files) {
+        *type = file_type_sniff(*type, (const unsigned char *)data, length);
+    }
+    if (*type == FILE_TYPE_SKIP) {
+        return true;
+    }
+    if (*type != FILE_TYPE_BINARY && is_binary_buffer((const unsigned char *)data, length)) {
+        *type = FILE_TYPE_BINARY;
+    }
+    return *type == FILE_TYPE_BINARY && !scanner->scan_binaries;
+}
+
+// The printable strings of a binary file, like strings -n 8: runs of at
+// least SCAN_STRINGS_MIN printable ASCII bytes or tabs, one per line in
+// runs. Whole lines are scanned whenever runs fills up, so a file of any
+// size takes this much memory.
+struct StringsScan {
+    ScannerContext *scanner;
+    const char *path;
+    RulesStream stream;
+    ByteClassSet printable;
+    ByteClassSet unprintable;
+    // runs[0..used): the strings from line first_line on, the last of them
+    // still open at run_start if in_run is set. A string longer than the
+    // buffer is cut into lines; continued marks the rest of one, which is
+    // kept however short.
+    char runs[SCAN_STRINGS_SIZE];
+    size_t used;
+    size_t run_start;
+    size_t first_line;
+    size_t line;
+    bool in_run;
+    bool continued;
+    size_t offsets[SCAN_STRINGS_RING];
+};
+
+static void strings_init(StringsScan *scan, ScannerContext *scanner, const char *path) {
+    unsigned char members[256];
+    for (unsigned int byte = 0; byte < 256; ++byte) {
+        members[byte] = (byte >= 0x20 && byte < 0x7F) || byte == '\t';
+    }
+    byte_class_set_init(&scan->printable, members);
+    for (unsigned int byte = 0; byte < 256; ++byte) {
+        members[byte] = !members[byte];
+    }
+    byte_class_set_init(&scan->unprintable, members);
+    scan->scanner = scanner;
+    scan->path = path;
+    rules_stream_init(&scan->stream);
+    scan->used = 0;
+    scan->run_start = 0;
+    scan->first_line = 1;
+    scan->line = 1;
+    scan->in_run = false;
+    scan->continued = false;
+}
+
+// Scan the whole lines in runs and move the open string to the front.
+static void strings_flush(StringsScan *scan) {
+    size_t complete = scan->in_run ? scan->run_start : scan->used;
+    if (complete > 0) {
+        ChunkContext chunk;
+        memset(&chunk, 0, sizeof(chunk));
+        chunk.scanner = scan->scanner;
+        chunk.path = scan->path;
+        chunk.buffer = scan->runs;
+        chunk.first_line = scan->first_line;
+        chunk.counted_line = scan->first_line;
+        chunk.run_offsets = scan->offsets;
+        rules_scan_stream(scan->scanner->rules,
+                          &scan->stream,
+                          FILE_TYPE_BINARY,
+                          scan->runs,
+                          complete,
+                          scan->first_line,
+                          match_callback,
+                          span_callback,
+                          &chunk);
+    }
+    memmove(scan->runs, scan->runs + complete, scan->used - complete);
+    scan->used -= complete;
+    scan->run_start = 0;
+    scan->first_line = scan->line;
+}
+
+// End the open string: a line if it is long enough, else dropped.
+static void strings_close_run(StringsScan *scan) {
+    if (scan->continued || scan->used - scan->run_start >= SCAN_STRINGS_MIN) {
+        scan->runs[scan->used++] = '\n';
+        scan->line++;
+    } else {
+        scan->used = scan->run_start;
+    }
+    scan->in_run = false;
+    scan->continued = false;
+}
+
+// Collect the strings of data, the bytes of the file from offset on.
+static void strings_feed(StringsScan *scan, const char *data, size_t length, size_t offset) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    size_t i = 0;
+    while (i < length && scan->stream.long_line == 0) {
+        if (!scan->in_run) {
+            i += byte_class_find_set(&scan->printable, bytes + i, length - i);
+            if (i == length) {
+                break;
+            }
+            scan->in_run = true;
+            scan->run_start = scan->used;
+            scan->offsets[scan->line % SCAN_STRINGS_RING] = offset + i;
+        }
+        size_t end = i + byte_class_find_set(&scan->unprintable, bytes + i, length - i);
+        while (i < end) {
+            // One byte stays free for the newline.
+            if (scan->used >= sizeof(scan->runs) - 1) {
+                if (scan->run_start == 0) {
+                    // The string fills the buffer: cut it here.
+                    scan->runs[scan->used++] = '\n';
+                    scan->line++;
+                    scan->run_start = scan->used;
+                    scan->continued = true;
+                    scan->offsets[scan->line % SCAN_STRINGS_RING] = offset + i;
+                }
+                strings_flush(scan);
+                if (scan->stream.long_line > 0) {
+                    return;
+                }
+            }
+            size_t copy = end - i;
+            if (copy > sizeof(scan->runs) - 1 - scan->used) {
+                copy = sizeof(scan->runs) - 1 - scan->used;
+            }
+            memcpy(scan->runs + scan->used, data + i, copy);
+            scan->used += copy;
+            i += copy;
+        }
+        if (end < length) {
+            strings_close_run(scan);
+        }
+    }
+}
+
+// Scan the strings of a binary file: length bytes at data, then whatever
+// is left to read from file_descriptor (-1 for none). A mapped file is
+// released page by page as its strings are taken out. Returns 0 when
+// done, 1 if the long line guard skipped the file, -1 on a read error.
+static int scan_strings(ScannerContext *scanner,
+                        const char *path,
+                        const char *data,
+                        size_t length,
+                        bool mapped,
+                        int file_descriptor) {
+    // Allocated for the first binary file and reused for the others.
+    if (!scanner->strings) {
+        scanner->strings = malloc(sizeof(*scanner->strings));
+        if (!scanner->strings) {
+            return -1;
+        }
+        scanner->allocations++;
+    }
+    StringsScan *scan = scanner->strings;
+    strings_init(scan, scanner, path);
+    size_t offset = 0;
+    while (offset < length && scan->stream.long_line == 0) {
+        size_t window = length - offset;
+        if (mapped && window > SCAN_STRINGS_WINDOW) {
+            window = SCAN_STRINGS_WINDOW;
+        }
+        strings_feed(scan, data + offset, window, offset);
+        if (mapped) {
+            madvise((void *)(data + offset), window, MADV_DONTNEED);
+        }
+        offset += window;
+    }
 
-    rules_scan_line(scanner->rules, line, length, match_callback, &line_context);
+    int result = 0;
+    if (file_descriptor >= 0 && scan->stream.long_line == 0) {
+        if (!scanner->read_buffer) {
+            scanner->read_buffer = malloc(scanner->io_buffer_size);
+            if (!scanner->read_buffer) {
+                return -1;
+            }
+            scanner->read_capacity = scanner->io_buffer_size;
+            scanner->allocations++;
+        }
+        ssize_t bytes_read = 0;
+        while (scan->stream.long_line == 0 &&
+               (bytes_read = read(file_descriptor, scanner->read_buffer, scanner->read_capacity)) > 0) {
+            strings_feed(scan, scanner->read_buffer, (size_t)bytes_read, offset);
+            offset += (size_t)bytes_read;
+        }
+        if (bytes_read < 0) {
+            fprintf(stderr, "ERROR: read failed on %s: %s\n", path, strerror(errno));
+            result = -1;
+        }
+    }
+
+    if (scan->in_run) {
+        strings_close_run(scan);
+    }
+    if (scan->stream.long_line == 0) {
+        strings_flush(scan);
+    }
+    if (end_stream(scanner, &scan->stream, path, scan->offsets) != 0) {
+        result = 1;
+    }
+    return result;
 }
 
-// Read the file in chunks and split into lines across buffer boundaries.
+int scanner_scan_binary(ScannerContext *scanner,
+                        const char *path,
+                        const char *head,
+                        size_t length,
+                        int file_descriptor) {
+    if (!scanner || !path || (!head && length > 0)) {
+        return -1;
+    }
+    return scan_strings(scanner, path, head, length, false, file_descriptor);
+}
+
+// Scan a whole file that is in memory (mapped, or read in one go).
+// Returns 1 if the file is skipped, like scan_file_descriptor.
+static int scan_memory(ScannerContext *scanner,
+                       const char *path,
+                       file_type_t type,
+                       const char *data,
+                       size_t length,
+                       bool mapped) {
+    if (length > 0 && scanner_sniff_skip(scanner, &type, data, length)) {
+        return 1;
+    }
+    if (type == FILE_TYPE_BINARY) {
+        return scan_strings(scanner, path, data, length, mapped, -1);
+    }
+    RulesStream stream;
+    rules_stream_init(&stream);
+    const char *last_newline = byte_class_find_last(data, length, '\n');
+    size_t complete = last_newline ? (size_t)(last_newline - data) + 1 : 0;
+    size_t line_number = 1;
+    if (complete > 0) {
+        line_number += scan_chunk(scanner, &stream, path, type, data, complete, line_number);
+    }
+    return finish_file(scanner, &stream, path, type, data + complete, length - complete, line_number);
+}
+
+size_t scanner_long_line_keep(const ScannerContext *scanner) {
+    size_t limit = rules_get_max_line_length(scanner->rules);
+    return limit > 0 ? limit + 2 : 0;
+}
+
+// Read the file in chunks and hand every run of complete lines to the rules
+// engine at once. A partial last line is carried over to the next read;
+// blocks of multi-line rules are carried over in a RulesStream. A line
+// over the length limit skips the file as soon as that much of it is read
+// (RULES_LONG_LINE_SKIP), or is cut to scanner_long_line_keep bytes, so
+// the buffer stays bounded.
+// The prefix_length bytes at prefix, already read from the file by the
+// caller, come before the rest. Returns 1 if the file is skipped: the
+// first chunk shows it is binary, or the long line guard skipped one of
+// its lines.
 static int scan_file_descriptor(ScannerContext *scanner,
                                 const char *path,
-                                int file_descriptor) {
-    char buffer[SCAN_BUFFER_SIZE];
-    char *line_buffer = NULL;
-    size_t line_capacity = 0;
-    size_t line_length = 0;
+                                file_type_t type,
+                                int file_descriptor,
+                                const char *prefix,
+                                size_t prefix_length) {
+    // The read buffer is kept from file to file, so scanning a file
+    // normally allocates nothing.
+    if (!scanner->read_buffer) {
+        scanner->read_buffer = malloc(scanner->io_buffer_size);
+        if (!scanner->read_buffer) {
+            return -1;
+        }
+        scanner->read_capacity = scanner->io_buffer_size;
+        scanner->allocations++;
+    }
+    char *buffer = scanner->read_buffer;
+    size_t capacity = scanner->read_capacity;
+    size_t used = 0;
     size_t line_number = 1;
     int result = 0;
     bool checked_binary = false;
+    size_t keep = scanner_long_line_keep(scanner);
+    // Set while the rest of a cut line is dropped.
+    bool dropping = false;
+    RulesStream stream;
+    rules_stream_init(&stream);
 
     ssize_t bytes_read = 0;
-    while ((bytes_read = read(file_descriptor, buffer, sizeof(buffer))) > 0) {
+    while (true) {
+        if (used == capacity) {
+            // A line longer than the buffer: grow it to hold the whole line,
+            // or up to keep bytes of it.
+            char *resized = realloc(buffer, capacity * 2);
+            if (!resized) {
+                result = -1;
+                goto cleanup;
+            }
+            buffer = resized;
+            capacity *= 2;
+            scanner->allocations++;
+        }
+        if (prefix_length > 0) {
+            size_t take = prefix_length < capacity - used ? prefix_length : capacity - used;
+            memcpy(buffer + used, prefix, take);
+            prefix += take;
+            prefix_length -= take;
+            bytes_read = (ssize_t)take;
+        } else {
+            bytes_read = read(file_descriptor, buffer + used, capacity - used);
+        }
+        if (bytes_read <= 0) {
+            break;
+        }
         if (!checked_binary) {
             checked_binary = true;
-            if (is_binary_buffer((const unsigned char *)buffer, (size_t)bytes_read)) {
+            if (scanner_sniff_skip(scanner, &type, buffer, (size_t)bytes_read)) {
                 result = 1;
                 goto cleanup;
             }
+            if (type == FILE_TYPE_BINARY) {
+                result = scan_strings(scanner, path, buffer, (size_t)bytes_read, false, file_descriptor);
+                goto cleanup;
+            }
         }
 
-        for (ssize_t i = 0; i < bytes_read; ++i) {
-            char current = buffer[i];
-            if (line_length + 2 > line_capacity) {
-                size_t new_capacity = line_capacity ? line_capacity * 2 : 256;
-                while (new_capacity < line_length + 2) {
-                    new_capacity *= 2;
-                }
-                char *resized = realloc(line_buffer, new_capacity);
-                if (!resized) {
-                    result = -1;
-                    goto cleanup;
-                }
-                line_buffer = resized;
-                line_capacity = new_capacity;
-            }
-
-            if (current == '\n') {
-                if (line_length > 0 && line_buffer[line_length - 1] == '\r') {
-                    line_length--;
-                }
-                line_buffer[line_length] = '\0';
-                scan_line(scanner, path, line_buffer, line_length, line_number);
-                line_length = 0;
-                line_number++;
-            } else {
-                line_buffer[line_length] = current;
-                line_length++;
+        size_t scan_from = used;
+        used += (size_t)bytes_read;
+        if (dropping) {
+            // The newline of the cut line was counted with its kept part.
+            const char *newline = memchr(buffer + scan_from, '\n', used - scan_from);
+            if (!newline) {
+                used = scan_from;
+                continue;
             }
+            size_t end = (size_t)(newline - buffer) + 1;
+            memmove(buffer + scan_from, buffer + end, used - end);
+            used -= end - scan_from;
+            dropping = false;
+        }
+        // Only the lines completed by this read are new; the rest of the
+        // buffer is a carried-over partial line without a newline.
+        const char *last_newline = byte_class_find_last(buffer + scan_from, used - scan_from, '\n');
+        if (last_newline) {
+            size_t complete = (size_t)(last_newline - buffer) + 1;
+            line_number += scan_chunk(scanner, &stream, path, type, buffer, complete, line_number);
+            memmove(buffer, buffer + complete, used - complete);
+            used -= complete;
+        }
+        if (keep > 0 && used > keep && stream.long_line == 0 &&
+            !rules_stream_skip_long_line(scanner->rules, &stream, line_number)) {
+            // The partial line is over the limit and not skipped: scan its
+            // first keep bytes as a line and drop the rest.
+            buffer[keep] = '\n';
+            line_number += scan_chunk(scanner, &stream, path, type, buffer, keep + 1, line_number);
+            used = 0;
+            dropping = true;
+        }
+        if (stream.long_line > 0) {
+            break;
         }
     }
 
@@ -470,14 +1298,54 @@ static int scan_file_descriptor(ScannerContext *scanner,
         fprintf(stderr, "ERROR: read failed on %s: %s\n", path, strerror(errno));
         result = -1;
     }
-
-    if (line_length > 0) {
-        line_buffer[line_length] = '\0';
-        scan_line(scanner, path, line_buffer, line_length, line_number);
+    if (finish_file(scanner, &stream, path, type, buffer, used, line_number) != 0) {
+        result = 1;
     }
 
 cleanup:
-    free(line_buffer);
+    if (capacity > SCAN_BUFFER_KEEP_SIZE && capacity > scanner->io_buffer_size) {
+        free(buffer);
+        buffer = NULL;
+        capacity = 0;
+    }
+    scanner->read_buffer = buffer;
+    scanner->read_capacity = capacity;
+    return result;
+}
+
+// Scan an open file with the backend io picks for it (SCANNER_IO_URING
+// reads like SCANNER_IO_READ here).
+static int scan_open_file(ScannerContext *scanner,
+                          const char *path,
+                          file_type_t type,
+                          int file_descriptor,
+                          scanner_io_t io) {
+    struct stat info;
+    if ((io == SCANNER_IO_AUTO || io == SCANNER_IO_MMAP) && fstat(file_descriptor, &info) == 0 &&
+        S_ISREG(info.st_mode) && info.st_size > 0 && (uint64_t)info.st_size <= SIZE_MAX &&
+        (io == SCANNER_IO_MMAP || (size_t)info.st_size >= SCANNER_MMAP_MIN_SIZE)) {
+        size_t size = (size_t)info.st_size;
+        void *mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+        if (mapped != MAP_FAILED) {
+            madvise(mapped, size, MADV_SEQUENTIAL);
+            int result = scan_memory(scanner, path, type, mapped, size, true);
+            munmap(mapped, size);
+            return result;
+        }
+    }
+    return scan_file_descriptor(scanner, path, type, file_descriptor, NULL, 0);
+}
+
+// Count a file by the result of scanning it (1: skipped).
+static int count_file(ScannerContext *scanner, int result) {
+    if (result == 0) {
+        scanner->files_scanned++;
+    } else if (result > 0) {
+        scanner->files_skipped++;
+        result = 0;
+    } else {
+        scanner->files_skipped++;
+    }
     return result;
 }
 
@@ -486,6 +1354,13 @@ int scanner_scan_path(ScannerContext *scanner, const char *path) {
         return -1;
     }
 
+    // Known-irrelevant files are skipped by name without opening them.
+    file_type_t type = scanner->classify_files ? file_type_from_path(path) : FILE_TYPE_UNKNOWN;
+    if (skip_by_name(scanner, type)) {
+        scanner->files_skipped++;
+        return 0;
+    }
+
     int file_descriptor = open(path, O_RDONLY);
     if (file_descriptor < 0) {
         fprintf(stderr, "ERROR: failed to open %s: %s\n", path, strerror(errno));
@@ -493,17 +1368,308 @@ int scanner_scan_path(ScannerContext *scanner, const char *path) {
         return -1;
     }
 
-    int result = scan_file_descriptor(scanner, path, file_descriptor);
+    int result = scan_open_file(scanner, path, type, file_descriptor, scanner->io);
     close(file_descriptor);
-    if (result == 0) {
-        scanner->files_scanned++;
-    } else if (result > 0) {
+    return count_file(scanner, result);
+}
+
+static int ensure_ring(ScannerContext *scanner) {
+    if (scanner->ring) {
+        return 0;
+    }
+    scanner->ring_buffers = malloc(SCANNER_URING_DEPTH * scanner->io_buffer_size);
+    scanner->ring = scanner->ring_buffers ? io_ring_create(SCANNER_URING_DEPTH) : NULL;
+    if (!scanner->ring) {
+        free(scanner->ring_buffers);
+        scanner->ring_buffers = NULL;
+        return -1;
+    }
+    scanner->allocations++;
+    return 0;
+}
+
+typedef enum { RING_SLOT_IDLE = 0, RING_SLOT_OPENING, RING_SLOT_READING } ring_slot_t;
+
+// Take up to outstanding completions from a failed ring, waiting for them
+// while it still lets us, and keep the descriptors of the files they
+// opened.
+static void drain_ring(IoRing *ring, const ring_slot_t *states, int *descriptors, size_t outstanding) {
+    while (outstanding > 0) {
+        uint64_t slot = 0;
+        int value = 0;
+        if (!io_ring_next(ring, &slot, &value)) {
+            if (io_ring_submit(ring, 1) != 0) {
+                return;
+            }
+            continue;
+        }
+        outstanding--;
+        if (states[slot] == RING_SLOT_OPENING && value >= 0) {
+            descriptors[slot] = value;
+        }
+    }
+}
+
+// Scan up to SCANNER_URING_DEPTH paths: every open is queued at once, each
+// opened file gets its first read queued, and each file is scanned as its
+// read completes, while the others are still on their way. A short read
+// is the whole file only if fstat gives a regular file of that size; a
+// file that fills the read or changed size is read again by
+// scan_open_file, and a FIFO or device carries on from its first read.
+// Returns 0 if every path was scanned, -1 if any failed.
+static int scan_ring_batch(ScannerContext *scanner, char *const *paths, size_t count) {
+    ring_slot_t states[SCANNER_URING_DEPTH];
+    file_type_t types[SCANNER_URING_DEPTH];
+    int descriptors[SCANNER_URING_DEPTH];
+    size_t outstanding = 0;
+    int result = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        states[i] = RING_SLOT_IDLE;
+        descriptors[i] = -1;
+        types[i] = scanner->classify_files ? file_type_from_path(paths[i]) : FILE_TYPE_UNKNOWN;
+        if (skip_by_name(scanner, types[i])) {
+            scanner->files_skipped++;
+        } else if (io_ring_queue_open(scanner->ring, paths[i], O_RDONLY | O_CLOEXEC, i) == 0) {
+            states[i] = RING_SLOT_OPENING;
+            outstanding++;
+        } else if (scanner_scan_path(scanner, paths[i]) != 0) {
+            result = -1;
+        }
+    }
+
+    while (outstanding > 0) {
+        uint64_t slot = 0;
+        int value = 0;
+        if (!io_ring_next(scanner->ring, &slot, &value)) {
+            if (io_ring_submit(scanner->ring, 1) != 0) {
+                break;
+            }
+            continue;
+        }
+        outstanding--;
+        const char *path = paths[slot];
+        char *buffer = scanner->ring_buffers + slot * scanner->io_buffer_size;
+
+        if (states[slot] == RING_SLOT_OPENING) {
+            if (value == -EINVAL) {
+                // Kernels before 5.6 have no IORING_OP_OPENAT.
+                states[slot] = RING_SLOT_IDLE;
+                result = scanner_scan_path(scanner, path) != 0 ? -1 : result;
+            } else if (value < 0) {
+                states[slot] = RING_SLOT_IDLE;
+                fprintf(stderr, "ERROR: failed to open %s: %s\n", path, strerror(-value));
+                scanner->files_skipped++;
+                result = -1;
+            } else {
+                descriptors[slot] = value;
+                states[slot] = RING_SLOT_READING;
+                // Once queued, the read is submitted here or by the next
+                // wait, so the file stays open until it completes.
+                if (io_ring_queue_read(scanner->ring, value, buffer, scanner->io_buffer_size, 0, slot) == 0) {
+                    io_ring_submit(scanner->ring, 0);
+                    outstanding++;
+                } else {
+                    states[slot] = RING_SLOT_IDLE;
+                    int file_result = scan_open_file(scanner, path, types[slot], value, SCANNER_IO_AUTO);
+                    result = count_file(scanner, file_result) != 0 ? -1 : result;
+                    close(value);
+                    descriptors[slot] = -1;
+                }
+            }
+            continue;
+        }
+
+        int file_result = 0;
+        struct stat info;
+        bool known = value >= 0 && fstat(descriptors[slot], &info) == 0;
+        if (value < 0 && value != -EINVAL && value != -ESPIPE) {
+            fprintf(stderr, "ERROR: read failed on %s: %s\n", path, strerror(-value));
+            file_result = -1;
+        } else if (known && !S_ISREG(info.st_mode)) {
+            // A FIFO or device has no offset to read at: the read took the
+            // first bytes of the stream, and the rest follows.
+            file_result =
+                scan_file_descriptor(scanner, path, types[slot], descriptors[slot], buffer, (size_t)value);
+        } else if (known && (size_t)value < scanner->io_buffer_size && (uint64_t)info.st_size == (uint64_t)value) {
+            // A short read of a regular file of that size is the whole file.
+            file_result = scan_memory(scanner, path, types[slot], buffer, (size_t)value, false);
+        } else {
+            // Larger than one read, a file that changed size, or a refused
+            // read: from the start, the pread above did not move the file
+            // offset.
+            file_result = scan_open_file(scanner, path, types[slot], descriptors[slot], SCANNER_IO_AUTO);
+        }
+        result = count_file(scanner, file_result) != 0 ? -1 : result;
+        close(descriptors[slot]);
+        descriptors[slot] = -1;
+        states[slot] = RING_SLOT_IDLE;
+    }
+
+    if (outstanding > 0) {
+        // The ring failed under us: take the completions still due, so the
+        // files opened under it are closed rather than leaked, then drop it
+        // (the kernel cancels what is in flight) and scan the files it
+        // still held one by one.
+        fprintf(stderr, "WARNING: io_uring failed (%s); reading files one by one.\n", strerror(errno));
+        drain_ring(scanner->ring, states, descriptors, outstanding);
+        io_ring_destroy(scanner->ring);
+        scanner->ring = NULL;
+        for (size_t i = 0; i < count; ++i) {
+            if (descriptors[i] >= 0) {
+                close(descriptors[i]);
+            }
+            if (states[i] != RING_SLOT_IDLE && scanner_scan_path(scanner, paths[i]) != 0) {
+                result = -1;
+            }
+        }
+        scanner->io = SCANNER_IO_AUTO;
+    }
+    return result;
+}
+
+int scanner_scan_paths(ScannerContext *scanner, char *const *paths, size_t count) {
+    if (!scanner || (!paths && count > 0)) {
+        return -1;
+    }
+    int result = 0;
+    if (scanner->io == SCANNER_IO_URING && ensure_ring(scanner) == 0) {
+        for (size_t i = 0; i < count && scanner->ring; i += SCANNER_URING_DEPTH) {
+            size_t batch = count - i < SCANNER_URING_DEPTH ? count - i : SCANNER_URING_DEPTH;
+            if (scan_ring_batch(scanner, paths + i, batch) != 0) {
+                result = -1;
+            }
+            if (!scanner->ring) {
+                // Fell back; scan the rest without the ring.
+                for (size_t j = i + batch; j < count; ++j) {
+                    result = scanner_scan_path(scanner, paths[j]) != 0 ? -1 : result;
+                }
+            }
+        }
+        return result;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (scanner_scan_path(scanner, paths[i]) != 0) {
+            result = -1;
+        }
+    }
+    return result;
+}
+
+int scanner_map_file(ScannerContext *scanner, const char *path, file_type_t *type, const char **data, size_t *length) {
+    if (!scanner || !path || !type || !data || !length) {
+        return -1;
+    }
+    *type = scanner->classify_files ? file_type_from_path(path) : FILE_TYPE_UNKNOWN;
+    if (skip_by_name(scanner, *type)) {
         scanner->files_skipped++;
-        result = 0;
-    } else {
+        return 1;
+    }
+    if (*type == FILE_TYPE_BINARY) {
+        // Strings are taken out in one pass: scanner_scan_path streams it.
+        return -1;
+    }
+
+    int file_descriptor = open(path, O_RDONLY);
+    if (file_descriptor < 0) {
+        return -1;
+    }
+    struct stat info;
+    void *mapped = MAP_FAILED;
+    if (fstat(file_descriptor, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0 &&
+        (uint64_t)info.st_size <= SIZE_MAX) {
+        mapped = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+    }
+    close(file_descriptor);
+    if (mapped == MAP_FAILED) {
+        return -1;
+    }
+
+    size_t size = (size_t)info.st_size;
+    madvise(mapped, size, MADV_SEQUENTIAL);
+    if (scanner_sniff_skip(scanner, type, mapped, size)) {
+        munmap(mapped, size);
         scanner->files_skipped++;
+        return 1;
     }
-    return result;
+    if (*type == FILE_TYPE_BINARY) {
+        munmap(mapped, size);
+        return -1;
+    }
+    *data = mapped;
+    *length = size;
+    return 0;
+}
+
+void scanner_unmap_file(const char *data, size_t length) {
+    if (data) {
+        munmap((void *)data, length);
+    }
+}
+
+void scanner_scan_part(ScannerPart *part, RulesEngine *rules, ScannerContext *owner) {
+    if (!part || !rules) {
+        return;
+    }
+    scanner_init(&part->scanner, rules);
+    part->scanner.classify_files = false;
+    if (owner) {
+        // Without the shared table, joining the part copies its paths.
+        scanner_share_paths(&part->scanner, owner);
+    }
+    rules_stream_init(&part->stream);
+    part->lines = 0;
+    if (!part->data) {
+        return;
+    }
+    const char *last_newline = byte_class_find_last(part->data, part->length, '\n');
+    size_t complete = last_newline ? (size_t)(last_newline - part->data) + 1 : 0;
+    if (complete > 0) {
+        part->lines = scan_chunk(&part->scanner, &part->stream, part->path, part->type, part->data, complete, 1);
+    }
+    if (complete < part->length) {
+        scan_chunk(&part->scanner, &part->stream, part->path, part->type, part->data + complete,
+                   part->length - complete, part->lines + 1);
+    }
+}
+
+static void ignore_span(const char *rule_name, severity_t severity, const RulesSpan *span, void *user_data) {
+    (void)rule_name;
+    (void)severity;
+    (void)span;
+    (void)user_data;
+}
+
+bool scanner_join_part(ScannerContext *dest, ScannerPart *const *parts, size_t count, bool ended, size_t first_line) {
+    if (!dest || !parts || count == 0) {
+        return false;
+    }
+    ScannerPart *part = parts[0];
+    // Try the blocks on a copy first, so nothing changes if the input
+    // given does not reach their end.
+    RulesStream probe = part->stream;
+    for (size_t i = 1; i < count && probe.count > 0; ++i) {
+        rules_stream_follow(&probe, parts[i]->data, parts[i]->length, ignore_span, NULL);
+    }
+    if (probe.count > 0 && !ended) {
+        return false;
+    }
+
+    ChunkContext chunk;
+    memset(&chunk, 0, sizeof(chunk));
+    chunk.scanner = &part->scanner;
+    chunk.path = part->path;
+    for (size_t i = 1; i < count && part->stream.count > 0; ++i) {
+        rules_stream_follow(&part->stream, parts[i]->data, parts[i]->length, span_callback, &chunk);
+    }
+    rules_stream_finish(&part->stream, span_callback, &chunk);
+
+    for (size_t i = 0; i < part->scanner.finding_count; ++i) {
+        part->scanner.findings[i].line_number += first_line - 1;
+    }
+    scanner_merge(dest, &part->scanner);
+    scanner_destroy(&part->scanner);
+    return true;
 }
 
 int scanner_scan_stdin(ScannerContext *scanner) {
@@ -511,7 +1677,7 @@ int scanner_scan_stdin(ScannerContext *scanner) {
         return -1;
     }
 
-    int result = scan_file_descriptor(scanner, DEFAULT_STDIN_LABEL, STDIN_FILENO);
+    int result = scan_file_descriptor(scanner, DEFAULT_STDIN_LABEL, FILE_TYPE_UNKNOWN, STDIN_FILENO, NULL, 0);
     if (result == 0) {
         scanner->files_scanned++;
     } else if (result > 0) {
@@ -1,19 +1,132 @@
 #include "scanner_parallel.h"
 
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
+#include "arena.h"
+#include "byte_class.h"
 #include "thread_pool.h"
 #include "util.h"
 #include "walk.h"
 
 #define DEFAULT_QUEUE_CAPACITY 256
+// Parts of a file per thread, so threads that finish early find more work.
+#define PARTS_PER_THREAD 4
+// Parts of standard input read ahead per thread.
+#define STDIN_PARTS_PER_THREAD 2
+// Arena block of a path batch: room for a batch of paths of 128 bytes.
+#define PATH_BATCH_BLOCK_SIZE (SCANNER_URING_DEPTH * 128)
 
 typedef struct {
-    // Each worker keeps its own scanner to avoid shared-state locks.
+    // Each worker keeps its own scanner and rules engine to avoid
+    // shared-state locks (glibc locks every regex_t inside regexec).
     ScannerContext scanner;
+    RulesEngine rules;
 } WorkerContext;
 
+// Every job starts with its kind.
+typedef enum {
+    SCAN_JOB_PATH,
+    SCAN_JOB_BATCH,
+    SCAN_JOB_PART,
+    SCAN_JOB_SORT
+} scan_job_kind_t;
+
+typedef struct {
+    scan_job_kind_t kind;
+    char path[];
+} PathJob;
+
+typedef struct PathBatch PathBatch;
+
+// Batches done with, for the walk to fill again.
+typedef struct {
+    pthread_mutex_t mutex;
+    PathBatch *free;
+} BatchList;
+
+// With --io uring the walker hands out paths in batches, so one worker
+// keeps a batch's opens and reads in flight together. The paths are
+// copied into the batch's arena; the worker that scanned the batch resets
+// it and puts the batch on the free list, so after the first batches the
+// walk copies paths without allocating.
+struct PathBatch {
+    scan_job_kind_t kind;
+    size_t count;
+    char *paths[SCANNER_URING_DEPTH];
+    Arena arena;
+    BatchList *list;
+    PathBatch *next;
+};
+
+// A large file or standard input scanned in parts by all workers (see
+// ScannerPart). Parts are joined in input order by whichever thread finds
+// the next one ready, into that thread's scanner.
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    char *path;
+    file_type_t type;
+    // Holds the shared path table.
+    ScannerContext *owner;
+    // The mapped file, or NULL for standard input, whose parts own their
+    // data.
+    const char *mapping;
+    size_t mapping_length;
+    // Parts in input order (NULL once joined) and whether each is scanned.
+    ScannerPart **parts;
+    bool *done;
+    size_t count;
+    size_t capacity;
+    size_t joined;
+    // Parts submitted and not scanned yet.
+    size_t scanning;
+    // Line number of the first line of the next part to join.
+    size_t next_line;
+    // No parts will be added; the input is over.
+    bool ended;
+    bool read_failed;
+    bool finished;
+} SplitInput;
+
+typedef struct {
+    scan_job_kind_t kind;
+    SplitInput *split;
+    size_t index;
+} PartJob;
+
+// After the scan every worker sorts its own findings. A worker that has
+// sorted waits until remaining reaches 0, so no worker takes two sort
+// jobs and each is left one.
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t sorted;
+    size_t remaining;
+} SortRound;
+
+typedef struct {
+    scan_job_kind_t kind;
+    SortRound *round;
+} SortJob;
+
+// What the walk does with each file: scan it (scanner, one thread), queue
+// it for the pool, or add it to a batch; and files of at least split_size
+// bytes are queued in parts.
+typedef struct {
+    ThreadPool *pool;
+    ScannerContext *scanner;
+    RulesEngine *rules;
+    PathBatch *batch;
+    BatchList batches;
+    bool batched;
+    uint64_t split_size;
+    size_t thread_count;
+} WalkState;
+
 static size_t get_cpu_count(void) {
     long count = sysconf(_SC_NPROCESSORS_ONLN);
     if (count < 1) {
@@ -29,54 +142,610 @@ static size_t resolve_thread_count(int requested) {
     return (size_t)requested;
 }
 
+static void destroy_split(SplitInput *split) {
+    for (size_t i = split->joined; i < split->count; ++i) {
+        if (!split->parts[i]) {
+            continue;
+        }
+        if (split->done[i]) {
+            scanner_destroy(&split->parts[i]->scanner);
+        }
+        if (!split->mapping) {
+            free((char *)split->parts[i]->data);
+        }
+        free(split->parts[i]);
+    }
+    scanner_unmap_file(split->mapping, split->mapping_length);
+    pthread_mutex_destroy(&split->mutex);
+    pthread_cond_destroy(&split->changed);
+    free(split->parts);
+    free(split->done);
+    free(split->path);
+    free(split);
+}
+
+static SplitInput *create_split(const char *path, file_type_t type, ScannerContext *owner) {
+    SplitInput *split = calloc(1, sizeof(*split));
+    if (!split) {
+        return NULL;
+    }
+    split->path = duplicate_string(path);
+    if (!split->path || pthread_mutex_init(&split->mutex, NULL) != 0) {
+        free(split->path);
+        free(split);
+        return NULL;
+    }
+    if (pthread_cond_init(&split->changed, NULL) != 0) {
+        pthread_mutex_destroy(&split->mutex);
+        free(split->path);
+        free(split);
+        return NULL;
+    }
+    split->type = type;
+    split->owner = owner;
+    split->next_line = 1;
+    return split;
+}
+
+// Append a part for data[0..length). Returns its index, or -1 on
+// allocation failure. Call with the mutex held once parts are queued.
+static long add_part(SplitInput *split, const char *data, size_t length) {
+    if (split->count == split->capacity) {
+        size_t capacity = split->capacity ? split->capacity * 2 : 16;
+        ScannerPart **parts = realloc(split->parts, capacity * sizeof(*parts));
+        if (!parts) {
+            return -1;
+        }
+        split->parts = parts;
+        bool *done = realloc(split->done, capacity * sizeof(*done));
+        if (!done) {
+            return -1;
+        }
+        split->done = done;
+        split->capacity = capacity;
+    }
+    ScannerPart *part = calloc(1, sizeof(*part));
+    if (!part) {
+        return -1;
+    }
+    part->data = data;
+    part->length = length;
+    part->path = split->path;
+    part->type = split->type;
+    split->parts[split->count] = part;
+    split->done[split->count] = false;
+    return (long)split->count++;
+}
+
+// Join the parts that are ready, in order, into dest. The thread that
+// joins the last part counts the input. Returns true if that was this
+// call. Call with the mutex held.
+static bool join_parts(SplitInput *split, ScannerContext *dest) {
+    while (split->joined < split->count && split->done[split->joined]) {
+        size_t index = split->joined;
+        ScannerPart *part = split->parts[index];
+        if (!scanner_join_part(dest, split->parts + index, split->count - index, split->ended, split->next_line)) {
+            break;
+        }
+        // Earlier parts are joined, so nothing reads this one's data again.
+        split->next_line += part->lines;
+        if (!split->mapping) {
+            free((char *)part->data);
+        }
+        free(part);
+        split->parts[index] = NULL;
+        split->joined++;
+    }
+    if (split->finished || !split->ended || split->joined < split->count) {
+        return false;
+    }
+    split->finished = true;
+    if (split->read_failed) {
+        dest->files_skipped++;
+        dest->scan_failed = true;
+    } else {
+        dest->files_scanned++;
+    }
+    return true;
+}
+
+// Scan part index of split into dest's results with rules.
+static void scan_split_part(SplitInput *split, size_t index, RulesEngine *rules, ScannerContext *dest) {
+    pthread_mutex_lock(&split->mutex);
+    ScannerPart *part = split->parts[index];
+    pthread_mutex_unlock(&split->mutex);
+
+    scanner_scan_part(part, rules, split->owner);
+
+    pthread_mutex_lock(&split->mutex);
+    split->done[index] = true;
+    split->scanning--;
+    // A file's parts are all queued before any can finish it, so the
+    // thread that does releases it; standard input is released by its
+    // reader, which may do so as soon as the mutex is unlocked.
+    bool release = join_parts(split, dest) && split->mapping;
+    pthread_cond_broadcast(&split->changed);
+    pthread_mutex_unlock(&split->mutex);
+    if (release) {
+        destroy_split(split);
+    }
+}
+
 static void scan_job(void *job, void *worker_context, void *shared_context) {
     (void)shared_context;
     WorkerContext *worker = (WorkerContext *)worker_context;
-    const char *path = (const char *)job;
-    scanner_scan_path(&worker->scanner, path);
+    switch (*(scan_job_kind_t *)job) {
+    case SCAN_JOB_PATH:
+        scanner_scan_path(&worker->scanner, ((PathJob *)job)->path);
+        break;
+    case SCAN_JOB_BATCH: {
+        PathBatch *batch = (PathBatch *)job;
+        scanner_scan_paths(&worker->scanner, batch->paths, batch->count);
+        break;
+    }
+    case SCAN_JOB_PART: {
+        PartJob *part = (PartJob *)job;
+        scan_split_part(part->split, part->index, &worker->rules, &worker->scanner);
+        break;
+    }
+    case SCAN_JOB_SORT: {
+        SortRound *round = ((SortJob *)job)->round;
+        scanner_sort_findings(&worker->scanner);
+        pthread_mutex_lock(&round->mutex);
+        round->remaining--;
+        pthread_cond_broadcast(&round->sorted);
+        while (round->remaining > 0) {
+            pthread_cond_wait(&round->sorted, &round->mutex);
+        }
+        pthread_mutex_unlock(&round->mutex);
+        break;
+    }
+    }
+}
+
+// Empty batch and put it on its free list.
+static void release_batch(PathBatch *batch) {
+    batch->count = 0;
+    arena_reset(&batch->arena);
+    pthread_mutex_lock(&batch->list->mutex);
+    batch->next = batch->list->free;
+    batch->list->free = batch;
+    pthread_mutex_unlock(&batch->list->mutex);
+}
+
+// A batch from the free list, or a new one. Returns NULL on allocation
+// failure.
+static PathBatch *take_batch(BatchList *list) {
+    pthread_mutex_lock(&list->mutex);
+    PathBatch *batch = list->free;
+    if (batch) {
+        list->free = batch->next;
+    }
+    pthread_mutex_unlock(&list->mutex);
+    if (!batch) {
+        batch = calloc(1, sizeof(*batch));
+        if (!batch) {
+            return NULL;
+        }
+        batch->kind = SCAN_JOB_BATCH;
+        arena_init(&batch->arena, PATH_BATCH_BLOCK_SIZE);
+        batch->list = list;
+    }
+    return batch;
+}
+
+// Free the batches on list once no job holds one.
+static void destroy_batches(BatchList *list) {
+    while (list->free) {
+        PathBatch *next = list->free->next;
+        arena_destroy(&list->free->arena);
+        free(list->free);
+        list->free = next;
+    }
+    pthread_mutex_destroy(&list->mutex);
 }
 
 static void free_job(void *job) {
-    free(job);
+    switch (*(scan_job_kind_t *)job) {
+    case SCAN_JOB_BATCH:
+        release_batch((PathBatch *)job);
+        break;
+    case SCAN_JOB_SORT:
+        // Sort jobs belong to sort_worker_findings.
+        break;
+    default:
+        free(job);
+        break;
+    }
+}
+
+// Queue part index of split, or scan it here with the walk's scanner if
+// the pool takes no more jobs. Returns 0 on success, -1 on error.
+static int submit_part(WalkState *state, SplitInput *split, size_t index) {
+    PartJob *job = malloc(sizeof(*job));
+    if (job) {
+        job->kind = SCAN_JOB_PART;
+        job->split = split;
+        job->index = index;
+        if (thread_pool_submit(state->pool, job) == 0) {
+            return 0;
+        }
+        free(job);
+    }
+    scan_split_part(split, index, state->rules, state->scanner);
+    return job ? 0 : -1;
+}
+
+// Map path and queue it in parts, so all workers share it. Returns 0 if
+// it was queued or skipped, -1 if it was not mapped.
+static int submit_split_file(WalkState *state, const char *path) {
+    file_type_t type = FILE_TYPE_UNKNOWN;
+    const char *data = NULL;
+    size_t length = 0;
+    int mapped = scanner_map_file(state->scanner, path, &type, &data, &length);
+    if (mapped != 0) {
+        return mapped > 0 ? 0 : -1;
+    }
+    SplitInput *split = create_split(path, type, state->scanner);
+    if (!split) {
+        scanner_unmap_file(data, length);
+        return -1;
+    }
+    split->mapping = data;
+    split->mapping_length = length;
+
+    size_t part_size = length / (state->thread_count * PARTS_PER_THREAD);
+    if (part_size < SCANNER_PART_SIZE) {
+        part_size = SCANNER_PART_SIZE;
+    }
+    size_t offset = 0;
+    while (offset < length) {
+        size_t end = length;
+        if (length - offset > part_size) {
+            const char *newline = memchr(data + offset + part_size - 1, '\n', length - offset - part_size + 1);
+            end = newline ? (size_t)(newline - data) + 1 : length;
+        }
+        if (add_part(split, data + offset, end - offset) < 0) {
+            destroy_split(split);
+            return -1;
+        }
+        offset = end;
+    }
+    // Every part is known before the first is queued, so the workers can
+    // join them as they finish.
+    split->ended = true;
+    size_t count = split->count;
+    split->scanning = count;
+    for (size_t i = 0; i < count; ++i) {
+        submit_part(state, split, i);
+    }
+    return 0;
 }
 
-static int enqueue_path_callback(const char *path, void *user_data) {
-    ThreadPool *pool = (ThreadPool *)user_data;
+static int submit_path(ThreadPool *pool, const char *path) {
     // Copy the path so it stays valid after the walk continues.
-    char *copy = duplicate_string(path);
-    if (!copy) {
+    size_t length = strlen(path);
+    PathJob *job = malloc(sizeof(*job) + length + 1);
+    if (!job) {
         return -1;
     }
-    if (thread_pool_submit(pool, copy) != 0) {
-        free(copy);
+    job->kind = SCAN_JOB_PATH;
+    memcpy(job->path, path, length + 1);
+    if (thread_pool_submit(pool, job) != 0) {
+        free(job);
         return -1;
     }
     return 0;
 }
 
-static int scan_file_callback(const char *path, void *user_data) {
-    ScannerContext *scanner = (ScannerContext *)user_data;
-    if (scanner_scan_path(scanner, path) != 0) {
+// Scan or submit the current batch. Returns 0 on success, -1 on error.
+static int flush_batch(WalkState *state) {
+    PathBatch *batch = state->batch;
+    if (!batch || batch->count == 0) {
         return 0;
     }
+    if (!state->pool) {
+        scanner_scan_paths(state->scanner, batch->paths, batch->count);
+        batch->count = 0;
+        arena_reset(&batch->arena);
+        return 0;
+    }
+    state->batch = NULL;
+    if (thread_pool_submit(state->pool, batch) != 0) {
+        free_job(batch);
+        return -1;
+    }
     return 0;
 }
 
+static int batch_path(WalkState *state, const char *path) {
+    if (!state->batch) {
+        state->batch = take_batch(&state->batches);
+        if (!state->batch) {
+            return -1;
+        }
+    }
+    char *copy = arena_copy_string(&state->batch->arena, path);
+    if (!copy) {
+        return -1;
+    }
+    state->batch->paths[state->batch->count++] = copy;
+    if (state->batch->count == SCANNER_URING_DEPTH) {
+        return flush_batch(state);
+    }
+    return 0;
+}
+
+static int visit_file_callback(const char *path, uint64_t size, void *user_data) {
+    WalkState *state = (WalkState *)user_data;
+    if (state->pool && state->split_size > 0 && size >= state->split_size && submit_split_file(state, path) == 0) {
+        return 0;
+    }
+    if (state->batched) {
+        return batch_path(state, path);
+    }
+    if (state->pool) {
+        return submit_path(state->pool, path);
+    }
+    scanner_scan_path(state->scanner, path);
+    return 0;
+}
+
+static int walk_files(const Config *config, WalkState *state) {
+    int result = walk_path_sized(config, visit_file_callback, state);
+    if (flush_batch(state) != 0) {
+        result = -1;
+    }
+    if (state->batch) {
+        free_job(state->batch);
+        state->batch = NULL;
+    }
+    return result;
+}
+
+// Read standard input in parts of whole lines and queue them, keeping
+// STDIN_PARTS_PER_THREAD parts per thread in flight. Returns 0 on success,
+// -1 on error.
+static int scan_stdin_parts(WalkState *state) {
+    SplitInput *split = create_split(DEFAULT_STDIN_LABEL, FILE_TYPE_UNKNOWN, state->scanner);
+    if (!split) {
+        return -1;
+    }
+    size_t limit = state->thread_count * STDIN_PARTS_PER_THREAD;
+    size_t keep = scanner_long_line_keep(state->scanner);
+    char *carry = NULL;
+    size_t carry_length = 0;
+    // Set while the rest of a line cut to keep bytes is dropped.
+    bool dropping = false;
+    bool end_of_input = false;
+    bool sniffed = false;
+    bool skipped = false;
+    int result = 0;
+
+    while (!end_of_input && !skipped && result == 0) {
+        size_t capacity = SCANNER_PART_SIZE + carry_length;
+        char *buffer = malloc(capacity);
+        if (!buffer) {
+            result = -1;
+            break;
+        }
+        size_t used = carry_length;
+        if (carry_length > 0) {
+            memcpy(buffer, carry, carry_length);
+        }
+        free(carry);
+        carry = NULL;
+        carry_length = 0;
+
+        // Fill the part, and past its size until a newline ends it.
+        size_t complete = 0;
+        while (true) {
+            if (used == capacity) {
+                const char *last_newline = byte_class_find_last(buffer, used, '\n');
+                if (last_newline) {
+                    complete = (size_t)(last_newline - buffer) + 1;
+                    break;
+                }
+                // Binary input may have no newline at all: look at it
+                // before reading the rest into the part.
+                file_type_t type = split->type;
+                if (!sniffed && (scanner_sniff_skip(state->scanner, &type, buffer, used) || type == FILE_TYPE_BINARY)) {
+                    complete = used;
+                    break;
+                }
+                // The part is one line: over the limit, it ends with the
+                // first keep bytes of it (see scanner_long_line_keep).
+                if (keep > 0 && used > keep) {
+                    buffer[keep] = '\n';
+                    complete = keep + 1;
+                    used = complete;
+                    dropping = true;
+                    break;
+                }
+                char *grown = realloc(buffer, capacity * 2);
+                if (!grown) {
+                    result = -1;
+                    break;
+                }
+                buffer = grown;
+                capacity *= 2;
+            }
+            ssize_t bytes_read = read(STDIN_FILENO, buffer + used, capacity - used);
+            if (bytes_read < 0 && errno == EINTR) {
+                continue;
+            }
+            if (bytes_read < 0) {
+                fprintf(stderr, "ERROR: read failed on %s: %s\n", DEFAULT_STDIN_LABEL, strerror(errno));
+                split->read_failed = true;
+            }
+            if (bytes_read <= 0) {
+                end_of_input = true;
+                complete = used;
+                break;
+            }
+            if (dropping) {
+                // The newline of the cut line ends its kept part.
+                const char *newline = memchr(buffer + used, '\n', (size_t)bytes_read);
+                if (!newline) {
+                    continue;
+                }
+                size_t end = (size_t)(newline - buffer) + 1;
+                bytes_read -= (ssize_t)(end - used);
+                memmove(buffer + used, buffer + end, (size_t)bytes_read);
+                dropping = false;
+            }
+            used += (size_t)bytes_read;
+        }
+        if (result != 0) {
+            free(buffer);
+            break;
+        }
+        if (!sniffed && used > 0) {
+            sniffed = true;
+            if (scanner_sniff_skip(state->scanner, &split->type, buffer, used)) {
+                free(buffer);
+                skipped = true;
+                break;
+            }
+            if (split->type == FILE_TYPE_BINARY) {
+                // Strings are taken out in one pass, from this part on.
+                int scanned = scanner_scan_binary(
+                    state->scanner, DEFAULT_STDIN_LABEL, buffer, used, end_of_input ? -1 : STDIN_FILENO);
+                free(buffer);
+                skipped = scanned > 0;
+                result = scanned < 0 ? -1 : 0;
+                break;
+            }
+        }
+        if (complete < used) {
+            carry_length = used - complete;
+            carry = malloc(carry_length);
+            if (!carry) {
+                free(buffer);
+                result = -1;
+                break;
+            }
+            memcpy(carry, buffer + complete, carry_length);
+        }
+
+        pthread_mutex_lock(&split->mutex);
+        while (split->scanning >= limit) {
+            pthread_cond_wait(&split->changed, &split->mutex);
+        }
+        long index = add_part(split, buffer, complete);
+        if (index >= 0) {
+            split->scanning++;
+        }
+        pthread_mutex_unlock(&split->mutex);
+        if (index < 0) {
+            free(buffer);
+            result = -1;
+            break;
+        }
+        submit_part(state, split, (size_t)index);
+    }
+    free(carry);
+
+    // Once the input is over, the workers can join the last parts too.
+    bool complete = !skipped && result == 0;
+    pthread_mutex_lock(&split->mutex);
+    split->ended = complete;
+    while (split->scanning > 0) {
+        pthread_cond_wait(&split->changed, &split->mutex);
+    }
+    if (complete) {
+        join_parts(split, state->scanner);
+    } else {
+        state->scanner->files_skipped++;
+        state->scanner->scan_failed = state->scanner->scan_failed || result != 0;
+    }
+    pthread_mutex_unlock(&split->mutex);
+    destroy_split(split);
+    return result;
+}
+
+// Sort every worker's findings on the worker's own thread, one sort job
+// each, once the pool is idle. Findings the pool did not sort are sorted
+// here.
+static void sort_worker_findings(ThreadPool *pool, WorkerContext *workers, size_t count) {
+    SortRound round;
+    SortJob *jobs = calloc(count, sizeof(*jobs));
+    if (jobs && pthread_mutex_init(&round.mutex, NULL) == 0) {
+        if (pthread_cond_init(&round.sorted, NULL) == 0) {
+            round.remaining = count;
+            size_t submitted = 0;
+            while (submitted < count) {
+                jobs[submitted].kind = SCAN_JOB_SORT;
+                jobs[submitted].round = &round;
+                if (thread_pool_submit(pool, &jobs[submitted]) != 0) {
+                    break;
+                }
+                submitted++;
+            }
+            // Release the workers waiting for the jobs that were not
+            // submitted.
+            pthread_mutex_lock(&round.mutex);
+            round.remaining -= count - submitted;
+            pthread_cond_broadcast(&round.sorted);
+            pthread_mutex_unlock(&round.mutex);
+            thread_pool_wait(pool);
+            pthread_cond_destroy(&round.sorted);
+        }
+        pthread_mutex_destroy(&round.mutex);
+    }
+    free(jobs);
+    for (size_t i = 0; i < count; ++i) {
+        scanner_sort_findings(&workers[i].scanner);
+    }
+}
+
+// Merge the sorted findings of the workers pairwise in a tree so each
+// finding moves log2(workers) times. Findings are moved between the
+// workers, never copied, and the result is sorted for the report.
+static void merge_worker_findings(ScannerContext *scanner, WorkerContext *workers, size_t count) {
+    for (size_t step = 1; step < count; step *= 2) {
+        for (size_t i = 0; i + step < count; i += 2 * step) {
+            scanner_merge(&workers[i].scanner, &workers[i + step].scanner);
+        }
+    }
+    // Findings of standard input joined here go in with the rest.
+    scanner_sort_findings(scanner);
+    scanner_merge(scanner, &workers[0].scanner);
+}
+
 int scanner_scan_parallel(const Config *config, RulesEngine *rules, ScannerContext *scanner) {
     if (!config || !rules || !scanner) {
         return -1;
     }
 
     scanner_init(scanner, rules);
+    scanner->classify_files = !config->all_files;
+    scanner->scan_binaries = config->scan_binaries;
+    scanner->io = config->io;
+    scanner->io_buffer_size = (size_t)config->io_buffer_kb << 10;
+    if (scanner->io == SCANNER_IO_URING && !io_ring_supported()) {
+        fprintf(stderr, "WARNING: io_uring is not available; falling back to --io auto.\n");
+        scanner->io = SCANNER_IO_AUTO;
+    }
 
-    if (config->stdin_mode) {
+    size_t thread_count = resolve_thread_count(config->threads);
+    WalkState state = {.scanner = scanner, .rules = rules, .batches = {PTHREAD_MUTEX_INITIALIZER, NULL},
+                       .batched = scanner->io == SCANNER_IO_URING, .thread_count = thread_count};
+    // A part cannot tell whether an earlier part stopped the input at a
+    // skipped long line, so such scans keep every file whole.
+    if (!(config->max_line_kb > 0 && config->long_lines == RULES_LONG_LINE_SKIP)) {
+        state.split_size = (uint64_t)config->split_mb << 20;
+    }
+
+    if (config->stdin_mode && (thread_count <= 1 || state.split_size == 0)) {
         return scanner_scan_stdin(scanner);
     }
 
-    size_t thread_count = resolve_thread_count(config->threads);
     if (thread_count <= 1) {
         // Single-threaded path for low thread counts.
-        int walk_result = walk_path(config, scan_file_callback, scanner);
+        int walk_result = walk_files(config, &state);
+        destroy_batches(&state.batches);
+        scanner_sort_findings(scanner);
         if (walk_result != 0) {
             scanner->scan_failed = true;
             return -1;
@@ -93,32 +762,48 @@ int scanner_scan_parallel(const Config *config, RulesEngine *rules, ScannerConte
         return -1;
     }
 
-    for (size_t i = 0; i < thread_count; ++i) {
-        scanner_init(&workers[i].scanner, rules);
-        worker_contexts[i] = &workers[i];
+    size_t ready = 0;
+    for (; ready < thread_count; ++ready) {
+        if (rules_clone(rules, &workers[ready].rules) != 0) {
+            break;
+        }
+        scanner_init(&workers[ready].scanner, &workers[ready].rules);
+        workers[ready].scanner.classify_files = scanner->classify_files;
+        workers[ready].scanner.scan_binaries = scanner->scan_binaries;
+        workers[ready].scanner.io = scanner->io;
+        workers[ready].scanner.io_buffer_size = scanner->io_buffer_size;
+        // Without a shared table the merge copies the worker's paths.
+        scanner_share_paths(&workers[ready].scanner, scanner);
+        worker_contexts[ready] = &workers[ready];
     }
 
-    ThreadPool *pool = thread_pool_create(thread_count,
-                                          DEFAULT_QUEUE_CAPACITY,
-                                          scan_job,
-                                          free_job,
-                                          NULL,
-                                          worker_contexts);
+    ThreadPool *pool = NULL;
+    if (ready == thread_count) {
+        pool = thread_pool_create(thread_count, DEFAULT_QUEUE_CAPACITY, scan_job, free_job, NULL, worker_contexts);
+    }
     if (!pool) {
+        for (size_t i = 0; i < ready; ++i) {
+            rules_destroy(&workers[i].rules);
+        }
         free(worker_contexts);
         free(workers);
         scanner->scan_failed = true;
         return -1;
     }
 
-    int walk_result = walk_path(config, enqueue_path_callback, pool);
+    state.pool = pool;
+    int walk_result = config->stdin_mode ? scan_stdin_parts(&state) : walk_files(config, &state);
 
     thread_pool_wait(pool);
+    sort_worker_findings(pool, workers, thread_count);
     thread_pool_destroy(pool);
+    destroy_batches(&state.batches);
 
+    merge_worker_findings(scanner, workers, thread_count);
     for (size_t i = 0; i < thread_count; ++i) {
-        scanner_merge(scanner, &workers[i].scanner);
+        rules_merge_profile(rules, &workers[i].rules);
         scanner_destroy(&workers[i].scanner);
+        rules_destroy(&workers[i].rules);
     }
 
     free(worker_contexts);
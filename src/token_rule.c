@@ -0,0 +1,130 @@
+#include "token_rule.h"
+
+#include <string.h>
+
+static size_t count_items(const PatternNode *node) {
+    if (node->kind != PATTERN_NODE_CONCAT) {
+        return 1;
+    }
+    return count_items(node->left) + count_items(node->right);
+}
+
+static void collect_items(const PatternNode *node, const PatternNode **items, size_t *count) {
+    if (node->kind != PATTERN_NODE_CONCAT) {
+        items[(*count)++] = node;
+        return;
+    }
+    collect_items(node->left, items, count);
+    collect_items(node->right, items, count);
+}
+
+static bool is_class_repeat(const PatternNode *node) {
+    return node->kind == PATTERN_NODE_REPEAT && node->left->kind == PATTERN_NODE_CHARSET;
+}
+
+// Append copies positions of class to the prefix.
+static bool add_prefix(TokenRule *rule, const PatternNode *class, int copies) {
+    if (copies > (int)(TOKEN_RULE_MAX_PREFIX - rule->prefix_length)) {
+        return false;
+    }
+    for (int copy = 0; copy < copies; ++copy) {
+        for (unsigned int byte = 0; byte < 256; ++byte) {
+            if (pattern_charset_contains(class, (unsigned char)byte)) {
+                rule->prefix[byte] |= 1u << rule->prefix_length;
+            }
+        }
+        rule->prefix_length++;
+    }
+    return true;
+}
+
+bool token_rule_compile(const PatternNode *pattern, TokenRule *rule) {
+    if (!pattern || !rule) {
+        return false;
+    }
+    size_t count = count_items(pattern);
+    if (count < 2 || count > TOKEN_RULE_MAX_PREFIX + 1) {
+        return false;
+    }
+    const PatternNode *items[TOKEN_RULE_MAX_PREFIX + 1];
+    size_t collected = 0;
+    collect_items(pattern, items, &collected);
+
+    memset(rule, 0, sizeof(*rule));
+    bool valid = true;
+    for (size_t i = 0; valid && i + 1 < count; ++i) {
+        const PatternNode *item = items[i];
+        if (item->kind == PATTERN_NODE_CHARSET) {
+            valid = add_prefix(rule, item, 1);
+        } else if (is_class_repeat(item) && item->repeat_min == item->repeat_max) {
+            valid = add_prefix(rule, item->left, item->repeat_min);
+        } else {
+            valid = false;
+        }
+    }
+    const PatternNode *run = items[count - 1];
+    if (!valid || rule->prefix_length == 0 || !is_class_repeat(run)) {
+        return false;
+    }
+    rule->run_min = (uint32_t)run->repeat_min;
+    rule->run_max = run->repeat_max == PATTERN_REPEAT_UNBOUNDED ? TOKEN_RULE_UNBOUNDED : (uint32_t)run->repeat_max;
+    for (unsigned int byte = 0; byte < 256; ++byte) {
+        rule->run[byte] = pattern_charset_contains(run->left, (unsigned char)byte) ? 1 : 0;
+    }
+    return true;
+}
+
+bool token_rule_check(const TokenRule *rule) {
+    if (!rule || rule->prefix_length == 0 || rule->prefix_length > TOKEN_RULE_MAX_PREFIX ||
+        rule->run_min > rule->run_max) {
+        return false;
+    }
+    uint32_t positions = rule->prefix_length == 32 ? UINT32_MAX : (1u << rule->prefix_length) - 1;
+    for (unsigned int byte = 0; byte < 256; ++byte) {
+        if ((rule->prefix[byte] & ~positions) != 0 || rule->run[byte] > 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Length of the run at text, stopping at limit. Eight lookups are combined
+// before branching, so long runs cost one branch per word.
+static size_t run_length(const unsigned char *run, const unsigned char *text, size_t limit) {
+    size_t length = 0;
+    while (length + 8 <= limit &&
+           (run[text[length]] & run[text[length + 1]] & run[text[length + 2]] & run[text[length + 3]] &
+            run[text[length + 4]] & run[text[length + 5]] & run[text[length + 6]] & run[text[length + 7]])) {
+        length += 8;
+    }
+    while (length < limit && run[text[length]]) {
+        length++;
+    }
+    return length;
+}
+
+bool token_rule_find(const TokenRule *rule, const char *text, size_t length, size_t *start, size_t *end) {
+    const unsigned char *bytes = (const unsigned char *)text;
+    // Bit i of state is set if the prefix up to position i ends here; the
+    // prefix has a fixed length, so matches are found in start order.
+    const uint32_t accept = 1u << (rule->prefix_length - 1);
+    uint32_t state = 0;
+    for (size_t i = 0; i < length; ++i) {
+        state = ((state << 1) | 1u) & rule->prefix[bytes[i]];
+        if (!(state & accept)) {
+            continue;
+        }
+        size_t run_start = i + 1;
+        size_t limit = length - run_start;
+        if (rule->run_max != TOKEN_RULE_UNBOUNDED && rule->run_max < limit) {
+            limit = rule->run_max;
+        }
+        size_t run = run_length(rule->run, bytes + run_start, limit);
+        if (run >= rule->run_min) {
+            *start = run_start - rule->prefix_length;
+            *end = run_start + run;
+            return true;
+        }
+    }
+    return false;
+}
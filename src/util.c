@@ -1,5 +1,6 @@
 #include "util.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -14,3 +15,47 @@ char *duplicate_string(const char *text) {
     }
     return copy;
 }
+
+void json_write_string(FILE *out, const char *text) {
+    if (!text) {
+        fputs("null", out);
+        return;
+    }
+
+    const unsigned char *ptr = (const unsigned char *)text;
+    fputc('"', out);
+    while (*ptr) {
+        unsigned char ch = *ptr++;
+        switch (ch) {
+        case '\"':
+            fputs("\\\"", out);
+            break;
+        case '\\':
+            fputs("\\\\", out);
+            break;
+        case '\b':
+            fputs("\\b", out);
+            break;
+        case '\f':
+            fputs("\\f", out);
+            break;
+        case '\n':
+            fputs("\\n", out);
+            break;
+        case '\r':
+            fputs("\\r", out);
+            break;
+        case '\t':
+            fputs("\\t", out);
+            break;
+        default:
+            if (ch < 0x20) {
+                fprintf(out, "\\u%04x", ch);
+            } else {
+                fputc(ch, out);
+            }
+            break;
+        }
+    }
+    fputc('"', out);
+}
@@ -2,39 +2,60 @@
 
 #include <dirent.h>
 #include <errno.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
-static char *join_path(const char *parent, const char *child) {
-    size_t parent_length = strlen(parent);
-    size_t child_length = strlen(child);
-    int needs_separator = (parent_length > 0 && parent[parent_length - 1] != '/');
-    size_t total = parent_length + (size_t)needs_separator + child_length + 1;
-
-    char *result = malloc(total);
-    if (!result) {
-        return NULL;
+// The path being visited. Each directory entry is appended in place and
+// cut off again after its visit, so the walk joins paths without
+// allocating one per entry.
+typedef struct {
+    char *text;
+    size_t length;
+    size_t capacity;
+} WalkPath;
+
+// Append "/" (unless path ends in one) and name. Returns 0 on success, -1
+// on allocation failure.
+static int push_name(WalkPath *path, const char *name) {
+    size_t name_length = strlen(name);
+    bool needs_separator = path->length > 0 && path->text[path->length - 1] != '/';
+    size_t total = path->length + (size_t)needs_separator + name_length + 1;
+    if (total > path->capacity) {
+        size_t capacity = path->capacity * 2 > total ? path->capacity * 2 : total;
+        char *grown = realloc(path->text, capacity);
+        if (!grown) {
+            return -1;
+        }
+        path->text = grown;
+        path->capacity = capacity;
     }
-
-    memcpy(result, parent, parent_length);
-    size_t position = parent_length;
     if (needs_separator) {
-        result[position] = '/';
-        position++;
+        path->text[path->length++] = '/';
     }
-    memcpy(result + position, child, child_length + 1);
-    return result;
+    memcpy(path->text + path->length, name, name_length + 1);
+    path->length += name_length;
+    return 0;
+}
+
+static void pop_name(WalkPath *path, size_t length) {
+    path->length = length;
+    path->text[length] = '\0';
 }
 
+// The callback of a walk: on_file, or on_sized_file with the file size.
+typedef struct {
+    file_visit_callback on_file;
+    file_size_callback on_sized_file;
+    void *user_data;
+} WalkVisitor;
+
 // Walk directories recursively, skipping symlinks and obeying max depth.
-static int walk_recursive(const Config *config,
-                          const char *path,
-                          int depth,
-                          file_visit_callback on_file,
-                          void *user_data) {
+static int walk_recursive(const Config *config, WalkPath *walk_path, int depth, const WalkVisitor *visitor) {
+    const char *path = walk_path->text;
     struct stat path_info;
     if (lstat(path, &path_info) != 0) {
         fprintf(stderr, "ERROR: failed to stat %s: %s\n", path, strerror(errno));
@@ -62,18 +83,13 @@ static int walk_recursive(const Config *config,
                 continue;
             }
 
-            char *child = join_path(path, entry->d_name);
-            if (!child) {
-                closedir(directory);
-                return -1;
-            }
-
-            if (walk_recursive(config, child, depth + 1, on_file, user_data) != 0) {
-                free(child);
+            size_t length = walk_path->length;
+            if (push_name(walk_path, entry->d_name) != 0 ||
+                walk_recursive(config, walk_path, depth + 1, visitor) != 0) {
                 closedir(directory);
                 return -1;
             }
-            free(child);
+            pop_name(walk_path, length);
         }
 
         closedir(directory);
@@ -84,17 +100,40 @@ static int walk_recursive(const Config *config,
         return 0;
     }
 
-    if (!on_file) {
+    if (visitor->on_sized_file) {
+        return visitor->on_sized_file(path, (uint64_t)path_info.st_size, visitor->user_data);
+    }
+    if (!visitor->on_file) {
         return 0;
     }
 
-    return on_file(path, user_data);
+    return visitor->on_file(path, visitor->user_data);
+}
+static int walk_root(const Config *config, const WalkVisitor *visitor) {
+    WalkPath path = {NULL, 0, 0};
+    if (push_name(&path, config->root_path) != 0) {
+        return -1;
+    }
+    int result = walk_recursive(config, &path, 0, visitor);
+    free(path.text);
+    return result;
 }
+
 // Walk the root path and scan each file via callback.
 int walk_path(const Config *config, file_visit_callback on_file, void *user_data) {
     if (!config || !config->root_path) {
         return 0;
     }
 
-    return walk_recursive(config, config->root_path, 0, on_file, user_data);
+    WalkVisitor visitor = {on_file, NULL, user_data};
+    return walk_root(config, &visitor);
+}
+
+int walk_path_sized(const Config *config, file_size_callback on_file, void *user_data) {
+    if (!config || !config->root_path) {
+        return 0;
+    }
+
+    WalkVisitor visitor = {NULL, on_file, user_data};
+    return walk_root(config, &visitor);
 }
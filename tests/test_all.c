@@ -7,18 +7,48 @@ void run_scanner_tests(void);
 void run_cli_tests(void);
 void run_walk_tests(void);
 void run_rules_tests(void);
+void run_rules_file_tests(void);
+void run_pattern_tests(void);
+void run_aho_corasick_tests(void);
+void run_lazy_dfa_tests(void);
+void run_kv_tokenizer_tests(void);
+void run_token_rule_tests(void);
+void run_entropy_tests(void);
+void run_line_cache_tests(void);
+void run_arena_tests(void);
+void run_path_table_tests(void);
+void run_io_ring_tests(void);
+void run_block_rule_tests(void);
+void run_file_type_tests(void);
+void run_generated_rules_tests(void);
 void run_config_tests(void);
 void run_util_tests(void);
+void run_byte_class_tests(void);
 void run_app_tests(void);
 
 int main(void) {
     UNITY_BEGIN();
     run_util_tests();
+    run_byte_class_tests();
     run_config_tests();
     run_scanner_tests();
     run_cli_tests();
     run_walk_tests();
     run_rules_tests();
+    run_rules_file_tests();
+    run_pattern_tests();
+    run_aho_corasick_tests();
+    run_lazy_dfa_tests();
+    run_kv_tokenizer_tests();
+    run_token_rule_tests();
+    run_entropy_tests();
+    run_line_cache_tests();
+    run_arena_tests();
+    run_path_table_tests();
+    run_io_ring_tests();
+    run_block_rule_tests();
+    run_file_type_tests();
+    run_generated_rules_tests();
     run_app_tests();
     return UNITY_END();
 }
@@ -0,0 +1,74 @@
+#include "unity.h"
+#include "arena.h"
+
+#include <stdalign.h>
+#include <stdint.h>
+#include <string.h>
+
+void test_arena_alloc(void) {
+    Arena arena;
+    arena_init(&arena, 256);
+    TEST_ASSERT_TRUE(arena.allocations == 0);
+
+    char *first = arena_copy_string(&arena, "src/a.c");
+    char *second = arena_copy_string(&arena, "src/b.c");
+    TEST_ASSERT_EQUAL_STRING("src/a.c", first);
+    TEST_ASSERT_EQUAL_STRING("src/b.c", second);
+    TEST_ASSERT_TRUE(arena.allocations == 1);
+
+    // Allocations are aligned for any type and come from the same block
+    // until it is full.
+    for (size_t size = 1; size < 40; size += 7) {
+        void *memory = arena_alloc(&arena, size);
+        TEST_ASSERT_NOT_NULL(memory);
+        TEST_ASSERT_EQUAL_UINT(0u, (unsigned int)((uintptr_t)memory % alignof(max_align_t)));
+        memset(memory, 0xab, size);
+    }
+    TEST_ASSERT_TRUE(arena.allocations == 1);
+    TEST_ASSERT_NOT_NULL(arena_alloc(&arena, 100));
+    TEST_ASSERT_TRUE(arena.allocations == 2);
+
+    // An allocation larger than a block gets its own; the current block
+    // keeps filling.
+    char *large = arena_alloc(&arena, 1000);
+    TEST_ASSERT_NOT_NULL(large);
+    memset(large, 'x', 1000);
+    TEST_ASSERT_TRUE(arena.allocations == 3);
+    TEST_ASSERT_NOT_NULL(arena_copy_string(&arena, "src/c.c"));
+    TEST_ASSERT_TRUE(arena.allocations == 3);
+    TEST_ASSERT_EQUAL_STRING("src/a.c", first);
+    TEST_ASSERT_NULL(arena_copy_string(&arena, NULL));
+
+    arena_destroy(&arena);
+}
+
+void test_arena_reset_reuses_block(void) {
+    Arena arena;
+    arena_init(&arena, 256);
+    TEST_ASSERT_NOT_NULL(arena_alloc(&arena, 200));
+    TEST_ASSERT_NOT_NULL(arena_alloc(&arena, 200));
+    TEST_ASSERT_NOT_NULL(arena_alloc(&arena, 1000));
+    TEST_ASSERT_TRUE(arena.allocations == 3);
+
+    // After a reset one block is kept and filled again from its start.
+    arena_reset(&arena);
+    char *first = arena_copy_string(&arena, "src/a.c");
+    TEST_ASSERT_NOT_NULL(first);
+    for (int round = 0; round < 3; ++round) {
+        arena_reset(&arena);
+        TEST_ASSERT_TRUE(arena_copy_string(&arena, "src/b.c") == first);
+        TEST_ASSERT_NOT_NULL(arena_alloc(&arena, 200));
+    }
+    TEST_ASSERT_EQUAL_STRING("src/b.c", first);
+    TEST_ASSERT_TRUE(arena.allocations == 3);
+
+    // A reset of an empty arena leaves it empty.
+    arena_destroy(&arena);
+    arena_reset(&arena);
+    TEST_ASSERT_NULL(arena.blocks);
+}
+
+void run_arena_tests(void) {
+    RUN_TEST(test_arena_alloc);
+    RUN_TEST(test_arena_reset_reuses_block);
+}
@@ -0,0 +1,210 @@
+#include "unity.h"
+#include "byte_class.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char *const kernels[] = {"scalar", "sse2", "avx2"};
+
+static size_t loop_count_control(const unsigned char *data, size_t length) {
+    size_t count = 0;
+    for (size_t i = 0; i < length; ++i) {
+        if (data[i] < 0x09 || (data[i] > 0x0D && data[i] < 0x20)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static size_t loop_find(const unsigned char *data, size_t length, const unsigned char *members) {
+    size_t i = 0;
+    while (i < length && !members[data[i]]) {
+        i++;
+    }
+    return i;
+}
+
+static size_t loop_count(const char *text, size_t length, char byte) {
+    size_t count = 0;
+    for (size_t i = 0; i < length; ++i) {
+        count += text[i] == byte;
+    }
+    return count;
+}
+
+static const char *loop_find_last(const char *text, size_t length, char byte) {
+    for (size_t i = length; i > 0; --i) {
+        if (text[i - 1] == byte) {
+            return text + i - 1;
+        }
+    }
+    return NULL;
+}
+
+// Mostly text, with newlines, NULs, other control bytes and bytes with the
+// high bit set mixed in at a density set by sparse.
+static void fill_random(unsigned char *data, size_t length, unsigned int *seed, unsigned int sparse) {
+    for (size_t i = 0; i < length; ++i) {
+        *seed = *seed * 1103515245u + 12345u;
+        unsigned int pick = (*seed >> 16) % (100 * sparse);
+        if (pick < 6) {
+            data[i] = '\n';
+        } else if (pick < 8) {
+            data[i] = '\0';
+        } else if (pick < 12) {
+            data[i] = (unsigned char)(pick * 7 % 32);
+        } else if (pick < 16) {
+            data[i] = (unsigned char)(0x80 + (*seed >> 8) % 128);
+        } else {
+            data[i] = (unsigned char)(' ' + pick % 95);
+        }
+    }
+}
+
+void test_byte_class_kernels_match_byte_loops(void) {
+    const char *previous = byte_class_kernel();
+    unsigned char members[256] = {0};
+    members['='] = 1;
+    members[':'] = 1;
+    members[0xE9] = 1;
+    unsigned char nul[256] = {0};
+    nul[0] = 1;
+    ByteClassSet separators;
+    byte_class_set_init(&separators, members);
+
+    // Every length up to 200 at every offset in a 32-byte vector, so the
+    // vector loops and their tails all run.
+    unsigned char buffer[256];
+    unsigned int seed = 4242;
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+        if (!byte_class_use_kernel(kernels[k])) {
+            continue;
+        }
+        TEST_ASSERT_EQUAL_STRING(kernels[k], byte_class_kernel());
+        for (size_t length = 0; length <= 200; ++length) {
+            for (size_t offset = 0; offset < 32; ++offset) {
+                unsigned char *data = buffer + offset;
+                fill_random(data, length, &seed, 1 + (unsigned int)(length % 4));
+                const char *text = (const char *)data;
+                TEST_ASSERT_EQUAL_UINT(loop_count_control(data, length), byte_class_count_control(data, length));
+                TEST_ASSERT_EQUAL_UINT(loop_find(data, length, nul), byte_class_find_nul(data, length));
+                TEST_ASSERT_EQUAL_UINT(loop_count(text, length, '\n'), byte_class_count(text, length, '\n'));
+                TEST_ASSERT_EQUAL_PTR(loop_find_last(text, length, '\n'), byte_class_find_last(text, length, '\n'));
+                TEST_ASSERT_EQUAL_UINT(loop_find(data, length, members), byte_class_find_set(&separators, data, length));
+            }
+        }
+    }
+    TEST_ASSERT_TRUE(byte_class_use_kernel(previous));
+}
+
+void test_byte_class_find_last_with_high_bytes(void) {
+    const char *previous = byte_class_kernel();
+    // Bytes with the high bit set next to the target, around the eight,
+    // 16 and 32-byte steps.
+    char text[72];
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+        if (!byte_class_use_kernel(kernels[k])) {
+            continue;
+        }
+        TEST_ASSERT_NULL(byte_class_find_last("", 0, '\n'));
+        TEST_ASSERT_NULL(byte_class_find_last("abc\n", 3, '\n'));
+        for (size_t length = 0; length <= sizeof(text); ++length) {
+            for (size_t position = 0; position <= length; ++position) {
+                memset(text, '\xff', sizeof(text));
+                for (size_t i = 0; i < length; i += 3) {
+                    text[i] = '\x0b';
+                }
+                if (position < length) {
+                    text[position] = '\n';
+                }
+                TEST_ASSERT_EQUAL_PTR(loop_find_last(text, length, '\n'), byte_class_find_last(text, length, '\n'));
+            }
+        }
+        TEST_ASSERT_EQUAL_PTR(text + sizeof(text) - 1, byte_class_find_last(text, sizeof(text), '\xff'));
+        TEST_ASSERT_EQUAL_PTR(text + sizeof(text) - 4, byte_class_find_last(text, sizeof(text) - 2, '\xff'));
+    }
+    TEST_ASSERT_TRUE(byte_class_use_kernel(previous));
+}
+
+void test_byte_class_sets_of_any_size(void) {
+    const char *previous = byte_class_kernel();
+    // Token characters, a set too large for the SSE2 compares, the bytes
+    // with the high bit set and the empty set.
+    unsigned char token[256] = {0};
+    unsigned char high[256] = {0};
+    unsigned char none[256] = {0};
+    for (unsigned int byte = 0; byte < 256; ++byte) {
+        token[byte] = (byte >= '0' && byte <= '9') || ((byte | 0x20) >= 'a' && (byte | 0x20) <= 'z') || byte == '_';
+        high[byte] = byte >= 0x80;
+    }
+    const unsigned char *sets[] = {token, high, none};
+    unsigned char buffer[600];
+    unsigned int seed = 99;
+    for (size_t s = 0; s < sizeof(sets) / sizeof(sets[0]); ++s) {
+        ByteClassSet set;
+        byte_class_set_init(&set, sets[s]);
+        for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+            if (!byte_class_use_kernel(kernels[k])) {
+                continue;
+            }
+            for (int round = 0; round < 200; ++round) {
+                size_t length = (size_t)round * 3;
+                for (size_t i = 0; i < length; ++i) {
+                    seed = seed * 1103515245u + 12345u;
+                    buffer[i] = (unsigned char)(seed >> 16);
+                }
+                // Non-members for a while, so the first member is found
+                // after some vectors.
+                for (size_t i = 0; i < length && i < (size_t)round; ++i) {
+                    while (sets[s][buffer[i]]) {
+                        buffer[i] = (unsigned char)(buffer[i] + 37);
+                        if (s == 1) {
+                            buffer[i] &= 0x7F;
+                        }
+                    }
+                }
+                TEST_ASSERT_EQUAL_UINT(loop_find(buffer, length, sets[s]), byte_class_find_set(&set, buffer, length));
+            }
+        }
+    }
+    TEST_ASSERT_TRUE(byte_class_use_kernel(previous));
+}
+
+void test_byte_class_counts_past_lane_limits(void) {
+    const char *previous = byte_class_kernel();
+    // Vector counts are summed every 255 vectors; 100000 bytes of nothing
+    // but matches would wrap a lane that is not.
+    size_t length = 100000;
+    char *text = malloc(length);
+    TEST_ASSERT_NOT_NULL(text);
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+        if (!byte_class_use_kernel(kernels[k])) {
+            continue;
+        }
+        memset(text, '\n', length);
+        TEST_ASSERT_EQUAL_UINT(length, byte_class_count(text, length, '\n'));
+        TEST_ASSERT_EQUAL_UINT(0, byte_class_count_control((const unsigned char *)text, length));
+        memset(text, '\x01', length);
+        TEST_ASSERT_EQUAL_UINT(length, byte_class_count_control((const unsigned char *)text, length));
+        TEST_ASSERT_EQUAL_UINT(length, byte_class_find_nul((const unsigned char *)text, length));
+        text[length - 1] = '\0';
+        TEST_ASSERT_EQUAL_UINT(length - 1, byte_class_find_nul((const unsigned char *)text, length));
+    }
+    free(text);
+    TEST_ASSERT_TRUE(byte_class_use_kernel(previous));
+}
+
+void test_byte_class_unknown_kernel(void) {
+    const char *previous = byte_class_kernel();
+    TEST_ASSERT_FALSE(byte_class_use_kernel("neon"));
+    TEST_ASSERT_FALSE(byte_class_use_kernel(NULL));
+    TEST_ASSERT_EQUAL_STRING(previous, byte_class_kernel());
+}
+
+void run_byte_class_tests(void) {
+    RUN_TEST(test_byte_class_kernels_match_byte_loops);
+    RUN_TEST(test_byte_class_find_last_with_high_bytes);
+    RUN_TEST(test_byte_class_sets_of_any_size);
+    RUN_TEST(test_byte_class_counts_past_lane_limits);
+    RUN_TEST(test_byte_class_unknown_kernel);
+}
@@ -1,6 +1,7 @@
 #include "unity.h"
 #include "cli.h"
 #include "config.h"
+#include "entropy.h"
 #include "test_utils.h"
 
 static void init_cli_config(Config *config) {
@@ -197,6 +198,301 @@ void test_parse_default_root_path(void) {
     destroy_cli_config(&config);
 }
 
+void test_parse_engine_values(void) {
+    Config config;
+    init_cli_config(&config);
+    TEST_ASSERT_EQUAL_INT(RULES_ENGINE_NATIVE, config.engine);
+    char *argv[] = {"secretguard", "--engine", "regex"};
+    TEST_ASSERT_EQUAL_INT(0, parse_arguments(3, argv, &config));
+    TEST_ASSERT_EQUAL_INT(RULES_ENGINE_REGEX, config.engine);
+    destroy_cli_config(&config);
+
+    init_cli_config(&config);
+    char *argv_equals[] = {"secretguard", "--engine=native"};
+    TEST_ASSERT_EQUAL_INT(0, parse_arguments(2, argv_equals, &config));
+    TEST_ASSERT_EQUAL_INT(RULES_ENGINE_NATIVE, config.engine);
+    destroy_cli_config(&config);
+
+    init_cli_config(&config);
+    char *argv_generated[] = {"secretguard", "--engine=generated"};
+    TEST_ASSERT_EQUAL_INT(0, parse_arguments(2, argv_generated, &config));
+    TEST_ASSERT_EQUAL_INT(RULES_ENGINE_GENERATED, config.engine);
+    destroy_cli_config(&config);
+}
+
+void test_parse_engine_invalid_value(void) {
+    int saved_stderr = -1;
+    TEST_ASSERT_EQUAL_INT(0, test_redirect_stderr_to_null(&saved_stderr));
+
+    Config config;
+    init_cli_config(&config);
+    char *argv[] = {"secretguard", "--engine", "pcre"};
+    TEST_ASSERT_EQUAL_INT(2, parse_arguments(3, argv, &config));
+    destroy_cli_config(&config);
+
+    test_restore_stderr(saved_stderr);
+}
+
+void test_parse_profile_rules_flag(void) {
+    Config config;
+    init_cli_config(&config);
+    TEST_ASSERT_FALSE(config.profile_rules);
+    char *argv[] = {"secretguard", "--profile-rules", "scan-target"};
+    TEST_ASSERT_EQUAL_INT(0, parse_arguments(3, argv, &config));
+    TEST_ASSERT_TRUE(config.profile_rules);
+    destroy_cli_config(&config);
+}
+
+void test_parse_all_files_flag(void) {
+    Config config;
+    init_cli_config(&config);
+    TEST_ASSERT_FALSE(config.all_files);
+    char *argv[] = {"secretguard", "--all-files", "scan-target"};
+    TEST_ASSERT_EQUAL_INT(0, parse_arguments(3, argv, &config));
+    TEST_ASSERT_TRUE(config.all_files);
+    destroy_cli_config(&config);
+}
+
+void test_parse_scan_binaries_flag(void) {
+    Config config;
+    init_cli_config(&config);
+    TEST_ASSERT_FALSE(config.scan_binaries);
+    char *argv[] = {"secretguard", "--scan-binaries", "scan-target"};
+    TEST_ASSERT_EQUAL_INT(0, parse_arguments(3, argv, &config));
+    TEST_ASSERT_TRUE(config.scan_binaries);
+    destroy_cli_config(&config);
+}
+
+void test_parse_rules_flag(void) {
+    Config config;
+    init_cli_config(&config);
+    char *argv[] = {"secretguard", "--rules", "team.rules", "scan-target"};
+    TEST_ASSERT_EQUAL_INT(0, parse_arguments(4, argv, &config));
+    TEST_ASSERT_EQUAL_STRING("team.rules", config.rules_path);
+    TEST_ASSERT_FALSE(config.compile_rules);
+    destroy_cli_config(&config);
+
+    init_cli_config(&config);
+    char *argv_equals[] = {"secretguard", "--rules=team.rules"};
+    TEST_ASSERT_EQUAL_INT(0, parse_arguments(2, argv_equals, &config));
+    TEST_ASSERT_EQUAL_STRING("team.rules", config.rules_path);
+    destroy_cli_config(&config);
+}
+
+void test_parse_compile_rules_mode(void) {
+    Config config;
+    init_cli_config(&config);
+    char *argv[] = {"secretguard", "compile-rules", "--rules", "team.rules", "team.bundle"};
+    TEST_ASSERT_EQUAL_INT(0, parse_arguments(5, argv, &config));
+    TEST_ASSERT_TRUE(config.compile_rules);
+    TEST_ASSERT_EQUAL_STRING("team.bundle", config.bundle_path);
+    TEST_ASSERT_NULL(config.root_path);
+    destroy_cli_config(&config);
+}
+
+void test_parse_compile_rules_requires_output(void) {
+    int saved_stderr = -1;
+    TEST_ASSERT_EQUAL_INT(0, test_redirect_stderr_to_null(&saved_stderr));
+
+    Config config;
+    init_cli_config(&config);
+    char *argv[] = {"secretguard", "compile-rules", "--rules", "team.rules"};
+    TEST_ASSERT_EQUAL_INT(2, parse_arguments(4, argv, &config));
+    destroy_cli_config(&config);
+
+    test_restore_stderr(saved_stderr);
+}
+
+void test_parse_rule_selection(void) {
+    Config config;
+    init_cli_config(&config);
+    TEST_ASSERT_EQUAL_INT(SEVERITY_LOW, config.min_severity);
+    char *argv[] = {"secretguard", "--rules-include", "AWS_*", "--rules-include=GITHUB_TOKEN",
+                    "--rules-exclude", "AWS_SECRET_*", "--min-severity", "high", "scan-target"};
+    TEST_ASSERT_EQUAL_INT(0, parse_arguments(9, argv, &config));
+    TEST_ASSERT_EQUAL_STRING("AWS_*,GITHUB_TOKEN", config.rules_include);
+    TEST_ASSERT_EQUAL_STRING("AWS_SECRET_*", config.rules_exclude);
+    TEST_ASSERT_EQUAL_INT(SEVERITY_HIGH, config.min_severity);
+    TEST_ASSERT_EQUAL_STRING("scan-target", config.root_path);
+    destroy_cli_config(&config);
+}
+
+void test_parse_min_severity_invalid_value(void) {
+    int saved_stderr = -1;
+    TEST_ASSERT_EQUAL_INT(0, test_redirect_stderr_to_null(&saved_stderr));
+
+    Config config;
+    init_cli_config(&config);
+    char *argv[] = {"secretguard", "--min-severity=critical"};
+    TEST_ASSERT_EQUAL_INT(2, parse_arguments(2, argv, &config));
+    destroy_cli_config(&config);
+
+    test_restore_stderr(saved_stderr);
+}
+
+void test_parse_entropy_options(void) {
+    Config config;
+    init_cli_config(&config);
+    TEST_ASSERT_TRUE(config.entropy_threshold == 0.0);
+    TEST_ASSERT_EQUAL_INT(ENTROPY_DEFAULT_MIN_LENGTH, config.entropy_min_length);
+    char *argv[] = {"secretguard", "--entropy", "4.25", "--entropy-min-length=32", "scan-target"};
+    TEST_ASSERT_EQUAL_INT(0, parse_arguments(5, argv, &config));
+    TEST_ASSERT_TRUE(config.entropy_threshold == 4.25);
+    TEST_ASSERT_EQUAL_INT(32, config.entropy_min_length);
+    TEST_ASSERT_EQUAL_STRING("scan-target", config.root_path);
+    destroy_cli_config(&config);
+}
+
+void test_parse_entropy_invalid_values(void) {
+    int saved_stderr = -1;
+    TEST_ASSERT_EQUAL_INT(0, test_redirect_stderr_to_null(&saved_stderr));
+
+    char *bad[][2] = {
+        {"secretguard", "--entropy=0"},
+        {"secretguard", "--entropy=9"},
+        {"secretguard", "--entropy=high"},
+        {"secretguard", "--entropy-min-length=0"},
+        {"secretguard", "--entropy-min-length=300"},
+    };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        Config config;
+        init_cli_config(&config);
+        TEST_ASSERT_EQUAL_INT(2, parse_arguments(2, bad[i], &config));
+        destroy_cli_config(&config);
+    }
+
+    test_restore_stderr(saved_stderr);
+}
+
+void test_parse_line_cache_option(void) {
+    Config config;
+    init_cli_config(&config);
+    TEST_ASSERT_EQUAL_INT(0, config.line_cache_mb);
+    char *argv[] = {"secretguard", "--line-cache", "64", "scan-target"};
+    TEST_ASSERT_EQUAL_INT(0, parse_arguments(4, argv, &config));
+    TEST_ASSERT_EQUAL_INT(64, config.line_cache_mb);
+    destroy_cli_config(&config);
+
+    int saved_stderr = -1;
+    TEST_ASSERT_EQUAL_INT(0, test_redirect_stderr_to_null(&saved_stderr));
+    char *bad[][2] = {
+        {"secretguard", "--line-cache=-1"},
+        {"secretguard", "--line-cache=4097"},
+        {"secretguard", "--line-cache=lots"},
+    };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        init_cli_config(&config);
+        TEST_ASSERT_EQUAL_INT(2, parse_arguments(2, bad[i], &config));
+        destroy_cli_config(&config);
+    }
+    test_restore_stderr(saved_stderr);
+}
+
+void test_parse_long_line_options(void) {
+    Config config;
+    init_cli_config(&config);
+    TEST_ASSERT_EQUAL_INT(0, config.max_line_kb);
+    TEST_ASSERT_EQUAL_INT(RULES_LONG_LINE_TRUNCATE, config.long_lines);
+    char *argv[] = {"secretguard", "--max-line-length", "1024", "--long-lines=window", "scan-target"};
+    TEST_ASSERT_EQUAL_INT(0, parse_arguments(5, argv, &config));
+    TEST_ASSERT_EQUAL_INT(1024, config.max_line_kb);
+    TEST_ASSERT_EQUAL_INT(RULES_LONG_LINE_WINDOW, config.long_lines);
+    destroy_cli_config(&config);
+
+    init_cli_config(&config);
+    char *skip[] = {"secretguard", "--max-line-length=64", "--long-lines", "skip"};
+    TEST_ASSERT_EQUAL_INT(0, parse_arguments(4, skip, &config));
+    TEST_ASSERT_EQUAL_INT(64, config.max_line_kb);
+    TEST_ASSERT_EQUAL_INT(RULES_LONG_LINE_SKIP, config.long_lines);
+    destroy_cli_config(&config);
+
+    int saved_stderr = -1;
+    TEST_ASSERT_EQUAL_INT(0, test_redirect_stderr_to_null(&saved_stderr));
+    char *bad[][2] = {
+        {"secretguard", "--max-line-length=-1"},
+        {"secretguard", "--max-line-length=1048577"},
+        {"secretguard", "--long-lines=drop"},
+        {"secretguard", "--long-lines"},
+    };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        init_cli_config(&config);
+        TEST_ASSERT_EQUAL_INT(2, parse_arguments(2, bad[i], &config));
+        destroy_cli_config(&config);
+    }
+    test_restore_stderr(saved_stderr);
+}
+
+void test_parse_io_options(void) {
+    Config config;
+    init_cli_config(&config);
+    TEST_ASSERT_EQUAL_INT(SCANNER_IO_AUTO, config.io);
+    TEST_ASSERT_EQUAL_INT(8, config.io_buffer_kb);
+    char *argv[] = {"secretguard", "--io-buffer", "256", "--io=mmap", "scan-target"};
+    TEST_ASSERT_EQUAL_INT(0, parse_arguments(5, argv, &config));
+    TEST_ASSERT_EQUAL_INT(SCANNER_IO_MMAP, config.io);
+    TEST_ASSERT_EQUAL_INT(256, config.io_buffer_kb);
+    destroy_cli_config(&config);
+
+    const char *modes[] = {"auto", "read", "mmap", "uring"};
+    const scanner_io_t expected[] = {SCANNER_IO_AUTO, SCANNER_IO_READ, SCANNER_IO_MMAP, SCANNER_IO_URING};
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i) {
+        init_cli_config(&config);
+        char *io[] = {"secretguard", "--io", (char *)modes[i], "--io-buffer=4"};
+        TEST_ASSERT_EQUAL_INT(0, parse_arguments(4, io, &config));
+        TEST_ASSERT_EQUAL_INT(expected[i], config.io);
+        TEST_ASSERT_EQUAL_INT(4, config.io_buffer_kb);
+        destroy_cli_config(&config);
+    }
+
+    int saved_stderr = -1;
+    TEST_ASSERT_EQUAL_INT(0, test_redirect_stderr_to_null(&saved_stderr));
+    char *bad[][2] = {
+        {"secretguard", "--io=aio"},
+        {"secretguard", "--io"},
+        {"secretguard", "--io-buffer=3"},
+        {"secretguard", "--io-buffer=65537"},
+        {"secretguard", "--io-buffer=8k"},
+        {"secretguard", "--iox"},
+    };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        init_cli_config(&config);
+        TEST_ASSERT_EQUAL_INT(2, parse_arguments(2, bad[i], &config));
+        destroy_cli_config(&config);
+    }
+    test_restore_stderr(saved_stderr);
+}
+
+void test_parse_split_size_option(void) {
+    Config config;
+    init_cli_config(&config);
+    TEST_ASSERT_EQUAL_INT(DEFAULT_SPLIT_MB, config.split_mb);
+    char *argv[] = {"secretguard", "--split-size", "256", "scan-target"};
+    TEST_ASSERT_EQUAL_INT(0, parse_arguments(4, argv, &config));
+    TEST_ASSERT_EQUAL_INT(256, config.split_mb);
+    destroy_cli_config(&config);
+
+    init_cli_config(&config);
+    char *off[] = {"secretguard", "--split-size=0"};
+    TEST_ASSERT_EQUAL_INT(0, parse_arguments(2, off, &config));
+    TEST_ASSERT_EQUAL_INT(0, config.split_mb);
+    destroy_cli_config(&config);
+
+    int saved_stderr = -1;
+    TEST_ASSERT_EQUAL_INT(0, test_redirect_stderr_to_null(&saved_stderr));
+    char *bad[][2] = {
+        {"secretguard", "--split-size=-1"},
+        {"secretguard", "--split-size=1048577"},
+        {"secretguard", "--split-size"},
+        {"secretguard", "--split-sizes=4"},
+    };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        init_cli_config(&config);
+        TEST_ASSERT_EQUAL_INT(2, parse_arguments(2, bad[i], &config));
+        destroy_cli_config(&config);
+    }
+    test_restore_stderr(saved_stderr);
+}
+
 void run_cli_tests(void) {
     RUN_TEST(test_parse_help_short_flag);
     RUN_TEST(test_parse_help_long_flag);
@@ -214,4 +510,20 @@ void run_cli_tests(void) {
     RUN_TEST(test_parse_unknown_flag);
     RUN_TEST(test_parse_extra_argument);
     RUN_TEST(test_parse_default_root_path);
+    RUN_TEST(test_parse_engine_values);
+    RUN_TEST(test_parse_engine_invalid_value);
+    RUN_TEST(test_parse_profile_rules_flag);
+    RUN_TEST(test_parse_all_files_flag);
+    RUN_TEST(test_parse_scan_binaries_flag);
+    RUN_TEST(test_parse_rules_flag);
+    RUN_TEST(test_parse_compile_rules_mode);
+    RUN_TEST(test_parse_compile_rules_requires_output);
+    RUN_TEST(test_parse_rule_selection);
+    RUN_TEST(test_parse_min_severity_invalid_value);
+    RUN_TEST(test_parse_entropy_options);
+    RUN_TEST(test_parse_entropy_invalid_values);
+    RUN_TEST(test_parse_line_cache_option);
+    RUN_TEST(test_parse_long_line_options);
+    RUN_TEST(test_parse_io_options);
+    RUN_TEST(test_parse_split_size_option);
 }
@@ -0,0 +1,107 @@
+#include "unity.h"
+#include "entropy.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// The run in text that the detector reports first, or "" if none.
+static void first_run(const char *kernel, const char *text, char *out, size_t out_size) {
+    EntropyDetector *detector = entropy_detector_create(ENTROPY_DEFAULT_THRESHOLD, ENTROPY_DEFAULT_MIN_LENGTH);
+    TEST_ASSERT_NOT_NULL(detector);
+    TEST_ASSERT_TRUE(entropy_detector_use_kernel(detector, kernel));
+    size_t start = 0;
+    size_t end = 0;
+    out[0] = '\0';
+    if (entropy_detector_next(detector, text, strlen(text), 0, &start, &end)) {
+        TEST_ASSERT_TRUE(end - start < out_size);
+        memcpy(out, text + start, end - start);
+        out[end - start] = '\0';
+    }
+    entropy_detector_destroy(detector);
+}
+
+static void assert_first_run(const char *text, const char *expected) {
+    char run[300];
+    first_run("scalar", text, run, sizeof(run));
+    TEST_ASSERT_EQUAL_STRING(expected, run);
+}
+
+void test_entropy_flags_random_runs_only(void) {
+    assert_first_run("secret: wJalrXUtnFEMI/K7MDENG/bPxRfiCYEXAMPLEKEY;", "wJalrXUtnFEMI/K7MDENG/bPxRfiCYEXAMPLEKEY");
+    assert_first_run("commit 2fd4e1c67a2d28fced849ee1bb76e7391b93eb12\n", "2fd4e1c67a2d28fced849ee1bb76e7391b93eb12");
+    // Identifiers lack digits, numbers lack letters, repeats lack entropy.
+    assert_first_run("call scanner_scan_parallel_with_options_and_pool();", "");
+    assert_first_run("id 123456789012345678901234567890", "");
+    assert_first_run("aaaaaaaaaaaaaaaaaaaa1111111111111111", "");
+    // Shorter than the minimum length.
+    assert_first_run("k=Xy7Qp2Lm9Rt4Vb8", "");
+}
+
+void test_entropy_skips_runs_too_long_or_started_before_from(void) {
+    char long_run[400];
+    for (size_t i = 0; i < 300; ++i) {
+        long_run[i] = "Ab3Cd5Ef7Gh9Jk2Mn4Pq6Rs8Tu0VwXyZ+/"[i % 34];
+    }
+    long_run[300] = '\0';
+    assert_first_run(long_run, "");
+
+    EntropyDetector *detector = entropy_detector_create(ENTROPY_DEFAULT_THRESHOLD, ENTROPY_DEFAULT_MIN_LENGTH);
+    TEST_ASSERT_NOT_NULL(detector);
+    const char *text = "wJalrXUtnFEMI/K7MDENG/bPxRfiCYEXAMPLEKEY 9f8e7d6c5b4a3f2e1d0c9b8a7f6e5d4c3b2a1f0e";
+    size_t start = 0;
+    size_t end = 0;
+    TEST_ASSERT_TRUE(entropy_detector_next(detector, text, strlen(text), 5, &start, &end));
+    TEST_ASSERT_EQUAL_UINT(41u, (unsigned int)start);
+    TEST_ASSERT_EQUAL_UINT((unsigned int)strlen(text), (unsigned int)end);
+    TEST_ASSERT_FALSE(entropy_detector_next(detector, text, strlen(text), end, &start, &end));
+    entropy_detector_destroy(detector);
+
+    TEST_ASSERT_NULL(entropy_detector_create(0.0, ENTROPY_DEFAULT_MIN_LENGTH));
+    TEST_ASSERT_NULL(entropy_detector_create(ENTROPY_DEFAULT_THRESHOLD, 0));
+}
+
+void test_entropy_kernels_agree(void) {
+    const char *kernels[] = {"sse2", "avx2"};
+    // Runs straddle the 64-byte blocks the kernels classify at a time.
+    char text[1024];
+    unsigned int seed = 12345;
+    for (int round = 0; round < 200; ++round) {
+        size_t length = 0;
+        while (length + 1 < sizeof(text)) {
+            seed = seed * 1103515245u + 12345u;
+            unsigned int pick = (seed >> 16) % 100;
+            text[length++] = pick < 85 ? "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/=_-"[pick % 67]
+                                       : " \n.:\"'"[pick % 6];
+        }
+        text[length] = '\0';
+        char expected[300];
+        first_run("scalar", text, expected, sizeof(expected));
+        for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+            EntropyDetector *detector = entropy_detector_create(ENTROPY_DEFAULT_THRESHOLD, ENTROPY_DEFAULT_MIN_LENGTH);
+            TEST_ASSERT_NOT_NULL(detector);
+            bool available = entropy_detector_use_kernel(detector, kernels[k]);
+            entropy_detector_destroy(detector);
+            if (!available) {
+                continue;
+            }
+            char run[300];
+            first_run(kernels[k], text, run, sizeof(run));
+            TEST_ASSERT_EQUAL_STRING(expected, run);
+        }
+    }
+}
+
+void test_entropy_bits(void) {
+    // Unity is built without double support; these values are exact.
+    TEST_ASSERT_TRUE(entropy_bits("aaaa", 4) == 0.0);
+    TEST_ASSERT_TRUE(entropy_bits("abab", 4) == 1.0);
+    TEST_ASSERT_TRUE(entropy_bits("0123456789abcdef", 16) == 4.0);
+    TEST_ASSERT_TRUE(entropy_bits("", 0) == 0.0);
+}
+
+void run_entropy_tests(void) {
+    RUN_TEST(test_entropy_flags_random_runs_only);
+    RUN_TEST(test_entropy_skips_runs_too_long_or_started_before_from);
+    RUN_TEST(test_entropy_kernels_agree);
+    RUN_TEST(test_entropy_bits);
+}
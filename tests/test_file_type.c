@@ -0,0 +1,46 @@
+#include "unity.h"
+#include "file_type.h"
+
+void test_file_type_from_path(void) {
+    TEST_ASSERT_EQUAL_INT(FILE_TYPE_JSON, file_type_from_path("keys/service_account.json"));
+    TEST_ASSERT_EQUAL_INT(FILE_TYPE_JSON, file_type_from_path("notebooks/Analysis.IPYNB"));
+    TEST_ASSERT_EQUAL_INT(FILE_TYPE_TEXT, file_type_from_path("certs/server.pem"));
+    TEST_ASSERT_EQUAL_INT(FILE_TYPE_TEXT, file_type_from_path("home/.ssh/id_ed25519"));
+    TEST_ASSERT_EQUAL_INT(FILE_TYPE_SKIP, file_type_from_path("assets/logo.PNG"));
+    TEST_ASSERT_EQUAL_INT(FILE_TYPE_SKIP, file_type_from_path("fonts/inter.woff2"));
+    TEST_ASSERT_EQUAL_INT(FILE_TYPE_SKIP, file_type_from_path("web/package-lock.json"));
+    TEST_ASSERT_EQUAL_INT(FILE_TYPE_SKIP, file_type_from_path("Cargo.lock"));
+    TEST_ASSERT_EQUAL_INT(FILE_TYPE_BINARY, file_type_from_path("build/App.class"));
+    TEST_ASSERT_EQUAL_INT(FILE_TYPE_BINARY, file_type_from_path("lib/libssl.so"));
+    // Source code, plain text and configuration can embed JSON, so they
+    // keep every rule.
+    TEST_ASSERT_EQUAL_INT(FILE_TYPE_UNKNOWN, file_type_from_path("app/.env"));
+    TEST_ASSERT_EQUAL_INT(FILE_TYPE_UNKNOWN, file_type_from_path(".env.production"));
+    TEST_ASSERT_EQUAL_INT(FILE_TYPE_UNKNOWN, file_type_from_path("deploy/values.yaml"));
+    TEST_ASSERT_EQUAL_INT(FILE_TYPE_UNKNOWN, file_type_from_path("pom.xml"));
+    TEST_ASSERT_EQUAL_INT(FILE_TYPE_UNKNOWN, file_type_from_path("src/main.py"));
+    TEST_ASSERT_EQUAL_INT(FILE_TYPE_UNKNOWN, file_type_from_path("notes.txt"));
+    TEST_ASSERT_EQUAL_INT(FILE_TYPE_UNKNOWN, file_type_from_path("README"));
+    TEST_ASSERT_EQUAL_INT(FILE_TYPE_UNKNOWN, file_type_from_path("dir.png/file."));
+    TEST_ASSERT_EQUAL_INT(FILE_TYPE_UNKNOWN, file_type_from_path(NULL));
+}
+
+void test_file_type_sniff_signatures(void) {
+    const unsigned char png[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n', 0, 0};
+    const unsigned char elf[] = {0x7f, 'E', 'L', 'F', 2, 1};
+    const unsigned char java[] = {0xca, 0xfe, 0xba, 0xbe, 0, 0, 0, 0x41};
+    const unsigned char mp4[] = {0, 0, 0, 0x20, 'f', 't', 'y', 'p', 'i', 's', 'o', 'm'};
+    const unsigned char text[] = "password = hunter22\n";
+    TEST_ASSERT_EQUAL_INT(FILE_TYPE_SKIP, file_type_sniff(FILE_TYPE_UNKNOWN, png, sizeof(png)));
+    TEST_ASSERT_EQUAL_INT(FILE_TYPE_BINARY, file_type_sniff(FILE_TYPE_TEXT, elf, sizeof(elf)));
+    TEST_ASSERT_EQUAL_INT(FILE_TYPE_BINARY, file_type_sniff(FILE_TYPE_UNKNOWN, java, sizeof(java)));
+    TEST_ASSERT_EQUAL_INT(FILE_TYPE_SKIP, file_type_sniff(FILE_TYPE_UNKNOWN, mp4, sizeof(mp4)));
+    TEST_ASSERT_EQUAL_INT(FILE_TYPE_JSON, file_type_sniff(FILE_TYPE_JSON, text, sizeof(text) - 1));
+    // Too short for the signature.
+    TEST_ASSERT_EQUAL_INT(FILE_TYPE_UNKNOWN, file_type_sniff(FILE_TYPE_UNKNOWN, png, 4));
+}
+
+void run_file_type_tests(void) {
+    RUN_TEST(test_file_type_from_path);
+    RUN_TEST(test_file_type_sniff_signatures);
+}
@@ -0,0 +1,57 @@
+#include "unity.h"
+#include "generated_rules.h"
+
+#include <regex.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define AWS_ACCESS_KEY_PATTERN "AKIA[0-9A-Z]{16}"
+
+void test_generated_rules_lookup(void) {
+    TEST_ASSERT_TRUE(generated_rules_count() > 0);
+    int index = generated_rules_lookup(AWS_ACCESS_KEY_PATTERN, REG_ICASE | REG_EXTENDED);
+    TEST_ASSERT_TRUE(index >= 0);
+    TEST_ASSERT_EQUAL_UINT(20u, (unsigned int)generated_rules_min_length((size_t)index));
+
+    // Same pattern with other flags, or a custom pattern, is not generated.
+    TEST_ASSERT_EQUAL_INT(-1, generated_rules_lookup(AWS_ACCESS_KEY_PATTERN, REG_EXTENDED));
+    TEST_ASSERT_EQUAL_INT(-1, generated_rules_lookup("custom[0-9]+", REG_ICASE | REG_EXTENDED));
+}
+
+void test_generated_rules_find(void) {
+    int index = generated_rules_lookup(AWS_ACCESS_KEY_PATTERN, REG_ICASE | REG_EXTENDED);
+    TEST_ASSERT_TRUE(index >= 0);
+
+    const char *text = "id=akia1234567890ABCDEF1 rest";
+    size_t start = 0;
+    size_t end = 0;
+    TEST_ASSERT_TRUE(generated_rules_find((size_t)index, text, strlen(text), &start, &end));
+    TEST_ASSERT_EQUAL_UINT(3u, (unsigned int)start);
+    TEST_ASSERT_EQUAL_UINT(23u, (unsigned int)end);
+
+    const char *short_text = "id=AKIA123";
+    TEST_ASSERT_FALSE(generated_rules_find((size_t)index, short_text, strlen(short_text), &start, &end));
+}
+
+void test_generated_rules_mark(void) {
+    int index = generated_rules_lookup(AWS_ACCESS_KEY_PATTERN, REG_ICASE | REG_EXTENDED);
+    TEST_ASSERT_TRUE(index >= 0);
+    unsigned char *marks = calloc(generated_rules_count(), 1);
+    TEST_ASSERT_NOT_NULL(marks);
+
+    const char *text = "key AKIA1234567890ABCDEF";
+    generated_rules_mark(text, strlen(text), marks);
+    TEST_ASSERT_EQUAL_UINT8(1, marks[index]);
+
+    memset(marks, 0, generated_rules_count());
+    const char *clean = "nothing to see here";
+    generated_rules_mark(clean, strlen(clean), marks);
+    TEST_ASSERT_EQUAL_UINT8(0, marks[index]);
+    free(marks);
+}
+
+void run_generated_rules_tests(void) {
+    RUN_TEST(test_generated_rules_lookup);
+    RUN_TEST(test_generated_rules_find);
+    RUN_TEST(test_generated_rules_mark);
+}
@@ -0,0 +1,81 @@
+#include "unity.h"
+#include "io_ring.h"
+#include "test_utils.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+void test_io_ring_open_and_read(void) {
+    IoRing *ring = io_ring_create(4);
+    if (!ring) {
+        TEST_ASSERT_FALSE(io_ring_supported());
+        TEST_IGNORE_MESSAGE("io_uring is not available");
+    }
+    TEST_ASSERT_TRUE(io_ring_supported());
+
+    char *root = test_make_temp_dir();
+    TEST_ASSERT_NOT_NULL(root);
+    char *path = test_join_path(root, "data.txt");
+    char *missing = test_join_path(root, "missing.txt");
+    TEST_ASSERT_EQUAL_INT(0, test_write_file(path, "password = hunter22\n"));
+
+    // Both opens complete, in either order.
+    TEST_ASSERT_EQUAL_INT(0, io_ring_queue_open(ring, path, O_RDONLY, 1));
+    TEST_ASSERT_EQUAL_INT(0, io_ring_queue_open(ring, missing, O_RDONLY, 2));
+    TEST_ASSERT_EQUAL_INT(0, io_ring_submit(ring, 2));
+    int fd = -1;
+    int missing_result = 0;
+    uint64_t user_data = 0;
+    int result = 0;
+    for (int i = 0; i < 2; ++i) {
+        TEST_ASSERT_TRUE(io_ring_next(ring, &user_data, &result));
+        if (user_data == 1) {
+            fd = result;
+        } else {
+            TEST_ASSERT_TRUE(user_data == 2);
+            missing_result = result;
+        }
+    }
+    TEST_ASSERT_FALSE(io_ring_next(ring, &user_data, &result));
+    TEST_ASSERT_TRUE(fd >= 0);
+    TEST_ASSERT_TRUE(missing_result < 0);
+
+    // A read past the start, then one at the end of the file.
+    char buffer[64];
+    TEST_ASSERT_EQUAL_INT(0, io_ring_queue_read(ring, fd, buffer, sizeof(buffer), 11, 3));
+    TEST_ASSERT_EQUAL_INT(0, io_ring_submit(ring, 1));
+    TEST_ASSERT_TRUE(io_ring_next(ring, &user_data, &result));
+    TEST_ASSERT_TRUE(user_data == 3);
+    TEST_ASSERT_EQUAL_INT(9, result);
+    TEST_ASSERT_EQUAL_MEMORY("hunter22\n", buffer, 9);
+
+    TEST_ASSERT_EQUAL_INT(0, io_ring_queue_read(ring, fd, buffer, sizeof(buffer), 20, 4));
+    TEST_ASSERT_EQUAL_INT(0, io_ring_submit(ring, 1));
+    TEST_ASSERT_TRUE(io_ring_next(ring, &user_data, &result));
+    TEST_ASSERT_EQUAL_INT(0, result);
+
+    // The queue holds no more than the ring's entries.
+    int queued = 0;
+    while (queued < 64 && io_ring_queue_read(ring, fd, buffer, sizeof(buffer), 0, 5) == 0) {
+        queued++;
+    }
+    TEST_ASSERT_TRUE(queued >= 4 && queued < 64);
+    TEST_ASSERT_EQUAL_INT(0, io_ring_submit(ring, (unsigned)queued));
+    for (int i = 0; i < queued; ++i) {
+        TEST_ASSERT_TRUE(io_ring_next(ring, &user_data, &result));
+        TEST_ASSERT_EQUAL_INT(20, result);
+    }
+
+    close(fd);
+    io_ring_destroy(ring);
+    free(path);
+    free(missing);
+    test_remove_tree(root);
+    free(root);
+}
+
+void run_io_ring_tests(void) {
+    RUN_TEST(test_io_ring_open_and_read);
+}
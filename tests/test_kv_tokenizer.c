@@ -0,0 +1,116 @@
+#include "unity.h"
+#include "kv_tokenizer.h"
+
+#include <regex.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PASSWORD_RULE "(^|[^[:alnum:]_-])(password|passwort)[[:space:]]*[:=][[:space:]]*[^[:space:]]+"
+#define PROJECT_RULE "project[_-]?id[[:space:]]*[:=][[:space:]]*[^[:space:]]+"
+#define TYPE_RULE "\"type\"[[:space:]]*:[[:space:]]*\"service_account\""
+
+static int add_pattern(KvTokenizer *tokenizer, const char *pattern, size_t id) {
+    PatternNode *node = pattern_parse(pattern, REG_EXTENDED | REG_ICASE);
+    TEST_ASSERT_NOT_NULL(node);
+    int added = kv_tokenizer_add(tokenizer, node, id);
+    pattern_free(node);
+    return added;
+}
+
+static KvTokenizer *build_tokenizer(void) {
+    KvTokenizer *tokenizer = kv_tokenizer_create();
+    TEST_ASSERT_NOT_NULL(tokenizer);
+    TEST_ASSERT_EQUAL_INT(1, add_pattern(tokenizer, PASSWORD_RULE, 0));
+    TEST_ASSERT_EQUAL_INT(1, add_pattern(tokenizer, PROJECT_RULE, 2));
+    TEST_ASSERT_EQUAL_INT(1, add_pattern(tokenizer, TYPE_RULE, 3));
+    TEST_ASSERT_EQUAL_INT(0, kv_tokenizer_build(tokenizer));
+    return tokenizer;
+}
+
+void test_kv_tokenizer_recognizes_key_value_rules(void) {
+    KvTokenizer *tokenizer = kv_tokenizer_create();
+    TEST_ASSERT_NOT_NULL(tokenizer);
+    TEST_ASSERT_EQUAL_INT(0, add_pattern(tokenizer, "AKIA[0-9A-Z]{16}", 0));
+    TEST_ASSERT_EQUAL_INT(0, add_pattern(tokenizer, "jdbc:[a-z]+://[^[:space:]]+", 1));
+    TEST_ASSERT_EQUAL_INT(1, add_pattern(tokenizer, PASSWORD_RULE, 2));
+    TEST_ASSERT_EQUAL_UINT(1u, (unsigned int)kv_tokenizer_count(tokenizer));
+    TEST_ASSERT_EQUAL_UINT(2u, (unsigned int)kv_tokenizer_id(tokenizer, 0));
+    kv_tokenizer_destroy(tokenizer);
+}
+
+void test_kv_tokenizer_marks_candidates(void) {
+    KvTokenizer *tokenizer = build_tokenizer();
+
+    unsigned char marks[4] = {0, 0, 0, 0};
+    const char *text = "{\"TYPE\": \"service_account\", \"x\": 1}";
+    kv_tokenizer_mark(tokenizer, text, strlen(text), marks);
+    TEST_ASSERT_EQUAL_UINT8(0, marks[0]);
+    TEST_ASSERT_EQUAL_UINT8(0, marks[2]);
+    TEST_ASSERT_EQUAL_UINT8(1, marks[3]);
+
+    // "mypassword" has no boundary before the key, "project_id" needs none.
+    memset(marks, 0, sizeof(marks));
+    text = "mypassword=x my_project_id = y";
+    kv_tokenizer_mark(tokenizer, text, strlen(text), marks);
+    TEST_ASSERT_EQUAL_UINT8(0, marks[0]);
+    TEST_ASSERT_EQUAL_UINT8(1, marks[2]);
+
+    // A separator without a value is not a candidate.
+    memset(marks, 0, sizeof(marks));
+    kv_tokenizer_mark(tokenizer, "password=", 9, marks);
+    TEST_ASSERT_EQUAL_UINT8(0, marks[0]);
+
+    kv_tokenizer_destroy(tokenizer);
+}
+
+void test_kv_tokenizer_next_finds_each_start(void) {
+    KvTokenizer *tokenizer = build_tokenizer();
+
+    // Starts include the boundary byte, except for '^' at position 0.
+    const char *text = "Password: a, passwort=b";
+    size_t length = strlen(text);
+    size_t start = 0;
+    TEST_ASSERT_TRUE(kv_tokenizer_next(tokenizer, 0, text, length, 0, &start));
+    TEST_ASSERT_EQUAL_UINT(0u, (unsigned int)start);
+    TEST_ASSERT_TRUE(kv_tokenizer_next(tokenizer, 0, text, length, start + 1, &start));
+    TEST_ASSERT_EQUAL_UINT(12u, (unsigned int)start);
+    TEST_ASSERT_FALSE(kv_tokenizer_next(tokenizer, 0, text, length, start + 1, &start));
+
+    // Rules without a boundary may start inside a longer word.
+    text = "my_project_id=7";
+    TEST_ASSERT_TRUE(kv_tokenizer_next(tokenizer, 1, text, strlen(text), 0, &start));
+    TEST_ASSERT_EQUAL_UINT(3u, (unsigned int)start);
+
+    kv_tokenizer_destroy(tokenizer);
+}
+
+void test_kv_tokenizer_serialize_roundtrip(void) {
+    KvTokenizer *tokenizer = build_tokenizer();
+    size_t size = kv_tokenizer_serialize(tokenizer, NULL);
+    TEST_ASSERT_TRUE(size > 0);
+    void *image = malloc(size);
+    TEST_ASSERT_NOT_NULL(image);
+    TEST_ASSERT_EQUAL_UINT(size, kv_tokenizer_serialize(tokenizer, image));
+    kv_tokenizer_destroy(tokenizer);
+
+    TEST_ASSERT_NULL(kv_tokenizer_load(image, size, 3));
+    TEST_ASSERT_NULL(kv_tokenizer_load(image, size - 1, 4));
+
+    tokenizer = kv_tokenizer_load(image, size, 4);
+    TEST_ASSERT_NOT_NULL(tokenizer);
+    TEST_ASSERT_EQUAL_UINT(3u, (unsigned int)kv_tokenizer_count(tokenizer));
+    unsigned char marks[4] = {0, 0, 0, 0};
+    const char *text = "export PASSWORD=hunter2";
+    kv_tokenizer_mark(tokenizer, text, strlen(text), marks);
+    TEST_ASSERT_EQUAL_UINT8(1, marks[0]);
+    TEST_ASSERT_EQUAL_UINT8(0, marks[2]);
+    kv_tokenizer_destroy(tokenizer);
+    free(image);
+}
+
+void run_kv_tokenizer_tests(void) {
+    RUN_TEST(test_kv_tokenizer_recognizes_key_value_rules);
+    RUN_TEST(test_kv_tokenizer_marks_candidates);
+    RUN_TEST(test_kv_tokenizer_next_finds_each_start);
+    RUN_TEST(test_kv_tokenizer_serialize_roundtrip);
+}
@@ -0,0 +1,208 @@
+#include "unity.h"
+#include "lazy_dfa.h"
+
+#include <regex.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    PatternNode *nodes[4];
+    size_t count;
+    LazyDfa *dfa;
+    LazyDfaCache *cache;
+} DfaFixture;
+
+static void build_fixture(DfaFixture *fixture, const char *const *patterns, size_t count, int flags) {
+    memset(fixture, 0, sizeof(*fixture));
+    fixture->count = count;
+    for (size_t i = 0; i < count; ++i) {
+        fixture->nodes[i] = pattern_parse(patterns[i], flags);
+        TEST_ASSERT_NOT_NULL(fixture->nodes[i]);
+        TEST_ASSERT_TRUE(lazy_dfa_supports(fixture->nodes[i]));
+    }
+    fixture->dfa = lazy_dfa_create(fixture->nodes, count);
+    TEST_ASSERT_NOT_NULL(fixture->dfa);
+    fixture->cache = lazy_dfa_cache_create(fixture->dfa);
+    TEST_ASSERT_NOT_NULL(fixture->cache);
+}
+
+static void destroy_fixture(DfaFixture *fixture) {
+    lazy_dfa_cache_destroy(fixture->cache);
+    lazy_dfa_destroy(fixture->dfa);
+    for (size_t i = 0; i < fixture->count; ++i) {
+        pattern_free(fixture->nodes[i]);
+    }
+}
+
+void test_lazy_dfa_marks_matching_patterns(void) {
+    const char *patterns[] = {"AKIA[0-9A-Z]{16}", "ghp_[A-Za-z0-9]{4}", "x{3}"};
+    DfaFixture fixture;
+    build_fixture(&fixture, patterns, 3, REG_EXTENDED);
+
+    unsigned char marks[3] = {0, 0, 0};
+    const char *text = "id=AKIA1234567890ABCDEF token=ghp_ab";
+    TEST_ASSERT_EQUAL_INT(0, lazy_dfa_mark(fixture.cache, text, strlen(text), marks));
+    TEST_ASSERT_EQUAL_UINT8(1, marks[0]);
+    TEST_ASSERT_EQUAL_UINT8(0, marks[1]);
+    TEST_ASSERT_EQUAL_UINT8(0, marks[2]);
+
+    destroy_fixture(&fixture);
+}
+
+void test_lazy_dfa_find_is_leftmost_longest(void) {
+    const char *patterns[] = {"a|ab|abc", "b+"};
+    DfaFixture fixture;
+    build_fixture(&fixture, patterns, 2, REG_EXTENDED);
+
+    size_t start = 0;
+    size_t end = 0;
+    TEST_ASSERT_TRUE(lazy_dfa_find(fixture.cache, 0, "xxabcd", 6, &start, &end));
+    TEST_ASSERT_EQUAL_UINT(2u, (unsigned int)start);
+    TEST_ASSERT_EQUAL_UINT(5u, (unsigned int)end);
+    TEST_ASSERT_TRUE(lazy_dfa_find(fixture.cache, 1, "abbbc", 5, &start, &end));
+    TEST_ASSERT_EQUAL_UINT(1u, (unsigned int)start);
+    TEST_ASSERT_EQUAL_UINT(4u, (unsigned int)end);
+
+    destroy_fixture(&fixture);
+}
+
+void test_lazy_dfa_anchors_and_case(void) {
+    const char *patterns[] = {"^key$", "token"};
+    DfaFixture fixture;
+    build_fixture(&fixture, patterns, 2, REG_EXTENDED | REG_ICASE);
+
+    unsigned char marks[2] = {0, 0};
+    TEST_ASSERT_EQUAL_INT(0, lazy_dfa_mark(fixture.cache, "KEY", 3, marks));
+    TEST_ASSERT_EQUAL_UINT8(1, marks[0]);
+    TEST_ASSERT_EQUAL_UINT8(0, marks[1]);
+
+    memset(marks, 0, sizeof(marks));
+    TEST_ASSERT_EQUAL_INT(0, lazy_dfa_mark(fixture.cache, " key Token", 10, marks));
+    TEST_ASSERT_EQUAL_UINT8(0, marks[0]);
+    TEST_ASSERT_EQUAL_UINT8(1, marks[1]);
+
+    destroy_fixture(&fixture);
+}
+
+void test_lazy_dfa_empty_match(void) {
+    const char *patterns[] = {"z*"};
+    DfaFixture fixture;
+    build_fixture(&fixture, patterns, 1, REG_EXTENDED);
+
+    size_t start = 1;
+    size_t end = 1;
+    TEST_ASSERT_TRUE(lazy_dfa_find(fixture.cache, 0, "abc", 3, &start, &end));
+    TEST_ASSERT_EQUAL_UINT(0u, (unsigned int)start);
+    TEST_ASSERT_EQUAL_UINT(0u, (unsigned int)end);
+
+    destroy_fixture(&fixture);
+}
+
+void test_lazy_dfa_rejects_repeated_anchor(void) {
+    PatternNode *node = pattern_parse("(^a){2}", REG_EXTENDED);
+    TEST_ASSERT_NOT_NULL(node);
+    TEST_ASSERT_FALSE(lazy_dfa_supports(node));
+    pattern_free(node);
+}
+
+void test_lazy_dfa_export_table(void) {
+    const char *patterns[] = {"ab+"};
+    DfaFixture fixture;
+    build_fixture(&fixture, patterns, 1, REG_EXTENDED);
+
+    LazyDfaTable table;
+    TEST_ASSERT_EQUAL_INT(0, lazy_dfa_export(fixture.dfa, true, 16, &table));
+    uint32_t state = table.start;
+    const char *text = "abb";
+    for (size_t i = 0; i < 3; ++i) {
+        state = table.next[state * table.class_count + table.class_of[(unsigned char)text[i]]];
+    }
+    TEST_ASSERT_EQUAL_UINT(1u, (unsigned int)table.match_count[state]);
+    TEST_ASSERT_EQUAL_UINT(0u, (unsigned int)table.ids[table.match_offset[state]]);
+    state = table.next[state * table.class_count + table.class_of['a']];
+    TEST_ASSERT_EQUAL_UINT((unsigned int)table.dead, (unsigned int)state);
+    lazy_dfa_table_free(&table);
+
+    TEST_ASSERT_EQUAL_INT(-1, lazy_dfa_export(fixture.dfa, true, 1, &table));
+
+    destroy_fixture(&fixture);
+}
+
+void test_lazy_dfa_serialize_roundtrip(void) {
+    const char *patterns[] = {"a|ab|abc", "^b+$"};
+    DfaFixture fixture;
+    build_fixture(&fixture, patterns, 2, REG_EXTENDED);
+
+    size_t size = lazy_dfa_serialize(fixture.dfa, NULL);
+    void *image = malloc(size);
+    TEST_ASSERT_NOT_NULL(image);
+    TEST_ASSERT_EQUAL_UINT(size, lazy_dfa_serialize(fixture.dfa, image));
+    destroy_fixture(&fixture);
+
+    TEST_ASSERT_NULL(lazy_dfa_load(image, size, 3));
+    TEST_ASSERT_NULL(lazy_dfa_load(image, size - 1, 2));
+
+    LazyDfa *dfa = lazy_dfa_load(image, size, 2);
+    TEST_ASSERT_NOT_NULL(dfa);
+    LazyDfaCache *cache = lazy_dfa_cache_create(dfa);
+    TEST_ASSERT_NOT_NULL(cache);
+    size_t start = 0;
+    size_t end = 0;
+    TEST_ASSERT_TRUE(lazy_dfa_find(cache, 0, "xxabcd", 6, &start, &end));
+    TEST_ASSERT_EQUAL_UINT(2u, (unsigned int)start);
+    TEST_ASSERT_EQUAL_UINT(5u, (unsigned int)end);
+    TEST_ASSERT_TRUE(lazy_dfa_find(cache, 1, "bbb", 3, &start, &end));
+    TEST_ASSERT_FALSE(lazy_dfa_find(cache, 1, "abbb", 4, &start, &end));
+    lazy_dfa_cache_destroy(cache);
+    lazy_dfa_destroy(dfa);
+    free(image);
+}
+
+void test_lazy_dfa_match_at_and_unmarked_patterns(void) {
+    PatternNode *nodes[2];
+    nodes[0] = pattern_parse("^ab+", REG_EXTENDED);
+    nodes[1] = pattern_parse("key=[0-9]+", REG_EXTENDED);
+    TEST_ASSERT_NOT_NULL(nodes[0]);
+    TEST_ASSERT_NOT_NULL(nodes[1]);
+    const bool marked[2] = {true, false};
+    LazyDfa *dfa = lazy_dfa_create_with_marks(nodes, 2, marked);
+    TEST_ASSERT_NOT_NULL(dfa);
+    LazyDfaCache *cache = lazy_dfa_cache_create(dfa);
+    TEST_ASSERT_NOT_NULL(cache);
+
+    // Unmarked patterns are never marked but can still be searched.
+    unsigned char marks[2] = {0, 0};
+    const char *text = "abb key=42";
+    TEST_ASSERT_EQUAL_INT(0, lazy_dfa_mark(cache, text, strlen(text), marks));
+    TEST_ASSERT_EQUAL_UINT8(1, marks[0]);
+    TEST_ASSERT_EQUAL_UINT8(0, marks[1]);
+    size_t start = 0;
+    size_t end = 0;
+    TEST_ASSERT_TRUE(lazy_dfa_find(cache, 1, text, strlen(text), &start, &end));
+    TEST_ASSERT_EQUAL_UINT(4u, (unsigned int)start);
+    TEST_ASSERT_EQUAL_UINT(10u, (unsigned int)end);
+
+    TEST_ASSERT_TRUE(lazy_dfa_match_at(cache, 1, text, strlen(text), 4, &end));
+    TEST_ASSERT_EQUAL_UINT(10u, (unsigned int)end);
+    TEST_ASSERT_FALSE(lazy_dfa_match_at(cache, 1, text, strlen(text), 3, &end));
+    // '^' stays anchored to the start of text, not to the start offset.
+    TEST_ASSERT_TRUE(lazy_dfa_match_at(cache, 0, text, strlen(text), 0, &end));
+    TEST_ASSERT_EQUAL_UINT(3u, (unsigned int)end);
+    TEST_ASSERT_FALSE(lazy_dfa_match_at(cache, 0, "xab", 3, 1, &end));
+
+    lazy_dfa_cache_destroy(cache);
+    lazy_dfa_destroy(dfa);
+    pattern_free(nodes[0]);
+    pattern_free(nodes[1]);
+}
+
+void run_lazy_dfa_tests(void) {
+    RUN_TEST(test_lazy_dfa_marks_matching_patterns);
+    RUN_TEST(test_lazy_dfa_find_is_leftmost_longest);
+    RUN_TEST(test_lazy_dfa_anchors_and_case);
+    RUN_TEST(test_lazy_dfa_empty_match);
+    RUN_TEST(test_lazy_dfa_rejects_repeated_anchor);
+    RUN_TEST(test_lazy_dfa_export_table);
+    RUN_TEST(test_lazy_dfa_serialize_roundtrip);
+    RUN_TEST(test_lazy_dfa_match_at_and_unmarked_patterns);
+}
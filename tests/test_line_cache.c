@@ -0,0 +1,96 @@
+#include "unity.h"
+#include "line_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static bool lookup(LineCache *cache, uint32_t tag, const char *line, size_t *count) {
+    const LineCacheMatch *matches = NULL;
+    uint64_t hash = line_cache_hash(tag, line, strlen(line));
+    return line_cache_lookup(cache, hash, tag, line, strlen(line), &matches, count);
+}
+
+static bool store(LineCache *cache, uint32_t tag, const char *line, const LineCacheMatch *matches, size_t count) {
+    uint64_t hash = line_cache_hash(tag, line, strlen(line));
+    return line_cache_store(cache, hash, tag, line, strlen(line), matches, count);
+}
+
+void test_line_cache_admits_on_second_miss(void) {
+    TEST_ASSERT_NULL(line_cache_create(LINE_CACHE_MIN_BYTES - 1));
+    LineCache *cache = line_cache_create(1 << 20);
+    TEST_ASSERT_NOT_NULL(cache);
+
+    const char *line = "GET /health token=AKIA1234567890ABCDEF";
+    LineCacheMatch match = {7, 17, 37};
+    size_t count = 0;
+    TEST_ASSERT_FALSE(lookup(cache, 0, line, &count));
+    TEST_ASSERT_FALSE(store(cache, 0, line, &match, 1));
+    TEST_ASSERT_FALSE(lookup(cache, 0, line, &count));
+    TEST_ASSERT_TRUE(store(cache, 0, line, &match, 1));
+
+    const LineCacheMatch *matches = NULL;
+    uint64_t hash = line_cache_hash(0, line, strlen(line));
+    TEST_ASSERT_TRUE(line_cache_lookup(cache, hash, 0, line, strlen(line), &matches, &count));
+    TEST_ASSERT_EQUAL_UINT(1u, (unsigned int)count);
+    TEST_ASSERT_EQUAL_UINT(7u, matches[0].rule);
+    TEST_ASSERT_EQUAL_UINT(17u, matches[0].start);
+    TEST_ASSERT_EQUAL_UINT(37u, matches[0].end);
+    // Another tag is another line.
+    TEST_ASSERT_FALSE(lookup(cache, 1, line, &count));
+
+    LineCacheStats stats;
+    line_cache_stats(cache, &stats);
+    TEST_ASSERT_EQUAL_UINT(1u, (unsigned int)stats.hits);
+    TEST_ASSERT_EQUAL_UINT(3u, (unsigned int)stats.misses);
+    line_cache_destroy(cache);
+}
+
+void test_line_cache_stays_within_cap(void) {
+    LineCache *cache = line_cache_create(LINE_CACHE_MIN_BYTES);
+    TEST_ASSERT_NOT_NULL(cache);
+    char line[64];
+    for (int i = 0; i < 500; ++i) {
+        snprintf(line, sizeof(line), "line %d of a log that does not repeat often", i);
+        store(cache, 0, line, NULL, 0);
+        store(cache, 0, line, NULL, 0);
+    }
+    LineCacheStats stats;
+    line_cache_stats(cache, &stats);
+    TEST_ASSERT_TRUE(stats.evictions > 0);
+    TEST_ASSERT_TRUE(stats.bytes <= LINE_CACHE_MIN_BYTES);
+    // The most recent line is still there.
+    size_t count = 1;
+    TEST_ASSERT_TRUE(lookup(cache, 0, line, &count));
+    TEST_ASSERT_EQUAL_UINT(0u, (unsigned int)count);
+    line_cache_destroy(cache);
+}
+
+void test_line_cache_bypasses_unique_text(void) {
+    LineCache *cache = line_cache_create(1 << 20);
+    TEST_ASSERT_NOT_NULL(cache);
+    char line[64];
+    size_t count = 0;
+    size_t active = 0;
+    for (int i = 0; i < 8192; ++i) {
+        if (!line_cache_active(cache)) {
+            continue;
+        }
+        active++;
+        snprintf(line, sizeof(line), "unique line %d", i);
+        if (!lookup(cache, 0, line, &count)) {
+            store(cache, 0, line, NULL, 0);
+        }
+    }
+    LineCacheStats stats;
+    line_cache_stats(cache, &stats);
+    TEST_ASSERT_EQUAL_UINT(0u, (unsigned int)stats.hits);
+    TEST_ASSERT_TRUE(active < 8192);
+    TEST_ASSERT_EQUAL_UINT(8192u, (unsigned int)(active + stats.bypassed));
+    line_cache_destroy(cache);
+}
+
+void run_line_cache_tests(void) {
+    RUN_TEST(test_line_cache_admits_on_second_miss);
+    RUN_TEST(test_line_cache_stays_within_cap);
+    RUN_TEST(test_line_cache_bypasses_unique_text);
+}
@@ -0,0 +1,41 @@
+#include "unity.h"
+#include "path_table.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void test_path_table_intern(void) {
+    PathTable *table = path_table_create();
+    TEST_ASSERT_NOT_NULL(table);
+    TEST_ASSERT_EQUAL_UINT(0u, (unsigned int)path_table_count(table));
+    TEST_ASSERT_NULL(path_table_get(table, 0));
+
+    char path[32];
+    const char *stored = NULL;
+    snprintf(path, sizeof(path), "src/a.c");
+    TEST_ASSERT_EQUAL_UINT(0u, path_table_intern(table, path, &stored));
+    TEST_ASSERT_EQUAL_STRING("src/a.c", stored);
+    // The table keeps its own copy.
+    snprintf(path, sizeof(path), "src/b.c");
+    TEST_ASSERT_EQUAL_STRING("src/a.c", path_table_get(table, 0));
+
+    // Stored strings stay put while the table grows.
+    for (unsigned int i = 1; i < 200; ++i) {
+        snprintf(path, sizeof(path), "file_%u", i);
+        TEST_ASSERT_EQUAL_UINT(i, path_table_intern(table, path, NULL));
+    }
+    TEST_ASSERT_EQUAL_STRING("src/a.c", stored);
+    TEST_ASSERT_EQUAL_STRING("file_199", path_table_get(table, 199));
+    TEST_ASSERT_EQUAL_UINT(200u, (unsigned int)path_table_count(table));
+
+    // Every call adds an entry, even for a path seen before.
+    TEST_ASSERT_EQUAL_UINT(200u, path_table_intern(table, "src/a.c", NULL));
+    TEST_ASSERT_NULL(path_table_get(table, 201));
+    TEST_ASSERT_EQUAL_UINT(PATH_TABLE_NONE, path_table_intern(NULL, "x", NULL));
+
+    path_table_destroy(table);
+}
+
+void run_path_table_tests(void) {
+    RUN_TEST(test_path_table_intern);
+}
@@ -0,0 +1,94 @@
+#include "unity.h"
+#include "pattern.h"
+
+#include <regex.h>
+#include <string.h>
+
+#define ERE_ICASE (REG_EXTENDED | REG_ICASE)
+
+static int literal_index(const PatternLiteralSet *literals, const char *text) {
+    for (size_t i = 0; i < literals->count; ++i) {
+        if (strcmp(literals->items[i], text) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static PatternLiteralSet literals_for(const char *pattern) {
+    PatternNode *root = pattern_parse(pattern, ERE_ICASE);
+    TEST_ASSERT_NOT_NULL(root);
+    PatternLiteralSet literals;
+    TEST_ASSERT_EQUAL_INT(0, pattern_required_literals(root, &literals));
+    pattern_free(root);
+    return literals;
+}
+
+void test_pattern_parse_rejects_unsupported_syntax(void) {
+    TEST_ASSERT_NULL(pattern_parse("(a)\\1", ERE_ICASE));
+    TEST_ASSERT_NULL(pattern_parse("[[=a=]]", ERE_ICASE));
+    TEST_ASSERT_NULL(pattern_parse("*a", ERE_ICASE));
+    TEST_ASSERT_NULL(pattern_parse("a{2", ERE_ICASE));
+    TEST_ASSERT_NULL(pattern_parse("(ab", ERE_ICASE));
+}
+
+void test_pattern_icase_folds_before_negation(void) {
+    PatternNode *root = pattern_parse("[^A-Z]", ERE_ICASE);
+    TEST_ASSERT_NOT_NULL(root);
+    TEST_ASSERT_FALSE(pattern_charset_contains(root, 'a'));
+    TEST_ASSERT_FALSE(pattern_charset_contains(root, 'Q'));
+    TEST_ASSERT_TRUE(pattern_charset_contains(root, '_'));
+    TEST_ASSERT_TRUE(pattern_charset_contains(root, 0xC3));
+    pattern_free(root);
+}
+
+void test_pattern_min_length(void) {
+    PatternNode *root = pattern_parse("AKIA[0-9A-Z]{16}", ERE_ICASE);
+    TEST_ASSERT_NOT_NULL(root);
+    TEST_ASSERT_EQUAL_UINT(20u, (unsigned int)pattern_min_length(root));
+    pattern_free(root);
+
+    root = pattern_parse("(^|[^[:alnum:]_-])(access|refresh|id)?_?token", ERE_ICASE);
+    TEST_ASSERT_NOT_NULL(root);
+    TEST_ASSERT_EQUAL_UINT(5u, (unsigned int)pattern_min_length(root));
+    pattern_free(root);
+}
+
+void test_pattern_literals_after_anchor_group(void) {
+    PatternLiteralSet literals =
+        literals_for("(^|[^[:alnum:]_-])(password|passwort)[[:space:]]*[:=][[:space:]]*[^[:space:]]+");
+    TEST_ASSERT_EQUAL_UINT(2u, (unsigned int)literals.count);
+    TEST_ASSERT_TRUE(literal_index(&literals, "password") >= 0);
+    TEST_ASSERT_TRUE(literal_index(&literals, "passwort") >= 0);
+    pattern_literal_set_free(&literals);
+}
+
+void test_pattern_literals_expand_small_classes(void) {
+    PatternLiteralSet literals = literals_for("gh[ousr]_[A-Za-z0-9]{36,}");
+    TEST_ASSERT_EQUAL_UINT(4u, (unsigned int)literals.count);
+    TEST_ASSERT_TRUE(literal_index(&literals, "ghu_") >= 0);
+    pattern_literal_set_free(&literals);
+}
+
+void test_pattern_literals_pick_most_selective(void) {
+    PatternLiteralSet literals = literals_for("[0-9]+-[A-Za-z0-9_]+\\.apps\\.googleusercontent\\.com");
+    TEST_ASSERT_EQUAL_UINT(1u, (unsigned int)literals.count);
+    TEST_ASSERT_EQUAL_STRING(".apps.googleusercontent.com", literals.items[0]);
+    pattern_literal_set_free(&literals);
+}
+
+void test_pattern_literals_none_for_optional_branch(void) {
+    PatternLiteralSet literals = literals_for("(abc|[0-9]+)x?");
+    TEST_ASSERT_EQUAL_UINT(0u, (unsigned int)literals.count);
+    pattern_literal_set_free(&literals);
+}
+
+void run_pattern_tests(void) {
+    RUN_TEST(test_pattern_parse_rejects_unsupported_syntax);
+    RUN_TEST(test_pattern_icase_folds_before_negation);
+    RUN_TEST(test_pattern_min_length);
+    RUN_TEST(test_pattern_literals_after_anchor_group);
+    RUN_TEST(test_pattern_literals_expand_small_classes);
+    RUN_TEST(test_pattern_literals_pick_most_selective);
+    RUN_TEST(test_pattern_literals_none_for_optional_branch);
+}
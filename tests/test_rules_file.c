@@ -0,0 +1,112 @@
+#include "unity.h"
+#include "rules_file.h"
+
+#include <regex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "test_utils.h"
+
+static int load_text(const char *text, RulesFile *file) {
+    char *root = test_make_temp_dir();
+    TEST_ASSERT_NOT_NULL(root);
+    char *path = test_join_path(root, "team.rules");
+    TEST_ASSERT_EQUAL_INT(0, test_write_file(path, text));
+    int result = rules_file_load(path, file);
+    test_remove_tree(root);
+    free(path);
+    free(root);
+    return result;
+}
+
+void test_rules_file_parses_rules(void) {
+    RulesFile file;
+    TEST_ASSERT_EQUAL_INT(0, load_text("# comment\n"
+                                       "\n"
+                                       "  ACME_KEY  high\t-  acme_[0-9a-f]{16} (x|y)  \r\n"
+                                       "OTHER Low icase other\n"
+                                       "TOKEN HIGH token,icase tok_[a-z]{8,}\n"
+                                       "DOC LOW json \"kind\": \"key\"\n"
+                                       "CERT HIGH icase,pem_block -----BEGIN CERT-----\n",
+                                       &file));
+    TEST_ASSERT_EQUAL_UINT(5u, (unsigned int)file.count);
+    TEST_ASSERT_FALSE(file.replace_defaults);
+    TEST_ASSERT_EQUAL_STRING("ACME_KEY", file.rules[0].name);
+    TEST_ASSERT_EQUAL_INT(SEVERITY_HIGH, file.rules[0].severity);
+    TEST_ASSERT_EQUAL_STRING("acme_[0-9a-f]{16} (x|y)", file.rules[0].pattern);
+    TEST_ASSERT_EQUAL_INT(REG_EXTENDED, file.rules[0].flags);
+    TEST_ASSERT_EQUAL_INT(SEVERITY_LOW, file.rules[1].severity);
+    TEST_ASSERT_EQUAL_INT(REG_EXTENDED | REG_ICASE, file.rules[1].flags);
+    TEST_ASSERT_EQUAL_INT(REG_EXTENDED | REG_ICASE | RULES_FLAG_TOKEN, file.rules[2].flags);
+    TEST_ASSERT_EQUAL_INT(REG_EXTENDED | RULES_FLAG_JSON, file.rules[3].flags);
+    TEST_ASSERT_EQUAL_INT(REG_EXTENDED | REG_ICASE | RULES_FLAG_PEM_BLOCK, file.rules[4].flags);
+    rules_file_free(&file);
+
+    TEST_ASSERT_EQUAL_INT(0, load_text("@replace-defaults\nONLY MEDIUM - x+", &file));
+    TEST_ASSERT_TRUE(file.replace_defaults);
+    TEST_ASSERT_EQUAL_UINT(1u, (unsigned int)file.count);
+    TEST_ASSERT_EQUAL_STRING("x+", file.rules[0].pattern);
+    rules_file_free(&file);
+}
+
+void test_rules_file_rejects_invalid_lines(void) {
+    int saved_stderr = -1;
+    TEST_ASSERT_EQUAL_INT(0, test_redirect_stderr_to_null(&saved_stderr));
+
+    const char *invalid[] = {
+        "ACME_KEY HIGH -\n",
+        "ACME_KEY SEVERE - acme\n",
+        "ACME_KEY HIGH nocase acme\n",
+        "ACME_KEY HIGH - acme(\n",
+        "ACME_KEY HIGH - acme\nACME_KEY LOW - other\n",
+        "ACME_KEY HIGH token acme_(a|b)+\n",
+        "ACME_KEY HIGH icase, acme\n",
+        "ACME_KEY HIGH pem_block,yaml_block acme\n",
+    };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i) {
+        RulesFile file;
+        TEST_ASSERT_EQUAL_INT(-1, load_text(invalid[i], &file));
+        TEST_ASSERT_NULL(file.rules);
+        TEST_ASSERT_NULL(file.text);
+    }
+
+    test_restore_stderr(saved_stderr);
+}
+
+void test_rules_file_rejects_duplicate_names(void) {
+    // Apart, and with the name of a built-in rule: the second line with a
+    // name is reported with its line number.
+    FILE *errors = tmpfile();
+    TEST_ASSERT_NOT_NULL(errors);
+    fflush(stderr);
+    int saved_stderr = dup(STDERR_FILENO);
+    TEST_ASSERT_TRUE(saved_stderr >= 0);
+    TEST_ASSERT_TRUE(dup2(fileno(errors), STDERR_FILENO) >= 0);
+
+    RulesFile file;
+    int result = load_text("AWS_ACCESS_KEY_ID HIGH - AKIA[0-9A-Z]{16}\n"
+                           "OTHER LOW - other\n"
+                           "# comment\n"
+                           "AWS_ACCESS_KEY_ID LOW - ASIA[0-9A-Z]{16}\n",
+                           &file);
+    fflush(stderr);
+    dup2(saved_stderr, STDERR_FILENO);
+    close(saved_stderr);
+    TEST_ASSERT_EQUAL_INT(-1, result);
+    TEST_ASSERT_NULL(file.rules);
+
+    char message[256] = "";
+    rewind(errors);
+    size_t length = fread(message, 1, sizeof(message) - 1, errors);
+    message[length] = '\0';
+    fclose(errors);
+    TEST_ASSERT_NOT_NULL(strstr(message, "line 4: duplicate rule AWS_ACCESS_KEY_ID"));
+}
+
+void run_rules_file_tests(void) {
+    RUN_TEST(test_rules_file_parses_rules);
+    RUN_TEST(test_rules_file_rejects_invalid_lines);
+    RUN_TEST(test_rules_file_rejects_duplicate_names);
+}
@@ -0,0 +1,96 @@
+#include "unity.h"
+#include "token_rule.h"
+
+#include <regex.h>
+#include <string.h>
+
+static void compile_token(const char *pattern, int flags, TokenRule *rule) {
+    PatternNode *root = pattern_parse(pattern, flags);
+    TEST_ASSERT_NOT_NULL(root);
+    TEST_ASSERT_TRUE(token_rule_compile(root, rule));
+    pattern_free(root);
+}
+
+static bool is_token_shape(const char *pattern) {
+    PatternNode *root = pattern_parse(pattern, REG_EXTENDED);
+    TEST_ASSERT_NOT_NULL(root);
+    TokenRule rule;
+    bool result = token_rule_compile(root, &rule);
+    pattern_free(root);
+    return result;
+}
+
+void test_token_rule_recognizes_shape(void) {
+    TEST_ASSERT_TRUE(is_token_shape("AKIA[0-9A-Z]{16}"));
+    TEST_ASSERT_TRUE(is_token_shape("gh[ousr]_[A-Za-z0-9]{36,}"));
+    TEST_ASSERT_TRUE(is_token_shape("x{3}y*"));
+    TEST_ASSERT_FALSE(is_token_shape("[0-9]+"));
+    TEST_ASSERT_FALSE(is_token_shape("ab"));
+    TEST_ASSERT_FALSE(is_token_shape("a+b+"));
+    TEST_ASSERT_FALSE(is_token_shape("^ab+"));
+    TEST_ASSERT_FALSE(is_token_shape("(ab|cd)e+"));
+    TEST_ASSERT_FALSE(is_token_shape("a{33}b+"));
+}
+
+void test_token_rule_agrees_with_regexec(void) {
+    const char *patterns[] = {
+        "AKIA[0-9A-Z]{16}",
+        "xox[baprs]-[A-Za-z0-9-]{3,5}",
+        "gh[ousr]_[A-Za-z0-9]{4,}",
+        "aab{2}",
+        "ab[a-z]*",
+    };
+    const char *texts[] = {
+        "",
+        "akia1234567890abcdef",
+        "AKIA1234567890ABCDE AKIA1234567890ABCDEFGH",
+        "xoxb-ab xoxp-abcdefgh xoxz-abcd",
+        "ghp_abc ghs_abcdefghij_ gh_abcd",
+        "aaabbb aabb",
+        "xab abc",
+    };
+    const int flag_sets[] = {REG_EXTENDED, REG_EXTENDED | REG_ICASE};
+    for (size_t f = 0; f < sizeof(flag_sets) / sizeof(flag_sets[0]); ++f) {
+        for (size_t p = 0; p < sizeof(patterns) / sizeof(patterns[0]); ++p) {
+            TokenRule rule;
+            compile_token(patterns[p], flag_sets[f], &rule);
+            TEST_ASSERT_TRUE(token_rule_check(&rule));
+            regex_t regex;
+            TEST_ASSERT_EQUAL_INT(0, regcomp(&regex, patterns[p], flag_sets[f]));
+            for (size_t t = 0; t < sizeof(texts) / sizeof(texts[0]); ++t) {
+                regmatch_t match;
+                bool expected = regexec(&regex, texts[t], 1, &match, 0) == 0;
+                size_t start = 0;
+                size_t end = 0;
+                TEST_ASSERT_EQUAL(expected, token_rule_find(&rule, texts[t], strlen(texts[t]), &start, &end));
+                if (expected) {
+                    TEST_ASSERT_EQUAL_UINT((unsigned int)match.rm_so, (unsigned int)start);
+                    TEST_ASSERT_EQUAL_UINT((unsigned int)match.rm_eo, (unsigned int)end);
+                }
+            }
+            regfree(&regex);
+        }
+    }
+}
+
+void test_token_rule_check_rejects_damage(void) {
+    TokenRule rule;
+    compile_token("ab[0-9]{2}", REG_EXTENDED, &rule);
+    TEST_ASSERT_TRUE(token_rule_check(&rule));
+
+    TokenRule damaged = rule;
+    damaged.prefix_length = 0;
+    TEST_ASSERT_FALSE(token_rule_check(&damaged));
+    damaged = rule;
+    damaged.prefix['c'] = 1u << 5;
+    TEST_ASSERT_FALSE(token_rule_check(&damaged));
+    damaged = rule;
+    damaged.run_min = 3;
+    TEST_ASSERT_FALSE(token_rule_check(&damaged));
+}
+
+void run_token_rule_tests(void) {
+    RUN_TEST(test_token_rule_recognizes_shape);
+    RUN_TEST(test_token_rule_agrees_with_regexec);
+    RUN_TEST(test_token_rule_check_rejects_damage);
+}
@@ -16,6 +16,14 @@ static int count_files_callback(const char *path, void *user_data) {
     return 0;
 }
 
+static int sum_sizes_callback(const char *path, uint64_t size, void *user_data) {
+    (void)path;
+    uint64_t *totals = (uint64_t *)user_data;
+    totals[0]++;
+    totals[1] += size;
+    return 0;
+}
+
 static size_t count_files_with_depth(const char *root_path, int max_depth) {
     Config config;
     init_walk_config(&config, root_path, max_depth);
@@ -74,6 +82,18 @@ void test_walk_depth_counts(void) {
     cleanup_walk_fixture(root);
 }
 
+void test_walk_sized_reports_file_sizes(void) {
+    char *root = create_walk_fixture();
+    Config config;
+    init_walk_config(&config, root, -1);
+    uint64_t totals[2] = {0, 0};
+    TEST_ASSERT_EQUAL_INT(0, walk_path_sized(&config, sum_sizes_callback, totals));
+    TEST_ASSERT_TRUE(totals[0] == 5);
+    TEST_ASSERT_TRUE(totals[1] == 14);
+    free_config(&config);
+    cleanup_walk_fixture(root);
+}
+
 void test_walk_missing_root_returns_error(void) {
     const char *missing = "build/test_missing_root";
     test_remove_tree(missing);
@@ -108,6 +128,7 @@ void test_walk_root_file_counts_once(void) {
 
 void run_walk_tests(void) {
     RUN_TEST(test_walk_depth_counts);
+    RUN_TEST(test_walk_sized_reports_file_sizes);
     RUN_TEST(test_walk_missing_root_returns_error);
     RUN_TEST(test_walk_root_file_counts_once);
 }
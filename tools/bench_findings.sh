@@ -0,0 +1,50 @@
+#!/bin/sh
+# Measure how scan and report time grow with the number of findings.
+#
+# Usage: tools/bench_findings.sh
+# Environment:
+#   BENCH_FINDINGS  finding counts to try (default: 12500 25000 50000 100000)
+#   BENCH_DIR       where to write the files (default: a fresh temp dir)
+#
+# Each file is a leaked dump with one AWS key per line, scanned with one
+# thread so the time is the matching plus storing and sorting the
+# findings. Time per finding should stay flat as the count doubles.
+
+set -eu
+
+BIN=${BIN:-./secretguard}
+COUNTS=${BENCH_FINDINGS:-12500 25000 50000 100000}
+
+if [ ! -x "$BIN" ]; then
+    echo "bench_findings: $BIN not found, run make first" >&2
+    exit 1
+fi
+
+CLEANUP=
+if [ -z "${BENCH_DIR:-}" ]; then
+    BENCH_DIR=$(mktemp -d "${TMPDIR:-/tmp}/secretguard-findings.XXXXXX")
+    CLEANUP=$BENCH_DIR
+fi
+trap '[ -n "$CLEANUP" ] && rm -rf "$CLEANUP"' EXIT INT TERM
+
+now() {
+    date +%s.%N
+}
+
+printf "%10s %10s %14s\n" findings seconds "us/finding"
+for count in $COUNTS; do
+    file="$BENCH_DIR/dump_$count.txt"
+    awk -v count="$count" 'BEGIN {
+        for (n = 0; n < count; n++) {
+            printf "user_%d aws_key = AKIA%016d\n", n, n;
+        }
+    }' > "$file"
+    cat "$file" > /dev/null
+    start=$(now)
+    "$BIN" --threads 1 --json --out /dev/null "$file" > /dev/null 2>&1 || true
+    end=$(now)
+    awk -v start="$start" -v end="$end" -v count="$count" 'BEGIN {
+        seconds = end - start;
+        printf "%10d %10.3f %14.2f\n", count, seconds, seconds / count * 1e6;
+    }'
+done
@@ -0,0 +1,92 @@
+#!/bin/sh
+# Measure how scan throughput scales with --threads on a CPU-bound corpus.
+#
+# Usage: tools/bench_threads.sh [ENGINE...]
+# Environment:
+#   BENCH_FILES    number of generated files (default: 64)
+#   BENCH_LINES    lines per file (default: 20000)
+#   BENCH_THREADS  thread counts to try (default: 1 2 4 ... up to 2x CPUs)
+#   BENCH_DIR      where to build the corpus (default: a fresh temp dir)
+#
+# The corpus is generated once and read before the first run so every
+# measurement comes from the page cache and only the matching work counts.
+
+set -eu
+
+BIN=${BIN:-./secretguard}
+FILES=${BENCH_FILES:-64}
+LINES=${BENCH_LINES:-20000}
+ENGINES=${*:-regex native generated}
+
+if [ ! -x "$BIN" ]; then
+    echo "bench_threads: $BIN not found, run make first" >&2
+    exit 1
+fi
+
+CPUS=$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1)
+if [ -z "${BENCH_THREADS:-}" ]; then
+    BENCH_THREADS=1
+    count=2
+    while [ "$count" -le $((CPUS * 2)) ]; do
+        BENCH_THREADS="$BENCH_THREADS $count"
+        count=$((count * 2))
+    done
+fi
+
+CLEANUP=
+if [ -z "${BENCH_DIR:-}" ]; then
+    BENCH_DIR=$(mktemp -d "${TMPDIR:-/tmp}/secretguard-bench.XXXXXX")
+    CLEANUP=$BENCH_DIR
+fi
+trap '[ -n "$CLEANUP" ] && rm -rf "$CLEANUP"' EXIT INT TERM
+
+# Mostly ordinary config and source lines, with keywords the prefilters
+# cannot dismiss and an occasional real finding.
+i=0
+while [ "$i" -lt "$FILES" ]; do
+    awk -v lines="$LINES" -v seed="$i" 'BEGIN {
+        srand(seed + 1);
+        for (n = 0; n < lines; n++) {
+            r = int(rand() * 100);
+            if (r < 40) {
+                printf "    result = compute_value(item_%d, offset + %d); // update token cache\n", n, r;
+            } else if (r < 70) {
+                printf "config.password_policy = \"min_length=%d\"  # secret rotation: monthly\n", r;
+            } else if (r < 90) {
+                printf "Authorization header is built from the api_key setting at line %d\n", n;
+            } else if (r < 99) {
+                printf "%s\n", "lorem ipsum dolor sit amet consectetur adipiscing elit sed do eiusmod tempor";
+            } else {
+                printf "aws_key = AKIA%016d\n", n;
+            }
+        }
+    }' > "$BENCH_DIR/file_$i.txt"
+    i=$((i + 1))
+done
+cat "$BENCH_DIR"/*.txt > /dev/null
+BYTES=$(cat "$BENCH_DIR"/*.txt | wc -c)
+
+now() {
+    date +%s.%N
+}
+
+echo "corpus: $FILES files, $BYTES bytes, $CPUS CPUs"
+for engine in $ENGINES; do
+    echo
+    echo "engine: $engine"
+    printf "%8s %10s %10s %8s\n" threads seconds MB/s speedup
+    base=
+    for threads in $BENCH_THREADS; do
+        start=$(now)
+        "$BIN" --engine "$engine" --threads "$threads" --json --out /dev/null "$BENCH_DIR" > /dev/null 2>&1
+        end=$(now)
+        awk -v start="$start" -v end="$end" -v bytes="$BYTES" -v threads="$threads" -v base="$base" 'BEGIN {
+            seconds = end - start;
+            if (base == "") base = seconds;
+            printf "%8d %10.3f %10.1f %7.2fx\n", threads, seconds, bytes / seconds / 1e6, base / seconds;
+        }'
+        if [ -z "$base" ]; then
+            base=$(awk -v start="$start" -v end="$end" 'BEGIN { print end - start }')
+        fi
+    done
+done
@@ -0,0 +1,675 @@
+// Build-time generator: turns include/default_rules.def into C matchers.
+// Every rule gets an anchored DFA emitted as a switch-based function that
+// finds leftmost-longest matches. Candidate rules are picked by one
+// table-driven pass over the line with an unanchored DFA. The exact
+// patterns of all rules together would need far too many states (their
+// counted tails multiply), so the group starts from the required literals
+// of each rule and then swaps in exact patterns, shortest literal first,
+// while the state limit allows. A group is split only if even the literal
+// automaton does not fit.
+//
+// Usage: rules_codegen OUTPUT.c
+
+#include <regex.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lazy_dfa.h"
+#include "pattern.h"
+#include "rules.h"
+
+// Upper bound on states of one group's marking DFA (uint16_t transitions).
+#define RULES_CODEGEN_GROUP_STATES 4096
+// Upper bound on states of one rule's anchored DFA.
+#define RULES_CODEGEN_RULE_STATES 4096
+
+typedef struct {
+    const char *name;
+    const char *pattern;
+    int flags;
+} SourceRule;
+
+static const SourceRule SOURCE_RULES[] = {
+#define DEFAULT_RULE(name, severity, pattern, flags) {name, pattern, flags},
+#include "default_rules.def"
+#undef DEFAULT_RULE
+};
+
+#define SOURCE_RULE_COUNT (sizeof(SOURCE_RULES) / sizeof(SOURCE_RULES[0]))
+
+typedef struct {
+    size_t source;
+    PatternNode *root;
+    // Alternation of the required literals and the length of the shortest.
+    PatternNode *literal_root;
+    size_t literal_length;
+    // Pattern used for marking: root, literal_root, or NULL to mark every line.
+    PatternNode *mark_root;
+    LazyDfaTable anchored;
+} GeneratedRule;
+
+typedef struct {
+    LazyDfaTable table;
+    // Generated rule indices; pattern i of the table is members[i].
+    size_t members[SOURCE_RULE_COUNT];
+    size_t count;
+} RuleGroup;
+
+static void emit_string(FILE *out, const char *text) {
+    fputc('"', out);
+    for (const unsigned char *ptr = (const unsigned char *)text; *ptr; ++ptr) {
+        if (*ptr == '"' || *ptr == '\\') {
+            fprintf(out, "\\%c", *ptr);
+        } else if (*ptr < 0x20 || *ptr > 0x7e) {
+            fprintf(out, "\\%03o", *ptr);
+        } else {
+            fputc(*ptr, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void emit_flags(FILE *out, int flags) {
+    const char *separator = "";
+    if (flags & REG_EXTENDED) {
+        fprintf(out, "%sREG_EXTENDED", separator);
+        separator = " | ";
+    }
+    if (flags & REG_ICASE) {
+        fprintf(out, "%sREG_ICASE", separator);
+        separator = " | ";
+    }
+    if (separator[0] == '\0') {
+        fprintf(out, "0");
+    }
+}
+
+static void emit_byte_array(FILE *out, const char *name, const unsigned char *values, size_t count) {
+    fprintf(out, "static const unsigned char %s[%zu] = {", name, count);
+    for (size_t i = 0; i < count; ++i) {
+        fprintf(out, "%s%u,", i % 16 == 0 ? "\n    " : " ", values[i]);
+    }
+    fprintf(out, "\n};\n\n");
+}
+
+// Offsets (count + 1 entries) and ids of per-state match lists. A trailing 0
+// keeps the id array non-empty.
+static void emit_id_lists(FILE *out,
+                          const char *prefix,
+                          const char *kind,
+                          const LazyDfaTable *table,
+                          const size_t *offsets,
+                          const size_t *counts,
+                          const size_t *local_of_id) {
+    size_t total = 0;
+    fprintf(out, "static const uint32_t %s_%s_start[%zu] = {", prefix, kind, table->state_count + 1);
+    for (size_t state = 0; state <= table->state_count; ++state) {
+        fprintf(out, "%s%zu,", state % 16 == 0 ? "\n    " : " ", total);
+        if (state < table->state_count) {
+            total += counts[state];
+        }
+    }
+    fprintf(out, "\n};\n\n");
+    fprintf(out, "static const uint16_t %s_%s_ids[%zu] = {", prefix, kind, total + 1);
+    size_t position = 0;
+    for (size_t state = 0; state < table->state_count; ++state) {
+        for (size_t j = 0; j < counts[state]; ++j) {
+            fprintf(out, "%s%zu,", position % 16 == 0 ? "\n    " : " ",
+                    local_of_id[table->ids[offsets[state] + j]]);
+            position++;
+        }
+    }
+    fprintf(out, "%s0\n};\n\n", position % 16 == 0 ? "\n    " : " ");
+}
+
+static void emit_group(FILE *out,
+                       size_t index,
+                       const GeneratedRule *rules,
+                       const RuleGroup *group,
+                       const size_t *local_of_id) {
+    const LazyDfaTable *table = &group->table;
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "group_%zu", index);
+
+    size_t exact = 0;
+    for (size_t i = 0; i < group->count; ++i) {
+        if (rules[group->members[i]].mark_root == rules[group->members[i]].root) {
+            exact++;
+        }
+    }
+    fprintf(out, "// Group %zu: %zu rules (%zu exact, the rest by literal), %zu states, %zu byte classes.\n",
+            index, group->count, exact, table->state_count, table->class_count);
+    char name[64];
+    snprintf(name, sizeof(name), "%s_class", prefix);
+    emit_byte_array(out, name, table->class_of, 256);
+
+    fprintf(out, "static const uint16_t %s_next[%zu][%zu] = {\n", prefix, table->state_count, table->class_count);
+    for (size_t state = 0; state < table->state_count; ++state) {
+        fprintf(out, "    {");
+        for (size_t c = 0; c < table->class_count; ++c) {
+            fprintf(out, "%s%u", c == 0 ? "" : ", ", table->next[state * table->class_count + c]);
+        }
+        fprintf(out, "},\n");
+    }
+    fprintf(out, "};\n\n");
+
+    emit_id_lists(out, prefix, "match", table, table->match_offset, table->match_count, local_of_id);
+    emit_id_lists(out, prefix, "eol", table, table->eol_offset, table->eol_count, local_of_id);
+
+    fprintf(out, "static void mark_%s(const unsigned char *text, size_t length, unsigned char *marks) {\n", prefix);
+    fprintf(out, "    unsigned int state = %u;\n", table->start);
+    fprintf(out, "    mark_ids(%s_match_ids, %s_match_start, state, marks);\n", prefix, prefix);
+    fprintf(out, "    if (length == 0) {\n");
+    for (size_t j = 0; j < table->empty_count; ++j) {
+        fprintf(out, "        marks[%zu] = 1;\n", local_of_id[table->ids[table->empty_offset + j]]);
+    }
+    fprintf(out, "        return;\n");
+    fprintf(out, "    }\n");
+    fprintf(out, "    for (size_t i = 0; i < length; ++i) {\n");
+    fprintf(out, "        state = %s_next[state][%s_class[text[i]]];\n", prefix, prefix);
+    fprintf(out, "        if (%s_match_start[state] != %s_match_start[state + 1]) {\n", prefix, prefix);
+    fprintf(out, "            mark_ids(%s_match_ids, %s_match_start, state, marks);\n", prefix, prefix);
+    fprintf(out, "        }\n");
+    fprintf(out, "    }\n");
+    fprintf(out, "    mark_ids(%s_eol_ids, %s_eol_start, state, marks);\n", prefix, prefix);
+    fprintf(out, "}\n\n");
+}
+
+static void emit_byte_condition(FILE *out, unsigned int low, unsigned int high) {
+    if (low == high) {
+        fprintf(out, "byte == 0x%02x", low);
+    } else if (low == 0) {
+        fprintf(out, "byte <= 0x%02x", high);
+    } else if (high == 255) {
+        fprintf(out, "byte >= 0x%02x", low);
+    } else {
+        fprintf(out, "(byte >= 0x%02x && byte <= 0x%02x)", low, high);
+    }
+}
+
+// One case per live state: byte ranges with the same target become one
+// condition, everything else leads to the dead state.
+static void emit_state_case(FILE *out, const LazyDfaTable *table, uint32_t state, uint32_t dead) {
+    uint32_t targets[256];
+    for (unsigned int byte = 0; byte < 256; ++byte) {
+        targets[byte] = table->next[(size_t)state * table->class_count + table->class_of[byte]];
+    }
+
+    fprintf(out, "            case %u:\n", state);
+    bool first = true;
+    bool all_live = true;
+    for (unsigned int byte = 0; byte < 256; ++byte) {
+        if (targets[byte] == dead) {
+            all_live = false;
+        }
+    }
+    if (all_live) {
+        bool uniform = true;
+        for (unsigned int byte = 1; byte < 256; ++byte) {
+            if (targets[byte] != targets[0]) {
+                uniform = false;
+            }
+        }
+        if (uniform) {
+            fprintf(out, "                state = %u;\n", targets[0]);
+            fprintf(out, "                break;\n");
+            return;
+        }
+    }
+
+    // Group the ranges by target so each target gets one condition.
+    bool emitted[256] = {false};
+    for (unsigned int byte = 0; byte < 256; ++byte) {
+        uint32_t target = targets[byte];
+        if (target == dead || emitted[byte]) {
+            continue;
+        }
+        fprintf(out, "                %sif (", first ? "" : "} else ");
+        first = false;
+        bool first_range = true;
+        unsigned int low = byte;
+        while (low < 256) {
+            if (targets[low] != target) {
+                low++;
+                continue;
+            }
+            unsigned int high = low;
+            while (high + 1 < 256 && targets[high + 1] == target) {
+                high++;
+            }
+            for (unsigned int marked = low; marked <= high; ++marked) {
+                emitted[marked] = true;
+            }
+            if (!first_range) {
+                fprintf(out, " ||\n                    ");
+            }
+            emit_byte_condition(out, low, high);
+            first_range = false;
+            low = high + 1;
+        }
+        fprintf(out, ") {\n");
+        fprintf(out, "                    state = %u;\n", target);
+    }
+    if (first) {
+        fprintf(out, "                state = %u;\n", dead);
+    } else {
+        fprintf(out, "                } else {\n");
+        fprintf(out, "                    state = %u;\n", dead);
+        fprintf(out, "                }\n");
+    }
+    fprintf(out, "                break;\n");
+}
+
+static void emit_rule_finder(FILE *out, size_t index, const GeneratedRule *rule) {
+    const LazyDfaTable *table = &rule->anchored;
+    // Without a dead state the scan runs to the end; use an unused index.
+    uint32_t dead = table->dead != UINT32_MAX ? table->dead : (uint32_t)table->state_count;
+
+    unsigned char *accept = calloc(table->state_count, 1);
+    if (!accept) {
+        return;
+    }
+    for (size_t state = 0; state < table->state_count; ++state) {
+        accept[state] = (unsigned char)((table->match_count[state] > 0 ? 1 : 0) |
+                                        (table->eol_count[state] > 0 ? 2 : 0));
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "rule_%zu_accept", index);
+    fprintf(out, "// %s: %zu anchored states.\n", SOURCE_RULES[rule->source].name, table->state_count);
+    emit_byte_array(out, name, accept, table->state_count);
+
+    // Bytes that can begin a match after position 0; unused if the pattern
+    // can match the empty string there.
+    bool filter = accept[table->start_inner] == 0;
+    if (filter) {
+        unsigned char first[256];
+        for (unsigned int byte = 0; byte < 256; ++byte) {
+            first[byte] = table->next[(size_t)table->start_inner * table->class_count + table->class_of[byte]] != dead;
+        }
+        snprintf(name, sizeof(name), "rule_%zu_first", index);
+        emit_byte_array(out, name, first, 256);
+    }
+    free(accept);
+
+    fprintf(out, "static bool find_rule_%zu(const unsigned char *text, size_t length, size_t *start, size_t *end) {\n", index);
+    fprintf(out, "    for (size_t from = 0; from <= length; ++from) {\n");
+    if (filter) {
+        fprintf(out, "        if (from > 0 && from < length && !rule_%zu_first[text[from]]) {\n", index);
+        fprintf(out, "            continue;\n");
+        fprintf(out, "        }\n");
+    }
+    fprintf(out, "        unsigned int state = from == 0 ? %uu : %uu;\n", table->start, table->start_inner);
+    fprintf(out, "        size_t last = SIZE_MAX;\n");
+    fprintf(out, "        size_t i = from;\n");
+    fprintf(out, "        for (;;) {\n");
+    fprintf(out, "            if (rule_%zu_accept[state] & 1) {\n", index);
+    fprintf(out, "                last = i;\n");
+    fprintf(out, "            }\n");
+    fprintf(out, "            if (i == length) {\n");
+    fprintf(out, "                bool at_end = length == 0 ? %s : (rule_%zu_accept[state] & 2) != 0;\n",
+            table->empty_count > 0 ? "true" : "false", index);
+    fprintf(out, "                if (at_end) {\n");
+    fprintf(out, "                    last = length;\n");
+    fprintf(out, "                }\n");
+    fprintf(out, "                break;\n");
+    fprintf(out, "            }\n");
+    fprintf(out, "            unsigned char byte = text[i++];\n");
+    fprintf(out, "            switch (state) {\n");
+    for (uint32_t state = 0; state < table->state_count; ++state) {
+        if (state != dead) {
+            emit_state_case(out, table, state, dead);
+        }
+    }
+    fprintf(out, "            default:\n");
+    fprintf(out, "                state = %u;\n", dead);
+    fprintf(out, "                break;\n");
+    fprintf(out, "            }\n");
+    fprintf(out, "            if (state == %uu) {\n", dead);
+    fprintf(out, "                break;\n");
+    fprintf(out, "            }\n");
+    fprintf(out, "        }\n");
+    fprintf(out, "        if (last != SIZE_MAX) {\n");
+    fprintf(out, "            *start = from;\n");
+    fprintf(out, "            *end = last;\n");
+    fprintf(out, "            return true;\n");
+    fprintf(out, "        }\n");
+    fprintf(out, "    }\n");
+    fprintf(out, "    return false;\n");
+    fprintf(out, "}\n\n");
+}
+
+// NULL-terminated list of the literals, one of which every match contains.
+static void emit_literals(FILE *out, size_t index, const GeneratedRule *rule) {
+    PatternLiteralSet literals;
+    if (pattern_required_literals(rule->root, &literals) != 0) {
+        // An empty list only costs the line filter its precision.
+        literals.count = 0;
+        literals.items = NULL;
+    }
+    fprintf(out, "static const char *const rule_%zu_literals[] = {", index);
+    for (size_t i = 0; i < literals.count; ++i) {
+        emit_string(out, literals.items[i]);
+        fprintf(out, ", ");
+    }
+    fprintf(out, "NULL};\n\n");
+    pattern_literal_set_free(&literals);
+}
+
+static int export_group(const GeneratedRule *rules,
+                        const size_t *members,
+                        size_t count,
+                        size_t max_states,
+                        LazyDfaTable *table) {
+    PatternNode **patterns = calloc(count, sizeof(*patterns));
+    if (!patterns) {
+        return -1;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        patterns[i] = rules[members[i]].mark_root;
+    }
+    LazyDfa *dfa = lazy_dfa_create(patterns, count);
+    free(patterns);
+    if (!dfa) {
+        return -1;
+    }
+    int result = lazy_dfa_export(dfa, false, max_states, table);
+    lazy_dfa_destroy(dfa);
+    return result;
+}
+
+// Build "lit1|lit2|..." from the required literals of root. The literals
+// are lowercase, so the pattern is matched case-insensitively.
+static int literal_pattern(const PatternNode *root, PatternNode **out, size_t *shortest) {
+    *out = NULL;
+    *shortest = 0;
+    PatternLiteralSet literals;
+    if (pattern_required_literals(root, &literals) != 0) {
+        return -1;
+    }
+    size_t size = 1;
+    for (size_t i = 0; i < literals.count; ++i) {
+        size += strlen(literals.items[i]) * 2 + 1;
+    }
+    char *text = malloc(size);
+    if (!text) {
+        pattern_literal_set_free(&literals);
+        return -1;
+    }
+    size_t length = 0;
+    for (size_t i = 0; i < literals.count; ++i) {
+        if (i > 0) {
+            text[length++] = '|';
+        }
+        size_t literal_length = strlen(literals.items[i]);
+        if (*shortest == 0 || literal_length < *shortest) {
+            *shortest = literal_length;
+        }
+        for (const char *ptr = literals.items[i]; *ptr; ++ptr) {
+            if (strchr(".[]()*+?{}|^$\\", *ptr)) {
+                text[length++] = '\\';
+            }
+            text[length++] = *ptr;
+        }
+    }
+    text[length] = '\0';
+
+    int result = 0;
+    if (literals.count > 0) {
+        *out = pattern_parse(text, REG_EXTENDED | REG_ICASE);
+        result = *out ? 0 : -1;
+    }
+    free(text);
+    pattern_literal_set_free(&literals);
+    return result;
+}
+
+// Swap exact patterns into the group, rules with the shortest literal
+// (the most false candidates) first, as long as the DFA stays in bounds.
+static void refine_group(GeneratedRule *rules, RuleGroup *group) {
+    size_t order[SOURCE_RULE_COUNT];
+    size_t count = 0;
+    for (size_t i = 0; i < group->count; ++i) {
+        size_t member = group->members[i];
+        if (rules[member].mark_root == rules[member].root) {
+            continue;
+        }
+        // A rule that alone needs a large share of the limit never fits.
+        PatternNode *previous = rules[member].mark_root;
+        rules[member].mark_root = rules[member].root;
+        LazyDfaTable table;
+        if (export_group(rules, &member, 1, RULES_CODEGEN_GROUP_STATES / 32, &table) == 0) {
+            lazy_dfa_table_free(&table);
+            order[count++] = member;
+        }
+        rules[member].mark_root = previous;
+    }
+    for (size_t i = 1; i < count; ++i) {
+        size_t current = order[i];
+        size_t j = i;
+        while (j > 0 && rules[order[j - 1]].literal_length > rules[current].literal_length) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = current;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        GeneratedRule *rule = &rules[order[i]];
+        PatternNode *previous = rule->mark_root;
+        rule->mark_root = rule->root;
+        LazyDfaTable table;
+        if (export_group(rules, group->members, group->count, RULES_CODEGEN_GROUP_STATES, &table) == 0) {
+            lazy_dfa_table_free(&group->table);
+            group->table = table;
+        } else {
+            rule->mark_root = previous;
+        }
+    }
+}
+
+static int export_anchored(GeneratedRule *rule) {
+    PatternNode *patterns[1] = {rule->root};
+    LazyDfa *dfa = lazy_dfa_create(patterns, 1);
+    if (!dfa) {
+        return -1;
+    }
+    int result = lazy_dfa_export(dfa, true, RULES_CODEGEN_RULE_STATES, &rule->anchored);
+    lazy_dfa_destroy(dfa);
+    return result;
+}
+
+static void emit_file(FILE *out, const GeneratedRule *rules, size_t rule_count, const RuleGroup *groups, size_t group_count) {
+    fprintf(out, "// Generated by tools/rules_codegen.c from include/default_rules.def.\n");
+    fprintf(out, "// Do not edit: make rebuilds this file when the rule table changes.\n\n");
+    fprintf(out, "#include \"generated_rules.h\"\n\n");
+    fprintf(out, "#include <regex.h>\n");
+    fprintf(out, "#include <stdint.h>\n");
+    fprintf(out, "#include <string.h>\n\n");
+    fprintf(out, "typedef struct {\n");
+    fprintf(out, "    const char *pattern;\n");
+    fprintf(out, "    int flags;\n");
+    fprintf(out, "    size_t min_length;\n");
+    fprintf(out, "    bool (*find)(const unsigned char *text, size_t length, size_t *start, size_t *end);\n");
+    fprintf(out, "    const char *const *literals;\n");
+    fprintf(out, "} GeneratedRule;\n\n");
+    fprintf(out, "static void mark_ids(const uint16_t *ids, const uint32_t *starts, unsigned int state, unsigned char *marks) {\n");
+    fprintf(out, "    for (uint32_t i = starts[state]; i < starts[state + 1]; ++i) {\n");
+    fprintf(out, "        marks[ids[i]] = 1;\n");
+    fprintf(out, "    }\n");
+    fprintf(out, "}\n\n");
+
+    for (size_t g = 0; g < group_count; ++g) {
+        emit_group(out, g, rules, &groups[g], groups[g].members);
+    }
+
+    for (size_t i = 0; i < rule_count; ++i) {
+        emit_rule_finder(out, i, &rules[i]);
+        emit_literals(out, i, &rules[i]);
+    }
+
+    fprintf(out, "static const GeneratedRule GENERATED_RULES[] = {\n");
+    for (size_t i = 0; i < rule_count; ++i) {
+        const SourceRule *source = &SOURCE_RULES[rules[i].source];
+        fprintf(out, "    {");
+        emit_string(out, source->pattern);
+        fprintf(out, ", ");
+        emit_flags(out, source->flags);
+        fprintf(out, ", %zu, find_rule_%zu, rule_%zu_literals},\n", pattern_min_length(rules[i].root), i, i);
+    }
+    if (rule_count == 0) {
+        fprintf(out, "    {\"\", 0, 0, NULL, NULL},\n");
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "size_t generated_rules_count(void) {\n");
+    fprintf(out, "    return %zu;\n", rule_count);
+    fprintf(out, "}\n\n");
+    fprintf(out, "int generated_rules_lookup(const char *pattern, int flags) {\n");
+    fprintf(out, "    for (size_t i = 0; i < generated_rules_count(); ++i) {\n");
+    fprintf(out, "        if (GENERATED_RULES[i].flags == flags && strcmp(GENERATED_RULES[i].pattern, pattern) == 0) {\n");
+    fprintf(out, "            return (int)i;\n");
+    fprintf(out, "        }\n");
+    fprintf(out, "    }\n");
+    fprintf(out, "    return -1;\n");
+    fprintf(out, "}\n\n");
+    fprintf(out, "size_t generated_rules_min_length(size_t index) {\n");
+    fprintf(out, "    return index < generated_rules_count() ? GENERATED_RULES[index].min_length : 0;\n");
+    fprintf(out, "}\n\n");
+    fprintf(out, "const char *const *generated_rules_literals(size_t index) {\n");
+    fprintf(out, "    return index < generated_rules_count() ? GENERATED_RULES[index].literals : NULL;\n");
+    fprintf(out, "}\n\n");
+    fprintf(out, "void generated_rules_mark(const char *text, size_t length, unsigned char *marks) {\n");
+    fprintf(out, "    const unsigned char *bytes = (const unsigned char *)text;\n");
+    for (size_t g = 0; g < group_count; ++g) {
+        fprintf(out, "    mark_group_%zu(bytes, length, marks);\n", g);
+    }
+    for (size_t i = 0; i < rule_count; ++i) {
+        if (!rules[i].mark_root) {
+            fprintf(out, "    marks[%zu] = 1;\n", i);
+        }
+    }
+    if (group_count == 0) {
+        fprintf(out, "    (void)bytes;\n");
+        fprintf(out, "    (void)length;\n");
+        fprintf(out, "    (void)marks;\n");
+    }
+    fprintf(out, "}\n\n");
+    fprintf(out, "bool generated_rules_find(size_t index, const char *text, size_t length, size_t *start, size_t *end) {\n");
+    fprintf(out, "    if (index >= generated_rules_count() || !text) {\n");
+    fprintf(out, "        return false;\n");
+    fprintf(out, "    }\n");
+    fprintf(out, "    return GENERATED_RULES[index].find((const unsigned char *)text, length, start, end);\n");
+    fprintf(out, "}\n");
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s OUTPUT.c\n", argc > 0 ? argv[0] : "rules_codegen");
+        return 2;
+    }
+
+    GeneratedRule rules[SOURCE_RULE_COUNT];
+    RuleGroup groups[SOURCE_RULE_COUNT];
+    size_t rule_count = 0;
+    size_t group_count = 0;
+    memset(rules, 0, sizeof(rules));
+    memset(groups, 0, sizeof(groups));
+    int exit_code = 0;
+
+    // Rules outside the native subset stay with the runtime engine.
+    for (size_t i = 0; i < SOURCE_RULE_COUNT; ++i) {
+        GeneratedRule *rule = &rules[rule_count];
+        rule->source = i;
+        rule->root = pattern_parse(SOURCE_RULES[i].pattern, SOURCE_RULES[i].flags);
+        if (!rule->root || !lazy_dfa_supports(rule->root) || export_anchored(rule) != 0) {
+            fprintf(stderr, "rules_codegen: %s left to the runtime engine\n", SOURCE_RULES[i].name);
+            pattern_free(rule->root);
+            rule->root = NULL;
+            continue;
+        }
+        rule_count++;
+    }
+
+    for (size_t i = 0; i < rule_count && exit_code == 0; ++i) {
+        GeneratedRule *rule = &rules[i];
+        if (literal_pattern(rule->root, &rule->literal_root, &rule->literal_length) != 0) {
+            fprintf(stderr, "rules_codegen: out of memory\n");
+            exit_code = 1;
+            break;
+        }
+        rule->mark_root = rule->literal_root;
+        if (!rule->mark_root) {
+            // Without a literal only the exact pattern can mark the rule.
+            LazyDfaTable table;
+            rule->mark_root = rule->root;
+            if (export_group(rules, &i, 1, RULES_CODEGEN_GROUP_STATES, &table) == 0) {
+                lazy_dfa_table_free(&table);
+            } else {
+                rule->mark_root = NULL;
+                fprintf(stderr, "rules_codegen: %s is marked on every line\n", SOURCE_RULES[rule->source].name);
+            }
+        }
+    }
+
+    // Grow each group until its marking DFA would exceed the state limit.
+    for (size_t i = 0; i < rule_count && exit_code == 0; ++i) {
+        if (!rules[i].mark_root) {
+            continue;
+        }
+        bool placed = false;
+        while (!placed) {
+            RuleGroup *group = &groups[group_count];
+            group->members[group->count] = i;
+            LazyDfaTable table;
+            if (export_group(rules, group->members, group->count + 1, RULES_CODEGEN_GROUP_STATES, &table) == 0) {
+                lazy_dfa_table_free(&group->table);
+                group->table = table;
+                group->count++;
+                placed = true;
+            } else if (group->count > 0) {
+                group_count++;
+            } else {
+                fprintf(stderr, "rules_codegen: cannot build a marking DFA for %s\n",
+                        SOURCE_RULES[rules[i].source].name);
+                exit_code = 1;
+                break;
+            }
+        }
+    }
+    if (exit_code == 0 && groups[group_count].count > 0) {
+        group_count++;
+    }
+    for (size_t g = 0; g < group_count && exit_code == 0; ++g) {
+        refine_group(rules, &groups[g]);
+    }
+
+    FILE *out = NULL;
+    if (exit_code == 0) {
+        out = fopen(argv[1], "w");
+        if (!out) {
+            fprintf(stderr, "rules_codegen: cannot write %s\n", argv[1]);
+            exit_code = 1;
+        }
+    }
+    if (out) {
+        emit_file(out, rules, rule_count, groups, group_count);
+        if (fclose(out) != 0) {
+            fprintf(stderr, "rules_codegen: failed to write %s\n", argv[1]);
+            remove(argv[1]);
+            exit_code = 1;
+        }
+    }
+
+    for (size_t i = 0; i <= group_count && i < SOURCE_RULE_COUNT; ++i) {
+        lazy_dfa_table_free(&groups[i].table);
+    }
+    for (size_t i = 0; i < rule_count; ++i) {
+        lazy_dfa_table_free(&rules[i].anchored);
+        pattern_free(rules[i].literal_root);
+        pattern_free(rules[i].root);
+    }
+    return exit_code;
+}